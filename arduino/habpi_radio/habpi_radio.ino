@@ -8,7 +8,9 @@
  * NORMAL and EMERGENCY.
  *
  * The Arduino Pro Mini will listen for a messages on the SPI bus, and once a message is received,
- * it is validated against the provided checksum byte. If the checksum fails, the message is discarded.
+ * it is validated against the CRC-16 in the frame trailer. If the CRC fails, the message is discarded.
+ * Each frame ends with a sequence number and CRC-16/CCITT-FALSE, both little endian, which are
+ * broadcast with the message so the ground station can detect corrupt and lost frames.
  * If the message is a SENSOR type, a copy is saved into the EEPROM, overwriting any existing message.
  * The Arduino Pro Mini will then create an API Frame formatted message to send to the XBee 900HP radio.
  * In the event that the Arduino Pro Mini does not receive a messsage from the Raspberry Pi Zero after SPITIMEOUT,
@@ -16,15 +18,19 @@
  * and broadcast this message through the XBee radio. If a message from the Raspberry Pi Zero is detected
  * the Arduino Pro Mini will switch back to the NORMAL state.
  * The Arduino Pro Mini reads the voltage sensors, and allows the Raspberry Pi Zero to request these values.
+ * Uplink frames from the ground station, acknowledging the image chunks it has received, are read from the
+ * XBee between SPI sessions, validated against their CRC-16, and held until the Raspberry Pi Zero requests them
+ * with the UPLINK command; the Raspberry Pi Zero then resends only the missing chunks.
  *
  * This work is licensed under a Creative Commons 
  * Attribution-ShareAlike 4.0 International License.
  *
  * Author: Chris Capobianco
  * Date: 2017-06-18
- * Updated: 2018-08-07
+ * Updated: 2018-12-02
  */
 //#include <avr/power.h>
+#include <avr/pgmspace.h>
 #include <EEPROM.h>
 #include <SoftwareSerial.h>
 #include <SPI.h>
@@ -65,6 +71,7 @@ volatile unsigned long batteryTime = 0;
 #define SENSOR            (0x60)
 #define IMAGE             (0x70)
 #define BATTERY           (0x90)
+#define UPLINK            (0xA0)
 volatile uint8_t spiCommand = NUL;
 
 // SPI States
@@ -79,20 +86,47 @@ volatile uint8_t spiState = IDLE;
 #define READY             (0x1F)
 volatile uint8_t dataReady = PENDING;
 volatile uint8_t backupReady = PENDING;
+volatile uint8_t uplinkReady = PENDING;
 
-// Message checksum and buffer index
+// Message CRC and buffer index
 volatile uint8_t i = 0;
-volatile uint8_t chksum = 0;
+volatile uint16_t crc = 0xFFFF;
 
 // Message size (bytes)
-#define BROADCASTSIZE     (100) // *Not* including checksum
-#define IMAGESIZE         (100) // *Not* including checksum
-#define SENSORSIZE        (72)  // *Not* including checksum
-#define BATTERYSIZE       (9)   // Including checksum
+#define TRAILERSIZE       (4)   // Sequence number and CRC-16
+#define CRCSIZE           (2)
+#define BROADCASTSIZE     (100) // Including trailer
+#define IMAGESIZE         (100) // Including trailer
+#define SENSORSIZE        (76)  // Including trailer
+#define BATTERYSIZE       (12)  // Including trailer
+#define UPLINKSIZE        (42)  // Including trailer
 uint8_t sensorData[SENSORSIZE] = {0};
 uint8_t imageData[IMAGESIZE] = {0};
 uint8_t batteryData[BATTERYSIZE] = {0};
-//uint8_t batteryData[BATTERYSIZE] = {0xDB, 0x0F, 0x49, 0x40, 0xDB, 0x0F, 0xC9, 0x3F, 0x9A};
+uint8_t uplinkData[UPLINKSIZE] = {0};
+
+// Sequence number of the next battery frame
+uint16_t batterySeq = 0;
+
+// CRC-16/CCITT-FALSE table (poly 0x1021), one byte per step
+const uint16_t crcTable[256] PROGMEM = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6, 0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485, 0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4, 0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823, 0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12, 0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41, 0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70, 0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F, 0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E, 0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D, 0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C, 0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB, 0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A, 0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9, 0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8, 0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
 
 // Broadcast States
 #define NORMAL            (0)
@@ -124,6 +158,7 @@ uint8_t broadcastData[BROADCASTSIZE] = {0};
 XBeeAddress64 addr64 = XBeeAddress64(STATION_SH, STATION_SL);
 ZBTxRequest zbTx = ZBTxRequest(addr64, broadcastData, BROADCASTSIZE);
 ZBTxStatusResponse txStatus = ZBTxStatusResponse();
+ZBRxResponse rx = ZBRxResponse();
 
 // XBee AT Commands
 uint8_t atRE[2] = {'R','E'}; // Reset Settings
@@ -277,6 +312,11 @@ void loop(void) {
     readBatteryVoltages();
   }
 
+  // Read uplink frames between SPI sessions, so a frame being relayed is never overwritten
+  if (spiState == IDLE) {
+    readUplink();
+  }
+
   // Execute appropriate broadcast state
   if(broadcastState == NORMAL) {
     normalState();
@@ -344,7 +384,7 @@ void normalState() {
     if (abs(millis() - spiTimeout) > static_cast<unsigned long>(SPITIMEOUT)) {
       spiTimeout = millis();
       i = 0;
-      chksum = 0;
+      crc = 0xFFFF;
       spiState = IDLE;
       spiCommand = NUL;
       SPDR = NUL;
@@ -446,7 +486,7 @@ void spiHandler() {
       } else {
         // Otherwise reset, and send back NUL
         i = 0;
-        chksum = 0;
+        crc = 0xFFFF;
         spiState = IDLE;
         spiCommand = NUL;
         SPDR = NUL;
@@ -471,25 +511,27 @@ void spiHandler() {
           if (first == true) {
             first = false;
             SPDR = ACK;
-          } else {            
-            // Store sent data
+          } else {
+            // Store sent data, computing the CRC of everything before the sent CRC
+            sensorData[i] = spi;
+            if (i < SENSORSIZE - CRCSIZE) {
+              crc = crcUpdate(crc, spi);
+            }
+            i++;
+
             if (i < SENSORSIZE) {
-              sensorData[i++] = spi;
-              chksum += spi;
               SPDR = ACK;
             } else {
-              // Store sent checksum value
-              uint8_t chksumSent = spi;
-
-              // Compute checksum and compare with sent value
-              chksum = 0xFF - (chksum & 0xFF);
+              // Compare computed CRC with sent value
+              uint16_t crcSent = sensorData[SENSORSIZE - 2] | (sensorData[SENSORSIZE - 1] << 8);
 
               // Reset first flag
               first = true;
 
-              if (chksum == chksumSent) {
+              if (crc == crcSent) {
+                // If CRC values match, send ACK messasge
                 i = 0;
-                chksum = 0;
+                crc = 0xFFFF;
                 spiCommand = NUL;
                 spiState = IDLE;
                 dataReady = READY;
@@ -500,20 +542,20 @@ void spiHandler() {
                 // Store copy in EEPROM
                 EEPROM.put(EEPROMADDRESS, sensorData);
 
-                // Populate broadcast data
+                // Populate broadcast data, including the trailer
                 for(uint8_t j = 0; j < SENSORSIZE; j++) {
                   broadcastData[j] = sensorData[j];
                 }
                 //Serial.println(F("ACK Sensor Data"));
               } else {
+                // Otherwise send NAK message
                 i = 0;
-                chksum = 0;
+                crc = 0xFFFF;
                 spiCommand = NUL;
                 spiState = IDLE;
                 dataReady = PENDING;
                 SPDR = NAK;
-                //Serial.print(F("chksum = 0x")); Serial.println(chksum, HEX);
-                //Serial.print(F("chksumSent = 0x")); Serial.println(chksumSent, HEX);
+                //Serial.print(F("crcSent = 0x")); Serial.println(crcSent, HEX);
                 //Serial.println(F("NAK Sensor Data"));
               }
             }
@@ -525,31 +567,32 @@ void spiHandler() {
             first = false;
             SPDR = ACK;
           } else {
-            // Store sent data
+            // Store sent data, computing the CRC of everything before the sent CRC
+            imageData[i] = spi;
+            if (i < IMAGESIZE - CRCSIZE) {
+              crc = crcUpdate(crc, spi);
+            }
+            i++;
+
             if (i < IMAGESIZE) {
-              imageData[i++] = spi;
-              chksum += spi;
               SPDR = ACK;
             } else {
-              // Store sent checksum value
-              uint8_t chksumSent = spi;
-
-              // Compute checksum and compare with sent value
-              chksum = 0xFF - (chksum & 0xFF);
+              // Compare computed CRC with sent value
+              uint16_t crcSent = imageData[IMAGESIZE - 2] | (imageData[IMAGESIZE - 1] << 8);
 
               // Reset first flag
               first = true;
 
-              if (chksum == chksumSent) {
-                // If checksum values match, send ACK messasge
+              if (crc == crcSent) {
+                // If CRC values match, send ACK messasge
                 i = 0;
-                chksum = 0;
+                crc = 0xFFFF;
                 spiCommand = NUL;
                 spiState = IDLE;
                 dataReady = READY;
                 SPDR = ACK;
 
-                // Populate broadcast data
+                // Populate broadcast data, including the trailer
                 for(uint8_t j = 0; j < IMAGESIZE; j++) {
                   broadcastData[j] = imageData[j];
                 }
@@ -557,13 +600,12 @@ void spiHandler() {
               } else {
                 // Otherwise send NAK message
                 i = 0;
-                chksum = 0;
+                crc = 0xFFFF;
                 spiCommand = NUL;
                 spiState = IDLE;
                 dataReady = PENDING;
                 SPDR = NAK;
-                //Serial.print(F("chksum = 0x")); Serial.println(chksum, HEX);
-                //Serial.print(F("chksumSent = 0x")); Serial.println(chksumSent, HEX);
+                //Serial.print(F("crcSent = 0x")); Serial.println(crcSent, HEX);
                 //Serial.println(F("NAK Image Data"));
               }
             }
@@ -572,7 +614,7 @@ void spiHandler() {
         default: {
           // Unrecognized command
           i = 0;
-          chksum = 0;
+          crc = 0xFFFF;
           spiState = IDLE;
           spiCommand = NUL;
           SPDR = NUL;
@@ -587,7 +629,23 @@ void spiHandler() {
             SPDR = batteryData[i++];
           } else {
             i = 0;
-            chksum = 0;
+            crc = 0xFFFF;
+            spiCommand = NUL;
+            spiState = IDLE;
+            SPDR = ACK;
+          }
+        } break;
+        case UPLINK: {
+          // Relay the pending uplink frame, or a NUL message type if there is none
+          if (i < UPLINKSIZE) {
+            SPDR = (uplinkReady == READY) ? uplinkData[i] : NUL;
+            i++;
+            if (i == UPLINKSIZE) {
+              uplinkReady = PENDING;
+            }
+          } else {
+            i = 0;
+            crc = 0xFFFF;
             spiCommand = NUL;
             spiState = IDLE;
             SPDR = ACK;
@@ -596,7 +654,7 @@ void spiHandler() {
         default: {
           // Unrecognized command
           i = 0;
-          chksum = 0;
+          crc = 0xFFFF;
           spiState = IDLE;
           spiCommand = NUL;
           SPDR = NUL;
@@ -606,7 +664,7 @@ void spiHandler() {
     default: {
       // Unrecogized state, reset and send back NUL
       i = 0;
-      chksum = 0;
+      crc = 0xFFFF;
       spiState = IDLE;
       spiCommand = NUL;
       SPDR = NUL;
@@ -614,16 +672,41 @@ void spiHandler() {
   }
 }
 
-// XBee API Packet Checksum
-uint8_t checksum(uint8_t len, uint8_t *buffer) {
-  // See http://knowledge.digi.com/articles/Knowledge_Base_Article/Calculating-the-Checksum-of-an-API-Packet
-  uint8_t check = 0;
+// Update a CRC-16/CCITT-FALSE with one byte
+uint16_t crcUpdate(uint16_t crc, uint8_t data) {
+  return (crc << 8) ^ pgm_read_word(&crcTable[(crc >> 8) ^ data]);
+}
+
+// CRC-16/CCITT-FALSE of a buffer
+uint16_t crc16(uint8_t len, uint8_t *buffer) {
+  uint16_t crc = 0xFFFF;
 
   for (uint8_t i = 0; i < len; i++) {
-    check += buffer[i];
+    crc = crcUpdate(crc, buffer[i]);
   }
 
-  return 0xFF - (check & 0xFF);
+  return crc;
+}
+
+// Read an uplink frame from the XBee, if one has arrived, keeping it for the Raspberry Pi
+void readUplink() {
+  xbee.readPacket();
+
+  if (xbee.getResponse().isAvailable() && xbee.getResponse().getApiId() == ZB_RX_RESPONSE) {
+    xbee.getResponse().getZBRxResponse(rx);
+    uint8_t *data = rx.getData();
+
+    // Keep only complete uplink frames whose CRC matches, a newer frame replaces a pending one
+    if (rx.getDataLength() == UPLINKSIZE && data[0] == UPLINK) {
+      uint16_t crcSent = data[UPLINKSIZE - 2] | (data[UPLINKSIZE - 1] << 8);
+      if (crc16(UPLINKSIZE - CRCSIZE, data) == crcSent) {
+        for (uint8_t j = 0; j < UPLINKSIZE; j++) {
+          uplinkData[j] = data[j];
+        }
+        uplinkReady = READY;
+      }
+    }
+  }
 }
 
 // Prepare AT command to XBee
@@ -713,11 +796,15 @@ void readBatteryVoltages() {
   *p = voltage;
   p++;
 
-  // Compute and store checksum
-  uint8_t chk = checksum(BATTERYSIZE - 1, batteryData);
+  // Store sequence number, then compute and store CRC
   uint8_t *q = (uint8_t *)p;
-  *q = chk;
-  q++;
+  *q++ = batterySeq & 0xFF;
+  *q++ = batterySeq >> 8;
+  batterySeq++;
+
+  uint16_t crc16Sent = crc16(BATTERYSIZE - CRCSIZE, batteryData);
+  *q++ = crc16Sent & 0xFF;
+  *q++ = crc16Sent >> 8;
 }
 
 // Deserialize sensor message
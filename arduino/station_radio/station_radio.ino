@@ -21,8 +21,16 @@
 #include <SoftwareSerial.h>
 
 /**
- * This example is for Series 2 XBee
- * Receives a ZB RX packet and prints the packet to softserial
+ * Station Radio
+ *
+ * Receives HABPi frames from the XBee and prints them. Image chunks are
+ * tracked in a bitmap for the image being received; once its last chunk
+ * arrives, or no chunk has arrived for ACKTIMEOUT, an uplink frame is sent
+ * back to the balloon acknowledging every chunk received so far, so that
+ * only the missing chunks are resent.
+ *
+ * Frames end with a sequence number and CRC-16/CCITT-FALSE, both little
+ * endian; frames whose CRC does not match are discarded.
  */
 
 XBee xbee = XBee();
@@ -38,18 +46,46 @@ uint8_t ssTX = 11;
 // Remember to connect all devices to a common Ground: XBee and Arduino
 SoftwareSerial softSerial(ssRX, ssTX);
 
-//Example Data Structure to be used in this example.
-typedef struct XBeeStruct {
-  int val1;
-  float val2;
-} XBeeDataStruct;
+// Message types
+#define SENSOR            (0x60)
+#define IMAGE             (0x70)
+#define UPLINK            (0xA0)
+
+// Message size (bytes)
+#define CRCSIZE           (2)
+#define SENSORSIZE        (76)  // Including trailer
+#define IMAGESIZE         (100) // Including trailer
+#define UPLINKSIZE        (42)  // Including trailer
+#define ACKBYTES          (32)
+
+// Image chunks tracked per image, enough for a 320x240 thumbnail
+#define MAXCHUNKS         (1024)
+
+// Time without a chunk before the received chunks are acknowledged (ms)
+#define ACKTIMEOUT        (5000)
+
+// Acknowledgements sent for an image without receiving a chunk
+#define ACKRETRIES        (5)
+
+// MAC (High + Low) Address of HABPi Radio
+#define HABPI_SH          (0x0013A200)
+#define HABPI_SL          (0x40F32EA5)
+
+// Image being received
+uint16_t imgId = 0;
+uint16_t imgChunks = 0;
+uint16_t imgReceived = 0;
+uint8_t imgBitmap[MAXCHUNKS / 8] = {0};
+bool imgActive = false;
+uint8_t ackRetries = 0;
+unsigned long chunkTime = 0;
 
-//Create the Data Structure
-static XBeeDataStruct XBeeData;
+// Uplink frame and its sequence number
+uint8_t uplinkData[UPLINKSIZE] = {0};
+uint16_t uplinkSeq = 0;
 
-//Receieve Variables
-uint8_t *data = 0;
-int len = 0;
+XBeeAddress64 addr64 = XBeeAddress64(HABPI_SH, HABPI_SL);
+ZBTxRequest zbTx = ZBTxRequest(addr64, uplinkData, UPLINKSIZE);
 
 int statusLed = 13;
 int errorLed = 13;
@@ -84,68 +120,13 @@ void setup() {
 
 // continuously reads packets, looking for ZB Receive or Modem Status
 void loop() {
-    
-  //xbee.readPacket();
-
-  // Read packet, waiting 5 seconds
-  if (xbee.readPacket(5000)) {
-
-    // Got something
-    Serial.println("Got Packet");
-         
+  // Read packet, waiting briefly so acknowledgements are sent on time
+  if (xbee.readPacket(100)) {
     if (xbee.getResponse().getApiId() == ZB_RX_RESPONSE) {
       // got a zb rx packet
-      
-      // now fill our zb rx class
       xbee.getResponse().getZBRxResponse(rx);
-    
-      Serial.println("Got an rx packet!");
-
-      Serial.print("RX Option: ");
-      Serial.println(rx.getOption());
-      if (rx.getOption() == ZB_PACKET_ACKNOWLEDGED) {
-        // the sender got an ACK
-        Serial.println("packet acknowledged");
-      } else {
-        Serial.println("packet not acknowledged");
-      }
-      
-      Serial.print("checksum is ");
-      Serial.println(rx.getChecksum(), HEX);
-
-      Serial.print("packet length is ");
-      Serial.println(rx.getPacketLength(), DEC);
-
-      // Store received data
-      data = rx.getData();
-
-      // Transform data to XBeeDataStruct object
-      XBeeData = (XBeeDataStruct &)*data;
-
-      Serial.print("Data Obtained:");
-      Serial.print("\tVal1 = ");
-      Serial.print(XBeeData.val1);
-      Serial.print("\tVal2 = ");
-      Serial.print(XBeeData.val2);
-      Serial.println();
-      
-      // Print raw data
-      /*for (int i = 0; i < rx.getDataLength(); i++) {
-        Serial.print("payload [");
-        Serial.print(i, DEC);
-        Serial.print("] is ");
-        Serial.println(rx.getData()[i], HEX);
-      }*/
-      
-      // Print raw data + frame
-     /*for (int i = 0; i < xbee.getResponse().getFrameDataLength(); i++) {
-       Serial.print("frame data [");
-       Serial.print(i, DEC);
-       Serial.print("] is ");
-       Serial.println(xbee.getResponse().getFrameData()[i], HEX);
-     }*/
-    }
-  } else if (xbee.getResponse().getApiId() == MODEM_STATUS_RESPONSE) {
+      receiveFrame(rx.getData(), rx.getDataLength());
+    } else if (xbee.getResponse().getApiId() == MODEM_STATUS_RESPONSE) {
       xbee.getResponse().getModemStatusResponse(msr);
       // the local XBee sends this response on certain events, like association/dissociation
       
@@ -163,10 +144,146 @@ void loop() {
         Serial.println(msr.getStatus());
         flashLed(statusLed, 5, 10);
       }
+    }
   } else if (xbee.getResponse().isError()) {
     Serial.print("Error Code: ");
     Serial.println(xbee.getResponse().getErrorCode());
   }
 
-  delay(5000);
+  // Acknowledge an incomplete image once its chunks stop arriving
+  if (imgActive && imgReceived < imgChunks && ackRetries < ACKRETRIES && millis() - chunkTime >= ACKTIMEOUT) {
+    chunkTime = millis();
+    ackRetries++;
+    sendAck();
+  }
+}
+
+// Validate and handle a received frame
+void receiveFrame(uint8_t *data, uint8_t rxLen) {
+  // The relay pads sensor frames to the image frame size, the type gives the real length
+  uint8_t len = (rxLen > 0 && data[0] == SENSOR) ? SENSORSIZE : IMAGESIZE;
+  if (rxLen < len) {
+    Serial.print("Unexpected frame length: ");
+    Serial.println(rxLen);
+    return;
+  }
+
+  uint16_t crcSent = data[len - 2] | (data[len - 1] << 8);
+  uint16_t seq = data[len - 4] | (data[len - 3] << 8);
+  if (crc16(len - CRCSIZE, data) != crcSent) {
+    Serial.print("CRC mismatch, frame ");
+    Serial.println(seq);
+    flashLed(errorLed, 3, 50);
+    return;
+  }
+
+  if (data[0] == SENSOR) {
+    Serial.print("Sensor frame ");
+    Serial.println(seq);
+  } else if (data[0] == IMAGE) {
+    uint16_t id = data[2] | (data[3] << 8);
+    uint16_t chunk = data[4] | (data[5] << 8);
+    uint16_t nchunks = data[6] | (data[7] << 8);
+
+    Serial.print("Image ");
+    Serial.print(id);
+    Serial.print(" chunk ");
+    Serial.print(chunk);
+    Serial.print("/");
+    Serial.println(nchunks);
+
+    receiveChunk(id, chunk, nchunks);
+  }
+}
+
+// Record an image chunk, acknowledging the image when its last chunk arrives
+void receiveChunk(uint16_t id, uint16_t chunk, uint16_t nchunks) {
+  // A new image starts, acknowledge what arrived of the previous one
+  if (!imgActive || id != imgId) {
+    if (imgActive && imgReceived < imgChunks) {
+      sendAck();
+    }
+
+    imgId = id;
+    imgChunks = min(nchunks, (uint16_t)MAXCHUNKS);
+    imgReceived = 0;
+    imgActive = true;
+    memset(imgBitmap, 0, sizeof(imgBitmap));
+  }
+
+  chunkTime = millis();
+  ackRetries = 0;
+  if (chunk >= imgChunks) return;
+
+  // Count each chunk once, a resent chunk may arrive twice
+  if (!(imgBitmap[chunk / 8] & (1 << (chunk % 8)))) {
+    imgBitmap[chunk / 8] |= 1 << (chunk % 8);
+    imgReceived++;
+
+    // Acknowledge on the last chunk, and on the last missing chunk of a resend
+    if (chunk == imgChunks - 1 || imgReceived == imgChunks) {
+      sendAck();
+    }
+  }
+}
+
+/**
+ * sendAck
+ *
+ * Every chunk below the first missing chunk is acknowledged by the base,
+ * and the ACKBYTES * 8 chunks from there by the bitmap.
+ */
+void sendAck() {
+  uint16_t base = 0;
+  while (base < imgChunks && (imgBitmap[base / 8] & (1 << (base % 8)))) {
+    base++;
+  }
+
+  memset(uplinkData, 0, UPLINKSIZE);
+  uplinkData[0] = UPLINK;
+  uplinkData[2] = imgId & 0xFF;
+  uplinkData[3] = imgId >> 8;
+  uplinkData[4] = base & 0xFF;
+  uplinkData[5] = base >> 8;
+
+  uint8_t nbytes = 0;
+  for (uint16_t j = base; j < imgChunks && j < base + 8 * ACKBYTES; j++) {
+    if (imgBitmap[j / 8] & (1 << (j % 8))) {
+      uplinkData[6 + (j - base) / 8] |= 1 << ((j - base) % 8);
+    }
+    nbytes = (j - base) / 8 + 1;
+  }
+  uplinkData[1] = nbytes;
+
+  // Store sequence number, then compute and store CRC
+  uplinkData[UPLINKSIZE - 4] = uplinkSeq & 0xFF;
+  uplinkData[UPLINKSIZE - 3] = uplinkSeq >> 8;
+  uplinkSeq++;
+
+  uint16_t crc = crc16(UPLINKSIZE - CRCSIZE, uplinkData);
+  uplinkData[UPLINKSIZE - 2] = crc & 0xFF;
+  uplinkData[UPLINKSIZE - 1] = crc >> 8;
+
+  xbee.send(zbTx);
+
+  Serial.print("Acknowledged image ");
+  Serial.print(imgId);
+  Serial.print(": ");
+  Serial.print(imgReceived);
+  Serial.print("/");
+  Serial.println(imgChunks);
+}
+
+// CRC-16/CCITT-FALSE of a buffer, bit by bit to save flash
+uint16_t crc16(uint8_t len, uint8_t *buffer) {
+  uint16_t crc = 0xFFFF;
+
+  for (uint8_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)buffer[i] << 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+
+  return crc;
 }
@@ -23,6 +23,13 @@ public:
 	// Update AHRS sensors
 	void update(float &roll, float &pitch, float &heading);
 
+	// Vertical (earth frame) acceleration from the last update, gravity removed [m/s^2]
+	float verticalAcceleration() const { return vertical; }
+
+	// Filter state: orientation quaternion (w, x, y, z) and integral feedback
+	void getState(float quaternion[4], float integral[3]);
+	void setState(const float quaternion[4], const float integral[3]);
+
 	// Static Constants
 
   // Mag calibration values are calculated via ahrs_calibration.
@@ -40,6 +47,9 @@ public:
 
   static const constexpr float mag_field_strength = 50.23F;
 
+  // Standard gravity [m/s^2]
+  static const constexpr float gravity = 9.80665F;
+
   // Offsets applied to compensate for gyro zero-drift error for x/y/z
   // Raw values converted to rad/s based on 250dps sensitiviy (1 lsb = 0.00875 rad/s)
   static const constexpr float rawToDPS = 0.00875F;
@@ -57,4 +67,7 @@ private:
   // on slower systems
   Mahony filter;
   //Madgwick filter;
+
+  // Last vertical acceleration
+  float vertical;
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+/**
+ * Vertical State Estimator
+ *
+ * Kalman filter fusing IMU vertical acceleration (prediction), barometric
+ * pressure altitude and GPS altitude/climb rate (corrections) into a single
+ * estimate of altitude and climb rate with its uncertainty.
+ *
+ * State: [altitude, climb rate, accelerometer bias, barometric offset]
+ *
+ * The barometric offset absorbs the difference between the standard
+ * atmosphere pressure altitude and the GPS (MSL) altitude, so the filter
+ * follows the fast, smooth barometer while staying anchored to GPS.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-09-09
+ */
+#pragma once
+
+#include <stdint.h>
+
+class Altimeter {
+public:
+  // Altimeter Constructor
+  Altimeter();
+
+  // Altimeter Destructor
+  ~Altimeter();
+
+  // Reset the filter, the next measurement initializes the state
+  void reset();
+
+  // Propagate the state using the vertical acceleration [m/s^2] over dt [s]
+  void predict(float accel, float dt);
+
+  // Propagate the state over dt [s] without an IMU measurement
+  void predict(float dt);
+
+  // Correct using barometric pressure [kPa]
+  void correctPressure(float pressure);
+
+  // Correct using GPS altitude [m] and climb rate [m/s]
+  void correctGPS(float altitude, float climb);
+
+  // Estimated altitude [m], climb rate [m/s] and their 1-sigma uncertainties
+  float altitude() const { return static_cast<float>(x[0]); }
+  float climbRate() const { return static_cast<float>(x[1]); }
+  float altitudeSigma() const;
+  float climbSigma() const;
+
+  // True once the filter has been initialized by a measurement
+  bool ready() const { return initialized; }
+
+  // Filter state (N values), covariance (N x N, row by row) and the measurements seen so far
+  void getState(double *state, double *covariance, bool &baro, bool &gps) const;
+
+  // Restore the filter state, e.g. when resuming a flight
+  void setState(const double *state, const double *covariance, bool baro, bool gps);
+
+  // True if the payload is descending with the given confidence (in sigmas)
+  bool descending(float sigmas = 2.0f) const;
+
+  // Pressure altitude [m] from pressure [kPa], using the Module::Alpha/Beta model
+  static float pressureAltitude(float pressure);
+
+  // Static Constants
+
+  // Number of states
+  static const int N = 4;
+
+  // Process noise: acceleration with and without the IMU [m/s^2], bias and offset random walks
+  static const constexpr double AccelNoise = 0.5;
+  static const constexpr double ModelNoise = 3.0;
+  static const constexpr double BiasNoise = 0.01;
+  static const constexpr double OffsetNoise = 0.1;
+
+  // Measurement noise [m, m, m/s]
+  static const constexpr double BaroNoise = 2.0;
+  static const constexpr double GpsNoise = 10.0;
+  static const constexpr double ClimbNoise = 1.0;
+
+  // Innovations beyond this many sigmas are rejected as outliers, unless
+  // MaxRejects consecutive measurements of the same kind disagree with the prediction
+  static const constexpr double Gate = 5.0;
+  static const int MaxRejects = 3;
+
+  // Module::Alpha is expressed per centimetre
+  static const constexpr double CentimetreToMetre = 0.01;
+
+private:
+  // Propagate the state and covariance
+  void propagate(double accel, double dt, double noise);
+
+  // Scalar measurement update, z = H x + noise, counting consecutive outliers in rejects
+  bool correct(const double H[N], double z, double variance, int &rejects);
+
+  // Initialize the state from a first altitude measurement
+  void initialize(double altitude, double offset);
+
+  // State and covariance
+  double x[N];
+  double P[N][N];
+
+  bool initialized;
+  bool baroSeen, gpsSeen;
+
+  // Consecutive outliers of each measurement
+  int baroRejects, altitudeRejects, climbRejects;
+};
@@ -0,0 +1,99 @@
+/**
+ * Image Archiver
+ *
+ * Writes full resolution captures to the SD card from a worker thread,
+ * so the camera cadence does not depend on how fast the card is. Frames
+ * arrive already JPEG encoded (by the camera's hardware encoder) and are
+ * held in a bounded queue; when the queue is full the drop policy either
+ * refuses new frames, which lets the camera skip the capture altogether,
+ * or discards the oldest queued frame.
+ *
+ * Each file is preallocated with fallocate and written with O_DIRECT in
+ * large page aligned blocks, bypassing the page cache, to a temporary
+ * name which is renamed once complete. The sync policy trades card wear
+ * and stalls against how much can be lost on a power cut.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-11-25
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Frame waiting to be written
+struct archive_frame_t {
+  std::string path;
+  std::vector<uint8_t> data;
+};
+
+class Archiver {
+public:
+  // Archiver Constructor
+  Archiver();
+
+  // Archiver Destructor
+  ~Archiver();
+
+  // Start the worker thread
+  void begin();
+
+  // Write out queued frames and stop the worker thread
+  void stop();
+
+  // Queue a frame for writing to path, returns false if it was dropped
+  bool push(const std::string &path, std::vector<uint8_t> &data);
+
+  // A new frame would be dropped under the DropNewest policy
+  bool full();
+
+  // Frames waiting to be written
+  size_t backlog();
+
+  // Static Constants
+
+  // Drop policies
+  static const uint8_t DropNewest = 0;
+  static const uint8_t DropOldest = 1;
+
+  // Sync policies
+  static const uint8_t SyncNone = 0;      // Leave it to the kernel
+  static const uint8_t SyncPeriodic = 1;  // syncfs every SyncInterval files
+  static const uint8_t SyncEachFile = 2;  // fdatasync before each rename
+
+  // Queue bounds
+  static const size_t MaxFrames = 4;
+  static const size_t MaxBytes = 32 * 1024 * 1024;
+
+  // Write block, a multiple of the page size [bytes]
+  static const size_t BlockSize = 1024 * 1024;
+  static const size_t Alignment = 4096;
+
+  static const int SyncInterval = 8;
+
+  // Configured policies
+  static uint8_t dropPolicy, syncPolicy;
+
+private:
+  // Worker thread
+  void run();
+
+  // Write one frame, returns false on error
+  bool write(const archive_frame_t &frame);
+
+  std::deque<archive_frame_t> queue;
+  size_t queuedBytes;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread worker;
+  bool running;
+
+  // Page aligned write buffer
+  uint8_t *buffer;
+  int unsynced;
+};
@@ -0,0 +1,30 @@
+/**
+ * Cyclic Redundancy Checks
+ *
+ * Table driven CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF, check
+ * 0x29B1) protecting each frame exchanged with the radio, and CRC-32
+ * (IEEE 802.3, check 0xCBF43926) for data kept on disk. Both process
+ * four bytes per step with four lookup tables (slice-by-4); the radio
+ * Arduino uses the first CRC-16 table one byte at a time.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-11-04
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class CRC {
+public:
+  // CRC-16/CCITT-FALSE of len bytes, continuing from crc
+  static uint16_t crc16(const uint8_t *data, size_t len, uint16_t crc = Crc16Init);
+
+  // CRC-32 of len bytes, continuing from crc
+  static uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+  // Static Constants
+  static const uint16_t Crc16Poly = 0x1021;
+  static const uint16_t Crc16Init = 0xFFFF;
+  static const uint32_t Crc32Poly = 0xEDB88320;   // Reflected
+};
@@ -10,25 +10,21 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <fstream>
+#include <iterator>
 #include <cstdint>
 #include <cstring>
 #include <cmath>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "Serializer.h"
-
-// RGB values
-struct rgb_t {
-  uint8_t r, g, b;
-
-  // RGB comparison method
-  bool compare(rgb_t p) {
-    bool status = true;
-    status = status && this->r == p.r;
-    status = status && this->g == p.g;
-    status = status && this->b == p.b;
-    return status;
-  }
-};
+#include "Palette.h"
+#include "ProcessRunner.h"
+#include "VideoRing.h"
 
 class Camera {
 public:
@@ -44,18 +40,75 @@ public:
   // Update Camera
   void update(uint8_t mode);
 
-  // Capture Image
-  void capture();
+  // Start capturing a Full Resolution Image, queued for archiving once collected, kept on disk only
+  void archive();
+
+  // Collect a finished full resolution capture, returns true while one is capturing
+  bool archiving();
+
+  // Start a burst of thumbnails, returns false if the camera could not be started
+  bool capture(int width, int height);
+
+  // Select the best frame of a finished burst and start quantising it,
+  // returns true once a quantised thumbnail is ready to load
+  bool captured();
 
-  // Record Video
+  // A burst has been started and not yet selected from
+  bool capturing() const { return burstTaken; }
+
+  // Score the frames of a burst, keep the best as the thumbnail and
+  // remove the rest, returns the index of the best frame or -1
+  int select();
+
+  // Start recording Video
   void record();
 
+  // Collect a finished video, returns true while one is recording
+  bool recording();
+
+  // Start streaming video into the pre-trigger ring, from the camera, or from the
+  // H.264 file source when it is not empty, returns false if it could not be started
+  bool stream(const std::string &source);
+
+  // Stop streaming video into the ring, writing out any event still open
+  void stopStream();
+
+  // Video is streaming into the ring, collecting a stream that has ended
+  bool streaming();
+
+  // Write the ring and the following VideoRing::PostTrigger to a new video file, or extend the one being written
+  void trigger();
+
+  // Write out the event being written, returns true while one is
+  bool flushing();
+
+  // Burst frame filename
+  static std::string burstFile(int frame);
+
+  // Record the frames of a burst in the flight recorder trace
+  void recordBurst();
+
+  // Restore the frames of a burst from the flight recorder trace
+  void replayBurst();
+
   // Load and Partition Image Data
   void load();
 
+  // Queue the chunks of the broadcast image from chunk first on, as image id, returns false if it can not be read
+  bool resume(uint16_t id, int first);
+
+  // Partition w x h palette indices into image messages for image id, queueing them from chunk first on
+  void partition(const uint8_t *image_broadcast, int w, int h, uint16_t id, int first);
+
+  // Map w x h RGB pixels (bpp bytes each) to VGA palette indices
+  void remap(const uint8_t *rgb, int w, int h, int bpp, uint8_t *indices);
+
   // VGA palette RGB values
   std::vector<rgb_t> palette;
 
+  // Pre-trigger video
+  VideoRing ring;
+
   // Static Constants
 
   // Height and Width for Large Images
@@ -66,6 +119,19 @@ public:
   static const int HeightSmall = 240;
   static const int WidthSmall = 320;
 
+  // Thumbnail sizes available for broadcast, smallest first
+  static const int NSizes = 3;
+  static const int ThumbWidth[NSizes];
+  static const int ThumbHeight[NSizes];
+
+  // Thumbnail burst length and frame interval [ms]
+  static const int BurstFrames = 4;
+  static const int BurstInterval = 250;
+
+  // Upper bound on the frame indices searched after a burst, raspistill
+  // takes one frame per interval of its timeout, numbered from 0 or 1
+  static const int MaxBurstFrames = BurstFrames + 1;
+
   static const bool Preview = false;
   static const bool Vstab = true;
   static const int Timeout = 2000;
@@ -75,12 +141,57 @@ public:
   static const int Bpp = 0;
   static const int NColours = 255;
 
+  // Time allowed beyond its own timeout for a camera tool to finish [ms]
+  static const int ToolMargin = 10000;
+
+  // Pre-trigger video stream size and bit rate [bits/s]
+  static const int VideoWidth = 1280;
+  static const int VideoHeight = 720;
+  static const int VideoBitrate = 1500000;
+
+  // Wait before restarting a video stream that ended by itself [ms]
+  static const int StreamRetry = 10000;
+
+  // Full resolution captures use the GPU's JPEG encoder
+  static const int ArchiveQuality = 95;
+
   static const std::string ImageEncoding;
   static const std::string VideoEncoding;
+  static const std::string ArchiveEncoding;
+
+  // Palette indexed image being broadcast
+  static const std::string BroadcastFile;
   static const std::string VgaPalette;
   static const std::string Exposure;
 
   // Camera Mode
   static const uint8_t ImageMode = 0x80;
   static const uint8_t VideoMode = 0xFF;
+
+private:
+  // Log the failure of a camera tool with the last line it wrote to stderr
+  static void failed(const char *tool, const process_result_t &result);
+
+  // Jobs of the archive capture, the burst, the quantisation of the selected frame, the video and the video stream
+  int archiveJob, burstJob, quantiseJob, videoJob, streamJob;
+
+  // Archive file of the capture in progress
+  std::string archivePath;
+  bool burstTaken;
+  std::chrono::steady_clock::time_point burstStart, quantiseStart, streamRetry;
+
+  // Feed each stream handed over by stream() into the ring, run by feeder
+  void feed();
+
+  // Thread feeding the ring, started with the first stream and kept for every later
+  // one, with the stream handed to it, whether it is paced, and whether to exit
+  std::thread feeder;
+  std::mutex feedMutex;
+  std::condition_variable feedChanged;
+  int feedFd;
+  bool feedPaced, feedQuit;
+
+  // A stream has been started and not yet stopped, is kept reading while feeding, and has finished
+  bool streamActive;
+  std::atomic<bool> feeding, fed;
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+/**
+ * Module Checkpoint
+ *
+ * Keeps the state needed to resume a flight after a watchdog reset or
+ * power glitch in a small memory-mapped file: image and video numbering,
+ * the frame sequence, flight phase, filter states, the last fix and the
+ * position in the image being broadcast.
+ *
+ * The file holds two page sized slots, each with a generation number and
+ * a CRC-32. A save always overwrites the older slot and syncs it before
+ * the next save may touch the other, so a save interrupted by a power
+ * cut leaves a slot that fails its CRC while the previous checkpoint
+ * remains intact. load() returns the newest valid slot.
+ *
+ * The sensor thread stages the flight state it owns, and the camera
+ * thread, which numbers the images, completes and saves it.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-01-06
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <string>
+
+#include "Altimeter.h"
+
+// Module state kept across restarts
+struct checkpoint_t {
+  // Wall clock when the flight state was staged [us since the epoch]
+  int64_t savedAt;
+
+  // Image, video and full resolution image numbers, and the next frame sequence number
+  int32_t imageNumber, videoNumber, archiveNumber;
+  uint16_t sequence;
+
+  // Flight phase and launch altitude [m]
+  uint8_t phase;
+  float launch;
+
+  // AHRS quaternion (w, x, y, z) and integral feedback
+  float quaternion[4], integral[3];
+
+  // Altimeter state, covariance and the measurements it has seen
+  uint8_t altimeterReady, baroSeen, gpsSeen;
+  double altimeterState[Altimeter::N];
+  double altimeterCovariance[Altimeter::N * Altimeter::N];
+
+  // Last fix
+  uint8_t gps_nsats, gps_status, gps_mode;
+  float gps_lat, gps_lon, gps_alt;
+
+  // Image being broadcast, and its first chunk not yet sent
+  uint8_t downlinkPending;
+  uint16_t downlinkImage, downlinkChunk;
+};
+
+class Checkpoint {
+public:
+  // Checkpoint Constructor
+  Checkpoint();
+
+  // Checkpoint Destructor
+  ~Checkpoint();
+
+  // Create or map the checkpoint file, returns false on error
+  bool open(const std::string &path);
+
+  // Unmap the checkpoint file
+  void close();
+
+  // Newest valid checkpoint, returns false if there is none
+  bool load(checkpoint_t &state);
+
+  // Write state to the older slot and sync it, returns false on error
+  bool save(const checkpoint_t &state);
+
+  // Keep the flight state for the next save
+  void stage(const checkpoint_t &state);
+
+  // Copy the staged flight state, returns false if none has been staged
+  bool staged(checkpoint_t &state);
+
+  // Static Constants
+
+  // File magic "CKPT" and format version
+  static const uint32_t Magic = 0x54504B43;
+  static const uint16_t Version = 1;
+
+  // Slots, each a page [bytes]
+  static const int NSlots = 2;
+  static const size_t SlotSize = 4096;
+
+private:
+  // Valid slot contents
+  bool valid(int slot);
+
+  int fd;
+  uint8_t *map;
+
+  // Generation of the newest slot, and the slot the next save overwrites
+  uint64_t generation;
+  int next;
+
+  std::mutex mutex;
+  checkpoint_t pending;
+  bool havePending;
+};
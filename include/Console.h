@@ -0,0 +1,105 @@
+/**
+ * Console Output
+ *
+ * Levelled console output for the loops. Lines are built with stream
+ * syntax and appended to a buffer, which is written to stdout once it
+ * holds FlushSize or has waited FlushInterval, so a loop printing every
+ * iteration costs a string append rather than a write into the journal.
+ * Errors and warnings go to stderr at once, after anything buffered.
+ *
+ * Usage:
+ *   CONSOLE_DEBUG("sensorLoop: " << sensorCounter);
+ *
+ * Levels above CONSOLE_LEVEL (Info unless defined, e.g. -DCONSOLE_LEVEL=4
+ * for Trace) compile to nothing, their arguments are not evaluated. The
+ * levels compiled in are printed up to Console::level, set at runtime.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-02-17
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+class Console {
+public:
+  // Levels compiled in at or below level are printed
+  static bool enabled(int level) { return level <= Console::level.load(std::memory_order_relaxed); }
+
+  // Append a line at level, flushing the buffer when due, unless the level is switched out
+  static void write(int level, const std::string &line);
+
+  // Write out the buffer if it has waited FlushInterval
+  static void poll();
+
+  // Write out the buffer
+  static void flush();
+
+  // Level of name (error, warning, info, debug or trace), or -1 when unknown or compiled out
+  static int parse(const char *name);
+
+  // Static Constants
+
+  // Levels
+  static const int Error = 0;
+  static const int Warning = 1;
+  static const int Info = 2;
+  static const int Debug = 3;
+  static const int Trace = 4;
+
+  // Buffered output written out at [bytes]
+  static const size_t FlushSize = 4096;
+
+  // Longest buffered output is held [ms]
+  static const int FlushInterval = 1000;
+
+  // Printed levels, Info unless set with -l
+  static std::atomic<int> level;
+
+private:
+  // Write out the buffer, with the mutex held
+  static void drain();
+
+  static std::mutex mutex;
+  static std::string buffer;
+  static uint64_t since;
+};
+
+#ifndef CONSOLE_LEVEL
+#define CONSOLE_LEVEL 2
+#endif
+
+#define CONSOLE_LINE(level, message) \
+  do { \
+    if (Console::enabled(level)) { \
+      std::ostringstream consoleLine; \
+      consoleLine << message; \
+      Console::write(level, consoleLine.str()); \
+    } \
+  } while (0)
+#define CONSOLE_NONE(message) do {} while (0)
+
+#define CONSOLE_ERROR(message) CONSOLE_LINE(Console::Error, message)
+#define CONSOLE_WARNING(message) CONSOLE_LINE(Console::Warning, message)
+
+#if CONSOLE_LEVEL >= 2
+#define CONSOLE_INFO(message) CONSOLE_LINE(Console::Info, message)
+#else
+#define CONSOLE_INFO(message) CONSOLE_NONE(message)
+#endif
+
+#if CONSOLE_LEVEL >= 3
+#define CONSOLE_DEBUG(message) CONSOLE_LINE(Console::Debug, message)
+#else
+#define CONSOLE_DEBUG(message) CONSOLE_NONE(message)
+#endif
+
+#if CONSOLE_LEVEL >= 4
+#define CONSOLE_TRACE(message) CONSOLE_LINE(Console::Trace, message)
+#else
+#define CONSOLE_TRACE(message) CONSOLE_NONE(message)
+#endif
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "Global.h"
+#include "DHTReader.h"
  
 #define clockCyclesPerMicrosecond() ( 260L ) // 260 is Clock Cycle of LinkIt ONE in MHz
 #define clockCyclesToMicroseconds(a) ( (a) / clockCyclesPerMicrosecond() )
@@ -51,5 +52,9 @@ private:
   uint32_t _lastreadtime, _maxcycles;
   bool _lastresult;
 
+  // Kernel edge capture, when available
+  DHTReader _reader;
+
+  bool readData();
   uint32_t expectPulse(bool level);
 };
@@ -0,0 +1,102 @@
+/**
+ * DHT Edge Capture Reader
+ *
+ * Reads a DHT11/DHT22 off the sensor thread, without busy waiting.
+ * A worker thread samples the sensor every Interval and caches the last
+ * reading with a valid checksum, which DHT::read picks up immediately.
+ *
+ * Two kernel backends are supported, in order of preference:
+ *   - the dht11 IIO driver (dtoverlay=dht11), which times the bits in
+ *     its interrupt handler and exposes millidegrees and millipercent
+ *   - the GPIO character device, driving the start pulse and then
+ *     capturing both edges with kernel timestamps; the 40 bits are
+ *     decoded from the widths of the last 40 high pulses
+ * Without either, DHT falls back to its original bit-banged read.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-11-11
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class DHTReader {
+public:
+  // DHTReader Constructor
+  DHTReader();
+
+  // DHTReader Destructor
+  ~DHTReader();
+
+  // Find a kernel backend for BCM GPIO line of a sensor type and start sampling
+  bool begin(unsigned int line, uint8_t type);
+
+  // Stop sampling
+  void stop();
+
+  // Sampling with a kernel backend
+  bool active() const { return backend != NoBackend; }
+
+  // Copy the cached 5 data bytes, returns false if there is no recent reading
+  bool read(uint8_t data[5]);
+
+  // Decode 5 data bytes from the edges of a transmission, returns false on a checksum failure
+  static bool decode(const uint64_t *times, const uint8_t *levels, int n, uint8_t data[5]);
+
+  // Static Constants
+
+  // Backends
+  static const uint8_t NoBackend = 0;
+  static const uint8_t IIOBackend = 1;
+  static const uint8_t GPIOBackend = 2;
+
+  // Time between samples, the DHT needs at least 1 s (DHT11) or 2 s (DHT22) [ms]
+  static const int Interval = 2000;
+
+  // Age after which a cached reading is discarded [ms]
+  static const int MaxAge = 10000;
+
+  // Start pulse holding the line low, and time allowed for the reply [ms]
+  static const int StartLow = 20;
+  static const int ReplyTimeout = 10;
+
+  // High pulses longer than this are 1 bits, 0 bits are ~27 us and 1 bits ~70 us [ns]
+  static const uint64_t OneThreshold = 48000;
+
+  // Edges buffered by the kernel, a reply has 84
+  static const int EventBufferSize = 128;
+
+  static const std::string IIOPath;
+  static const std::string GPIOChip;
+
+private:
+  // Worker thread
+  void run();
+
+  // Take one sample with the selected backend
+  bool sample(uint8_t data[5]);
+  bool sampleIIO(uint8_t data[5]);
+  bool sampleGPIO(uint8_t data[5]);
+
+  // Encode an IIO reading as the bytes the sensor would have sent
+  void encode(long temperature, long humidity, uint8_t data[5]);
+
+  uint8_t backend, type;
+  unsigned int line;
+  std::string iioDevice;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool running;
+
+  // Last good reading
+  uint8_t cache[5];
+  bool cached;
+  std::chrono::steady_clock::time_point cacheTime;
+};
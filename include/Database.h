@@ -23,6 +23,17 @@ typedef enum {
   NMSG = 16
 } message_type_id_t;
 
+// Sensor Type ID
+typedef enum {
+  SENSOR_NONE = 0,
+  SENSOR_GPS = 1,
+  SENSOR_BMP180 = 2,
+  SENSOR_MPL3115A2 = 3,
+  SENSOR_AHRS = 4,
+  SENSOR_BAT = 5,
+  SENSOR_CAM = 6
+} sensor_type_id_t;
+
 // Default Database location
 //#define DBFILE       ("db/habpi.sqlite3")
 
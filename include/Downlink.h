@@ -0,0 +1,112 @@
+/**
+ * Image Downlink Queue
+ *
+ * Thread safe queue of image chunks waiting to be broadcast, shared by the
+ * camera and broadcast loops. It measures the rate at which chunks are
+ * acknowledged while the link is busy, so the camera scheduler can size
+ * and time the next capture to keep the radio occupied without building
+ * up a backlog.
+ *
+ * The chunks of the last MaxImages images are kept after they are sent.
+ * When the ground station acknowledges an image with an uplink bitmap,
+ * only the chunks it is missing are queued again, ahead of newer images,
+ * so each image completes without resending what already arrived.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-09-23
+ */
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <chrono>
+
+#include "Serializer.h"
+
+// Chunks of an image kept for retransmission
+struct downlink_image_t {
+  std::vector<image_msg_t> chunks;
+  std::vector<uint8_t> state;
+  std::vector<std::chrono::steady_clock::time_point> sentTime;
+  int acked;
+};
+
+class Downlink {
+public:
+  // Downlink Constructor
+  Downlink();
+
+  // Downlink Destructor
+  ~Downlink();
+
+  // Append an image chunk to the back of the queue
+  void push(const image_msg_t &msg);
+
+  // Remove the chunk at the front of the queue, returns false if empty
+  bool pop(image_msg_t &msg);
+
+  // Remove all queued chunks
+  void clear();
+
+  // Apply a ground station acknowledgement, returns the number of chunks queued again
+  int ack(const uplink_msg_t &msg);
+
+  // Images sent but not yet fully acknowledged
+  size_t unacked();
+
+  // Record the outcome of a chunk transmission
+  void sent(bool ack);
+
+  // Number of chunks waiting to be sent
+  size_t backlog();
+
+  // First chunk of image id waiting to be sent, returns false if none is
+  bool pending(uint16_t id, uint16_t &chunk);
+
+  // Measured throughput while busy [chunks/s], zero until measured
+  float throughput();
+
+  // Estimated time to send the backlog [s]
+  float drainTime();
+
+  // Static Constants
+
+  // Minimum busy time per throughput measurement [s]
+  static const constexpr float Window = 5.0f;
+
+  // Gaps between transmissions longer than this are idle time [s]
+  static const constexpr float IdleGap = 1.0f;
+
+  // Weight of the newest throughput measurement
+  static const constexpr float Smoothing = 0.3f;
+
+  // Images kept for retransmission
+  static const size_t MaxImages = 3;
+
+  // A chunk sent more recently than this is not resent, its acknowledgement may still be in flight [s]
+  static const constexpr float Holdoff = 2.0f;
+
+  // Chunk states
+  static const uint8_t Queued = 0x01;
+  static const uint8_t Sent = 0x02;
+  static const uint8_t Acked = 0x04;
+
+private:
+  // Kept chunk matching a message, NULL if the image is no longer kept
+  downlink_image_t *find(const image_msg_t &msg);
+
+  std::mutex mutex;
+  std::deque<image_msg_t> queue;
+
+  // Kept images by id, and their ids oldest first
+  std::map<uint16_t, downlink_image_t> images;
+  std::deque<uint16_t> order;
+
+  // Throughput measurement
+  std::chrono::steady_clock::time_point lastSent;
+  bool haveSent;
+  float busyTime, rate;
+  int acked;
+};
@@ -0,0 +1,91 @@
+/**
+ * Flight Phase Detector
+ *
+ * Tracks the phase of the flight (pad, ascent, float, burst, descent and
+ * landed) from the fused altitude, climb rate and vertical acceleration.
+ * Each transition requires its condition to hold for a minimum time, so
+ * a single noisy estimate cannot flip the phase.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-09-16
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+class FlightPhase {
+public:
+  // FlightPhase Constructor
+  FlightPhase();
+
+  // FlightPhase Destructor
+  ~FlightPhase();
+
+  // Reset to the pad phase
+  void reset();
+
+  // Update with altitude [m], climb rate [m/s], vertical acceleration [m/s^2]
+  // over dt [s], returns true if the phase changed
+  bool update(float altitude, float climb, float accel, float dt);
+
+  // Current phase
+  uint8_t phase() const { return current; }
+
+  // Force the phase, e.g. when resuming a flight
+  void set(uint8_t phase);
+
+  // Resume a flight in phase, launched from launchAltitude [m]
+  void resume(uint8_t phase, float launchAltitude);
+
+  // Launch altitude [m], tracked while on the pad
+  float launchAltitude() const { return launch; }
+
+  // Phase name
+  static const char *name(uint8_t phase);
+
+  // Static Constants
+
+  // Flight Phases
+  static const uint8_t Pad = 0;
+  static const uint8_t Ascent = 1;
+  static const uint8_t Float = 2;
+  static const uint8_t Burst = 3;
+  static const uint8_t Descent = 4;
+  static const uint8_t Landed = 5;
+  static const uint8_t NPhases = 6;
+
+  // Climb rate thresholds [m/s]
+  static const constexpr float AscentRate = 1.5f;
+  static const constexpr float FloatRate = 1.0f;
+  static const constexpr float BurstRate = -5.0f;
+  static const constexpr float LandedRate = 0.5f;
+
+  // Launch detection altitude gain [m]
+  static const constexpr float LaunchHeight = 100.0f;
+
+  // Vertical acceleration indicating free fall after burst [m/s^2]
+  static const constexpr float FreeFall = -6.0f;
+
+  // Minimum time a transition condition must hold [s]
+  static const constexpr float AscentHold = 5.0f;
+  static const constexpr float FloatHold = 60.0f;
+  static const constexpr float BurstHold = 2.0f;
+  static const constexpr float FreeFallHold = 0.5f;
+  static const constexpr float LandedHold = 30.0f;
+
+  // Time spent in the burst phase before descent [s]
+  static const constexpr float BurstTime = 30.0f;
+
+private:
+  // Accumulate the time a candidate transition has held, returns true once it exceeds hold
+  bool hold(uint8_t candidate, bool condition, float hold, float dt);
+
+  // Change phase
+  void enter(uint8_t phase);
+
+  std::atomic<uint8_t> current;
+  uint8_t candidate;
+  float candidateTime, phaseTime, launch;
+  bool launchSet;
+};
@@ -0,0 +1,42 @@
+/**
+ * Frame Quality Score
+ *
+ * Cheap quality metrics used to pick the best frame of a camera burst:
+ * the variance of the Laplacian measures sharpness (payload swing blurs
+ * edges), and the entropy of the intensity histogram measures content
+ * (a frame of empty sky has a narrow histogram). Both are computed on a
+ * greyscale copy downscaled to at most MaxWidth pixels wide.
+ *
+ * The Laplacian kernel is a simple loop over contiguous rows with 32 bit
+ * accumulators, so it auto-vectorises; the Makefile builds this file with
+ * -O3 -ftree-vectorize whatever CFLAGS says, adding -mfpu=neon on a CPU
+ * with NEON such as the Pi 3. On the Pi Zero it runs as scalar code.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-09-30
+ */
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+class FrameScore {
+public:
+  // Combined score of an 8 bit image with 1, 3 or 4 channels, higher is better
+  static float score(const uint8_t *image, int width, int height, int channels);
+
+  // Box filter to a greyscale image at most MaxWidth pixels wide
+  static void downscale(const uint8_t *image, int width, int height, int channels,
+                        std::vector<uint8_t> &grey, int &greyWidth, int &greyHeight);
+
+  // Variance of the 4-neighbour Laplacian of a greyscale image
+  static float sharpness(const uint8_t *grey, int width, int height);
+
+  // Shannon entropy of the intensity histogram of a greyscale image [bits]
+  static float entropy(const uint8_t *grey, int width, int height);
+
+  // Static Constants
+
+  // Maximum width of the scoring buffer [pixels]
+  static const int MaxWidth = 160;
+};
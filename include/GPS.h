@@ -9,9 +9,17 @@
 #pragma once
 
 #include <iostream>
+#include <string>
 #include <stdint.h>
 #include <iomanip>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
 #include "libgpsmm.h"
+#include "NMEA.h"
 
 class GPS {
 public:
@@ -21,19 +29,52 @@ public:
 	// GPS Constructor
 	~GPS();
 
-	// Begin GPS
+	// Begin GPS using gpsd
 	bool begin();
 
-	// Update GPS
-	void update();
+	// Begin GPS reading the receiver directly from a serial device
+	bool begin(const std::string &device);
+
+	// Update GPS, returns true when a new fix was stored
+	bool update();
 
 	// Store GPS Data
 	void storeData(struct gps_data_t *collect);
 
+	// Store GPS Data decoded by the NMEA/UBX parser
+	void storeData(const gnss_fix_t &fix);
+
 	// Static Constants
 	static const int GpsTimeout = 20000; //2000000
 
+	// Fix period requested from the receiver when read directly [ms]
+	static const int FixPeriod = 200;
+
+	// Reads of the serial device without a fix before a timeout is reported
+	static const int MissedReads = 10;
+
+	// Flight recorder keys for raw receiver output and gpsd reports
+	static const uint16_t RawKey = 0;
+	static const uint16_t FixKey = 1;
+
 private:
+	// Update GPS from the serial device, returns true when a new fix was stored
+	bool updateSerial();
+
+	// Update GPS from a replayed trace, returns true when a new fix was stored
+	bool updateReplay();
+
+	// Record a gpsd report as a fix
+	void recordData(struct gps_data_t *collect);
+
+	// Print the current GPS values
+	void print();
+
 	gpsmm *gps_rec;
 	struct gps_data_t *data;
+
+	// Serial device and parser for the direct backend, and reads since the last fix
+	int fd;
+	NMEA nmea;
+	int missed;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+/**
+ * Power Governor
+ *
+ * Maps the battery voltage onto performance tiers (full, reduced, low
+ * and critical), which the Module turns into the CPU frequency governor,
+ * sensor, camera and downlink rates, and thumbnail size. A tier is left
+ * as soon as the voltage falls below its threshold, but only regained
+ * once the voltage is Hysteresis above it, so a battery recovering as
+ * the load drops does not flip the tier back and forth.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-01-27
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+class Governor {
+public:
+  // Governor Constructor
+  Governor();
+
+  // Update with the battery voltage [V], returns true if the tier changed
+  bool update(float voltage);
+
+  // Current tier
+  uint8_t tier() const { return current; }
+
+  // Tier name
+  static const char *name(uint8_t tier);
+
+  // Static Constants
+
+  // Performance Tiers
+  static const uint8_t Full = 0;
+  static const uint8_t Reduced = 1;
+  static const uint8_t Low = 2;
+  static const uint8_t Critical = 3;
+  static const uint8_t NTiers = 4;
+
+  // Lowest voltage of the full, reduced and low tiers, for four lithium AA cells [V]
+  static const constexpr float FullVoltage = 6.0f;
+  static const constexpr float ReducedVoltage = 5.6f;
+  static const constexpr float LowVoltage = 5.2f;
+
+  // Voltage above a threshold needed to regain its tier [V]
+  static const constexpr float Hysteresis = 0.1f;
+
+private:
+  // Lowest voltage of tier [V]
+  static float threshold(uint8_t tier);
+
+  std::atomic<uint8_t> current;
+};
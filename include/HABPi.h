@@ -3,12 +3,26 @@
 #include "Global.h"
 
 #include "Logger.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "Console.h"
+#include "Realtime.h"
+#include "Startup.h"
+#include "Watchdog.h"
+#include "ProcessRunner.h"
+#include "Recorder.h"
 #include "Database.h"
+#include "TelemetryLog.h"
+#include "TelemetryCache.h"
+#include "CRC.h"
 #include "Serializer.h"
+#include "XBeeApi.h"
+#include "XBeeRadio.h"
 
 #include "i2c_bus.h"
 #include "spi_bus.h"
 
+#include "NMEA.h"
 #include "GPS.h"
 
 #include "FXAS21002C.h"
@@ -20,9 +34,20 @@
 #include "MPL3115A2.h"
 #include "MPL3115A2_U.h"
 
+#include "DHTReader.h"
 #include "DHT.h"
 #include "DHT_U.h"
 
+#include "Palette.h"
+#include "FrameScore.h"
+#include "Archiver.h"
+#include "VideoRing.h"
 #include "Camera.h"
 
+#include "Altimeter.h"
+#include "Checkpoint.h"
+#include "FlightPhase.h"
+#include "Governor.h"
+#include "Downlink.h"
+
 #include "Module.h"
@@ -66,4 +66,21 @@ public:
     *y = q2;
     *z = q3;
   }
+  void setQuaternion(float w, float x, float y, float z) {
+    q0 = w;
+    q1 = x;
+    q2 = y;
+    q3 = z;
+    anglesComputed = 0;
+  }
+  void getIntegralFeedback(float *x, float *y, float *z) {
+    *x = integralFBx;
+    *y = integralFBy;
+    *z = integralFBz;
+  }
+  void setIntegralFeedback(float x, float y, float z) {
+    integralFBx = x;
+    integralFBy = y;
+    integralFBz = z;
+  }
 };
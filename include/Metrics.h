@@ -0,0 +1,130 @@
+/**
+ * Metrics Registry
+ *
+ * Always-on latency histograms and event counters for the sensor,
+ * camera and broadcast loops. Each thread records into its own shard,
+ * so a sample is a few relaxed atomic stores with no locks or
+ * contention; a snapshot sums the shards.
+ *
+ * Histograms are log-linear (HDR style): values below SubBuckets are
+ * exact, above that every power of two is split into SubBuckets equal
+ * buckets, bounding the relative error of a percentile to 1/SubBuckets.
+ *
+ * A snapshot is written to a file every SnapshotPeriod and on SIGUSR1.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-10-21
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <iostream>
+
+class Metrics {
+public:
+  // Record a sample of histogram id
+  static void record(uint8_t id, uint64_t value);
+
+  // Add to counter id
+  static void count(uint8_t id, uint64_t n = 1);
+
+  // Value of percentile p (0 to 100) of histogram id
+  static uint64_t percentile(uint8_t id, double p);
+
+  // Write a snapshot of every histogram and counter
+  static void snapshot(std::ostream &out);
+
+  // Atomically replace path with a snapshot, returns false on error
+  static bool dump(const std::string &path);
+
+  // Request a snapshot, safe to call from a signal handler
+  static void request() { requested = true; }
+
+  // Dump a snapshot to Path if requested or SnapshotPeriod has elapsed
+  static void poll(std::chrono::steady_clock::time_point now);
+
+  // Times a scope into a histogram [us]
+  class Timer {
+  public:
+    explicit Timer(uint8_t id): id(id), start(std::chrono::steady_clock::now()) {}
+    ~Timer() { record(id, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()); }
+  private:
+    uint8_t id;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  // Static Constants
+
+  // Latency histograms [us], unless noted
+  static const uint8_t SensorUpdate = 0;
+  static const uint8_t GpsRead = 1;
+  static const uint8_t ImuRead = 2;
+  static const uint8_t MplRead = 3;
+  static const uint8_t DhtRead = 4;
+  static const uint8_t Serialize = 5;
+  static const uint8_t SpiHandshake = 6;     // handshake attempts per command
+  static const uint8_t SpiTransfer = 7;
+  static const uint8_t Broadcast = 8;
+  static const uint8_t ImageCapture = 9;
+  static const uint8_t ImageQuantise = 10;
+  static const uint8_t ImageLoad = 11;
+  static const uint8_t DbWrite = 12;
+  static const uint8_t WakeLatency = 13;     // broadcast loop lateness after sleeping
+  static const uint8_t ArchiveWrite = 14;
+  static const uint8_t RadioStatus = 15;     // XBee transmit request to status
+  static const uint8_t Stall = 16;           // loop without a heartbeat past its deadline
+  static const uint8_t NHistograms = 17;
+
+  // Counters
+  static const uint8_t SensorSent = 0;
+  static const uint8_t SensorFailed = 1;
+  static const uint8_t ImageSent = 2;
+  static const uint8_t ImageFailed = 3;
+  static const uint8_t SpiHandshakeFailed = 4;
+  static const uint8_t ImagesCaptured = 5;
+  static const uint8_t ArchiveWritten = 6;
+  static const uint8_t ArchiveDropped = 7;
+  static const uint8_t ChunksResent = 8;
+  static const uint8_t UplinkReceived = 9;
+  static const uint8_t RadioDelivered = 10;
+  static const uint8_t RadioFailed = 11;
+  static const uint8_t Stalls = 12;
+  static const uint8_t NCounters = 13;
+
+  // Histogram resolution
+  static const int SubBits = 3;
+  static const int SubBuckets = 1 << SubBits;
+  static const int NBuckets = SubBuckets * 34;
+
+  // Threads with a shard of their own, further threads share the last one
+  static const int MaxShards = 8;
+
+  // Snapshot file and period
+  static const std::string Path;
+  static const int SnapshotPeriod = 10;
+
+private:
+  // Per thread samples, each shard has a single writer
+  struct shard_t {
+    std::atomic<uint32_t> buckets[NHistograms][NBuckets];
+    std::atomic<uint64_t> sum[NHistograms], max[NHistograms];
+    std::atomic<uint64_t> counters[NCounters];
+  };
+
+  // Bucket index of a value
+  static int bucket(uint64_t value);
+
+  // Representative value of a bucket
+  static uint64_t value(int bucket);
+
+  // Shard of the calling thread
+  static shard_t &shard();
+
+  static shard_t shards[MaxShards];
+  static std::atomic<int> nextShard;
+  static std::atomic<bool> requested;
+  static std::chrono::steady_clock::time_point lastDump;
+};
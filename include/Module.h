@@ -12,7 +12,44 @@
 #include "Madgwick.h"
 #include "Mahony.h"
 #include "libgpsmm.h"
+#include "GPS.h"
 #include "Camera.h"
+#include "Altimeter.h"
+#include "FlightPhase.h"
+#include "Governor.h"
+#include "Downlink.h"
+#include "Recorder.h"
+#include "Archiver.h"
+#include "Startup.h"
+#include "Watchdog.h"
+#include "ProcessRunner.h"
+
+// Per flight phase rates and priorities
+struct phase_profile_t {
+  // Sensor, archived image, captured thumbnail and broadcast delays [us]
+  int sensorDelay, imageDelay, captureDelay, broadcastDelay;
+
+  // Image chunks sent before a pending sensor message
+  int imageChunks;
+
+  // Write video of entering the phase, and keep the pre-trigger video ring running
+  bool video, ring;
+};
+
+// Per power tier rates and limits
+struct power_profile_t {
+  // CPU frequency governor
+  const char *cpuGovernor;
+
+  // Sensor, image and broadcast delays, as multiples of those of the flight phase
+  int sensorScale, imageScale, broadcastScale;
+
+  // Largest thumbnail, as an index into the camera's size ladder
+  int maxSize;
+
+  // Keep full resolution images, and record video
+  bool archive, video;
+};
 
 /**
  * Module Class
@@ -34,13 +71,37 @@ public:
 	// Module Broadcast Update
 	void broadcastUpdate(std::atomic<bool> &sensorReady, std::atomic<bool> &imageReady);
 
-	// Send SPI Command
+	// Send SPI Command, recorded or replayed by the flight recorder
 	bool sendSPICommand(uint8_t command, uint8_t len, uint8_t *rxData);
 
+	// Send a sealed sensor or image frame to the radio
+	bool transmit(uint8_t command, uint8_t len);
+
 	// Static variables
 
-	// Flags to enable sensor component
-  static bool isRunning, enableGPS, enableAHRS, enableMPL, enableDHT, enableIMG, recordVideo;
+	// Flags to enable sensor component, set as each component comes up
+  static std::atomic<bool> isRunning, enableGPS, enableAHRS, enableMPL, enableDHT, enableIMG, recordVideo;
+
+  // Stage of the sensor bypassed by the watchdog while its read is stuck, or NULL
+  static std::atomic<const char *> bypassed;
+
+  // Read the GPS receiver directly instead of through gpsd
+  static bool directGPS;
+
+  // Drive the XBee directly instead of through the Arduino
+  static bool directRadio;
+
+  // Directory of the segmented telemetry log, empty to disable it
+  static std::string telemetryDirectory;
+
+  // H.264 file fed to the pre-trigger video ring instead of the camera, empty to use the camera
+  static std::string videoSource;
+
+  // Resume from the last checkpoint instead of starting afresh
+  static bool warmStart;
+
+  // Feed the hardware watchdog while the critical loops are healthy
+  static bool hardwareWatchdog;
 
   // Image Number and Chunk Number
   static int imageNumber, imageChunkNumber;
@@ -48,23 +109,57 @@ public:
   // Video Number
   static int videoNumber;
 
+  // Full Resolution Image Number
+  static int archiveNumber;
+
   // Sensor, Image and Battery Messages
   static sensor_msg_t sensorMsg;
   static image_msg_t imageMsg;
   static battery_msg_t batteryMsg;
 
   // Image broadcast queue
-  static std::vector<image_msg_t> broadcast_queue;
+  static Downlink downlink;
 
   // Sensor and Image Payloads
   static uint8_t sensorPayload[Serializer::SensorSize], imagePayload[Serializer::ImageSize];
 
+  // Sequence number of the next frame sent to the radio
+  static uint16_t sequence;
+
 	// Serializer
 	static Serializer serializer;
 
 	// Logger
 	static Logger logger;
 
+	// Flight recorder
+	static Recorder recorder;
+
+  // Full resolution image writer
+  static Archiver archiver;
+
+  // High rate telemetry store
+  static TelemetryLog telemetry;
+
+  // Recent telemetry history, for trends
+  static TelemetryCache history;
+
+  // XBee in API mode, when driven directly
+  static XBeeRadio radio;
+
+  // State kept across restarts
+  static Checkpoint checkpoint;
+
+  // Component initialization
+  static Startup init;
+
+  // Loop supervisor, and the ids of the supervised loops
+  static Watchdog watchdog;
+  static int sensorLoop, cameraLoop, broadcastLoop;
+
+  // Child processes of the camera, video and gpsd tools
+  static ProcessRunner processes;
+
   // Sensors
   static GPS gps;
   static AHRS ahrs;
@@ -72,6 +167,15 @@ public:
   static DHT_Unified dht;
   static Camera camera;
 
+  // Vertical state estimator
+  static Altimeter altimeter;
+
+  // Flight phase detector
+  static FlightPhase flight;
+
+  // Battery power governor
+  static Governor governor;
+
   // Debugging counters
   static int sensorCounter, imageCounter;
   static int sensorAckCounter, imageAckCounter;
@@ -79,18 +183,51 @@ public:
 
   // Static Constants
 
-  // Paths to I2C and SPI devices
+  // Paths to I2C, SPI and GPS devices
   static const std::string I2CPath;
   static const std::string SPIPath;
+  static const std::string GPSPath;
+  static const std::string XBeePath;
+
+  // Path to the checkpoint file
+  static const std::string CheckpointPath;
+
+  // Path to the hardware watchdog device
+  static const std::string WatchdogPath;
+
+  // Path to the CPU frequency governor
+  static const std::string CpuGovernorPath;
+
+  // XBee serial rate, and the 64-bit address of the ground station XBee
+  static const int XBeeBaud = 115200;
+  static const uint64_t StationAddress = 0x0013A20040F32EB0ULL;
 
   // Timing Constants
 	static const int Microsecond = 1000000;
 	static const int SensorDelay = Microsecond;
+	static const int ImuDelay = Microsecond / 70;
+	static const int GpsDelay = GPS::FixPeriod * (Microsecond / 1000) / 2;   // Twice per fix, when read directly
 	static const int ImageDelay = 100 * Microsecond;
+	static const int MinImageDelay = 5 * Microsecond;
 	static const int BroadcastDelay = 9 * Microsecond / 100;
 	static const int SpiTimeout = 10 * Microsecond;
+	static const int CheckpointDelay = 5 * Microsecond;
 	static const int MinDelay = 10;
 
+	// Startup deadlines, for buses and files, sensors, and gpsd and the camera [ms]
+	static const int BusDeadline = 1000;
+	static const int SensorDeadline = 3000;
+	static const int SlowDeadline = 5000;
+
+	// Timeout of the gpsd commands [ms]
+	static const int CommandTimeout = 5000;
+
+	// Longest time each loop may go without a heartbeat, a camera iteration
+	// includes a full resolution capture [ms]
+	static const int SensorStall = 5000;
+	static const int CameraStall = 15000;
+	static const int BroadcastStall = 5000;
+
 	// SPI Messages
 	static const uint8_t Nul = 0x00;
 	static const uint8_t Stx = 0x02;
@@ -104,6 +241,29 @@ public:
 	static const uint8_t SensorCmd = 0x60;
 	static const uint8_t ImageCmd = 0x70;
 	static const uint8_t BatteryCmd = 0x90;
+	static const uint8_t UplinkCmd = 0xA0;
+
+	// Without an uplink frame for UplinkQuiet [ms], the Arduino is asked for one
+	// only every UplinkBackoff broadcast slots, as no ground station may be listening
+	static const int UplinkQuiet = 30000;
+	static const int UplinkBackoff = 8;
+
+	// Image, video and archive numbers, and frame sequence numbers, skipped on a warm start
+	// since some may have been used after the last checkpoint
+	static const int NumberMargin = 16;
+	static const int SequenceMargin = 256;
+
+	// Flight state older than this is not resumed [s]
+	static const int ResumeAge = 6 * 3600;
+
+	// Rates and priorities for each flight phase
+	static const phase_profile_t Profiles[FlightPhase::NPhases];
+
+	// Rates and limits for each power tier
+	static const power_profile_t Power[Governor::NTiers];
+
+	// Battery voltages are taken over this window [s]
+	static const constexpr float PowerWindow = 60.0f;
 
 	// Pressure-Altitude Coefficient
 	static const constexpr double Alpha = 2.25577E-7;
@@ -120,21 +280,81 @@ public:
 	// Pressure at Sea Level [hPa]
 	static const constexpr double P_0 = 1013.25;
 
+	// Capture the next thumbnail when the downlink backlog drains within this time [s]
+	static const constexpr float CaptureLead = 5.0f;
+
+	// Start recording video when descending below this altitude [m]
+	static const constexpr float VideoAltitude = 500.0f;
+
+	// Set the proximity flag when descending below this altitude [m]
+	static const constexpr float ProximityAltitude = 250.0f;
+
   // Static Methods
 
+	// Restart gpsd on the GPS receiver
+	static void resetGPSD();
+
+	// Bypass the sensor the sensor loop is stuck in
+	static void sensorStall(const char *stage);
+
+	// Re-enable the sensor bypassed by sensorStall
+	static void sensorResume();
+
+	// Stop the child process the camera loop is stuck in
+	static void cameraStall(const char *stage);
+
 	// Module update
 	static void update();
 
+	// Module IMU update, run at ImuDelay
+	static void imuUpdate();
+
+	// Module GPS update of the receiver read directly, run at GpsDelay
+	static void gpsUpdate();
+
+	// Rates and priorities for the current flight phase
+	static const phase_profile_t &profile() { return Profiles[flight.phase()]; }
+
+	// Rates and limits for the current power tier
+	static const power_profile_t &power() { return Power[governor.tier()]; }
+
+	// Sensor, image and broadcast delays for the flight phase and power tier [us]
+	static int64_t sensorDelay() { return static_cast<int64_t>(profile().sensorDelay) * power().sensorScale; }
+	static int64_t imageDelay() { return static_cast<int64_t>(profile().imageDelay) * power().imageScale; }
+	static int64_t captureDelay() { return static_cast<int64_t>(profile().captureDelay) * power().imageScale; }
+	static int64_t broadcastDelay() { return static_cast<int64_t>(profile().broadcastDelay) * power().broadcastScale; }
+
+	// Flight phase update, dt in seconds
+	static void phaseUpdate(float dt);
+
+	// Power tier update, from the battery voltages
+	static void powerUpdate();
+
 	// Module Sensor Update
 	static void sensorUpdate(std::atomic<bool> &sensorReady);
 
 	// Module Camera Update
 	static void cameraUpdate(std::atomic<bool> &imageReady);
 
-	// Digi XBee API Frame Packet Checksum
-  static uint8_t checksum(uint8_t len, uint8_t *buffer);
+	// Apply an uplink frame from the ground station
+	static void uplinkUpdate(uint8_t *frame, std::atomic<bool> &imageReady);
+
+	// Thumbnail size for the measured downlink throughput
+	static void thumbnailSize(int &width, int &height);
+
+	// Stage the flight state for the next checkpoint
+	static void checkpointUpdate();
+
+	// Save a checkpoint of the staged flight state and the image numbering
+	static void checkpointSave();
+
+	// Resume from the last checkpoint
+	static void resume();
 
 private:
+	// Exchange an SPI Command with the Arduino
+	bool exchangeSPICommand(uint8_t command, uint8_t len, uint8_t *rxData);
+
 	// SPI Parameters
   spi_bus spi;
 
@@ -0,0 +1,168 @@
+/**
+ * NMEA and UBX Parser
+ *
+ * Incremental, allocation free parser for the NMEA 0183 sentences
+ * (GGA, RMC, GSA, VTG) and the u-blox UBX NAV-PVT packet emitted by the
+ * GPS receiver on the RPi UART. Bytes are fed one at a time, and the
+ * decoded values are accumulated into a gnss_fix_t which mirrors the
+ * gpsd fields used by GPS::storeData.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-09-02
+ */
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+
+// Decoded GNSS fix
+struct gnss_fix_t {
+  // Bitmask of NMEA::*Set flags updated since the last clear
+  uint32_t set;
+
+  // Fix status, mode and number of satellites used
+  uint8_t status, mode, nsats;
+
+  // Position [deg, deg, m], ground speed [m/s], track [deg] and climb [m/s]
+  double latitude, longitude, altitude, speed, track, climb;
+
+  // UTC time of day [s]
+  double time;
+};
+
+class NMEA {
+public:
+  // NMEA Constructor
+  NMEA();
+
+  // NMEA Destructor
+  ~NMEA();
+
+  // Reset parser state and fix
+  void reset();
+
+  // Parse a single byte, returns true when a complete and valid
+  // sentence or packet has updated the fix
+  bool parse(uint8_t c);
+
+  // Parse a buffer, returns the number of sentences or packets decoded
+  int parse(const uint8_t *buffer, size_t len);
+
+  // Current fix
+  const gnss_fix_t &fix() const { return current; }
+
+  // Clear the set flags of the current fix
+  void clearSet() { current.set = 0; }
+
+  // Number of valid sentences/packets and checksum failures
+  uint32_t sentences() const { return nsentences; }
+  uint32_t errors() const { return nerrors; }
+
+  // Build a UBX packet in buffer, returns the packet length
+  static size_t ubxPacket(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len, uint8_t *buffer);
+
+  // Build UBX-CFG-RATE to set the measurement period, returns the packet length
+  static size_t rateCommand(uint16_t periodMs, uint8_t *buffer);
+
+  // Build UBX-CFG-MSG to set the output rate of a message, returns the packet length
+  static size_t messageRateCommand(uint8_t cls, uint8_t id, uint8_t rate, uint8_t *buffer);
+
+  // Static Constants
+
+  // Fix fields set flags
+  static const uint32_t TimeSet = 0x0001;
+  static const uint32_t LatLonSet = 0x0002;
+  static const uint32_t AltitudeSet = 0x0004;
+  static const uint32_t SpeedSet = 0x0008;
+  static const uint32_t TrackSet = 0x0010;
+  static const uint32_t ClimbSet = 0x0020;
+  static const uint32_t StatusSet = 0x0040;
+  static const uint32_t ModeSet = 0x0080;
+  static const uint32_t SatelliteSet = 0x0100;
+
+  // Fix status and mode, matching gpsd
+  static const uint8_t StatusNoFix = 0;
+  static const uint8_t StatusFix = 1;
+  static const uint8_t StatusDgpsFix = 2;
+  static const uint8_t ModeNoFix = 1;
+  static const uint8_t Mode2D = 2;
+  static const uint8_t Mode3D = 3;
+
+  // UBX message classes and identifiers
+  static const uint8_t UbxNav = 0x01;
+  static const uint8_t UbxCfg = 0x06;
+  static const uint8_t UbxNavPvt = 0x07;
+  static const uint8_t UbxCfgMsg = 0x01;
+  static const uint8_t UbxCfgRate = 0x08;
+  static const uint8_t NmeaStd = 0xF0;
+
+  // Standard NMEA sentence identifiers, GGA, GLL, GSA, GSV, RMC and VTG in order
+  static const uint8_t NmeaGga = 0x00;
+  static const uint8_t NmeaVtg = 0x05;
+
+  // Maximum sentence and UBX payload lengths
+  static const int MaxSentence = 96;
+  static const int MaxFields = 24;
+  static const int MaxPayload = 100;
+
+  // Unit conversions
+  static const constexpr double KnotsToMs = 0.514444;
+  static const constexpr double KphToMs = 1.0 / 3.6;
+
+private:
+  // Decode a complete NMEA sentence
+  bool decodeSentence();
+
+  // Decode the supported NMEA sentences
+  void decodeGGA();
+  void decodeRMC();
+  void decodeGSA();
+  void decodeVTG();
+
+  // Decode a complete UBX packet
+  bool decodeUBX();
+
+  // Field helpers
+  const char *field(int n) const { return n < nfields ? fields[n] : ""; }
+  static bool empty(const char *s) { return *s == '\0'; }
+  static double decimal(const char *s);
+  static double coordinate(const char *s, char hemisphere);
+  static double utc(const char *s);
+  static int hex(char c);
+
+  // Parser states
+  enum {
+    Idle,
+    Sentence,
+    Checksum1,
+    Checksum2,
+    UbxSync2,
+    UbxClass,
+    UbxId,
+    UbxLength1,
+    UbxLength2,
+    UbxPayload,
+    UbxCheckA,
+    UbxCheckB
+  };
+
+  uint8_t state;
+
+  // NMEA sentence buffer, split in place into fields
+  char sentence[MaxSentence];
+  const char *fields[MaxFields];
+  int length, nfields;
+  uint8_t checksum, received;
+
+  // UBX packet buffer
+  uint8_t ubxClass, ubxId, ubxCkA, ubxCkB;
+  uint16_t ubxLength, ubxIndex;
+  uint8_t payload[MaxPayload];
+
+  // Previous altitude and time used to derive the climb rate from GGA
+  double prevAltitude, prevTime;
+  bool havePrev;
+
+  gnss_fix_t current;
+  uint32_t nsentences, nerrors;
+};
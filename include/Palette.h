@@ -0,0 +1,36 @@
+/**
+ * VGA Palette
+ *
+ * The 256 colour palette thumbnails are remapped to before broadcast,
+ * so each pixel is sent as a single index byte. Shared by the camera
+ * and the ground station, which maps the indices back to RGB.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-09
+ */
+#pragma once
+
+#include <stdint.h>
+
+// RGB values
+struct rgb_t {
+  uint8_t r, g, b;
+
+  // RGB comparison method
+  bool compare(rgb_t p) {
+    bool status = true;
+    status = status && this->r == p.r;
+    status = status && this->g == p.g;
+    status = status && this->b == p.b;
+    return status;
+  }
+};
+
+class Palette {
+public:
+  // Static Constants
+  static const int NColours = 256;
+
+  // VGA palette RGB values
+  static const rgb_t Vga[NColours];
+};
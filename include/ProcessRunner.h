@@ -0,0 +1,120 @@
+/**
+ * Process Runner
+ *
+ * Runs the camera, video and gpsd tools as child processes without a
+ * shell. Children are started with posix_spawn in a process group of
+ * their own, so a SIGINT from the terminal reaches only HABPi, which
+ * then stops them itself. A reaper thread collects their stdout (when
+ * asked for) and stderr, and their exit status, waking on a pidfd where
+ * the kernel has one and otherwise every PollInterval.
+ *
+ * A child may have a timeout, after which it is sent SIGTERM and, after
+ * KillGrace, SIGKILL. A streaming child hands its stdout to the caller,
+ * who reads it as it is written. At most MaxRunning children run at once; start()
+ * waits for a free slot. stop() ends every child for a prompt shutdown.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-02-03
+ */
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Outcome of a child process
+struct process_result_t {
+  // Exit status, or -1 if it was killed by a signal or could not be started
+  int status;
+
+  // Stopped at its timeout
+  bool timedOut;
+
+  // Captured stdout, and stderr (up to MaxError bytes)
+  std::string out, err;
+};
+
+class ProcessRunner {
+public:
+  // ProcessRunner Constructor
+  ProcessRunner();
+
+  // ProcessRunner Destructor
+  ~ProcessRunner();
+
+  // Start argv with a timeout [ms], or 0 for none, optionally capturing stdout, returns a job id, or -1 with errno set
+  int start(const std::vector<std::string> &argv, int timeout, bool captureOut = false);
+
+  // Start argv with a timeout [ms], or 0 for none, handing the read end of its stdout to the caller in outFd
+  int stream(const std::vector<std::string> &argv, int timeout, int &outFd);
+
+  // Job has finished
+  bool finished(int job);
+
+  // Wait for job to finish and take its result
+  process_result_t wait(int job);
+
+  // Start argv and wait for it
+  process_result_t run(const std::vector<std::string> &argv, int timeout, bool captureOut = false);
+
+  // Stop the running children started as name, returns how many
+  int terminate(const std::string &name);
+
+  // Stop every child, and refuse new ones
+  void stop();
+
+  // Static Constants
+
+  // Children running at once
+  static const int MaxRunning = 2;
+
+  // Time between SIGTERM and SIGKILL [ms]
+  static const int KillGrace = 1000;
+
+  // Reaper wakeup without a pidfd [ms]
+  static const int PollInterval = 20;
+
+  // Captured stderr [bytes]
+  static const size_t MaxError = 4096;
+
+private:
+  struct child_t {
+    std::string name;
+    pid_t pid;
+    int pidfd, outFd, errFd;
+    std::chrono::steady_clock::time_point deadline, killAt;
+    bool terminated, done;
+    process_result_t result;
+  };
+
+  // Spawn argv, with stdout captured, on a pipe read into outFd when it is not NULL, or discarded
+  int spawn(const std::vector<std::string> &argv, int timeout, bool captureOut, int *outFd);
+
+  // Reaper thread
+  void reap();
+
+  // Read what is available from fd into out, up to limit bytes, closing it at end of file
+  static void drain(int &fd, std::string &out, size_t limit);
+
+  // Send SIGTERM to the process group of child
+  void interrupt(child_t &child, bool timedOut);
+
+  // Children started and not yet waited for, and how many of them are running
+  std::map<int, child_t> children;
+  int nrunning;
+  int nextJob;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::thread reaper;
+  bool stopping;
+
+  // Pipe waking the reaper when a child is added or the runner stops
+  int wake[2];
+};
@@ -0,0 +1,41 @@
+/**
+ * Real-time Execution
+ *
+ * Optional real-time profile for the SPI broadcast loop, whose byte
+ * gaps the Arduino slave has to keep up with. reserve() is called by
+ * main before any thread is started: it locks memory and keeps the
+ * process, and so every thread and shell command started later, off the
+ * last CPU. enter() then moves the broadcast thread onto that CPU with
+ * SCHED_FIFO priority and prefaults its stack. On a single core Pi only
+ * the priority and memory locking apply.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-11-18
+ */
+#pragma once
+
+#include <stddef.h>
+
+class Realtime {
+public:
+  // Lock memory and reserve a CPU for the real-time thread, returns false on error
+  static bool reserve();
+
+  // Run the calling thread on the reserved CPU with SCHED_FIFO priority
+  static bool enter();
+
+  // Real-time mode requested
+  static bool enabled;
+
+  // Static Constants
+
+  // SCHED_FIFO priority, above kernel threaded interrupts (50)
+  static const int Priority = 80;
+
+  // Stack prefaulted by enter [bytes]
+  static const size_t PrefaultStack = 256 * 1024;
+
+private:
+  // CPU reserved for the real-time thread, -1 if none
+  static int cpu;
+};
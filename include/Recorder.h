@@ -0,0 +1,139 @@
+/**
+ * Flight Recorder
+ *
+ * Records every raw device interaction (I2C reads, GPS reports, DHT
+ * bits, SPI command outcomes and camera frames) with a timestamp into a
+ * compact binary trace, and replays a trace back through the real code
+ * so a whole flight can be run without hardware.
+ *
+ * Trace format (little endian):
+ *   header: "HABT", uint16 version, uint16 reserved
+ *   record: varint time delta [us], uint8 channel, uint16 key,
+ *           varint length, payload
+ *
+ * During replay each (channel, key) pair is an independent queue, so
+ * threads consuming different devices do not need to interleave exactly
+ * as they did in flight. Time seen by the Module loops comes from now(),
+ * which runs faster than real time by the replay speed factor.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-10-07
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sys/resource.h>
+
+// Location of a record payload in the loaded trace
+struct trace_record_t {
+  uint64_t time;
+  uint32_t offset;
+  uint32_t length;
+};
+
+class Recorder {
+public:
+  // Recorder Constructor
+  Recorder();
+
+  // Recorder Destructor
+  ~Recorder();
+
+  // Start recording a trace to path
+  bool record(const std::string &path);
+
+  // Load a trace from path for replay at speed times real time (0 = as fast as possible)
+  bool replay(const std::string &path, float speed);
+
+  // Flush and close the trace
+  void close();
+
+  // Recording a trace
+  bool recording() const { return mode == RecordMode; }
+
+  // Replaying a trace
+  bool replaying() const { return mode == ReplayMode; }
+
+  // Record a device interaction
+  void record(uint8_t channel, uint16_t key, const uint8_t *data, size_t len);
+
+  // Replay the next interaction for (channel, key) into data, up to len bytes;
+  // returns the recorded length, or -1 once the queue is exhausted
+  int replay(uint8_t channel, uint16_t key, uint8_t *data, size_t len);
+
+  // Replay the next interaction for (channel, key) of any length
+  bool replay(uint8_t channel, uint16_t key, std::vector<uint8_t> &data);
+
+  // Current time, accelerated by the speed factor during replay
+  std::chrono::steady_clock::time_point now();
+
+  // Sleep for us microseconds of (replay) time
+  void sleep(int us);
+
+  // Sleep until time t of now()
+  void sleepUntil(std::chrono::steady_clock::time_point t);
+
+  // Print throughput and memory usage
+  void report(std::ostream &out);
+
+  // Static Constants
+
+  // Modes
+  static const uint8_t OffMode = 0;
+  static const uint8_t RecordMode = 1;
+  static const uint8_t ReplayMode = 2;
+
+  // Channels
+  static const uint8_t I2CChannel = 1;
+  static const uint8_t SPIChannel = 2;
+  static const uint8_t GPSChannel = 3;
+  static const uint8_t DHTChannel = 4;
+  static const uint8_t CameraChannel = 5;
+  static const uint8_t NChannels = 6;
+
+  // Trace format version
+  static const uint16_t Version = 1;
+
+  // Speed factor used to replay as fast as possible
+  static const constexpr float MaxSpeed = 1000.0f;
+
+  // Size of the record buffer flushed to disk [bytes]
+  static const size_t BufferSize = 65536;
+
+private:
+  // Append a variable length integer to the record buffer
+  void putVarint(uint64_t value);
+
+  // Read a variable length integer from the loaded trace
+  bool getVarint(size_t &pos, uint64_t &value);
+
+  // Elapsed microseconds since start
+  uint64_t elapsed(std::chrono::steady_clock::time_point t);
+
+  uint8_t mode;
+  float speed;
+  std::mutex mutex;
+  std::chrono::steady_clock::time_point start;
+
+  // Recording
+  std::ofstream file;
+  std::vector<uint8_t> buffer;
+  uint64_t lastTime;
+
+  // Replay
+  std::vector<uint8_t> trace;
+  std::map<uint32_t, std::deque<trace_record_t> > queues;
+  uint64_t duration;
+
+  // Statistics
+  uint64_t records[NChannels], bytes[NChannels];
+};
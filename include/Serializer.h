@@ -6,7 +6,9 @@
 // Broadcast message parameters
 #define PAYLOADSIZE          (100)
 #define HEADERSIZE           (12)
-#define CHUNKSIZE            (88)
+#define TRAILERSIZE          (4)
+#define CHUNKSIZE            (84)
+#define ACKBYTES             (32)
 
 // Union to convert four uint8_t to a float
 union floatunion_t {
@@ -46,6 +48,20 @@ struct image_msg_t {
   uint16_t img_id, img_chunk_id, img_nchunks, img_w, img_h;
 };
 
+// Uplink message, acknowledging the image chunks received on the ground:
+// every chunk below ack_base has arrived, and bit i of ack_bitmap (least
+// significant bit first) is set if chunk ack_base + i has arrived, for
+// the first ack_nbytes bytes of the bitmap
+struct uplink_msg_t {
+  // Message Type
+  uint8_t type;
+
+  // Acknowledgement
+  uint8_t ack_nbytes;
+  uint16_t img_id, ack_base;
+  uint8_t ack_bitmap[ACKBYTES];
+};
+
 // Battery message
 struct battery_msg_t {
   // Battery Data
@@ -74,7 +90,19 @@ public:
 
   // Deserialize Battery Message
   void deserialize(uint8_t *data, battery_msg_t *msg);
+
+  // Serialize Uplink Message
+  void serialize(uplink_msg_t *msg, uint8_t *data);
+
+  // Deserialize Uplink Message
+  void deserialize(uint8_t *data, uplink_msg_t *msg);
   
+  // Append the sequence number and CRC-16 to a serialized frame of size bytes
+  void seal(uint8_t *frame, int size, uint16_t seq);
+
+  // Verify the CRC-16 of a frame of size bytes, and read its sequence number
+  bool check(const uint8_t *frame, int size, uint16_t &seq);
+
   // Print Sensor Message
   void print(sensor_msg_t msg);
 
@@ -85,9 +113,14 @@ public:
   static int NChunks;
 
   // Static Constants
-  static const int PayloadSize = PAYLOADSIZE;               // Including checksum
-  static const int BatterySize = 1 + sizeof(battery_msg_t); // Including checksum
-  static const int ImageSize = 1 + sizeof(image_msg_t);     // Including checksum
-  static const int SensorSize = 1 + sizeof(sensor_msg_t);   // Including checksum
+  // Frames end with a trailer of a uint16 sequence number and the uint16
+  // CRC-16 of everything before the CRC, both little endian
+  static const int TrailerSize = TRAILERSIZE;
+  static const int PayloadSize = PAYLOADSIZE;                         // Largest frame
+  static const int BatterySize = sizeof(battery_msg_t) + TrailerSize; // Including trailer
+  static const int ImageSize = sizeof(image_msg_t) + TrailerSize;     // Including trailer
+  static const int SensorSize = sizeof(sensor_msg_t) + TrailerSize;   // Including trailer
+  static const int UplinkSize = sizeof(uplink_msg_t) + TrailerSize;   // Including trailer
   static const int ChunkSize = CHUNKSIZE;
+  static const int AckBytes = ACKBYTES;
 };
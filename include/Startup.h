@@ -0,0 +1,89 @@
+/**
+ * Startup Graph
+ *
+ * Brings components up concurrently. Each task runs on its own thread
+ * once the tasks it comes after have finished, whatever their outcome,
+ * and reports whether its component is ready. Every task has a deadline,
+ * counted from start(): waiting for a task gives up at its deadline, so
+ * a slow component does not hold up the others, and joins later when it
+ * finishes. Tasks that finish late are reported as they do.
+ *
+ * The timeline (start, duration and outcome of each task) is written by
+ * report().
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-01-13
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Startup {
+public:
+  // Startup Constructor
+  Startup();
+
+  // Startup Destructor
+  ~Startup();
+
+  // Add a task run after the tasks in after, with a deadline [ms], returns its id
+  int add(const char *name, std::function<bool()> fn, int deadline, const std::vector<int> &after = std::vector<int>());
+
+  // Start every task
+  void start();
+
+  // Wait for task until its deadline, returns true if its component is ready
+  bool wait(int task);
+
+  // Wait for the first of tasks to be ready, until the last of their deadlines, returns true if one is
+  bool waitAny(const std::vector<int> &any);
+
+  // Component of task is ready
+  bool ready(int task);
+
+  // Write the timeline of every task
+  void report(std::ostream &out);
+
+  // Join the threads of finished tasks, and leave those still running
+  void join();
+
+  // Static Constants
+
+  // Task states
+  static const uint8_t Waiting = 0;
+  static const uint8_t Running = 1;
+  static const uint8_t Ready = 2;
+  static const uint8_t Unavailable = 3;
+
+private:
+  struct task_t {
+    const char *name;
+    std::function<bool()> fn;
+    int deadline;
+    std::vector<int> after;
+    uint8_t state;
+    std::chrono::steady_clock::time_point begin, end;
+  };
+
+  // Run task once its predecessors have finished
+  void run(int task);
+
+  // Task has finished
+  bool finished(int task) const { return tasks[task].state >= Ready; }
+
+  // Deadline of task
+  std::chrono::steady_clock::time_point deadline(int task) const { return origin + std::chrono::milliseconds(tasks[task].deadline); }
+
+  std::vector<task_t> tasks;
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::chrono::steady_clock::time_point origin;
+};
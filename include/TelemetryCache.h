@@ -0,0 +1,119 @@
+/**
+ * Telemetry Cache
+ *
+ * Recent history of every sensor_msg_t field, kept in memory so flight
+ * decisions can look at trends without querying the database. Samples
+ * are kept raw, and folded into 1 s, 10 s and 1 min buckets as they are
+ * inserted. Each tier is a ring of Capacity buckets holding the count,
+ * minimum, maximum and sum of every field; empty intervals are stored
+ * as empty buckets, so a window maps directly onto ring positions.
+ *
+ * Window queries take constant time: the sum and count come from prefix
+ * sums, and the minimum and maximum from a sparse table, in which level
+ * k of a bucket covers the 2^k buckets ending there and is filled in as
+ * the bucket closes. Windows end at the last inserted sample.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-30
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+#include "Serializer.h"
+
+// Aggregate of one field over a window
+struct telemetry_stats_t {
+  uint32_t count;
+  float min, max, mean;
+};
+
+class TelemetryCache {
+public:
+  // TelemetryCache Constructor
+  TelemetryCache();
+
+  // Add a sample taken at time
+  void insert(const sensor_msg_t &msg, std::chrono::steady_clock::time_point time);
+
+  // Aggregate of field over the last n samples, returns false if there are none
+  bool recent(uint8_t field, int n, telemetry_stats_t &stats) const;
+
+  // Aggregate of field over the last seconds, at the finest tier spanning them, returns false if there are no samples
+  bool window(uint8_t field, float seconds, telemetry_stats_t &stats) const;
+
+  // Value of field in msg
+  static float value(const sensor_msg_t &msg, uint8_t field);
+
+  // Static Constants
+
+  // Fields of sensor_msg_t
+  static const uint8_t GpsNsats = 0;
+  static const uint8_t GpsStatus = 1;
+  static const uint8_t GpsMode = 2;
+  static const uint8_t GpsLat = 3;
+  static const uint8_t GpsLon = 4;
+  static const uint8_t GpsAlt = 5;
+  static const uint8_t GpsGspd = 6;
+  static const uint8_t GpsDir = 7;
+  static const uint8_t GpsVspd = 8;
+  static const uint8_t MplTemp = 9;
+  static const uint8_t MplPres = 10;
+  static const uint8_t MplAlt = 11;
+  static const uint8_t AhrsHead = 12;
+  static const uint8_t AhrsPitch = 13;
+  static const uint8_t AhrsRoll = 14;
+  static const uint8_t DhtTemp = 15;
+  static const uint8_t DhtRelh = 16;
+  static const uint8_t BatRpi = 17;
+  static const uint8_t BatArd = 18;
+  static const uint8_t NFields = 19;
+
+  // Tiers
+  static const uint8_t Raw = 0;
+  static const uint8_t Second = 1;
+  static const uint8_t TenSecond = 2;
+  static const uint8_t Minute = 3;
+  static const uint8_t NTiers = 4;
+
+  // Bucket length of each tier, raw buckets hold one sample each [ms]
+  static const int Resolution[NTiers];
+
+  // Buckets per tier, and sparse table levels (log2(Capacity) + 1)
+  static const int Capacity = 256;
+  static const int Levels = 9;
+
+private:
+  struct tier_t {
+    // Buckets closed so far, the next is stored at closed % Capacity
+    uint64_t closed;
+
+    // Interval of the open bucket, and its aggregate
+    int64_t interval;
+    uint32_t openCount;
+    float openMin[NFields], openMax[NFields];
+    double openSum[NFields];
+
+    // Prefix sums up to and including each bucket
+    uint64_t count[Capacity];
+    double sum[Capacity][NFields];
+
+    // Minimum and maximum of the 2^k buckets ending at each bucket
+    float min[Levels][Capacity][NFields];
+    float max[Levels][Capacity][NFields];
+  };
+
+  // Start a new open bucket
+  void open(tier_t &tier, int64_t interval);
+
+  // Close the open bucket into the ring
+  void close(tier_t &tier);
+
+  // Aggregate of field over the last n closed buckets of tier, and optionally its open bucket
+  bool aggregate(const tier_t &tier, uint8_t field, int n, bool withOpen, telemetry_stats_t &stats) const;
+
+  tier_t tiers[NTiers];
+  std::chrono::steady_clock::time_point origin;
+  bool started;
+};
@@ -0,0 +1,137 @@
+/**
+ * Segmented Telemetry Log
+ *
+ * Append-only store for high rate telemetry, written in place of SQLite
+ * during the flight. Fixed size records are gathered into blocks of at
+ * most 4 KiB, each with a CRC-32, and a worker thread appends the blocks
+ * to segment files of at most SegmentSize, syncing after every batch.
+ * Blocks are written once a block fills or FlushInterval has passed.
+ *
+ * A power cut can only tear the tail of the last segment, so open()
+ * truncates it back to the last block with a valid CRC before starting
+ * a new segment. Every IndexInterval blocks an entry is appended to the
+ * segment's sparse time index, letting a reader skip to a given time.
+ * After the flight the segments are bulk imported into the message
+ * table of the flight database with TelemetryImport.
+ *
+ * Segment: header (16 bytes), then blocks
+ * Block:   crc32 (4), count (2), reserved (2), first time (8), records
+ * Index:   time (8), block offset (4), crc32 of the first 12 bytes (4)
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-23
+ */
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One value of one message type
+struct telemetry_record_t {
+  uint64_t time;        // Wall clock [us since the epoch]
+  uint8_t type;         // message_type_id_t
+  uint8_t sensor;       // sensor_type_id_t
+  uint16_t reserved;
+  float value;
+};
+
+// Block of records waiting to be written
+struct telemetry_block_t {
+  uint16_t count;
+  telemetry_record_t records[255];
+};
+
+class TelemetryLog {
+public:
+  // TelemetryLog Constructor
+  TelemetryLog();
+
+  // TelemetryLog Destructor
+  ~TelemetryLog();
+
+  // Recover the last segment in directory, start a new one and the writer, returns false on error
+  bool open(const std::string &directory);
+
+  // Write out queued blocks and stop the writer
+  void close();
+
+  // Writer running
+  bool isOpen();
+
+  // Append a value stamped with the current time
+  void append(uint8_t type, uint8_t sensor, float value);
+
+  // Append a record
+  void append(const telemetry_record_t &record);
+
+  // Blocks dropped because the writer fell behind, or failed to write
+  uint64_t dropped();
+
+  // Segment files in directory, oldest first
+  static std::vector<std::string> segments(const std::string &directory);
+
+  // Truncate a segment, and its index, after the last valid block, returns the valid length or -1 on error
+  static off_t recover(const std::string &path);
+
+  // Read the records of a segment from time onward, returns false if it can not be read
+  static bool read(const std::string &path, uint64_t from, std::vector<telemetry_record_t> &records);
+
+  // Static Constants
+
+  // File magic "HABT" and format version
+  static const uint32_t Magic = 0x54424148;
+  static const uint16_t Version = 1;
+
+  static const size_t HeaderSize = 16;
+  static const size_t BlockHeaderSize = 16;
+  static const size_t IndexEntrySize = 16;
+
+  // Records per block, a full block is 4 KiB
+  static const int BlockRecords = 255;
+
+  // Segment rollover size [bytes]
+  static const off_t SegmentSize = 4 * 1024 * 1024;
+
+  // Blocks between sparse index entries
+  static const int IndexInterval = 16;
+
+  // Longest a partial block waits before it is written [ms]
+  static const int FlushInterval = 1000;
+
+  // Blocks queued for the writer, 1 MiB
+  static const size_t MaxPending = 256;
+
+  static const std::string SegmentSuffix;
+  static const std::string IndexSuffix;
+
+private:
+  // Writer thread
+  void run();
+
+  // Start segment number, returns false on error
+  bool startSegment(uint32_t number);
+
+  // Append a block to the current segment, returns false on error
+  bool write(const telemetry_block_t &block);
+
+  std::string directory;
+  uint32_t segment;
+  int fd, indexFd;
+  off_t length;
+  int blocks;
+
+  telemetry_block_t current;
+  std::deque<telemetry_block_t> pending;
+  uint64_t droppedBlocks;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread writer;
+  bool running;
+};
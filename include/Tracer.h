@@ -0,0 +1,127 @@
+/**
+ * Span Tracer
+ *
+ * Records named spans (start time and duration) from every thread into
+ * a per-thread ring buffer, so interference between the sensor, camera
+ * and broadcast loops can be seen on a common timeline after a run.
+ * Recording a span costs two clock reads and a few stores with no locks;
+ * each ring holds the most recent Capacity spans of its thread. The ring
+ * of a thread that exits, with its spans, is taken over by the next new
+ * thread under a new tid and without a name, so short-lived threads do
+ * not add rings.
+ *
+ * The rings are exported as Chrome trace-event JSON, which loads in
+ * chrome://tracing and ui.perfetto.dev, on SIGUSR2 and at shutdown.
+ *
+ * Usage:
+ *   void Camera::load() {
+ *     TRACE_SPAN("Camera::load");
+ *     ...
+ *   }
+ *
+ * Span names must be string literals, only the pointer is stored.
+ * Defining HABPI_NO_TRACE compiles every span out.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-10-28
+ */
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+
+// Completed span
+struct trace_event_t {
+  const char *name;
+  uint64_t start;
+  uint64_t duration;
+  int tid;
+};
+
+class Tracer {
+public:
+  // Monotonic time [ns]
+  static uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+  }
+
+  // Record a completed span on the calling thread
+  static void record(const char *name, uint64_t start, uint64_t stop);
+
+  // Name the calling thread in the exported trace
+  static void name(const char *thread);
+
+  // Write every ring as Chrome trace-event JSON
+  static void write(std::ostream &out);
+
+  // Atomically replace path with the trace, returns false on error
+  static bool dump(const std::string &path);
+
+  // Request an export, safe to call from a signal handler
+  static void request() { requested = true; }
+
+  // Export the trace to Path if requested
+  static void poll();
+
+  // Records the lifetime of a scope
+  class Span {
+  public:
+    explicit Span(const char *name): name(name), start(now()) {}
+    ~Span() { record(name, start, now()); }
+  private:
+    const char *name;
+    uint64_t start;
+  };
+
+  // Static Constants
+
+  // Spans kept per thread
+  static const uint32_t Capacity = 8192;
+
+  // Oldest spans skipped when exporting a full ring, as the owning
+  // thread may be overwriting them during the export
+  static const uint32_t Margin = 64;
+
+  // Trace file
+  static const std::string Path;
+
+private:
+  // Ring buffer of one thread, with a single writer
+  struct ring_t {
+    trace_event_t events[Capacity];
+    std::atomic<uint64_t> head;
+    std::string thread;
+    int id;
+  };
+
+  // Owner of the calling thread's ring, returning it to spare when the thread exits
+  struct holder_t {
+    ring_t *ring;
+    ~holder_t();
+  };
+
+  // Ring of the calling thread, taken from spare or created on first use
+  static ring_t &ring();
+
+  static std::mutex mutex;
+  static std::vector<ring_t *> rings, spare;
+
+  // Threads given a ring so far, numbering their tids
+  static int threads;
+  static std::atomic<bool> requested;
+};
+
+#ifdef HABPI_NO_TRACE
+#define TRACE_SPAN(name)
+#else
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) Tracer::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#endif
@@ -0,0 +1,131 @@
+/**
+ * Pre-trigger Video Ring
+ *
+ * Keeps the last PreTrigger of the camera's H.264 stream in a fixed-size
+ * ring in memory, so that video of a flight event (burst, descent below
+ * the video altitude, landing) starts before the event was detected.
+ * The stream is split into segments at its keyframes (an SPS and IDR
+ * picture, which raspivid repeats every second with --inline --intra),
+ * so the ring always starts where a decoder can. Time is taken from the
+ * stream itself by counting pictures, so a file fed in at any speed
+ * plays back as the camera would have.
+ *
+ * An event writes the ring out, followed by the stream for PostTrigger,
+ * to a video file. A further event while writing extends it. Only the
+ * events reach the SD card, and the ring never holds more than Capacity.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-02-10
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class VideoRing {
+public:
+  // VideoRing Constructor, keeping preTrigger [ms] of a stream at framerate [frames/s] in capacity [bytes]
+  VideoRing(int preTrigger = PreTrigger, size_t capacity = Capacity, int framerate = Framerate);
+
+  // VideoRing Destructor
+  ~VideoRing();
+
+  // Append H.264 (Annex B byte stream) data
+  void write(const uint8_t *data, size_t len);
+
+  // Append the stream read from source until end of file or running is cleared,
+  // paced to the stream time when it comes from a file, returns false on a read error
+  bool feed(int source, bool paced, const std::atomic<bool> &running);
+
+  // Write the ring and the next post [ms] of the stream to path, or extend the event being written
+  bool trigger(const std::string &path, int post);
+
+  // Write out what the event has not written yet, returns false on a write error
+  bool flush();
+
+  // Write out what the event has not written yet and close it, even if the stream stopped short of its end
+  bool finish();
+
+  // An event is being written
+  bool flushing();
+
+  // Stream time [ms], from the pictures seen
+  int64_t time();
+
+  // Stream held by the ring [ms] and [bytes]
+  int64_t duration();
+  size_t size();
+
+  // Static Constants
+
+  // Stream kept before an event, covering the time FlightPhase takes to detect a landing [ms]
+  static const int PreTrigger = 40000;
+
+  // Stream written after an event [ms]
+  static const int PostTrigger = 20000;
+
+  // Ring size, 40 s at 1.5 Mbit/s with room for busy scenes [bytes]
+  static const size_t Capacity = 12 * 1024 * 1024;
+
+  // Pictures per second of the stream
+  static const int Framerate = 30;
+
+  // Largest read from the stream, and write to an event file [bytes]
+  static const size_t ChunkSize = 64 * 1024;
+
+  // Wait for stream data before checking running [ms]
+  static const int ReadInterval = 100;
+
+  // NAL unit types
+  static const uint8_t NalSlice = 1;
+  static const uint8_t NalIdr = 5;
+  static const uint8_t NalSps = 7;
+
+private:
+  struct segment_t {
+    // Stream position of the segment's first start code, and its stream time [ms]
+    uint64_t start;
+    int64_t time;
+  };
+
+  // Stream time [ms], with the ring held
+  int64_t current() const;
+
+  // Start a segment at position start
+  void segment(uint64_t start);
+
+  // Drop segments that have been overwritten, or are older than needed to cover preTrigger
+  void prune();
+
+  // Write out the event up to its end, or all of the stream when closing
+  bool drain(bool closing);
+
+  // Close the event file
+  void close();
+
+  int preTrigger, framerate;
+  size_t capacity;
+  std::unique_ptr<uint8_t[]> buffer;
+  std::deque<segment_t> segments;
+
+  // Bytes and pictures of the stream seen
+  uint64_t written, pictures;
+
+  // Parser state: zero bytes before the current byte, a NAL header or slice
+  // header is next, and a segment was started by an SPS awaiting its IDR
+  int zeros;
+  bool header, slice, keyframe;
+  uint64_t nalStart;
+
+  // Event file, its stream position, the stream position it ends at once
+  // known, and the stream time it ends at [ms]
+  int fd;
+  uint64_t position, last;
+  int64_t until;
+
+  std::mutex mutex;
+};
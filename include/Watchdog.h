@@ -0,0 +1,107 @@
+/**
+ * Loop Watchdog
+ *
+ * Supervises the sensor, camera and broadcast loops. Each loop beats at
+ * the top of every iteration and names the stage it enters before any
+ * call that could block (a sensor read, a child process, an SPI
+ * exchange). A supervisor thread checks every Interval that each loop
+ * has beaten within its deadline; a loop that has not is reported as
+ * stalled in the stage it last entered, and its stall handler is called
+ * with that stage to restart or bypass the stuck component. The stall
+ * duration is recorded once the loop beats again.
+ *
+ * When a hardware watchdog device is given, it is fed only while every
+ * critical loop is healthy, so a stuck downlink reboots the payload, and
+ * disarmed on a clean stop.
+ *
+ * Beats and stages are relaxed atomic stores; stage names must be string
+ * literals, only the pointer is stored.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2019-01-20
+ */
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+class Watchdog {
+public:
+  // Watchdog Constructor
+  Watchdog();
+
+  // Watchdog Destructor
+  ~Watchdog();
+
+  // Add a loop with a heartbeat deadline [ms] and a stall handler, returns its id
+  int add(const char *name, int deadline, bool critical, std::function<void(const char *stage)> onStall = nullptr);
+
+  // Heartbeat of loop, entering stage
+  void beat(int loop, const char *stage) {
+    loops[loop].last.store(now(), std::memory_order_relaxed);
+    loops[loop].stage.store(stage, std::memory_order_relaxed);
+  }
+
+  // Loop is entering stage
+  void stage(int loop, const char *stage) {
+    loops[loop].stage.store(stage, std::memory_order_relaxed);
+  }
+
+  // Start supervising, feeding the hardware watchdog device unless it is empty, returns false on error
+  bool start(const std::string &device);
+
+  // Stop supervising, and disarm the hardware watchdog
+  void stop();
+
+  // Write the stalls of each loop
+  void report(std::ostream &out);
+
+  // Static Constants
+
+  // Supervision period [ms]
+  static const int Interval = 500;
+
+  // Loops supervised
+  static const int MaxLoops = 8;
+
+private:
+  struct loop_t {
+    const char *name;
+    int deadline;
+    bool critical;
+    std::function<void(const char *)> onStall;
+
+    // Last heartbeat [ms] and current stage, written by the loop
+    std::atomic<int64_t> last;
+    std::atomic<const char *> stage;
+
+    // Stall in progress, and stall history, kept by the supervisor
+    bool stalled;
+    int64_t since;
+    uint32_t stalls;
+    int64_t longest;
+    const char *stuck;
+  };
+
+  // Monotonic time [ms]
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Supervisor thread
+  void run();
+
+  // Check every loop, returns true if every critical loop is healthy
+  bool check();
+
+  loop_t loops[MaxLoops];
+  int nloops;
+  int fd;
+  std::atomic<bool> running;
+  std::thread supervisor;
+};
@@ -0,0 +1,87 @@
+/**
+ * XBee API Frames
+ *
+ * Encoder and incremental decoder for XBee API mode 2 (AP=2) frames:
+ *   0x7E | length (uint16 big endian) | frame data | checksum
+ * After the start delimiter, 0x7E, 0x7D, 0x11 and 0x13 are escaped as
+ * 0x7D followed by the byte XOR 0x20. The checksum is 0xFF minus the low
+ * byte of the sum of the frame data, whose first byte is the API frame
+ * type. Only the frame types the radios exchange are built and parsed.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-09
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class XBeeApi {
+public:
+  // XBeeApi Constructor
+  XBeeApi();
+
+  // Feed one received byte, returns true when a frame with a valid checksum is complete
+  bool decode(uint8_t byte);
+
+  // Frame data of the last complete frame
+  const uint8_t *frame() const { return data; }
+  size_t length() const { return len; }
+
+  // Frames discarded for a bad checksum or length
+  uint32_t errors() const { return nerrors; }
+
+  // Escape and delimit frame data into out (at least MaxEncoded bytes), returns the encoded length
+  static size_t encode(const uint8_t *frameData, size_t n, uint8_t *out);
+
+  // Build the frame data of a transmit request to a 64-bit address, returns its length
+  static size_t txRequest(uint64_t address, uint8_t frameId, const uint8_t *payload, size_t n, uint8_t *frameData);
+
+  // Find the source address and payload of a receive packet, returns false for other frame types
+  static bool rxPacket(const uint8_t *frameData, size_t n, uint64_t &source, const uint8_t *&payload, size_t &payloadLen);
+
+  // Read the frame id and delivery status of a transmit status, returns false for other frame types
+  static bool txStatus(const uint8_t *frameData, size_t n, uint8_t &frameId, uint8_t &status);
+
+  // Static Constants
+  static const uint8_t StartDelimiter = 0x7E;
+  static const uint8_t Escape = 0x7D;
+  static const uint8_t Xon = 0x11;
+  static const uint8_t Xoff = 0x13;
+  static const uint8_t EscapeMask = 0x20;
+
+  // API frame types
+  static const uint8_t TxRequest = 0x10;
+  static const uint8_t TxStatus = 0x8B;
+  static const uint8_t RxPacket = 0x90;
+
+  // Frame data before the payload of a transmit request and a receive packet, and of a transmit status
+  static const size_t TxHeader = 14;
+  static const size_t RxHeader = 12;
+  static const size_t StatusSize = 7;
+
+  // Delivery status of a transmit status
+  static const uint8_t Delivered = 0x00;
+
+  // Largest frame data accepted, and its worst case encoded size
+  static const size_t MaxFrame = 256;
+  static const size_t MaxEncoded = 2 * (MaxFrame + 3) + 1;
+
+  // 16-bit address used when only the 64-bit address is known
+  static const uint16_t UnknownAddress = 0xFFFE;
+
+private:
+  // Decoder states
+  static const uint8_t WaitStart = 0;
+  static const uint8_t LengthHigh = 1;
+  static const uint8_t LengthLow = 2;
+  static const uint8_t FrameData = 3;
+  static const uint8_t Checksum = 4;
+
+  uint8_t state;
+  bool escaped;
+  size_t expected, count, len;
+  uint8_t sum;
+  uint32_t nerrors;
+  uint8_t data[MaxFrame];
+};
@@ -0,0 +1,97 @@
+/**
+ * Direct XBee Radio
+ *
+ * Optional driver for an XBee on the Pi's hardware UART, in API mode 2,
+ * bypassing the SPI relay through the Arduino, whose software serial
+ * link to the XBee runs at 9600 baud with one transmit request at a time.
+ *
+ * Each transmit request gets a frame id, and up to Window requests are
+ * in flight at once. A reader thread matches the transmit status frames
+ * to their requests as they arrive, freeing their window slots; requests
+ * without a status after StatusTimeout are given up on. Receive packets
+ * (uplink frames from the ground station) are queued for the broadcast
+ * loop. Radio throughput is then bound by the RF link, not the relay.
+ *
+ * The XBee is wired to the PL011 UART (/dev/ttyAMA0, which needs
+ * dtoverlay=disable-bt on a Pi Zero W) and configured with AP=2 and
+ * BD=7 (115200 baud). The Arduino still reports the battery voltages.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-16
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "XBeeApi.h"
+
+class XBeeRadio {
+public:
+  // XBeeRadio Constructor
+  XBeeRadio();
+
+  // XBeeRadio Destructor
+  ~XBeeRadio();
+
+  // Open the UART in raw mode and start the reader, frames are sent to the 64-bit destination address
+  bool open(const std::string &path, int baud, uint64_t destination);
+
+  // Stop the reader and close the UART
+  void close();
+
+  // Queue a frame for transmission, waiting up to SendTimeout for a window slot, returns false if not sent
+  bool send(const uint8_t *payload, size_t n);
+
+  // Free window slots
+  int space();
+
+  // Take the oldest received payload, returns false if there is none
+  bool receive(std::vector<uint8_t> &payload);
+
+  // Static Constants
+
+  // Transmit requests in flight
+  static const int Window = 4;
+
+  // Time allowed for a transmit status, the XBee retries for up to ~2.5 s at the lowest rate [ms]
+  static const int StatusTimeout = 3000;
+
+  // Time send waits for a window slot [ms]
+  static const int SendTimeout = 500;
+
+  // Received payloads kept for the broadcast loop, the oldest is dropped first
+  static const size_t MaxReceived = 16;
+
+private:
+  // Reader thread
+  void run();
+
+  // Handle a complete API frame
+  void handle(const uint8_t *frame, size_t n);
+
+  // Give up on requests whose status is overdue
+  void expire(std::chrono::steady_clock::time_point now);
+
+  int fd;
+  uint64_t destination;
+  XBeeApi decoder;
+
+  std::thread reader;
+  std::mutex mutex;
+  std::condition_variable slot;
+  bool running;
+
+  // Send time of each frame id in flight
+  std::map<uint8_t, std::chrono::steady_clock::time_point> inflight;
+  uint8_t nextId;
+
+  std::deque<std::vector<uint8_t> > received;
+};
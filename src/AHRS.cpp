@@ -1,7 +1,7 @@
 #include "HABPi.h"
 
 // AHRS Constructor
-AHRS::AHRS() {}
+AHRS::AHRS(): vertical(0.0F) {}
 
 // AHRS Destructor
 AHRS::~AHRS() {}
@@ -81,8 +81,21 @@ bool AHRS::begin(i2c_bus &common_bus) {
 	return status;
 }
 
+// Filter state
+void AHRS::getState(float quaternion[4], float integral[3]) {
+  filter.getQuaternion(&quaternion[0], &quaternion[1], &quaternion[2], &quaternion[3]);
+  filter.getIntegralFeedback(&integral[0], &integral[1], &integral[2]);
+}
+
+// Restore the filter state, e.g. when resuming a flight
+void AHRS::setState(const float quaternion[4], const float integral[3]) {
+  filter.setQuaternion(quaternion[0], quaternion[1], quaternion[2], quaternion[3]);
+  filter.setIntegralFeedback(integral[0], integral[1], integral[2]);
+}
+
 // Update AHRS
 void AHRS::update(float &roll, float &pitch, float &heading) {
+  TRACE_SPAN("AHRS::update");
   // Get new sensor events
   sensors_event_t aevent, mevent, gevent;
   bool amstatus = accelmag.getEvent(&aevent, &mevent);
@@ -122,7 +135,16 @@ void AHRS::update(float &roll, float &pitch, float &heading) {
     roll = filter.getRoll();
     pitch = filter.getPitch();
     heading = filter.getYaw();
-    std::cout << "Heading: " << heading << ", Pitch: " << pitch << ", Roll: " << roll << std::endl;
+    CONSOLE_TRACE("Heading: " << heading << ", Pitch: " << pitch << ", Roll: " << roll);
+
+    // Rotate the measured specific force into the earth frame, and remove gravity
+    // to obtain the vertical acceleration used by the altimeter
+    float qw, qx, qy, qz;
+    filter.getQuaternion(&qw, &qx, &qy, &qz);
+    vertical = 2.0F * (qx * qz - qw * qy) * aevent.acceleration.x
+             + 2.0F * (qy * qz + qw * qx) * aevent.acceleration.y
+             + (qw * qw - qx * qx - qy * qy + qz * qz) * aevent.acceleration.z
+             - gravity;
 
     // Print the orientation filter output in quaternions.
     // This avoids the gimbal lock problem with Euler angles when you get
@@ -131,6 +153,6 @@ void AHRS::update(float &roll, float &pitch, float &heading) {
     filter.getQuaternion(&qw, &qx, &qy, &qz);
     std::cout << "qw: " << qw << ", qx: " << qx << ", qy: " << qy << ", qz: " << qz << std::endl;*/
   } else {
-    std::cerr << "Error: Unable to get valid FXOS8700 or FXAS21002C sensor data" << std::endl;
+    CONSOLE_ERROR("Error: Unable to get valid FXOS8700 or FXAS21002C sensor data");
   }
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "HABPi.h"
+
+// Altimeter Constructor
+Altimeter::Altimeter() {
+  reset();
+}
+
+// Altimeter Destructor
+Altimeter::~Altimeter() {}
+
+// Reset the filter
+void Altimeter::reset() {
+  std::memset(x, 0, sizeof(x));
+  std::memset(P, 0, sizeof(P));
+  initialized = false;
+  baroSeen = false;
+  gpsSeen = false;
+  baroRejects = altitudeRejects = climbRejects = 0;
+}
+
+// Initialize the state from a first altitude measurement
+void Altimeter::initialize(double altitude, double offset) {
+  std::memset(P, 0, sizeof(P));
+  x[0] = altitude;
+  x[1] = 0.0;
+  x[2] = 0.0;
+  x[3] = offset;
+  P[0][0] = GpsNoise * GpsNoise;
+  P[1][1] = 25.0;
+  P[2][2] = 0.25;
+  P[3][3] = 0.0;
+  initialized = true;
+}
+
+/**
+ * predict
+ *
+ * Constant acceleration model driven by the bias corrected IMU vertical
+ * acceleration:
+ *   h' = h + v dt + 0.5 (a - b) dt^2
+ *   v' = v + (a - b) dt
+ * with the bias and barometric offset modelled as random walks.
+ */
+void Altimeter::predict(float accel, float dt) {
+  propagate(accel, dt, AccelNoise);
+}
+
+// Without an IMU the acceleration is unknown, so rely on a noisier constant velocity model
+void Altimeter::predict(float dt) {
+  propagate(x[2], dt, ModelNoise);
+}
+
+// Propagate the state and covariance
+void Altimeter::propagate(double accel, double dt, double noise) {
+  if (!initialized || dt <= 0.0) return;
+
+  double t = dt, t2 = 0.5 * t * t;
+  double a = accel - x[2];
+
+  // State propagation
+  x[0] += x[1] * t + a * t2;
+  x[1] += a * t;
+
+  // F = [[1, t, -t2, 0], [0, 1, -t, 0], [0, 0, 1, 0], [0, 0, 0, 1]]
+  double F[N][N] = {
+    {1.0, t, -t2, 0.0},
+    {0.0, 1.0, -t, 0.0},
+    {0.0, 0.0, 1.0, 0.0},
+    {0.0, 0.0, 0.0, 1.0}
+  };
+
+  // P = F P F^T + Q
+  double FP[N][N];
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      double s = 0.0;
+      for (int k = 0; k < N; k++) s += F[i][k] * P[k][j];
+      FP[i][j] = s;
+    }
+  }
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      double s = 0.0;
+      for (int k = 0; k < N; k++) s += FP[i][k] * F[j][k];
+      P[i][j] = s;
+    }
+  }
+
+  // Acceleration noise enters through G = [t2, t, 0, 0]
+  double qa = noise * noise;
+  P[0][0] += t2 * t2 * qa;
+  P[0][1] += t2 * t * qa;
+  P[1][0] += t2 * t * qa;
+  P[1][1] += t * t * qa;
+  P[2][2] += BiasNoise * BiasNoise * t;
+  P[3][3] += OffsetNoise * OffsetNoise * t;
+}
+
+// Correct using barometric pressure [kPa], z = h + offset
+void Altimeter::correctPressure(float pressure) {
+  if (pressure <= 0.0f) return;
+
+  double z = pressureAltitude(pressure);
+  if (!initialized) {
+    initialize(z, 0.0);
+  } else if (!baroSeen && gpsSeen) {
+    // First barometer reading after GPS: seed the offset rather than the altitude
+    x[3] = z - x[0];
+    P[3][3] = P[0][0];
+  }
+  baroSeen = true;
+
+  const double H[N] = {1.0, 0.0, 0.0, 1.0};
+  correct(H, z, BaroNoise * BaroNoise, baroRejects);
+}
+
+// Correct using GPS altitude [m] and climb rate [m/s]
+void Altimeter::correctGPS(float altitude, float climb) {
+  if (!initialized) {
+    initialize(altitude, 0.0);
+  } else if (!gpsSeen && baroSeen) {
+    // First fix after the barometer: move the altitude, keep the pressure altitude
+    // consistent, and let the offset be refined by subsequent fixes
+    double z = x[0] + x[3];
+    x[0] = altitude;
+    x[3] = z - altitude;
+    P[0][0] = P[3][3] = GpsNoise * GpsNoise;
+    P[0][3] = P[3][0] = -GpsNoise * GpsNoise;
+  }
+  gpsSeen = true;
+
+  const double Ha[N] = {1.0, 0.0, 0.0, 0.0};
+  correct(Ha, altitude, GpsNoise * GpsNoise, altitudeRejects);
+
+  const double Hv[N] = {0.0, 1.0, 0.0, 0.0};
+  correct(Hv, climb, ClimbNoise * ClimbNoise, climbRejects);
+}
+
+/**
+ * correct
+ *
+ * Scalar Kalman update with innovation gating, which keeps a single
+ * spurious GPS altitude (or a pressure spike) from dragging the estimate.
+ * Each measurement keeps its own count, so outliers of one cannot let
+ * through, or be let through by, those of another.
+ */
+bool Altimeter::correct(const double H[N], double z, double variance, int &rejects) {
+  double PHt[N], S = variance, y = z;
+
+  for (int i = 0; i < N; i++) {
+    y -= H[i] * x[i];
+    double s = 0.0;
+    for (int j = 0; j < N; j++) s += P[i][j] * H[j];
+    PHt[i] = s;
+  }
+  for (int i = 0; i < N; i++) S += H[i] * PHt[i];
+
+  if (S <= 0.0) return false;
+  if (y * y > Gate * Gate * S && ++rejects <= MaxRejects) return false;
+  rejects = 0;
+
+  double K[N];
+  for (int i = 0; i < N; i++) {
+    K[i] = PHt[i] / S;
+    x[i] += K[i] * y;
+  }
+
+  // P = P - K (H P), using symmetry H P = (P H^T)^T
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      P[i][j] -= K[i] * PHt[j];
+    }
+  }
+
+  return true;
+}
+
+// Filter state, covariance and the measurements seen so far
+void Altimeter::getState(double *state, double *covariance, bool &baro, bool &gps) const {
+  for (int i = 0; i < N; i++) {
+    state[i] = x[i];
+    for (int j = 0; j < N; j++) covariance[i*N + j] = P[i][j];
+  }
+  baro = baroSeen;
+  gps = gpsSeen;
+}
+
+// Restore the filter state
+void Altimeter::setState(const double *state, const double *covariance, bool baro, bool gps) {
+  for (int i = 0; i < N; i++) {
+    x[i] = state[i];
+    for (int j = 0; j < N; j++) P[i][j] = covariance[i*N + j];
+  }
+  initialized = true;
+  baroSeen = baro;
+  gpsSeen = gps;
+  baroRejects = altitudeRejects = climbRejects = 0;
+}
+
+// 1-sigma altitude uncertainty [m]
+float Altimeter::altitudeSigma() const {
+  return static_cast<float>(std::sqrt(std::max(P[0][0], 0.0)));
+}
+
+// 1-sigma climb rate uncertainty [m/s]
+float Altimeter::climbSigma() const {
+  return static_cast<float>(std::sqrt(std::max(P[1][1], 0.0)));
+}
+
+// Descending with the given confidence
+bool Altimeter::descending(float sigmas) const {
+  return initialized && (climbRate() + sigmas * climbSigma() < 0.0f);
+}
+
+// Pressure altitude [m] from pressure [kPa]
+float Altimeter::pressureAltitude(float pressure) {
+  double p = 10.0 * pressure; // kPa to hPa
+  return static_cast<float>(CentimetreToMetre * Module::AlphaInv * (1.0 - std::pow(p / Module::P_0, Module::BetaInv)));
+}
@@ -0,0 +1,175 @@
+#include "HABPi.h"
+#include <fcntl.h>
+
+// Archiver Constructor
+Archiver::Archiver(): queuedBytes(0), running(false), buffer(NULL), unsynced(0) {}
+
+// Archiver Destructor
+Archiver::~Archiver() {
+  stop();
+  free(buffer);
+}
+
+// Start the worker thread
+void Archiver::begin() {
+  if (buffer == NULL && posix_memalign(reinterpret_cast<void **>(&buffer), Alignment, BlockSize) != 0) {
+    buffer = NULL;
+    Module::logger.error("Archiver: Unable to allocate write buffer");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (running) return;
+  running = true;
+  worker = std::thread(&Archiver::run, this);
+}
+
+// Write out queued frames and stop the worker thread
+void Archiver::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  wake.notify_all();
+  if (worker.joinable()) worker.join();
+}
+
+// Queue a frame for writing
+bool Archiver::push(const std::string &path, std::vector<uint8_t> &data) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!running) return false;
+
+  while (queue.size() >= MaxFrames || (!queue.empty() && queuedBytes + data.size() > MaxBytes)) {
+    if (dropPolicy == DropNewest) {
+      Metrics::count(Metrics::ArchiveDropped);
+      return false;
+    }
+
+    // Discard the oldest frame to make room
+    Metrics::count(Metrics::ArchiveDropped);
+    queuedBytes -= queue.front().data.size();
+    queue.pop_front();
+  }
+
+  queue.push_back(archive_frame_t());
+  queue.back().path = path;
+  queue.back().data.swap(data);
+  queuedBytes += queue.back().data.size();
+  lock.unlock();
+
+  wake.notify_one();
+  return true;
+}
+
+// A new frame would be dropped under the DropNewest policy
+bool Archiver::full() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return dropPolicy == DropNewest && (queue.size() >= MaxFrames || queuedBytes >= MaxBytes);
+}
+
+// Frames waiting to be written
+size_t Archiver::backlog() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+// Worker thread
+void Archiver::run() {
+  Tracer::name("archive");
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    wake.wait(lock, [this] { return !running || !queue.empty(); });
+    if (queue.empty()) break;
+
+    archive_frame_t frame;
+    frame.path.swap(queue.front().path);
+    frame.data.swap(queue.front().data);
+    queue.pop_front();
+    queuedBytes -= frame.data.size();
+    lock.unlock();
+
+    {
+      TRACE_SPAN("Archiver::write");
+      Metrics::Timer timer(Metrics::ArchiveWrite);
+      if (!write(frame)) {
+        std::string msg = "Archiver: Unable to write " + frame.path;
+        Module::logger.error(msg.c_str());
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+/**
+ * write
+ *
+ * O_DIRECT needs the buffer, offset and length aligned, so the last
+ * block is padded and the file truncated to its real size afterwards.
+ * File systems without O_DIRECT fall back to buffered writes.
+ */
+bool Archiver::write(const archive_frame_t &frame) {
+  std::string tmpPath = frame.path + ".tmp";
+  off_t size = static_cast<off_t>(frame.data.size());
+  off_t padded = (size + Alignment - 1) / Alignment * Alignment;
+
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+  if (fd < 0 && errno == EINVAL) {
+    fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  }
+  if (fd < 0) return false;
+
+  // Reserve the space up front, so the file is contiguous and a full card fails early
+  int result = fallocate(fd, 0, 0, padded);
+  if (result != 0 && errno != EOPNOTSUPP) {
+    close(fd);
+    unlink(tmpPath.c_str());
+    return false;
+  }
+
+  for (off_t offset = 0; offset < size; offset += BlockSize) {
+    size_t len = std::min(static_cast<size_t>(size - offset), static_cast<size_t>(BlockSize));
+    size_t aligned = (len + Alignment - 1) / Alignment * Alignment;
+    std::memcpy(buffer, &frame.data[offset], len);
+    std::memset(buffer + len, 0, aligned - len);
+
+    uint8_t *p = buffer;
+    size_t remaining = aligned;
+    while (remaining > 0) {
+      ssize_t n = ::write(fd, p, remaining);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        close(fd);
+        unlink(tmpPath.c_str());
+        return false;
+      }
+      p += n;
+      remaining -= n;
+    }
+  }
+
+  // Drop the padding of the last block
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    unlink(tmpPath.c_str());
+    return false;
+  }
+
+  // Flush this file, or every file written since the last periodic sync
+  if (syncPolicy == SyncEachFile) {
+    fdatasync(fd);
+  } else if (syncPolicy == SyncPeriodic && ++unsynced >= SyncInterval) {
+    syncfs(fd);
+    unsynced = 0;
+  }
+  close(fd);
+
+  if (std::rename(tmpPath.c_str(), frame.path.c_str()) != 0) return false;
+  Metrics::count(Metrics::ArchiveWritten);
+  return true;
+}
+
+// Initialize static variables
+uint8_t Archiver::dropPolicy = Archiver::DropNewest;
+uint8_t Archiver::syncPolicy = Archiver::SyncPeriodic;
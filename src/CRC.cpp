@@ -0,0 +1,61 @@
+#include "CRC.h"
+
+// Slice-by-4 tables, Table[k][b] is the CRC of byte b followed by k zero bytes
+static uint16_t Crc16Table[4][256];
+static uint32_t Crc32Table[4][256];
+
+// Fill the tables at startup
+static struct CRCTables {
+  CRCTables() {
+    for (int b = 0; b < 256; b++) {
+      uint16_t c16 = static_cast<uint16_t>(b << 8);
+      uint32_t c32 = static_cast<uint32_t>(b);
+      for (int i = 0; i < 8; i++) {
+        c16 = (c16 & 0x8000) ? static_cast<uint16_t>((c16 << 1) ^ CRC::Crc16Poly) : static_cast<uint16_t>(c16 << 1);
+        c32 = (c32 & 1) ? (c32 >> 1) ^ CRC::Crc32Poly : c32 >> 1;
+      }
+      Crc16Table[0][b] = c16;
+      Crc32Table[0][b] = c32;
+    }
+
+    for (int k = 1; k < 4; k++) {
+      for (int b = 0; b < 256; b++) {
+        uint16_t c16 = Crc16Table[k - 1][b];
+        uint32_t c32 = Crc32Table[k - 1][b];
+        Crc16Table[k][b] = static_cast<uint16_t>((c16 << 8) ^ Crc16Table[0][c16 >> 8]);
+        Crc32Table[k][b] = (c32 >> 8) ^ Crc32Table[0][c32 & 0xFF];
+      }
+    }
+  }
+} crcTables;
+
+// CRC-16/CCITT-FALSE
+uint16_t CRC::crc16(const uint8_t *data, size_t len, uint16_t crc) {
+  while (len >= 4) {
+    crc ^= static_cast<uint16_t>((data[0] << 8) | data[1]);
+    crc = Crc16Table[3][crc >> 8] ^ Crc16Table[2][crc & 0xFF] ^ Crc16Table[1][data[2]] ^ Crc16Table[0][data[3]];
+    data += 4;
+    len -= 4;
+  }
+  while (len-- > 0) {
+    crc = static_cast<uint16_t>((crc << 8) ^ Crc16Table[0][(crc >> 8) ^ *data++]);
+  }
+  return crc;
+}
+
+// CRC-32
+uint32_t CRC::crc32(const uint8_t *data, size_t len, uint32_t crc) {
+  crc = ~crc;
+  while (len >= 4) {
+    crc ^= static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    crc = Crc32Table[3][crc & 0xFF] ^ Crc32Table[2][(crc >> 8) & 0xFF] ^
+          Crc32Table[1][(crc >> 16) & 0xFF] ^ Crc32Table[0][crc >> 24];
+    data += 4;
+    len -= 4;
+  }
+  while (len-- > 0) {
+    crc = (crc >> 8) ^ Crc32Table[0][(crc ^ *data++) & 0xFF];
+  }
+  return ~crc;
+}
@@ -7,273 +7,29 @@
 #include "stb_image_write.h"
 
 // Camera Constructor
-Camera::Camera() {
+Camera::Camera(): archiveJob(-1), burstJob(-1), quantiseJob(-1), videoJob(-1), streamJob(-1), burstTaken(false),
+  feedFd(-1), feedPaced(false), feedQuit(false), streamActive(false), feeding(false), fed(false) {
   // Load VGA palette RGB values
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0xa8});
-  palette.push_back({0x0,0xa8,0x0});
-  palette.push_back({0x0,0xa8,0xa8});
-  palette.push_back({0xa8,0x0,0x0});
-  palette.push_back({0xa8,0x0,0xa8});
-  palette.push_back({0xa8,0x57,0x0});
-  palette.push_back({0xa8,0xa8,0xa8});
-  palette.push_back({0x57,0x57,0x57});
-  palette.push_back({0x57,0x57,0xff});
-  palette.push_back({0x57,0xff,0x57});
-  palette.push_back({0x57,0xff,0xff});
-  palette.push_back({0xff,0x57,0x57});
-  palette.push_back({0xff,0x57,0xff});
-  palette.push_back({0xff,0xff,0x57});
-  palette.push_back({0xff,0xff,0xff});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x17,0x17,0x17});
-  palette.push_back({0x20,0x20,0x20});
-  palette.push_back({0x2f,0x2f,0x2f});
-  palette.push_back({0x38,0x38,0x38});
-  palette.push_back({0x47,0x47,0x47});
-  palette.push_back({0x50,0x50,0x50});
-  palette.push_back({0x60,0x60,0x60});
-  palette.push_back({0x70,0x70,0x70});
-  palette.push_back({0x80,0x80,0x80});
-  palette.push_back({0x90,0x90,0x90});
-  palette.push_back({0xa0,0xa0,0xa0});
-  palette.push_back({0xb7,0xb7,0xb7});
-  palette.push_back({0xc8,0xc8,0xc8});
-  palette.push_back({0xe0,0xe0,0xe0});
-  palette.push_back({0xff,0xff,0xff});
-  palette.push_back({0x0,0x0,0xff});
-  palette.push_back({0x40,0x0,0xff});
-  palette.push_back({0x7f,0x0,0xff});
-  palette.push_back({0xbf,0x0,0xff});
-  palette.push_back({0xff,0x0,0xff});
-  palette.push_back({0xff,0x0,0xbf});
-  palette.push_back({0xff,0x0,0x7f});
-  palette.push_back({0xff,0x0,0x40});
-  palette.push_back({0xff,0x0,0x0});
-  palette.push_back({0xff,0x40,0x0});
-  palette.push_back({0xff,0x7f,0x0});
-  palette.push_back({0xff,0xbf,0x0});
-  palette.push_back({0xff,0xff,0x0});
-  palette.push_back({0xbf,0xff,0x0});
-  palette.push_back({0x7f,0xff,0x0});
-  palette.push_back({0x40,0xff,0x0});
-  palette.push_back({0x0,0xff,0x0});
-  palette.push_back({0x0,0xff,0x40});
-  palette.push_back({0x0,0xff,0x7f});
-  palette.push_back({0x0,0xff,0xbf});
-  palette.push_back({0x0,0xff,0xff});
-  palette.push_back({0x0,0xbf,0xff});
-  palette.push_back({0x0,0x7f,0xff});
-  palette.push_back({0x0,0x40,0xff});
-  palette.push_back({0x7f,0x7f,0xff});
-  palette.push_back({0x9f,0x7f,0xff});
-  palette.push_back({0xbf,0x7f,0xff});
-  palette.push_back({0xdf,0x7f,0xff});
-  palette.push_back({0xff,0x7f,0xff});
-  palette.push_back({0xff,0x7f,0xdf});
-  palette.push_back({0xff,0x7f,0xbf});
-  palette.push_back({0xff,0x7f,0x9f});
-  palette.push_back({0xff,0x7f,0x7f});
-  palette.push_back({0xff,0x9f,0x7f});
-  palette.push_back({0xff,0xbf,0x7f});
-  palette.push_back({0xff,0xdf,0x7f});
-  palette.push_back({0xff,0xff,0x7f});
-  palette.push_back({0xdf,0xff,0x7f});
-  palette.push_back({0xbf,0xff,0x7f});
-  palette.push_back({0x9f,0xff,0x7f});
-  palette.push_back({0x7f,0xff,0x7f});
-  palette.push_back({0x7f,0xff,0x9f});
-  palette.push_back({0x7f,0xff,0xbf});
-  palette.push_back({0x7f,0xff,0xdf});
-  palette.push_back({0x7f,0xff,0xff});
-  palette.push_back({0x7f,0xdf,0xff});
-  palette.push_back({0x7f,0xbf,0xff});
-  palette.push_back({0x7f,0x9f,0xff});
-  palette.push_back({0xb7,0xb7,0xff});
-  palette.push_back({0xc7,0xb7,0xff});
-  palette.push_back({0xd8,0xb7,0xff});
-  palette.push_back({0xe8,0xb7,0xff});
-  palette.push_back({0xff,0xb7,0xff});
-  palette.push_back({0xff,0xb7,0xe8});
-  palette.push_back({0xff,0xb7,0xd8});
-  palette.push_back({0xff,0xb7,0xc7});
-  palette.push_back({0xff,0xb7,0xb7});
-  palette.push_back({0xff,0xc7,0xb7});
-  palette.push_back({0xff,0xd8,0xb7});
-  palette.push_back({0xff,0xe8,0xb7});
-  palette.push_back({0xff,0xff,0xb7});
-  palette.push_back({0xe8,0xff,0xb7});
-  palette.push_back({0xd8,0xff,0xb7});
-  palette.push_back({0xc7,0xff,0xb7});
-  palette.push_back({0xb7,0xff,0xb7});
-  palette.push_back({0xb7,0xff,0xc7});
-  palette.push_back({0xb7,0xff,0xd8});
-  palette.push_back({0xb7,0xff,0xe8});
-  palette.push_back({0xb7,0xff,0xff});
-  palette.push_back({0xb7,0xe8,0xff});
-  palette.push_back({0xb7,0xd8,0xff});
-  palette.push_back({0xb7,0xc7,0xff});
-  palette.push_back({0x0,0x0,0x70});
-  palette.push_back({0x1f,0x0,0x70});
-  palette.push_back({0x38,0x0,0x70});
-  palette.push_back({0x57,0x0,0x70});
-  palette.push_back({0x70,0x0,0x70});
-  palette.push_back({0x70,0x0,0x57});
-  palette.push_back({0x70,0x0,0x38});
-  palette.push_back({0x70,0x0,0x1f});
-  palette.push_back({0x70,0x0,0x0});
-  palette.push_back({0x70,0x1f,0x0});
-  palette.push_back({0x70,0x38,0x0});
-  palette.push_back({0x70,0x57,0x0});
-  palette.push_back({0x70,0x70,0x0});
-  palette.push_back({0x57,0x70,0x0});
-  palette.push_back({0x38,0x70,0x0});
-  palette.push_back({0x1f,0x70,0x0});
-  palette.push_back({0x0,0x70,0x0});
-  palette.push_back({0x0,0x70,0x1f});
-  palette.push_back({0x0,0x70,0x38});
-  palette.push_back({0x0,0x70,0x57});
-  palette.push_back({0x0,0x70,0x70});
-  palette.push_back({0x0,0x57,0x70});
-  palette.push_back({0x0,0x38,0x70});
-  palette.push_back({0x0,0x1f,0x70});
-  palette.push_back({0x38,0x38,0x70});
-  palette.push_back({0x47,0x38,0x70});
-  palette.push_back({0x57,0x38,0x70});
-  palette.push_back({0x60,0x38,0x70});
-  palette.push_back({0x70,0x38,0x70});
-  palette.push_back({0x70,0x38,0x60});
-  palette.push_back({0x70,0x38,0x57});
-  palette.push_back({0x70,0x38,0x47});
-  palette.push_back({0x70,0x38,0x38});
-  palette.push_back({0x70,0x47,0x38});
-  palette.push_back({0x70,0x57,0x38});
-  palette.push_back({0x70,0x60,0x38});
-  palette.push_back({0x70,0x70,0x38});
-  palette.push_back({0x60,0x70,0x38});
-  palette.push_back({0x57,0x70,0x38});
-  palette.push_back({0x47,0x70,0x38});
-  palette.push_back({0x38,0x70,0x38});
-  palette.push_back({0x38,0x70,0x47});
-  palette.push_back({0x38,0x70,0x57});
-  palette.push_back({0x38,0x70,0x60});
-  palette.push_back({0x38,0x70,0x70});
-  palette.push_back({0x38,0x60,0x70});
-  palette.push_back({0x38,0x57,0x70});
-  palette.push_back({0x38,0x47,0x70});
-  palette.push_back({0x50,0x50,0x70});
-  palette.push_back({0x58,0x50,0x70});
-  palette.push_back({0x60,0x50,0x70});
-  palette.push_back({0x68,0x50,0x70});
-  palette.push_back({0x70,0x50,0x70});
-  palette.push_back({0x70,0x50,0x68});
-  palette.push_back({0x70,0x50,0x60});
-  palette.push_back({0x70,0x50,0x58});
-  palette.push_back({0x70,0x50,0x50});
-  palette.push_back({0x70,0x58,0x50});
-  palette.push_back({0x70,0x60,0x50});
-  palette.push_back({0x70,0x68,0x50});
-  palette.push_back({0x70,0x70,0x50});
-  palette.push_back({0x68,0x70,0x50});
-  palette.push_back({0x60,0x70,0x50});
-  palette.push_back({0x58,0x70,0x50});
-  palette.push_back({0x50,0x70,0x50});
-  palette.push_back({0x50,0x70,0x58});
-  palette.push_back({0x50,0x70,0x60});
-  palette.push_back({0x50,0x70,0x68});
-  palette.push_back({0x50,0x70,0x70});
-  palette.push_back({0x50,0x68,0x70});
-  palette.push_back({0x50,0x60,0x70});
-  palette.push_back({0x50,0x58,0x70});
-  palette.push_back({0x0,0x0,0x40});
-  palette.push_back({0x10,0x0,0x40});
-  palette.push_back({0x20,0x0,0x40});
-  palette.push_back({0x30,0x0,0x40});
-  palette.push_back({0x40,0x0,0x40});
-  palette.push_back({0x40,0x0,0x30});
-  palette.push_back({0x40,0x0,0x20});
-  palette.push_back({0x40,0x0,0x10});
-  palette.push_back({0x40,0x0,0x0});
-  palette.push_back({0x40,0x10,0x0});
-  palette.push_back({0x40,0x20,0x0});
-  palette.push_back({0x40,0x30,0x0});
-  palette.push_back({0x40,0x40,0x0});
-  palette.push_back({0x30,0x40,0x0});
-  palette.push_back({0x20,0x40,0x0});
-  palette.push_back({0x10,0x40,0x0});
-  palette.push_back({0x0,0x40,0x0});
-  palette.push_back({0x0,0x40,0x10});
-  palette.push_back({0x0,0x40,0x20});
-  palette.push_back({0x0,0x40,0x30});
-  palette.push_back({0x0,0x40,0x40});
-  palette.push_back({0x0,0x30,0x40});
-  palette.push_back({0x0,0x20,0x40});
-  palette.push_back({0x0,0x10,0x40});
-  palette.push_back({0x20,0x20,0x40});
-  palette.push_back({0x28,0x20,0x40});
-  palette.push_back({0x30,0x20,0x40});
-  palette.push_back({0x38,0x20,0x40});
-  palette.push_back({0x40,0x20,0x40});
-  palette.push_back({0x40,0x20,0x38});
-  palette.push_back({0x40,0x20,0x30});
-  palette.push_back({0x40,0x20,0x28});
-  palette.push_back({0x40,0x20,0x20});
-  palette.push_back({0x40,0x28,0x20});
-  palette.push_back({0x40,0x30,0x20});
-  palette.push_back({0x40,0x38,0x20});
-  palette.push_back({0x40,0x40,0x20});
-  palette.push_back({0x38,0x40,0x20});
-  palette.push_back({0x30,0x40,0x20});
-  palette.push_back({0x28,0x40,0x20});
-  palette.push_back({0x20,0x40,0x20});
-  palette.push_back({0x20,0x40,0x28});
-  palette.push_back({0x20,0x40,0x30});
-  palette.push_back({0x20,0x40,0x38});
-  palette.push_back({0x20,0x40,0x40});
-  palette.push_back({0x20,0x38,0x40});
-  palette.push_back({0x20,0x30,0x40});
-  palette.push_back({0x20,0x28,0x40});
-  palette.push_back({0x2f,0x2f,0x40});
-  palette.push_back({0x30,0x2f,0x40});
-  palette.push_back({0x37,0x2f,0x40});
-  palette.push_back({0x3f,0x2f,0x40});
-  palette.push_back({0x40,0x2f,0x40});
-  palette.push_back({0x40,0x2f,0x3f});
-  palette.push_back({0x40,0x2f,0x37});
-  palette.push_back({0x40,0x2f,0x30});
-  palette.push_back({0x40,0x2f,0x2f});
-  palette.push_back({0x40,0x30,0x2f});
-  palette.push_back({0x40,0x37,0x2f});
-  palette.push_back({0x40,0x3f,0x2f});
-  palette.push_back({0x40,0x40,0x2f});
-  palette.push_back({0x3f,0x40,0x2f});
-  palette.push_back({0x37,0x40,0x2f});
-  palette.push_back({0x30,0x40,0x2f});
-  palette.push_back({0x2f,0x40,0x2f});
-  palette.push_back({0x2f,0x40,0x30});
-  palette.push_back({0x2f,0x40,0x37});
-  palette.push_back({0x2f,0x40,0x3f});
-  palette.push_back({0x2f,0x40,0x40});
-  palette.push_back({0x2f,0x3f,0x40});
-  palette.push_back({0x2f,0x37,0x40});
-  palette.push_back({0x2f,0x30,0x40});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
-  palette.push_back({0x0,0x0,0x0});
+  palette.assign(Palette::Vga, Palette::Vga + Palette::NColours);
 }
 
 // Camera Destructor
-Camera::~Camera() {}
+Camera::~Camera() {
+  {
+    std::lock_guard<std::mutex> lock(feedMutex);
+    feedQuit = true;
+    feeding = false;
+  }
+  feedChanged.notify_all();
+  if (feeder.joinable()) feeder.join();
+}
 
 // Begin Camera
 bool Camera::begin() {
+  if (Module::recorder.replaying()) return true;
+
 	std::string delimiter = "detected=";
-	std::string result = Global::exec("vcgencmd get_camera");
+	std::string result = Global::trim_copy(Module::processes.run({"vcgencmd", "get_camera"}, ToolMargin, true).out);
 
 	size_t pos = 0;
 	std::string token;
@@ -292,9 +48,12 @@ bool Camera::begin() {
 
 // Update Camera
 void Camera::update(uint8_t mode) {
+  TRACE_SPAN("Camera::update");
 	switch(mode) {
 		case ImageMode: {
-			capture();
+			// The camera takes one still at a time, the burst waits for the archive capture
+			archive();
+			if (!archiving()) capture(WidthSmall, HeightSmall);
 			break;
 		}
 		case VideoMode: {
@@ -311,113 +70,536 @@ void Camera::update(uint8_t mode) {
 	}
 }
 
-// Capture Image
-void Camera::capture() {
+/**
+ * archive
+ *
+ * Starts raspistill capturing a full resolution JPEG to stdout and
+ * returns, leaving the camera loop free while it runs; archiving()
+ * hands the image to the archiver, which writes it out in the
+ * background. When the archiver cannot take another frame the capture
+ * is skipped, rather than blocking the camera.
+ */
+void Camera::archive() {
+  TRACE_SPAN("Camera::archive");
+  // Full resolution images are not kept in traces
+  if (Module::recorder.replaying()) return;
+
+  if (Module::archiver.full()) {
+    Metrics::count(Metrics::ArchiveDropped);
+    Module::logger.warning("Camera: Archive backlog full, skipping capture");
+    return;
+  }
+
 	// Construct command to capture large size image
-  std::ostringstream cmdLarge;
-  cmdLarge << "raspistill --nopreview --thumb none";
-  cmdLarge << " --sharpness " << Sharpness;
-  cmdLarge << " --exposure " << Exposure;
-  cmdLarge << " --rotation " << Rotation;
-  cmdLarge << " --width " << WidthLarge;
-  cmdLarge << " --height " << HeightLarge;
-  cmdLarge << " --quality " << Quality;
-  cmdLarge << " --timeout " << Timeout;
-  cmdLarge << " --encoding " << ImageEncoding;
-  cmdLarge << " --output images/image_" << Module::imageNumber << "." << ImageEncoding;
-  std::string cmdLargeStr = cmdLarge.str();
-
-  // Execute large size image command
-  system(cmdLargeStr.c_str());
-
-  // Construct command to capture small size image
-  std::ostringstream cmdSmall;
-  cmdSmall << "raspistill --nopreview --thumb none";
-  cmdSmall << " --sharpness " << Sharpness;
-  cmdSmall << " --exposure " << Exposure;
-  cmdSmall << " --rotation " << Rotation;
-  cmdSmall << " --width " << WidthSmall;
-  cmdSmall << " --height " << HeightSmall;
-  cmdSmall << " --quality " << Quality;
-  cmdSmall << " --timeout " << Timeout;
-  cmdSmall << " --encoding " << ImageEncoding;
-  cmdSmall << " --output images/thumbnail." << ImageEncoding;
-  std::string cmdSmallStr = cmdSmall.str();
+  std::vector<std::string> cmdLarge = {"raspistill", "--nopreview", "--thumb", "none"};
+  cmdLarge.insert(cmdLarge.end(), {"--sharpness", std::to_string(Sharpness)});
+  cmdLarge.insert(cmdLarge.end(), {"--exposure", Exposure});
+  cmdLarge.insert(cmdLarge.end(), {"--rotation", std::to_string(Rotation)});
+  cmdLarge.insert(cmdLarge.end(), {"--width", std::to_string(WidthLarge)});
+  cmdLarge.insert(cmdLarge.end(), {"--height", std::to_string(HeightLarge)});
+  cmdLarge.insert(cmdLarge.end(), {"--quality", std::to_string(ArchiveQuality)});
+  cmdLarge.insert(cmdLarge.end(), {"--timeout", std::to_string(Timeout)});
+  cmdLarge.insert(cmdLarge.end(), {"--encoding", ArchiveEncoding});
+  cmdLarge.insert(cmdLarge.end(), {"--output", "-"});
+
+  std::ostringstream path;
+  path << "images/image_" << Module::archiveNumber << "." << ArchiveEncoding;
+  archivePath = path.str();
+  Module::archiveNumber++;
+
+  // Execute large size image command, capturing the encoded image from stdout
+  archiveJob = Module::processes.start(cmdLarge, Timeout + ToolMargin, true);
+  if (archiveJob < 0) {
+    char msg[Global::MaxLength];
+    sprintf(msg, "Camera: Unable to start archive capture: %s", strerror(errno));
+    Module::logger.error(msg);
+  }
+}
+
+// Collect a finished full resolution capture, returns true while one is capturing
+bool Camera::archiving() {
+  if (archiveJob < 0) return false;
+  if (!Module::processes.finished(archiveJob)) return true;
+
+  process_result_t result = Module::processes.wait(archiveJob);
+  archiveJob = -1;
+  if (result.status != 0 || result.out.empty()) {
+    failed("Archive", result);
+    return false;
+  }
+
+  std::vector<uint8_t> data(result.out.begin(), result.out.end());
+  Module::archiver.push(archivePath, data);
+  return false;
+}
+
+/**
+ * capture
+ *
+ * Starts raspistill on a burst of BurstFrames thumbnails and returns,
+ * leaving the camera loop free while the burst is taken. In timelapse
+ * mode raspistill takes a frame every interval of its timeout, so the
+ * timeout is the burst itself; a first frame taken before the exposure
+ * has settled scores low and is passed over. When replaying, the burst
+ * is restored from the trace instead.
+ */
+bool Camera::capture(int width, int height) {
+  TRACE_SPAN("Camera::capture");
+  burstStart = std::chrono::steady_clock::now();
+
+  if (Module::recorder.replaying()) {
+    replayBurst();
+    burstTaken = true;
+    return true;
+  }
+
+  // Construct command to capture a burst of small size images
+  std::vector<std::string> cmdSmall = {"raspistill", "--nopreview", "--thumb", "none", "--burst"};
+  cmdSmall.insert(cmdSmall.end(), {"--sharpness", std::to_string(Sharpness)});
+  cmdSmall.insert(cmdSmall.end(), {"--exposure", Exposure});
+  cmdSmall.insert(cmdSmall.end(), {"--rotation", std::to_string(Rotation)});
+  cmdSmall.insert(cmdSmall.end(), {"--width", std::to_string(width)});
+  cmdSmall.insert(cmdSmall.end(), {"--height", std::to_string(height)});
+  cmdSmall.insert(cmdSmall.end(), {"--quality", std::to_string(Quality)});
+  cmdSmall.insert(cmdSmall.end(), {"--timeout", std::to_string(BurstFrames * BurstInterval)});
+  cmdSmall.insert(cmdSmall.end(), {"--timelapse", std::to_string(BurstInterval)});
+  cmdSmall.insert(cmdSmall.end(), {"--encoding", ImageEncoding});
+  cmdSmall.insert(cmdSmall.end(), {"--output", "images/burst_%d." + ImageEncoding});
 
   // Execute small size image command
-  system(cmdSmallStr.c_str());
+  burstJob = Module::processes.start(cmdSmall, BurstFrames * BurstInterval + ToolMargin);
+  if (burstJob < 0) {
+    char msg[Global::MaxLength];
+    sprintf(msg, "Camera: Unable to start thumbnail burst: %s", strerror(errno));
+    Module::logger.error(msg);
+    return false;
+  }
+
+  burstTaken = true;
+  return true;
+}
+
+/**
+ * captured
+ *
+ * Once the burst has finished, scores each frame for sharpness and
+ * content, keeps the best one as images/thumbnail, and starts convert
+ * remapping it to the VGA palette for broadcast. A quantised thumbnail
+ * is handed to load() before the next one is selected and quantised
+ * over it, so the next burst can be taken while this one is quantised.
+ */
+bool Camera::captured() {
+  // Collect the quantised thumbnail
+  if (quantiseJob >= 0) {
+    if (!Module::processes.finished(quantiseJob)) return false;
+
+    process_result_t result = Module::processes.wait(quantiseJob);
+    quantiseJob = -1;
+    Metrics::record(Metrics::ImageQuantise, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - quantiseStart).count());
+    if (result.status == 0) return true;
+
+    failed("convert", result);
+    return false;
+  }
+
+  // Collect the burst
+  if (!burstTaken) return false;
+  if (burstJob >= 0) {
+    if (!Module::processes.finished(burstJob)) return false;
+
+    process_result_t result = Module::processes.wait(burstJob);
+    burstJob = -1;
+    if (result.status != 0) failed("Burst", result);
+    if (Module::recorder.recording()) recordBurst();
+  }
+  burstTaken = false;
+  Metrics::record(Metrics::ImageCapture, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - burstStart).count());
+
+  // Keep the best frame of the burst as the thumbnail
+  int best = select();
+  if (best < 0) {
+    Module::logger.error("Unable to load any frames of the thumbnail burst");
+    return false;
+  }
 
   // Construct command to dither and down-sample with VGA palatte
   // e.g. convert thumbnail.png -alpha off -colors 256 +dither -remap config/vga.png thumbnail_vga.png
-  std::ostringstream cmdVga;
-  cmdVga << "convert images/thumbnail." << ImageEncoding;
-  cmdVga << " -alpha off";
-  cmdVga << " -colors " << NColours;
-  cmdVga << " +dither";
-  cmdVga << " -remap " << VgaPalette;
-  cmdVga << " images/thumbnail_vga." << ImageEncoding;
-  std::string cmdVgaStr = cmdVga.str();
+  std::vector<std::string> cmdVga = {"convert", "images/thumbnail." + ImageEncoding};
+  cmdVga.insert(cmdVga.end(), {"-alpha", "off"});
+  cmdVga.insert(cmdVga.end(), {"-colors", std::to_string(NColours)});
+  cmdVga.push_back("+dither");
+  cmdVga.insert(cmdVga.end(), {"-remap", VgaPalette});
+  cmdVga.push_back("images/thumbnail_vga." + ImageEncoding);
 
   // Execute VGA dither command
-  system(cmdVgaStr.c_str());
+  quantiseStart = std::chrono::steady_clock::now();
+  quantiseJob = Module::processes.start(cmdVga, ToolMargin);
+  if (quantiseJob < 0) {
+    char msg[Global::MaxLength];
+    sprintf(msg, "Camera: Unable to start convert: %s", strerror(errno));
+    Module::logger.error(msg);
+  }
+  return false;
+}
+
+// Select the best frame of a burst
+int Camera::select() {
+  TRACE_SPAN("Camera::select");
+  int best = -1;
+  float bestScore = -1.0f;
+
+  for (int i = 0; i < MaxBurstFrames; i++) {
+    std::string nameStr = burstFile(i);
+
+    int w, h, bpp;
+    uint8_t *frame = stbi_load(nameStr.c_str(), &w, &h, &bpp, Bpp);
+    if (frame == NULL) continue;
+
+    float score = FrameScore::score(frame, w, h, bpp);
+    stbi_image_free(frame);
+
+    if (score > bestScore) {
+      bestScore = score;
+      best = i;
+    }
+  }
+
+  // Move the best frame into place and remove the rest
+  for (int i = 0; i < MaxBurstFrames; i++) {
+    std::string nameStr = burstFile(i);
+
+    if (i == best) {
+      std::ostringstream thumbnail;
+      thumbnail << "images/thumbnail." << ImageEncoding;
+      std::rename(nameStr.c_str(), thumbnail.str().c_str());
+    } else {
+      std::remove(nameStr.c_str());
+    }
+  }
+
+  if (best >= 0) {
+    std::ostringstream msg;
+    msg << "Selected burst frame " << best << " with score " << bestScore;
+    std::string msgStr = msg.str();
+    Module::logger.info(msgStr.c_str());
+  }
+
+  return best;
+}
+
+// Burst frame filename
+std::string Camera::burstFile(int frame) {
+  std::ostringstream name;
+  name << "images/burst_" << frame << "." << ImageEncoding;
+  return name.str();
+}
+
+// Record the frames of a burst as one trace record of length prefixed files
+void Camera::recordBurst() {
+  std::vector<uint8_t> frames;
+
+  for (int i = 0; i < MaxBurstFrames; i++) {
+    std::ifstream in(burstFile(i).c_str(), std::ios::in | std::ios::binary);
+    if (!in.is_open()) continue;
+
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint32_t len = bytes.size();
+    frames.push_back(static_cast<uint8_t>(i));
+    frames.insert(frames.end(), reinterpret_cast<uint8_t *>(&len), reinterpret_cast<uint8_t *>(&len) + sizeof(len));
+    frames.insert(frames.end(), bytes.begin(), bytes.end());
+  }
+
+  Module::recorder.record(Recorder::CameraChannel, 0, frames.data(), frames.size());
 }
 
-// Record Video
+// Restore the frames of a burst from a trace
+void Camera::replayBurst() {
+  std::vector<uint8_t> frames;
+  if (!Module::recorder.replay(Recorder::CameraChannel, 0, frames)) return;
+
+  size_t pos = 0;
+  while (pos + 1 + sizeof(uint32_t) <= frames.size()) {
+    int frame = frames[pos];
+    uint32_t len;
+    std::memcpy(&len, &frames[pos + 1], sizeof(len));
+    pos += 1 + sizeof(len);
+    if (pos + len > frames.size()) break;
+
+    std::ofstream out(burstFile(frame).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&frames[pos]), len);
+    pos += len;
+  }
+}
+
+// Start recording Video
 void Camera::record() {
+  if (Module::recorder.replaying()) return;
+
 	// Construct command to record a video
-  std::ostringstream cmd;
-  cmd << "raspivid --nopreview --vstab";
-  cmd << " --sharpness " << Sharpness;
-  cmd << " --exposure " << Exposure;
-  cmd << " --rotation " << Rotation;
-  cmd << " --timeout " << Timeout * 8;
-  cmd << " --output images/video_" << Module::videoNumber << "." << VideoEncoding;
+  std::ostringstream output;
+  output << "images/video_" << Module::videoNumber << "." << VideoEncoding;
   Module::videoNumber++;
-  std::string cmdStr = cmd.str();
+
+  std::vector<std::string> cmd = {"raspivid", "--nopreview", "--vstab"};
+  cmd.insert(cmd.end(), {"--sharpness", std::to_string(Sharpness)});
+  cmd.insert(cmd.end(), {"--exposure", Exposure});
+  cmd.insert(cmd.end(), {"--rotation", std::to_string(Rotation)});
+  cmd.insert(cmd.end(), {"--timeout", std::to_string(Timeout * 8)});
+  cmd.insert(cmd.end(), {"--output", output.str()});
 
   // Execute record command
-  system(cmdStr.c_str());
+  videoJob = Module::processes.start(cmd, Timeout * 8 + ToolMargin);
+  if (videoJob < 0) {
+    char msg[Global::MaxLength];
+    sprintf(msg, "Camera: Unable to start video: %s", strerror(errno));
+    Module::logger.error(msg);
+  }
 }
 
-// Load and Partition Image Data
-void Camera::load() {
-  int w, h, bpp, image_offset = 0, stride = 0;
-  image_msg_t imageMsg;
-  uint8_t *input_image, *image_broadcast;
+// Collect a finished video, returns true while one is recording
+bool Camera::recording() {
+  if (videoJob < 0) return false;
+  if (!Module::processes.finished(videoJob)) return true;
 
-  // Load the thumbnail image
-  input_image = stbi_load("images/thumbnail_vga.png", &w, &h, &bpp, Bpp); 
+  process_result_t result = Module::processes.wait(videoJob);
+  videoJob = -1;
+  if (result.status != 0) failed("Video", result);
+  return false;
+}
 
-  //std::cout << "Image width, height, bpp: " << w << ", " << h << ", " << bpp << std::endl;
+/**
+ * stream
+ *
+ * Starts raspivid writing H.264 to stdout with an SPS and keyframe every
+ * second, or opens the file source, and hands it to the feeder thread,
+ * started with the first stream, to be fed into the ring. The stream is
+ * stopped and restarted around every still, so one thread is kept for
+ * all of them. A file is fed at the rate the camera would have written it.
+ */
+bool Camera::stream(const std::string &source) {
+  char msg[Global::MaxLength];
+  if (streamActive || std::chrono::steady_clock::now() < streamRetry) return false;
 
-  // Define size of broadcast image
-  image_broadcast = new uint8_t[w*h];
+  int fd = -1;
+  bool paced = !source.empty();
+  if (paced) {
+    fd = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      sprintf(msg, "Camera: Unable to open video source: %s", strerror(errno));
+      Module::logger.error(msg);
+      streamRetry = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(StreamRetry));
+      return false;
+    }
+  } else {
+    std::vector<std::string> cmd = {"raspivid", "--nopreview", "--inline"};
+    cmd.insert(cmd.end(), {"--sharpness", std::to_string(Sharpness)});
+    cmd.insert(cmd.end(), {"--exposure", Exposure});
+    cmd.insert(cmd.end(), {"--rotation", std::to_string(Rotation)});
+    cmd.insert(cmd.end(), {"--width", std::to_string(VideoWidth)});
+    cmd.insert(cmd.end(), {"--height", std::to_string(VideoHeight)});
+    cmd.insert(cmd.end(), {"--bitrate", std::to_string(VideoBitrate)});
+    cmd.insert(cmd.end(), {"--framerate", std::to_string(VideoRing::Framerate)});
+    cmd.insert(cmd.end(), {"--intra", std::to_string(VideoRing::Framerate)});
+    cmd.insert(cmd.end(), {"--timeout", "0"});
+    cmd.insert(cmd.end(), {"--output", "-"});
 
-  // Replace three RGB bytes with VGA palette index byte
-  std::memset(image_broadcast, 0, w*h);
+    streamJob = Module::processes.stream(cmd, 0, fd);
+    if (streamJob < 0) {
+      sprintf(msg, "Camera: Unable to start video stream: %s", strerror(errno));
+      Module::logger.error(msg);
+      streamRetry = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(StreamRetry));
+      return false;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(feedMutex);
+    feeding = true;
+    fed = false;
+    feedFd = fd;
+    feedPaced = paced;
+  }
+  feedChanged.notify_all();
+  if (!feeder.joinable()) feeder = std::thread(&Camera::feed, this);
+  streamActive = true;
+  return true;
+}
+
+// Feed each stream handed over by stream() into the ring
+void Camera::feed() {
+  Tracer::name("video");
+  std::unique_lock<std::mutex> lock(feedMutex);
+
+  while (true) {
+    feedChanged.wait(lock, [this]() { return feedFd >= 0 || feedQuit; });
+    if (feedFd < 0) return;
+
+    int fd = feedFd;
+    bool paced = feedPaced;
+    lock.unlock();
+    if (!ring.feed(fd, paced, feeding)) {
+      Module::logger.error("Camera: Unable to read the video stream");
+    }
+    close(fd);
+    lock.lock();
+
+    feedFd = -1;
+    fed = true;
+    feedChanged.notify_all();
+  }
+}
+
+// Stop streaming video into the ring, writing out any event still open
+void Camera::stopStream() {
+  if (!streamActive) return;
+
+  // A stream that ended by itself is restarted only after StreamRetry
+  bool ended = fed;
+  if (!ended && streamJob >= 0) Module::processes.terminate("raspivid");
+  {
+    std::unique_lock<std::mutex> lock(feedMutex);
+    feeding = false;
+    feedChanged.wait(lock, [this]() { return feedFd < 0; });
+  }
+  streamActive = false;
+
+  if (streamJob >= 0) {
+    process_result_t result = Module::processes.wait(streamJob);
+    streamJob = -1;
+    if (ended && result.status != 0) failed("Video stream", result);
+  }
+  if (ended) {
+    streamRetry = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(StreamRetry));
+  }
+
+  if (!ring.finish()) {
+    Module::logger.error("Camera: Unable to write the pre-trigger video");
+  }
+}
+
+// Video is streaming into the ring, collecting a stream that has ended
+bool Camera::streaming() {
+  if (!streamActive) return false;
+  if (!fed) return true;
+
+  stopStream();
+  return false;
+}
+
+// Write the ring and the following PostTrigger to a new video file, or extend the one being written
+void Camera::trigger() {
+  char msg[Global::MaxLength];
+  bool extend = ring.flushing();
+
+  std::ostringstream path;
+  path << "images/video_" << Module::videoNumber << "." << VideoEncoding;
+  std::string pathStr = path.str();
+
+  if (!ring.trigger(pathStr, VideoRing::PostTrigger)) {
+    sprintf(msg, "Camera: Unable to open %s: %s", pathStr.c_str(), strerror(errno));
+    Module::logger.error(msg);
+    return;
+  }
+  if (extend) return;
+
+  Module::videoNumber++;
+  sprintf(msg, "Camera: Writing %lld ms of pre-trigger video to %s", static_cast<long long>(ring.duration()), pathStr.c_str());
+  Module::logger.info(msg);
+}
+
+// Write out the event being written, returns true while one is
+bool Camera::flushing() {
+  if (!ring.flush()) {
+    Module::logger.error("Camera: Unable to write the pre-trigger video");
+  }
+  return ring.flushing();
+}
+
+// Log the failure of a camera tool with the last line it wrote to stderr, cut to fit the log record
+void Camera::failed(const char *tool, const process_result_t &result) {
+  char msg[Global::MaxLength];
+  std::string err = Global::trim_copy(result.err);
+  size_t pos = err.find_last_of('\n');
+  if (pos != std::string::npos) err.erase(0, pos + 1);
+
+  if (result.timedOut) {
+    sprintf(msg, "Camera: %s timed out: %.40s", tool, err.c_str());
+  } else {
+    sprintf(msg, "Camera: %s failed with status %d: %.40s", tool, result.status, err.c_str());
+  }
+  Module::logger.error(msg);
+}
+
+// Map RGB pixels to VGA palette indices
+void Camera::remap(const uint8_t *rgb, int w, int h, int bpp, uint8_t *indices) {
   for(int i = 0; i < h; i++) {
     for(int j = 0; j < w; j++) {
       rgb_t p;
-      p.r = input_image[i*w*bpp + j*bpp + 0];
-      p.g = input_image[i*w*bpp + j*bpp + 1];
-      p.b = input_image[i*w*bpp + j*bpp + 2];
+      p.r = rgb[i*w*bpp + j*bpp + 0];
+      p.g = rgb[i*w*bpp + j*bpp + 1];
+      p.b = rgb[i*w*bpp + j*bpp + 2];
 
-      bool found = false;
+      // Set unknown colours to (r, g, b) = (0xFF, 0x0, 0xFF) @ index 36
+      uint8_t index = 36;
       for(int k = 0; k < static_cast<int>(palette.size()); k++) {
         if(palette[k].compare(p) == true) {
-          found = true;
-          image_broadcast[image_offset++] = static_cast<uint8_t>(k);
+          // Use the first match, the palette repeats black and white
+          index = static_cast<uint8_t>(k);
+          break;
         }
       }
-      if(found == false) {
-        // Set unknown colours to (r, g, b) = (0xFF, 0x0, 0xFF) @ index 36
-        image_broadcast[image_offset++] = static_cast<uint8_t>(36);
-      }
+      indices[i*w + j] = index;
     }
   }
+}
+
+// Load and Partition Image Data
+void Camera::load() {
+  TRACE_SPAN("Camera::load");
+  Metrics::Timer timer(Metrics::ImageLoad);
+  int w, h, bpp, stride = 0;
+  uint8_t *input_image, *image_broadcast;
+
+  // Load the thumbnail image
+  input_image = stbi_load("images/thumbnail_vga.png", &w, &h, &bpp, Bpp); 
+
+  //std::cout << "Image width, height, bpp: " << w << ", " << h << ", " << bpp << std::endl;
+
+  // Define size of broadcast image
+  image_broadcast = new uint8_t[w*h];
+
+  // Replace three RGB bytes with VGA palette index byte
+  remap(input_image, w, h, bpp, image_broadcast);
 
   // Save broadcast image
-  stbi_write_png("images/thumbnail_broadcast.png", w, h, 1, image_broadcast, stride);
+  stbi_write_png(BroadcastFile.c_str(), w, h, 1, image_broadcast, stride);
+
+  // Queue the image messages to broadcast
+  partition(image_broadcast, w, h, Module::imageNumber, 0);
+
+  // Increment image number
+  Module::imageNumber++;
+
+  // Free resources
+  stbi_image_free(input_image);
+  delete [] image_broadcast;
+}
+
+// Queue the chunks of the broadcast image from chunk first on
+bool Camera::resume(uint16_t id, int first) {
+  int w, h, bpp;
+  uint8_t *image_broadcast = stbi_load(BroadcastFile.c_str(), &w, &h, &bpp, 1);
+  if (image_broadcast == NULL) return false;
+
+  partition(image_broadcast, w, h, id, first);
+  stbi_image_free(image_broadcast);
+  return true;
+}
+
+// Partition palette indices into image messages, queueing them from chunk first on
+void Camera::partition(const uint8_t *image_broadcast, int w, int h, uint16_t id, int first) {
+  image_msg_t imageMsg;
+  int image_offset = 0;
 
   // Compute number of chunks
   Serializer::NChunks = std::floor(static_cast<float>(w*h)/static_cast<float>(Serializer::ChunkSize));
@@ -426,41 +608,37 @@ void Camera::load() {
   if(w*h % Serializer::ChunkSize != 0) Serializer::NChunks += 1;
   //std::cout << "Number of image chunks = " << Serializer::NChunks << '\n';
 
-  // Clear broadcast queue
-  Module::broadcast_queue.clear();
-
   // Create image messages to broadcast
-  image_offset = 0;
-  for(int i = 0; i < Serializer::NChunks; i++) {
+  image_offset = first * Serializer::ChunkSize;
+  for(int i = first; i < Serializer::NChunks; i++) {
     // Copy parameters to image message
     for(int j = 0; j < Serializer::ChunkSize; j++) {
       imageMsg.img_chunk[j] = image_broadcast[image_offset + j];
     }
     
     imageMsg.type = Module::ImageCmd;
-    imageMsg.img_id = Module::imageNumber;
+    imageMsg.img_id = id;
     imageMsg.img_chunk_id = i;
     imageMsg.img_nchunks = Serializer::NChunks;
     imageMsg.img_chunksize = Serializer::ChunkSize;
     imageMsg.img_w = w;
     imageMsg.img_h = h;
     
-    // Append to broadcast queue
-    Module::broadcast_queue.push_back(imageMsg);
+    // Append to broadcast queue, behind any chunks still being sent
+    Module::downlink.push(imageMsg);
 
     // Increment image_offset
     image_offset += Serializer::ChunkSize;
   }
-
-  // Increment image number
-  Module::imageNumber++;
-
-  // Free resources
-  stbi_image_free(input_image);
-  delete [] image_broadcast;
 }
 
+// Thumbnail sizes, smallest first
+const int Camera::ThumbWidth[Camera::NSizes] = {160, 240, WidthSmall};
+const int Camera::ThumbHeight[Camera::NSizes] = {120, 180, HeightSmall};
+
 const std::string Camera::ImageEncoding = "png";
 const std::string Camera::VideoEncoding = "h264";
+const std::string Camera::ArchiveEncoding = "jpg";
+const std::string Camera::BroadcastFile = "images/thumbnail_broadcast.png";
 const std::string Camera::VgaPalette = "config/vga.png";
 const std::string Camera::Exposure = "auto";
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "HABPi.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Slot as stored in the file
+struct checkpoint_slot_t {
+  uint32_t magic;
+  uint16_t version, size;
+  uint64_t generation;
+  checkpoint_t state;
+  uint32_t crc;
+};
+
+static_assert(sizeof(checkpoint_slot_t) <= Checkpoint::SlotSize, "checkpoint slot larger than a page");
+
+// Checkpoint Constructor
+Checkpoint::Checkpoint(): fd(-1), map(NULL), generation(0), next(0), havePending(false) {}
+
+// Checkpoint Destructor
+Checkpoint::~Checkpoint() {
+  close();
+}
+
+// Create or map the checkpoint file
+bool Checkpoint::open(const std::string &path) {
+  char msg[Global::MaxLength];
+  size_t length = NSlots * SlotSize;
+  struct stat st;
+
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0 || fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) < length && ftruncate(fd, length) != 0)) {
+    sprintf(msg, "Checkpoint: Unable to open %s: %s", path.c_str(), strerror(errno));
+    Module::logger.error(msg);
+    close();
+    return false;
+  }
+
+  void *addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    sprintf(msg, "Checkpoint: Unable to map %s: %s", path.c_str(), strerror(errno));
+    Module::logger.error(msg);
+    close();
+    return false;
+  }
+  map = static_cast<uint8_t *>(addr);
+
+  // Continue after the newest slot
+  generation = 0;
+  next = 0;
+  for (int i = 0; i < NSlots; i++) {
+    const checkpoint_slot_t *slot = reinterpret_cast<const checkpoint_slot_t *>(map + i * SlotSize);
+    if (valid(i) && slot->generation >= generation) {
+      generation = slot->generation;
+      next = (i + 1) % NSlots;
+    }
+  }
+
+  return true;
+}
+
+// Unmap the checkpoint file
+void Checkpoint::close() {
+  if (map != NULL) munmap(map, NSlots * SlotSize);
+  if (fd >= 0) ::close(fd);
+  map = NULL;
+  fd = -1;
+}
+
+// Newest valid checkpoint
+bool Checkpoint::load(checkpoint_t &state) {
+  if (map == NULL) return false;
+
+  int newest = -1;
+  for (int i = 0; i < NSlots; i++) {
+    const checkpoint_slot_t *slot = reinterpret_cast<const checkpoint_slot_t *>(map + i * SlotSize);
+    if (valid(i) && (newest < 0 || slot->generation > reinterpret_cast<const checkpoint_slot_t *>(map + newest * SlotSize)->generation)) {
+      newest = i;
+    }
+  }
+  if (newest < 0) return false;
+
+  std::memcpy(&state, &reinterpret_cast<const checkpoint_slot_t *>(map + newest * SlotSize)->state, sizeof(state));
+  return true;
+}
+
+// Write state to the older slot and sync it
+bool Checkpoint::save(const checkpoint_t &state) {
+  TRACE_SPAN("Checkpoint::save");
+  if (map == NULL) return false;
+
+  checkpoint_slot_t slot;
+  std::memset(&slot, 0, sizeof(slot));
+  slot.magic = Magic;
+  slot.version = Version;
+  slot.size = sizeof(checkpoint_t);
+  slot.generation = generation + 1;
+  std::memcpy(&slot.state, &state, sizeof(state));
+  slot.crc = CRC::crc32(reinterpret_cast<const uint8_t *>(&slot), offsetof(checkpoint_slot_t, crc));
+
+  // The other slot holds the last checkpoint until this one is on disk
+  uint8_t *addr = map + next * SlotSize;
+  std::memcpy(addr, &slot, sizeof(slot));
+  if (msync(addr, SlotSize, MS_SYNC) != 0) {
+    Module::logger.error("Checkpoint: Unable to sync checkpoint");
+    return false;
+  }
+
+  generation++;
+  next = (next + 1) % NSlots;
+  return true;
+}
+
+// Keep the flight state for the next save
+void Checkpoint::stage(const checkpoint_t &state) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pending = state;
+  havePending = true;
+}
+
+// Copy the staged flight state
+bool Checkpoint::staged(checkpoint_t &state) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (havePending) state = pending;
+  return havePending;
+}
+
+// Valid slot contents
+bool Checkpoint::valid(int i) {
+  const checkpoint_slot_t *slot = reinterpret_cast<const checkpoint_slot_t *>(map + i * SlotSize);
+  return slot->magic == Magic && slot->version == Version && slot->size == sizeof(checkpoint_t) &&
+         slot->crc == CRC::crc32(reinterpret_cast<const uint8_t *>(slot), offsetof(checkpoint_slot_t, crc));
+}
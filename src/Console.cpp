@@ -0,0 +1,66 @@
+#include "Console.h"
+
+#include <string.h>
+#include <time.h>
+#include <iostream>
+
+// Monotonic time [ms]
+static uint64_t milliseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+// Append a line at level, flushing the buffer when due, unless the level is switched out
+void Console::write(int level, const std::string &line) {
+  if (!enabled(level)) return;
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Keep errors in order with what was printed before them
+  if (level <= Warning) {
+    drain();
+    std::cerr << line << '\n';
+    std::cerr.flush();
+    return;
+  }
+
+  if (buffer.empty()) since = milliseconds();
+  buffer += line;
+  buffer += '\n';
+  if (buffer.size() >= FlushSize || milliseconds() - since >= static_cast<uint64_t>(FlushInterval)) drain();
+}
+
+// Write out the buffer if it has waited FlushInterval
+void Console::poll() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!buffer.empty() && milliseconds() - since >= static_cast<uint64_t>(FlushInterval)) drain();
+}
+
+// Write out the buffer
+void Console::flush() {
+  std::lock_guard<std::mutex> lock(mutex);
+  drain();
+}
+
+// Level of name, or -1 when unknown or compiled out
+int Console::parse(const char *name) {
+  const char *names[] = {"error", "warning", "info", "debug", "trace"};
+  for (int i = Error; i <= CONSOLE_LEVEL && i <= Trace; i++) {
+    if (strcmp(name, names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+// Write out the buffer, with the mutex held
+void Console::drain() {
+  if (buffer.empty()) return;
+  std::cout.write(buffer.data(), buffer.size());
+  std::cout.flush();
+  buffer.clear();
+}
+
+// Initialize static members
+std::atomic<int> Console::level(Console::Info);
+std::mutex Console::mutex;
+std::string Console::buffer;
+uint64_t Console::since = 0;
@@ -18,8 +18,11 @@ DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
 }
 
 void DHT::begin(void) {
-  // set up the pins!
-  pinMode(_pin, INPUT);
+  // Read through the kernel when it can time the edges, otherwise poll the pin
+  if (!Module::recorder.replaying() && !_reader.begin(wpiPinToGpio(_pin), _type)) {
+    // set up the pins!
+    pinMode(_pin, INPUT);
+  }
   // Using this value makes sure that millis() - lastreadtime will be
   // >= MIN_INTERVAL right away. Note that this assignment wraps around,
   // but so will the subtraction.
@@ -125,9 +128,32 @@ bool DHT::read(bool force) {
   }
   _lastreadtime = currenttime;
 
+  if (Module::recorder.replaying()) {
+    // Replay the bits decoded in flight instead of reading the data line
+    _lastresult = Module::recorder.replay(Recorder::DHTChannel, 0, data, sizeof(data)) == sizeof(data);
+    return _lastresult;
+  }
+
+  _lastresult = readData();
+
+  // Record the bits of a good reading, or an empty record for a failure
+  if (Module::recorder.recording()) {
+    Module::recorder.record(Recorder::DHTChannel, 0, data, _lastresult ? sizeof(data) : 0);
+  }
+
+  return _lastresult;
+}
+
+// Read the 40 bits sent by the sensor, returns true if the checksum matches
+bool DHT::readData() {
   // Reset 40 bits of received data to zero.
   data[0] = data[1] = data[2] = data[3] = data[4] = 0;
 
+  // Use the latest reading captured off-thread, without blocking
+  if (_reader.active()) {
+    return _reader.read(data);
+  }
+
   // Send start signal.  See DHT datasheet for full signal diagram:
   //   http://www.adafruit.com/datasheets/Digital%20humidity%20and%20temperature%20sensor%20AM2302.pdf
 
@@ -155,13 +181,11 @@ bool DHT::read(bool force) {
     // for ~80 microseconds again.
     if (expectPulse(LOW) == 0) {
       if (Global::Debug) std::cout << "DEBUG:: " << "Timeout waiting for start signal low pulse" << std::endl;
-      _lastresult = false;
-      return _lastresult;
+      return false;
     }
     if (expectPulse(HIGH) == 0) {
       if (Global::Debug) std::cout << "DEBUG :: " << "Timeout waiting for start signal high pulse" << std::endl;
-      _lastresult = false;
-      return _lastresult;
+      return false;
     }
 
     // Now read the 40 bits sent by the sensor.  Each bit is sent as a 50
@@ -185,8 +209,7 @@ bool DHT::read(bool force) {
     uint32_t highCycles = cycles[2*i+1];
     if ((lowCycles == 0) || (highCycles == 0)) {
       if (Global::Debug) std::cout << "DEBUG :: " << "Timeout waiting for pulse" << std::endl;
-      _lastresult = false;
-      return _lastresult;
+      return false;
     }
     data[i/8] <<= 1;
     // Now compare the low and high cycle times to see if the bit is a 0 or 1.
@@ -207,13 +230,11 @@ bool DHT::read(bool force) {
 
   // Check we read 40 bits and that the checksum matches.
   if (data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
-    _lastresult = true;
-    return _lastresult;
+    return true;
   }
   else {
     if (Global::Debug) std::cout << "DEBUG :: " << "Checksum failure!" << std::endl;
-    _lastresult = false;
-    return _lastresult;
+    return false;
   }
 }
 
@@ -0,0 +1,248 @@
+#include "HABPi.h"
+#include <dirent.h>
+#include <poll.h>
+#include <linux/gpio.h>
+
+// DHTReader Constructor
+DHTReader::DHTReader(): backend(NoBackend), type(DHT11), line(0), running(false), cached(false) {
+  std::memset(cache, 0, sizeof(cache));
+}
+
+// DHTReader Destructor
+DHTReader::~DHTReader() {
+  stop();
+}
+
+// Find a kernel backend and start sampling
+bool DHTReader::begin(unsigned int line, uint8_t type) {
+  this->line = line;
+  this->type = type;
+  backend = NoBackend;
+
+  // Prefer the dht11 IIO driver, which also handles DHT22
+  DIR *dir = opendir(IIOPath.c_str());
+  if (dir != NULL) {
+    struct dirent *entry;
+    while (backend == NoBackend && (entry = readdir(dir)) != NULL) {
+      if (std::strncmp(entry->d_name, "iio:device", 10) != 0) continue;
+
+      std::string device = IIOPath + "/" + entry->d_name;
+      std::ifstream nameFile((device + "/name").c_str());
+      std::string name;
+      if (nameFile >> name && name == "dht11") {
+        iioDevice = device;
+        backend = IIOBackend;
+      }
+    }
+    closedir(dir);
+  }
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  // Otherwise capture edges through the GPIO character device
+  if (backend == NoBackend && access(GPIOChip.c_str(), R_OK | W_OK) == 0) {
+    backend = GPIOBackend;
+  }
+#endif
+
+  if (backend == NoBackend) {
+    Module::logger.info("DHT: No kernel backend, reading by polling");
+    return false;
+  }
+
+  Module::logger.info(backend == IIOBackend ? "DHT: Reading through the dht11 IIO driver" : "DHT: Reading through GPIO edge capture");
+
+  running = true;
+  worker = std::thread(&DHTReader::run, this);
+  return true;
+}
+
+// Stop sampling
+void DHTReader::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  wake.notify_all();
+  if (worker.joinable()) worker.join();
+}
+
+// Copy the cached reading
+bool DHTReader::read(uint8_t data[5]) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!cached) return false;
+
+  int age = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - cacheTime).count();
+  if (age > MaxAge) return false;
+
+  std::memcpy(data, cache, sizeof(cache));
+  return true;
+}
+
+// Worker thread
+void DHTReader::run() {
+  Tracer::name("dht");
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (running) {
+    lock.unlock();
+    uint8_t data[5];
+    bool good;
+    {
+      TRACE_SPAN("DHTReader::sample");
+      good = sample(data);
+    }
+    lock.lock();
+
+    if (good) {
+      std::memcpy(cache, data, sizeof(cache));
+      cached = true;
+      cacheTime = std::chrono::steady_clock::now();
+    } else {
+      CONSOLE_DEBUG("DHT sample failed");
+    }
+
+    wake.wait_for(lock, std::chrono::milliseconds(static_cast<int>(Interval)), [this] { return !running; });
+  }
+}
+
+// Take one sample
+bool DHTReader::sample(uint8_t data[5]) {
+  switch (backend) {
+    case IIOBackend: return sampleIIO(data);
+    case GPIOBackend: return sampleGPIO(data);
+    default: return false;
+  }
+}
+
+// Read the dht11 IIO driver, which blocks while it receives the bits
+bool DHTReader::sampleIIO(uint8_t data[5]) {
+  long temperature, humidity;
+  std::ifstream temperatureFile((iioDevice + "/in_temp_input").c_str());
+  if (!(temperatureFile >> temperature)) return false;
+  std::ifstream humidityFile((iioDevice + "/in_humidityrelative_input").c_str());
+  if (!(humidityFile >> humidity)) return false;
+
+  encode(temperature, humidity, data);
+  return true;
+}
+
+/**
+ * sampleGPIO
+ *
+ * Requests the line as an output and holds it low for StartLow, then
+ * reconfigures the same request as an input with edge detection, so no
+ * edges are lost between the start pulse and the reply. The kernel
+ * timestamps every edge in its interrupt handler, so being descheduled
+ * while the edges are queued does not corrupt the reading.
+ */
+bool DHTReader::sampleGPIO(uint8_t data[5]) {
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  int chip = open(GPIOChip.c_str(), O_RDWR | O_CLOEXEC);
+  if (chip < 0) return false;
+
+  struct gpio_v2_line_request request;
+  std::memset(&request, 0, sizeof(request));
+  request.offsets[0] = line;
+  request.num_lines = 1;
+  request.event_buffer_size = EventBufferSize;
+  std::strncpy(request.consumer, "habpi-dht", GPIO_MAX_NAME_SIZE - 1);
+  request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT | GPIO_V2_LINE_FLAG_OPEN_DRAIN;
+  request.config.num_attrs = 1;
+  request.config.attrs[0].mask = 1;
+  request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+  request.config.attrs[0].attr.values = 0;
+
+  int result = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+  close(chip);
+  if (result < 0) {
+    Module::logger.error("DHT: Unable to request GPIO line");
+    return false;
+  }
+
+  // Start signal
+  usleep(StartLow * 1000);
+
+  // Release the line and capture the reply
+  struct gpio_v2_line_config config;
+  std::memset(&config, 0, sizeof(config));
+  config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+  if (ioctl(request.fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0) {
+    close(request.fd);
+    return false;
+  }
+
+  uint64_t times[EventBufferSize];
+  uint8_t levels[EventBufferSize];
+  int n = 0;
+  struct gpio_v2_line_event events[16];
+  struct pollfd pfd = {request.fd, POLLIN, 0};
+
+  // Collect edges until the line stays idle for ReplyTimeout
+  while (n < EventBufferSize && poll(&pfd, 1, ReplyTimeout) > 0) {
+    ssize_t bytes = ::read(request.fd, events, sizeof(events));
+    if (bytes <= 0) break;
+    for (size_t i = 0; i < bytes / sizeof(events[0]) && n < EventBufferSize; i++, n++) {
+      times[n] = events[i].timestamp_ns;
+      levels[n] = (events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? HIGH : LOW;
+    }
+  }
+  close(request.fd);
+
+  return decode(times, levels, n, data);
+#else
+  return false;
+#endif
+}
+
+/**
+ * decode
+ *
+ * Each bit is a ~50 us low followed by a high of ~27 us for a 0 or
+ * ~70 us for a 1, and the reply ends with a final low. The bits are the
+ * last 40 complete high pulses, which skips the 80 us response pulse
+ * and any edges of the start signal. A lost edge merges two pulses and
+ * is caught by the checksum.
+ */
+bool DHTReader::decode(const uint64_t *times, const uint8_t *levels, int n, uint8_t data[5]) {
+  uint64_t widths[40];
+  int count = 0;
+
+  // Walk backwards collecting high pulses (a rising edge followed by a falling edge)
+  for (int i = n - 1; i > 0 && count < 40; i--) {
+    if (levels[i] == LOW && levels[i - 1] == HIGH) {
+      widths[39 - count] = times[i] - times[i - 1];
+      count++;
+      i--;
+    }
+  }
+  if (count < 40) return false;
+
+  std::memset(data, 0, 5);
+  for (int i = 0; i < 40; i++) {
+    data[i / 8] <<= 1;
+    if (widths[i] > OneThreshold) data[i / 8] |= 1;
+  }
+
+  return data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF);
+}
+
+// Encode millidegrees and millipercent in the sensor's own format
+void DHTReader::encode(long temperature, long humidity, uint8_t data[5]) {
+  if (type == DHT11) {
+    data[0] = static_cast<uint8_t>(humidity / 1000);
+    data[1] = static_cast<uint8_t>((humidity % 1000) / 100);
+    data[2] = static_cast<uint8_t>(temperature / 1000);
+    data[3] = static_cast<uint8_t>((temperature % 1000) / 100);
+  } else {
+    long rh = humidity / 100, t = std::labs(temperature) / 100;
+    data[0] = static_cast<uint8_t>(rh >> 8);
+    data[1] = static_cast<uint8_t>(rh & 0xFF);
+    data[2] = static_cast<uint8_t>(((t >> 8) & 0x7F) | (temperature < 0 ? 0x80 : 0));
+    data[3] = static_cast<uint8_t>(t & 0xFF);
+  }
+  data[4] = static_cast<uint8_t>((data[0] + data[1] + data[2] + data[3]) & 0xFF);
+}
+
+// Initialize static constants
+const std::string DHTReader::IIOPath = "/sys/bus/iio/devices";
+const std::string DHTReader::GPIOChip = "/dev/gpiochip0";
@@ -87,7 +87,7 @@ void DHT_Unified::update(float &temperature, float &relative_humidity) {
   if (tstatus == true && hstatus == true) {
     temperature = tevent.temperature;
     relative_humidity = hevent.relative_humidity;
-    std::cout << "Temperature: " << temperature << " C, Rel. Humidity: " << relative_humidity << "%" << std::endl;
+    CONSOLE_DEBUG("Temperature: " << temperature << " C, Rel. Humidity: " << relative_humidity << "%");
   } else {
     Module::logger.error("Error: Unable to get valid DHT sensor data");
   }
@@ -57,6 +57,8 @@ int Database::callback(void *data, int argc, char **argv, char **azColName) {
 
 // Insert data into sqlite3 DB
 void Database::insertRecord(message_type_id_t messageTypeId, char *data) {
+  TRACE_SPAN("Database::insertRecord");
+  Metrics::Timer timer(Metrics::DbWrite);
   int rc;
   char *zErrMsg = 0;
   char sql[Global::MaxLength], msg[Global::MaxLength];
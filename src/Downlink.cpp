@@ -0,0 +1,199 @@
+#include "HABPi.h"
+
+// Downlink Constructor
+Downlink::Downlink(): haveSent(false), busyTime(0.0f), rate(0.0f), acked(0) {}
+
+// Downlink Destructor
+Downlink::~Downlink() {}
+
+// Append an image chunk to the back of the queue, keeping a copy for retransmission
+void Downlink::push(const image_msg_t &msg) {
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.push_back(msg);
+
+  // The first chunk of an image starts a new record, dropping the oldest beyond MaxImages
+  if (msg.img_chunk_id == 0 || images.find(msg.img_id) == images.end()) {
+    if (images.erase(msg.img_id) > 0) {
+      order.erase(std::find(order.begin(), order.end(), msg.img_id));
+    }
+
+    downlink_image_t &image = images[msg.img_id];
+    image.chunks.resize(msg.img_nchunks);
+    image.state.assign(msg.img_nchunks, 0);
+    image.sentTime.resize(msg.img_nchunks);
+    image.acked = 0;
+    order.push_back(msg.img_id);
+
+    while (order.size() > MaxImages) {
+      images.erase(order.front());
+      order.pop_front();
+    }
+  }
+
+  downlink_image_t *image = find(msg);
+  if (image != NULL) {
+    image->chunks[msg.img_chunk_id] = msg;
+    image->state[msg.img_chunk_id] |= Queued;
+  }
+}
+
+// Remove the chunk at the front of the queue, skipping chunks acknowledged while queued
+bool Downlink::pop(image_msg_t &msg) {
+  std::chrono::steady_clock::time_point now = Module::recorder.now();
+  std::lock_guard<std::mutex> lock(mutex);
+
+  while (!queue.empty()) {
+    msg = queue.front();
+    queue.pop_front();
+
+    downlink_image_t *image = find(msg);
+    if (image == NULL) return true;
+
+    uint8_t &state = image->state[msg.img_chunk_id];
+    state &= ~Queued;
+    if (state & Acked) continue;
+
+    state |= Sent;
+    image->sentTime[msg.img_chunk_id] = now;
+    return true;
+  }
+  return false;
+}
+
+// Remove all queued chunks
+void Downlink::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  queue.clear();
+  images.clear();
+  order.clear();
+}
+
+/**
+ * ack
+ *
+ * Marks the chunks the ground station has received, then queues again,
+ * at the front in chunk order, those it reports missing. Chunks that
+ * have not been sent yet, are already queued, or were sent less than
+ * Holdoff ago are left alone. A fully acknowledged image is forgotten.
+ */
+int Downlink::ack(const uplink_msg_t &msg) {
+  std::chrono::steady_clock::time_point now = Module::recorder.now();
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::map<uint16_t, downlink_image_t>::iterator it = images.find(msg.img_id);
+  if (it == images.end()) return 0;
+  downlink_image_t &image = it->second;
+
+  int nchunks = static_cast<int>(image.chunks.size());
+  int base = std::min(static_cast<int>(msg.ack_base), nchunks);
+  int nbits = 8 * std::min(static_cast<int>(msg.ack_nbytes), static_cast<int>(Serializer::AckBytes));
+  int end = std::min(base + nbits, nchunks);
+  std::vector<int> missing;
+
+  for (int i = 0; i < end; i++) {
+    bool received = (i < base) || ((msg.ack_bitmap[(i - base) / 8] >> ((i - base) % 8)) & 1);
+    uint8_t &state = image.state[i];
+
+    if (received) {
+      if (!(state & Acked)) {
+        state |= Acked;
+        image.acked++;
+      }
+    } else if ((state & Sent) && !(state & (Queued | Acked))) {
+      float dt = std::chrono::duration_cast<std::chrono::microseconds>(now - image.sentTime[i]).count() * 1.0E-6f;
+      if (dt >= Holdoff) missing.push_back(i);
+    }
+  }
+
+  // Forget a complete image, along with any of its chunks still queued
+  if (image.acked == nchunks) {
+    uint16_t id = msg.img_id;
+    queue.erase(std::remove_if(queue.begin(), queue.end(), [id](const image_msg_t &m) { return m.img_id == id; }), queue.end());
+    images.erase(it);
+    order.erase(std::find(order.begin(), order.end(), id));
+    return 0;
+  }
+
+  for (std::vector<int>::reverse_iterator i = missing.rbegin(); i != missing.rend(); ++i) {
+    image.state[*i] |= Queued;
+    queue.push_front(image.chunks[*i]);
+  }
+  Metrics::count(Metrics::ChunksResent, missing.size());
+  return static_cast<int>(missing.size());
+}
+
+// Images sent but not yet fully acknowledged
+size_t Downlink::unacked() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return images.size();
+}
+
+/**
+ * sent
+ *
+ * Accumulates the acknowledged chunks and the busy time between
+ * consecutive transmissions; once Window seconds of busy time have been
+ * observed the throughput estimate is updated. Idle gaps (no image data
+ * to send) are excluded, so the estimate reflects the link capacity
+ * rather than the offered load.
+ */
+void Downlink::sent(bool ack) {
+  std::chrono::steady_clock::time_point now = Module::recorder.now();
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (haveSent) {
+    float dt = std::chrono::duration_cast<std::chrono::microseconds>(now - lastSent).count() * 1.0E-6f;
+    if (dt < IdleGap) busyTime += dt;
+  }
+  lastSent = now;
+  haveSent = true;
+
+  if (ack) acked++;
+
+  if (busyTime >= Window) {
+    float measured = static_cast<float>(acked) / busyTime;
+    rate = (rate > 0.0f) ? (1.0f - Smoothing) * rate + Smoothing * measured : measured;
+    busyTime = 0.0f;
+    acked = 0;
+  }
+}
+
+// Number of chunks waiting to be sent
+size_t Downlink::backlog() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return queue.size();
+}
+
+// First chunk of an image waiting to be sent
+bool Downlink::pending(uint16_t id, uint16_t &chunk) {
+  std::lock_guard<std::mutex> lock(mutex);
+  bool found = false;
+  for (std::deque<image_msg_t>::const_iterator it = queue.begin(); it != queue.end(); ++it) {
+    if (it->img_id == id && (!found || it->img_chunk_id < chunk)) {
+      chunk = it->img_chunk_id;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// Measured throughput while busy
+float Downlink::throughput() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return rate;
+}
+
+// Estimated time to send the backlog
+float Downlink::drainTime() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (queue.empty()) return 0.0f;
+  if (rate <= 0.0f) return 1.0E9f;
+  return static_cast<float>(queue.size()) / rate;
+}
+
+// Kept chunk matching a message
+downlink_image_t *Downlink::find(const image_msg_t &msg) {
+  std::map<uint16_t, downlink_image_t>::iterator it = images.find(msg.img_id);
+  if (it == images.end() || msg.img_chunk_id >= it->second.chunks.size()) return NULL;
+  return &it->second;
+}
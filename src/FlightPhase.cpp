@@ -0,0 +1,125 @@
+#include "HABPi.h"
+
+// FlightPhase Constructor
+FlightPhase::FlightPhase() {
+  reset();
+}
+
+// FlightPhase Destructor
+FlightPhase::~FlightPhase() {}
+
+// Reset to the pad phase
+void FlightPhase::reset() {
+  current = Pad;
+  candidate = Pad;
+  candidateTime = 0.0f;
+  phaseTime = 0.0f;
+  launch = 0.0f;
+  launchSet = false;
+}
+
+// Force the phase
+void FlightPhase::set(uint8_t phase) {
+  if (phase < NPhases) enter(phase);
+}
+
+// Resume a flight
+void FlightPhase::resume(uint8_t phase, float launchAltitude) {
+  set(phase);
+  launch = launchAltitude;
+  launchSet = phase != Pad;
+}
+
+// Change phase
+void FlightPhase::enter(uint8_t phase) {
+  current = phase;
+  candidate = phase;
+  candidateTime = 0.0f;
+  phaseTime = 0.0f;
+}
+
+// Accumulate the time a candidate transition has held
+bool FlightPhase::hold(uint8_t next, bool condition, float holdTime, float dt) {
+  if (!condition) {
+    if (candidate == next) {
+      candidate = current;
+      candidateTime = 0.0f;
+    }
+    return false;
+  }
+
+  if (candidate != next) {
+    candidate = next;
+    candidateTime = 0.0f;
+  }
+  candidateTime += dt;
+
+  return candidateTime >= holdTime;
+}
+
+/**
+ * update
+ *
+ *   Pad     -> Ascent   climbing faster than AscentRate, or LaunchHeight above the pad
+ *   Ascent  -> Float    climb rate within FloatRate for FloatHold
+ *   Float   -> Ascent   climbing faster than AscentRate again
+ *   Ascent,
+ *   Float   -> Burst    falling faster than BurstRate, or in free fall
+ *   Burst   -> Descent  after BurstTime
+ *   Descent -> Landed   climb rate within LandedRate for LandedHold
+ */
+bool FlightPhase::update(float altitude, float climb, float accel, float dt) {
+  uint8_t previous = current;
+  phaseTime += dt;
+
+  switch (current) {
+    case Pad: {
+      // Track the launch altitude while stationary
+      if (!launchSet) {
+        launch = altitude;
+        launchSet = true;
+      } else if (std::fabs(climb) < FloatRate) {
+        launch += 0.05f * (altitude - launch);
+      }
+
+      bool launched = (climb > AscentRate) || (altitude - launch > LaunchHeight);
+      if (hold(Ascent, launched, AscentHold, dt)) enter(Ascent);
+    } break;
+    case Ascent:
+    case Float: {
+      bool falling = (climb < BurstRate);
+      bool freefall = (accel < FreeFall) && (climb < 0.0f);
+      if (hold(Burst, falling || freefall, freefall ? FreeFallHold : BurstHold, dt)) {
+        enter(Burst);
+      } else if (current == Ascent) {
+        if (hold(Float, std::fabs(climb) < FloatRate, FloatHold, dt)) enter(Float);
+      } else {
+        if (hold(Ascent, climb > AscentRate, AscentHold, dt)) enter(Ascent);
+      }
+    } break;
+    case Burst: {
+      if (phaseTime >= BurstTime) enter(Descent);
+    } break;
+    case Descent: {
+      if (hold(Landed, std::fabs(climb) < LandedRate, LandedHold, dt)) enter(Landed);
+    } break;
+    case Landed:
+    default: {
+    } break;
+  }
+
+  return current != previous;
+}
+
+// Phase name
+const char *FlightPhase::name(uint8_t phase) {
+  switch (phase) {
+    case Pad: return "Pad";
+    case Ascent: return "Ascent";
+    case Float: return "Float";
+    case Burst: return "Burst";
+    case Descent: return "Descent";
+    case Landed: return "Landed";
+    default: return "Unknown";
+  }
+}
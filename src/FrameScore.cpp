@@ -0,0 +1,110 @@
+#include "HABPi.h"
+
+/**
+ * score
+ *
+ * Entropy (0 to 8 bits) weighted by the Laplacian standard deviation,
+ * so a sharp frame of featureless sky and a blurred frame of the ground
+ * both score below a sharp frame with content.
+ */
+float FrameScore::score(const uint8_t *image, int width, int height, int channels) {
+  std::vector<uint8_t> grey;
+  int w = 0, h = 0;
+
+  downscale(image, width, height, channels, grey, w, h);
+  if (w < 3 || h < 3) return 0.0f;
+
+  return entropy(grey.data(), w, h) * std::sqrt(sharpness(grey.data(), w, h));
+}
+
+// Box filter to a greyscale image at most MaxWidth pixels wide
+void FrameScore::downscale(const uint8_t *image, int width, int height, int channels,
+                           std::vector<uint8_t> &grey, int &greyWidth, int &greyHeight) {
+  int f = (width + MaxWidth - 1) / MaxWidth;
+  if (f < 1) f = 1;
+
+  greyWidth = width / f;
+  greyHeight = height / f;
+  grey.assign(greyWidth * greyHeight, 0);
+
+  // Integer luma weights (sum to 256)
+  const uint32_t wr = (channels >= 3) ? 77 : 256;
+  const uint32_t wg = (channels >= 3) ? 150 : 0;
+  const uint32_t wb = (channels >= 3) ? 29 : 0;
+  const int gOffset = (channels >= 3) ? 1 : 0;
+  const int bOffset = (channels >= 3) ? 2 : 0;
+  const uint32_t norm = 256 * f * f;
+
+  std::vector<uint32_t> row(greyWidth);
+  for (int y = 0; y < greyHeight; y++) {
+    std::fill(row.begin(), row.end(), 0);
+    for (int dy = 0; dy < f; dy++) {
+      const uint8_t *src = image + static_cast<size_t>(y * f + dy) * width * channels;
+      for (int x = 0; x < greyWidth; x++) {
+        const uint8_t *p = src + x * f * channels;
+        uint32_t sum = 0;
+        for (int dx = 0; dx < f; dx++, p += channels) {
+          sum += wr * p[0] + wg * p[gOffset] + wb * p[bOffset];
+        }
+        row[x] += sum;
+      }
+    }
+
+    uint8_t *dst = grey.data() + y * greyWidth;
+    for (int x = 0; x < greyWidth; x++) {
+      dst[x] = static_cast<uint8_t>(row[x] / norm);
+    }
+  }
+}
+
+// Variance of the 4-neighbour Laplacian of a greyscale image
+float FrameScore::sharpness(const uint8_t *grey, int width, int height) {
+  int64_t sum = 0, sumSq = 0;
+  int n = (width - 2) * (height - 2);
+  if (n <= 0) return 0.0f;
+
+  for (int y = 1; y < height - 1; y++) {
+    const uint8_t *up = grey + (y - 1) * width;
+    const uint8_t *mid = grey + y * width;
+    const uint8_t *dn = grey + (y + 1) * width;
+
+    // Per row accumulators fit in 32 bits for rows up to MaxWidth wide
+    int32_t rowSum = 0, rowSumSq = 0;
+    for (int x = 1; x < width - 1; x++) {
+      int32_t lap = 4 * mid[x] - mid[x - 1] - mid[x + 1] - up[x] - dn[x];
+      rowSum += lap;
+      rowSumSq += lap * lap;
+    }
+    sum += rowSum;
+    sumSq += rowSumSq;
+  }
+
+  double mean = static_cast<double>(sum) / n;
+  return static_cast<float>(static_cast<double>(sumSq) / n - mean * mean);
+}
+
+// Shannon entropy of the intensity histogram of a greyscale image
+float FrameScore::entropy(const uint8_t *grey, int width, int height) {
+  // Four interleaved histograms avoid stalls on repeated values
+  uint32_t hist[4][256] = {{0}};
+  int n = width * height, i = 0;
+
+  for (; i + 3 < n; i += 4) {
+    hist[0][grey[i]]++;
+    hist[1][grey[i + 1]]++;
+    hist[2][grey[i + 2]]++;
+    hist[3][grey[i + 3]]++;
+  }
+  for (; i < n; i++) hist[0][grey[i]]++;
+
+  double h = 0.0;
+  for (int k = 0; k < 256; k++) {
+    uint32_t count = hist[0][k] + hist[1][k] + hist[2][k] + hist[3][k];
+    if (count > 0) {
+      double p = static_cast<double>(count) / n;
+      h -= p * std::log2(p);
+    }
+  }
+
+  return static_cast<float>(h);
+}
@@ -1,13 +1,20 @@
 #include "HABPi.h"
 
 // GPS Constructor
-GPS::GPS() {}
+GPS::GPS(): gps_rec(NULL), data(NULL), fd(-1), missed(0) {}
 
 // GPS Destructor
-GPS::~GPS() {}
+GPS::~GPS() {
+  if (fd != -1) {
+    close(fd);
+    fd = -1;
+  }
+}
 
 // Begin GPS
 bool GPS::begin() {
+  if (Module::recorder.replaying()) return true;
+
 	gps_rec = new gpsmm("localhost", DEFAULT_GPSD_PORT);
 
   if (gps_rec->stream(WATCH_ENABLE|WATCH_JSON) == NULL) {
@@ -19,33 +26,190 @@ bool GPS::begin() {
   }
 }
 
-// Update GPS
-void GPS::update() {
+/**
+ * begin
+ *
+ * Opens the receiver's serial device in raw mode, bypassing gpsd.
+ * A u-blox receiver is asked to emit UBX-NAV-PVT (108 bytes framed)
+ * in place of every standard NMEA sentence, so that a FixPeriod
+ * solution rate needs about 540 B/s of the 960 B/s a 9600 baud link
+ * carries; with the NMEA sentences left on it would need three times
+ * that. Other receivers ignore these packets and continue to be
+ * decoded from their NMEA output.
+ */
+bool GPS::begin(const std::string &device) {
+  struct termios tty;
+  uint8_t cmd[16];
+  size_t len;
+
+  if (Module::recorder.replaying()) return true;
+
+  fd = open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd == -1) {
+    std::string msg = std::string("Failed to open GPS device ") + device;
+    Module::logger.error(msg.c_str());
+    return false;
+  }
+
+  // Raw 8N1 at 9600 baud
+  std::memset(&tty, 0, sizeof(tty));
+  if (tcgetattr(fd, &tty) == 0) {
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B9600);
+    cfsetospeed(&tty, B9600);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(fd, TCSANOW, &tty);
+  }
+  tcflush(fd, TCIOFLUSH);
+
+  // Enable NAV-PVT, disable GGA, GLL, GSA, GSV, RMC and VTG, and raise the fix rate
+  len = NMEA::messageRateCommand(NMEA::UbxNav, NMEA::UbxNavPvt, 1, cmd);
+  if (write(fd, cmd, len) < 0) Module::logger.error("Unable to configure GPS receiver");
+  for (uint8_t sentence = NMEA::NmeaGga; sentence <= NMEA::NmeaVtg; sentence++) {
+    len = NMEA::messageRateCommand(NMEA::NmeaStd, sentence, 0, cmd);
+    if (write(fd, cmd, len) < 0) Module::logger.error("Unable to configure GPS receiver");
+  }
+  len = NMEA::rateCommand(FixPeriod, cmd);
+  if (write(fd, cmd, len) < 0) Module::logger.error("Unable to configure GPS receiver");
+
+  nmea.reset();
+
+  std::string msg = std::string("Reading GPS directly from ") + device;
+  Module::logger.info(msg.c_str());
+  return true;
+}
+
+// Update GPS, returns true when a new fix was stored
+bool GPS::update() {
+  TRACE_SPAN("GPS::update");
+  if (Module::recorder.replaying()) {
+    return updateReplay();
+  }
+
+  if (fd != -1) {
+    return updateSerial();
+  }
+
 	if (gps_rec == NULL) {
 		Module::logger.error("GPS: gps_rec is NULL");
-    return;
+    return false;
 	}
 
 	if (!gps_rec->waiting(GPS::GpsTimeout)) {
 		Module::logger.error("GPS Timeout Error");
-    return;
+    return false;
 	}
 
   if ((data = gps_rec->read()) == NULL) {
     Module::logger.error("GPS Read Error");
-    return;
+    return false;
   } else {
     storeData(data);
+    if (Module::recorder.recording()) recordData(data);
+    print();
+    return true;
+  }
+}
+
+/**
+ * updateSerial
+ *
+ * Called faster than the receiver's fix rate, so each read finds at most
+ * one new fix and never waits for one. Every read is recorded, even an
+ * empty one, so a replay sees the fixes arrive on the same reads.
+ */
+bool GPS::updateSerial() {
+  uint8_t buffer[256];
+  std::vector<uint8_t> received;
+  ssize_t n;
+  int updates = 0;
 
-    std::cout << "nstats: " << static_cast<int>(Module::sensorMsg.gps_nsats);
-    std::cout << ", status: " << static_cast<int>(Module::sensorMsg.gps_status);
-    std::cout << ", mode: " << static_cast<int>(Module::sensorMsg.gps_mode) << std::endl;
-    std::cout << "lat, lon: " << std::setprecision(8) << Module::sensorMsg.gps_lat << ", " << std::setprecision(8) << Module::sensorMsg.gps_lon;
-    std::cout << ", alt: " << std::setprecision(8) << Module::sensorMsg.gps_alt;
-    std::cout << ", dir: " << std::setprecision(8) << Module::sensorMsg.gps_dir;
-    std::cout << ", gspd: " << std::setprecision(8) << Module::sensorMsg.gps_gspd;
-    std::cout << ", vspd: " << std::setprecision(8) << Module::sensorMsg.gps_vspd << std::endl;
+  // Drain everything available, keeping only the most recent fix
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    updates += nmea.parse(buffer, static_cast<size_t>(n));
+    if (Module::recorder.recording()) received.insert(received.end(), buffer, buffer + n);
   }
+  Module::recorder.record(Recorder::GPSChannel, RawKey, received.data(), received.size());
+  if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    Module::logger.error("GPS Read Error");
+    return false;
+  }
+
+  if (updates == 0) {
+    if (++missed == MissedReads) Module::logger.error("GPS Timeout Error");
+    return false;
+  }
+  missed = 0;
+
+  storeData(nmea.fix());
+  nmea.clearSet();
+  print();
+  return true;
+}
+
+// Update GPS from a replayed trace, returns true when a new fix was stored
+bool GPS::updateReplay() {
+  std::vector<uint8_t> bytes;
+
+  if (Module::recorder.replay(Recorder::GPSChannel, RawKey, bytes)) {
+    // Receiver output read directly, run it through the parser again
+    if (nmea.parse(bytes.data(), bytes.size()) > 0) {
+      storeData(nmea.fix());
+      nmea.clearSet();
+      print();
+      return true;
+    }
+  } else if (Module::recorder.replay(Recorder::GPSChannel, FixKey, bytes) && bytes.size() == sizeof(gnss_fix_t)) {
+    // Report received from gpsd
+    gnss_fix_t fix;
+    std::memcpy(&fix, bytes.data(), sizeof(fix));
+    storeData(fix);
+    print();
+    return true;
+  } else {
+    Module::logger.error("GPS Timeout Error");
+  }
+  return false;
+}
+
+// Record a gpsd report as a fix
+void GPS::recordData(struct gps_data_t *collect) {
+  gnss_fix_t fix;
+  std::memset(&fix, 0, sizeof(fix));
+
+  if (collect->set & TIME_SET) fix.set |= NMEA::TimeSet;
+  if (collect->set & LATLON_SET) fix.set |= NMEA::LatLonSet;
+  if (collect->set & ALTITUDE_SET) fix.set |= NMEA::AltitudeSet;
+  if (collect->set & SPEED_SET) fix.set |= NMEA::SpeedSet;
+  if (collect->set & TRACK_SET) fix.set |= NMEA::TrackSet;
+  if (collect->set & CLIMB_SET) fix.set |= NMEA::ClimbSet;
+  if (collect->set & STATUS_SET) fix.set |= NMEA::StatusSet;
+  if (collect->set & MODE_SET) fix.set |= NMEA::ModeSet;
+  if (collect->set & SATELLITE_SET) fix.set |= NMEA::SatelliteSet;
+
+  fix.status = collect->status;
+  fix.mode = collect->fix.mode;
+  fix.nsats = collect->satellites_used;
+  fix.latitude = collect->fix.latitude;
+  fix.longitude = collect->fix.longitude;
+  fix.altitude = collect->fix.altitude;
+  fix.speed = collect->fix.speed;
+  fix.track = collect->fix.track;
+  fix.climb = collect->fix.climb;
+
+  Module::recorder.record(Recorder::GPSChannel, FixKey, reinterpret_cast<const uint8_t *>(&fix), sizeof(fix));
+}
+
+// Print the current GPS values
+void GPS::print() {
+  CONSOLE_DEBUG("nstats: " << static_cast<int>(Module::sensorMsg.gps_nsats)
+    << ", status: " << static_cast<int>(Module::sensorMsg.gps_status)
+    << ", mode: " << static_cast<int>(Module::sensorMsg.gps_mode));
+  CONSOLE_DEBUG("lat, lon: " << std::setprecision(8) << Module::sensorMsg.gps_lat << ", " << Module::sensorMsg.gps_lon
+    << ", alt: " << Module::sensorMsg.gps_alt
+    << ", dir: " << Module::sensorMsg.gps_dir
+    << ", gspd: " << Module::sensorMsg.gps_gspd
+    << ", vspd: " << Module::sensorMsg.gps_vspd);
 }
 
 /**
@@ -83,4 +247,33 @@ void GPS::storeData(struct gps_data_t *collect) {
   if (collect->set & SATELLITE_SET) {
     Module::sensorMsg.gps_nsats = collect->satellites_used;
   }
+}
+
+// Store GPS Data decoded by the NMEA/UBX parser
+void GPS::storeData(const gnss_fix_t &fix) {
+  if (fix.set & NMEA::LatLonSet) {
+    Module::sensorMsg.gps_lat = fix.latitude;
+    Module::sensorMsg.gps_lon = fix.longitude;
+  }
+  if (fix.set & NMEA::AltitudeSet) {
+    Module::sensorMsg.gps_alt = fix.altitude;
+  }
+  if (fix.set & NMEA::SpeedSet) {
+    Module::sensorMsg.gps_gspd = fix.speed;
+  }
+  if (fix.set & NMEA::TrackSet) {
+    Module::sensorMsg.gps_dir = fix.track;
+  }
+  if (fix.set & NMEA::ClimbSet) {
+    Module::sensorMsg.gps_vspd = fix.climb;
+  }
+  if (fix.set & NMEA::StatusSet) {
+    Module::sensorMsg.gps_status = fix.status;
+  }
+  if (fix.set & NMEA::ModeSet) {
+    Module::sensorMsg.gps_mode = fix.mode;
+  }
+  if (fix.set & NMEA::SatelliteSet) {
+    Module::sensorMsg.gps_nsats = fix.nsats;
+  }
 }
\ No newline at end of file
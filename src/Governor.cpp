@@ -0,0 +1,51 @@
+#include "HABPi.h"
+
+// Governor Constructor
+Governor::Governor(): current(Full) {}
+
+/**
+ * update
+ *
+ * Finds the tier the voltage belongs to, and drops to it at once if it
+ * is lower. Higher tiers are regained only as far as the voltage clears
+ * their thresholds by Hysteresis. A voltage of zero has not been
+ * measured yet, and leaves the tier as it is.
+ */
+bool Governor::update(float voltage) {
+  if (voltage <= 0.0f) return false;
+
+  uint8_t target = Full;
+  while (target < Critical && voltage < threshold(target)) target++;
+
+  uint8_t next = current;
+  if (target > next) {
+    next = target;
+  } else {
+    while (next > target && voltage >= threshold(next - 1) + Hysteresis) next--;
+  }
+
+  if (next == current) return false;
+  current = next;
+  return true;
+}
+
+// Tier name
+const char *Governor::name(uint8_t tier) {
+  switch (tier) {
+    case Full: return "full";
+    case Reduced: return "reduced";
+    case Low: return "low";
+    case Critical: return "critical";
+    default: return "unknown";
+  }
+}
+
+// Lowest voltage of tier
+float Governor::threshold(uint8_t tier) {
+  switch (tier) {
+    case Full: return FullVoltage;
+    case Reduced: return ReducedVoltage;
+    case Low: return LowVoltage;
+    default: return 0.0f;
+  }
+}
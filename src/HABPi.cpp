@@ -36,20 +36,40 @@ void signalHandler(int signum) {
   }
 }
 
-// Reset GPSD
-void resetGPSD() {
-  std::cout << "GPSD: Reset Begin" << std::endl;
-  system("sudo killall gpsd > /dev/null 2>&1");
-  system("sleep 1");
-  system("sudo gpsd /dev/ttyS0 -F /var/run/gpsd.sock");
-  system("sleep 1");
-  std::cout << "GPSD: Reset End" << std::endl;
+// Snapshot the metrics on SIGUSR1, e.g. kill -USR1 $(pidof HABPi)
+void metricsHandler(int) {
+  Metrics::request();
+}
+
+// Export the span trace on SIGUSR2
+void traceHandler(int) {
+  Tracer::request();
+}
+
+// Print usage
+void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [-g] [-x] [-w] [-W] [-R] [-y sync] [-t directory] [-v video] [-l level] [-r trace | -p trace [-s speed]] [/path/to/log/rootfilename] [/path/to/db.sqlite3]" << std::endl;
+  std::cerr << "  -g  Read the GPS receiver directly from " << Module::GPSPath << ", bypassing gpsd" << std::endl;
+  std::cerr << "  -x  Drive the XBee directly on " << Module::XBeePath << " in API mode, bypassing the Arduino relay" << std::endl;
+  std::cerr << "  -w  Warm start: resume numbering, flight state and the image broadcast from " << Module::CheckpointPath << std::endl;
+  std::cerr << "  -W  Feed the hardware watchdog " << Module::WatchdogPath << " while the sensor and broadcast loops are healthy" << std::endl;
+  std::cerr << "  -R  Run the broadcast loop in real-time mode (SCHED_FIFO, own CPU, locked memory)" << std::endl;
+  std::cerr << "  -y  Archive sync policy: none, periodic (default) or file" << std::endl;
+  std::cerr << "  -t  Append high rate telemetry to a segmented log in directory, see TelemetryImport" << std::endl;
+  std::cerr << "  -v  Feed the pre-trigger video ring from an H.264 file instead of the camera" << std::endl;
+  std::cerr << "  -l  Console output: error, warning, info (default), debug or trace, levels above CONSOLE_LEVEL " << CONSOLE_LEVEL << " are compiled out" << std::endl;
+  std::cerr << "  -r  Record every device interaction to a trace file" << std::endl;
+  std::cerr << "  -p  Replay a trace file instead of using the hardware" << std::endl;
+  std::cerr << "  -s  Replay speed factor, 1 for real time (default), 0 for as fast as possible" << std::endl;
 }
 
 int main(int argc, char *argv[]) {
   std::atomic<bool> sensorReady(false);
   std::atomic<bool> imageReady(false);
   char dbFileName[Global::MaxLength];
+  std::string recordPath, replayPath;
+  float replaySpeed = 1.0f;
+  int opt;
 
   // Trigger execution of signalHandler if we receive these interrupts
   signal(SIGHUP, signalHandler);
@@ -57,13 +77,78 @@ int main(int argc, char *argv[]) {
   signal(SIGTERM, signalHandler);
   signal(SIGPIPE, signalHandler);
   signal(SIGSEGV, signalHandler);
+  signal(SIGUSR1, metricsHandler);
+  signal(SIGUSR2, traceHandler);
 
-  // Disable buffering to STDOUT
-  std::cout.setf(std::ios::unitbuf);
-  std::cerr.setf(std::ios::unitbuf);
+  // Parse command line options
+  while ((opt = getopt(argc, argv, "gxwWRy:t:v:l:r:p:s:")) != -1) {
+    switch (opt) {
+      case 'g': {
+        Module::directGPS = true;
+      } break;
+      case 'x': {
+        Module::directRadio = true;
+      } break;
+      case 'w': {
+        Module::warmStart = true;
+      } break;
+      case 'W': {
+        Module::hardwareWatchdog = true;
+      } break;
+      case 'R': {
+        Realtime::enabled = true;
+      } break;
+      case 'y': {
+        if (strcmp(optarg, "none") == 0) {
+          Archiver::syncPolicy = Archiver::SyncNone;
+        } else if (strcmp(optarg, "periodic") == 0) {
+          Archiver::syncPolicy = Archiver::SyncPeriodic;
+        } else if (strcmp(optarg, "file") == 0) {
+          Archiver::syncPolicy = Archiver::SyncEachFile;
+        } else {
+          usage(argv[0]);
+          exit(Global::Error);
+        }
+      } break;
+      case 't': {
+        Module::telemetryDirectory = optarg;
+      } break;
+      case 'v': {
+        Module::videoSource = optarg;
+      } break;
+      case 'l': {
+        int level = Console::parse(optarg);
+        if (level < 0) {
+          usage(argv[0]);
+          exit(Global::Error);
+        }
+        Console::level = level;
+      } break;
+      case 'r': {
+        recordPath = optarg;
+      } break;
+      case 'p': {
+        replayPath = optarg;
+      } break;
+      case 's': {
+        replaySpeed = static_cast<float>(atof(optarg));
+      } break;
+      default: {
+        usage(argv[0]);
+        exit(Global::Error);
+      } break;
+    }
+  }
 
-  // Reset GPSD
-  resetGPSD();
+  if (!recordPath.empty() && !replayPath.empty()) {
+    usage(argv[0]);
+    exit(Global::Error);
+  }
+
+  // Components come up in Module::startup, gpsd included
+  if (!replayPath.empty()) {
+    std::cout << "Replaying " << replayPath << std::endl;
+  }
 
   // Create Module Instance
   Module module;
@@ -76,23 +161,23 @@ int main(int argc, char *argv[]) {
   std::cout << "+=~=~=~=~=~=~=~=~=~=~=~=~=~=~=+" << std::endl;
 
   // Create Logger and set database filename
-  if (argc == 1) {
+  if (argc - optind == 0) {
     // Set Logger files using default log location
     Module::logger.startup(Logger::RootLogFile.c_str());
 
     // Store database filename
     strncpy(dbFileName, Database::DBFile.c_str(), Global::MaxLength - 1);
     dbFileName[Global::MaxLength - 1] = '\0';
-  } else if (argc == 3) {
+  } else if (argc - optind == 2) {
     // Set Logger files using custom log location
-    Module::logger.startup(argv[1]);
+    Module::logger.startup(argv[optind]);
 
     // Store database filename
-    strncpy(dbFileName, argv[2], Global::MaxLength - 1);
+    strncpy(dbFileName, argv[optind + 1], Global::MaxLength - 1);
     dbFileName[Global::MaxLength - 1] = '\0';
   } else {
     // Abort if incorrect number of arguments are provided
-    std::cerr << "Usage: " << argv[0] << " [/path/to/log/rootfilename] [/path/to/db.sqlite3]" << std::endl;
+    usage(argv[0]);
     exit(Global::Error);
   }
 
@@ -105,11 +190,20 @@ int main(int argc, char *argv[]) {
 
   Module::logger.notice("Begin Component Initialization");
 
-  // Initialize WiringPi using default pin convention
-  wiringPiSetup();
-  Module::logger.info("WiringPi Initialization Complete");
+  // Record or replay device interactions
+  if (!recordPath.empty() && !Module::recorder.record(recordPath)) {
+    exit(Global::Error);
+  }
+  if (!replayPath.empty() && !Module::recorder.replay(replayPath, replaySpeed)) {
+    exit(Global::Error);
+  }
 
-  // Module Initialization
+  // Lock memory and reserve a CPU before any other thread is started
+  if (Realtime::enabled) {
+    Realtime::reserve();
+  }
+
+  // Module Initialization, concurrently and within deadlines
   module.startup(dbFileName);
 
   Module::logger.notice("Finished Component Initialization");
@@ -125,6 +219,9 @@ int main(int argc, char *argv[]) {
   // Module Broadcast Update
   module.broadcastUpdate(sensorReady, imageReady);
 
+  // Stop the camera and video tools, so the camera loop is not left waiting on them
+  Module::processes.stop();
+
   // Join the thread with the main thread
   sensorThread.join();
   
@@ -138,6 +235,16 @@ int main(int argc, char *argv[]) {
   // Module Shutdown
   module.shutdown();
 
+  // Write the final metrics snapshot
+  if (!Metrics::dump(Metrics::Path)) {
+    Module::logger.error("Unable to write metrics snapshot");
+  }
+
+  // Write the span trace of the end of the run
+  if (!Tracer::dump(Tracer::Path)) {
+    Module::logger.error("Unable to write trace");
+  }
+
   Module::logger.notice("Finished Component Shutdown");
 
   Module::logger.notice("Stopping HABPi Program");
@@ -145,12 +252,28 @@ int main(int argc, char *argv[]) {
   // Logger Shutdown
   Module::logger.shutdown();
 
+  // Write out any console output still buffered, including the logger's own
+  Console::flush();
+
   std::cout << "Sensor Messages Sent: " << Module::sensorCounter << std::endl;
-  std::cout << "Image Messages Sent:  " << Module::imageCounter*Serializer::NChunks << std::endl;
+  std::cout << "Images Captured:      " << Module::imageCounter << std::endl;
+  std::cout << "Image Messages Sent:  " << Module::imageAckCounter + Module::imageNakCounter << std::endl;
+  std::cout << "Image Chunks Unsent:  " << Module::downlink.backlog() << std::endl;
   std::cout << "Sensor Messages ACK:  " << Module::sensorAckCounter << std::endl;
   std::cout << "Image Messages ACK:   " << Module::imageAckCounter << std::endl;
   std::cout << "Sensor Messages NAK:  " << Module::sensorNakCounter << std::endl;
   std::cout << "Image Messages NAK:   " << Module::imageNakCounter << std::endl;
 
+  // Report loops that stalled
+  Module::watchdog.report(std::cout);
+
+  // Report throughput, latency and memory of a recorded or replayed run
+  if (Module::recorder.recording() || Module::recorder.replaying()) {
+    Module::recorder.report(std::cout);
+  }
+
+  // Report per-stage latency percentiles and counters
+  Metrics::snapshot(std::cout);
+
   return Global::Ok;
 }
@@ -8,10 +8,6 @@ Logger::~Logger() {}
 
 // Startup Logger
 void Logger::startup(const char *rootLogFilename) {
-  // Disable buffering to STDOUT
-  std::cout.setf(std::ios::unitbuf);
-  std::cerr.setf(std::ios::unitbuf);
-
   std::ostringstream outstream, errstream;
   outstream << rootLogFilename << ".stdout";
   errstream << rootLogFilename << ".stderr";
@@ -71,11 +67,12 @@ void Logger::log(const char *tag, const char *message) {
     }
   } else {
     // Fallback to local filesystem
-    // If the ERROR tag is passed, send to stderr, otherwise send to stdout
+    // If the ERROR tag is passed, send to stderr, otherwise send to the buffered stdout
+    msg[strlen(msg) - 1] = '\0';
     if(strcasecmp(tag, ErrorTag.c_str()) != 0) {
-      std::cout << msg << std::endl;
+      Console::write(Console::Info, msg);
     } else {
-      std::cerr << msg << std::endl;
+      Console::write(Console::Error, msg);
     }
   }
 }
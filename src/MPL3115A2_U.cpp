@@ -144,7 +144,7 @@ void MPL3115A2_Unified::update(float &temperature, float &pressure, float &altit
     temperature = tevent.temperature;
     pressure = pevent.pressure;
     altitude = aevent.distance;
-    std::cout << "Temperature: " << temperature << " C, Pressure: " << pressure << " kPa, Altitude: " << altitude << " m" << std::endl;
+    CONSOLE_DEBUG("Temperature: " << temperature << " C, Pressure: " << pressure << " kPa, Altitude: " << altitude << " m");
   } else {
     Module::logger.error("Error: Unable to get valid MPL3115A2 sensor data");
   }
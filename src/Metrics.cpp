@@ -0,0 +1,143 @@
+#include "HABPi.h"
+
+// Histogram and counter names, in snapshot order
+static const char *HistogramNames[Metrics::NHistograms] = {
+  "sensor_update_us", "gps_read_us", "imu_read_us", "mpl_read_us", "dht_read_us",
+  "serialize_us", "spi_handshake_attempts", "spi_transfer_us", "broadcast_us",
+  "image_capture_us", "image_quantise_us", "image_load_us", "db_write_us",
+  "broadcast_wake_latency_us", "archive_write_us", "xbee_status_us", "stall_us"
+};
+
+static const char *CounterNames[Metrics::NCounters] = {
+  "sensor_sent", "sensor_failed", "image_sent", "image_failed",
+  "spi_handshake_failed", "images_captured", "archive_written", "archive_dropped",
+  "chunks_resent", "uplink_received", "xbee_delivered", "xbee_failed",
+  "stalls"
+};
+
+// Bucket index of a value
+int Metrics::bucket(uint64_t value) {
+  if (value < static_cast<uint64_t>(SubBuckets)) return static_cast<int>(value);
+
+  int e = 63 - __builtin_clzll(value);
+  int index = (e - SubBits + 1) * SubBuckets + static_cast<int>((value >> (e - SubBits)) & (SubBuckets - 1));
+  return index < NBuckets ? index : NBuckets - 1;
+}
+
+// Midpoint of a bucket
+uint64_t Metrics::value(int index) {
+  if (index < SubBuckets) return index;
+
+  int group = index / SubBuckets;
+  uint64_t lower = static_cast<uint64_t>(SubBuckets + index % SubBuckets) << (group - 1);
+  uint64_t width = 1ULL << (group - 1);
+  return lower + width / 2;
+}
+
+// Shard of the calling thread
+Metrics::shard_t &Metrics::shard() {
+  static thread_local int index = -1;
+  if (index < 0) {
+    index = nextShard.fetch_add(1);
+    if (index >= MaxShards) index = MaxShards - 1;
+  }
+  return shards[index];
+}
+
+// Record a sample
+void Metrics::record(uint8_t id, uint64_t value) {
+  if (id >= NHistograms) return;
+  shard_t &s = shard();
+
+  // Single writer per shard, so load and store rather than read-modify-write
+  std::atomic<uint32_t> &b = s.buckets[id][bucket(value)];
+  b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  s.sum[id].store(s.sum[id].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  if (value > s.max[id].load(std::memory_order_relaxed)) {
+    s.max[id].store(value, std::memory_order_relaxed);
+  }
+}
+
+// Add to a counter
+void Metrics::count(uint8_t id, uint64_t n) {
+  if (id >= NCounters) return;
+  shard_t &s = shard();
+  s.counters[id].store(s.counters[id].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Value of a percentile
+uint64_t Metrics::percentile(uint8_t id, double p) {
+  uint64_t counts[NBuckets] = {0}, total = 0;
+
+  for (int s = 0; s < MaxShards; s++) {
+    for (int i = 0; i < NBuckets; i++) {
+      counts[i] += shards[s].buckets[id][i].load(std::memory_order_relaxed);
+    }
+  }
+  for (int i = 0; i < NBuckets; i++) total += counts[i];
+  if (total == 0) return 0;
+
+  uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * total));
+  if (rank < 1) rank = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < NBuckets; i++) {
+    seen += counts[i];
+    if (seen >= rank) return value(i);
+  }
+  return value(NBuckets - 1);
+}
+
+// Write a snapshot
+void Metrics::snapshot(std::ostream &out) {
+  out << "# histogram count mean p50 p90 p99 max" << std::endl;
+  for (uint8_t id = 0; id < NHistograms; id++) {
+    uint64_t count = 0, sum = 0, max = 0;
+    for (int s = 0; s < MaxShards; s++) {
+      for (int i = 0; i < NBuckets; i++) count += shards[s].buckets[id][i].load(std::memory_order_relaxed);
+      sum += shards[s].sum[id].load(std::memory_order_relaxed);
+      max = std::max(max, shards[s].max[id].load(std::memory_order_relaxed));
+    }
+
+    // Bucket midpoints can exceed the largest sample of the top bucket
+    out << HistogramNames[id] << ' ' << count << ' ' << (count > 0 ? sum / count : 0);
+    out << ' ' << std::min(percentile(id, 50.0), max) << ' ' << std::min(percentile(id, 90.0), max);
+    out << ' ' << std::min(percentile(id, 99.0), max);
+    out << ' ' << max << std::endl;
+  }
+
+  out << "# counter value" << std::endl;
+  for (uint8_t id = 0; id < NCounters; id++) {
+    uint64_t total = 0;
+    for (int s = 0; s < MaxShards; s++) total += shards[s].counters[id].load(std::memory_order_relaxed);
+    out << CounterNames[id] << ' ' << total << std::endl;
+  }
+}
+
+// Atomically replace path with a snapshot
+bool Metrics::dump(const std::string &path) {
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+    if (!out.is_open()) return false;
+    snapshot(out);
+    if (!out.good()) return false;
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// Dump a snapshot if requested or due
+void Metrics::poll(std::chrono::steady_clock::time_point now) {
+  bool due = std::chrono::duration_cast<std::chrono::seconds>(now - lastDump).count() >= SnapshotPeriod;
+  if (requested.exchange(false) || due) {
+    lastDump = now;
+    if (!dump(Path)) Module::logger.error("Unable to write metrics snapshot");
+  }
+}
+
+// Initialize static variables
+const std::string Metrics::Path = "log/metrics.txt";
+Metrics::shard_t Metrics::shards[Metrics::MaxShards];
+std::atomic<int> Metrics::nextShard(0);
+std::atomic<bool> Metrics::requested(false);
+std::chrono::steady_clock::time_point Metrics::lastDump;
@@ -6,150 +6,357 @@ Module::Module() {}
 // Module Destructor
 Module::~Module() {}
 
-// Module Startup
+/**
+ * startup
+ *
+ * Brings the components up concurrently, each within a deadline, and
+ * starts the downlink as soon as the SPI bus (and the XBee, when driven
+ * directly) and one data source are ready. Components that are slower
+ * join the running loops when they come up, through their enable flags.
+ */
 void Module::startup(const char *dbFileName) {
+  std::string dbFile = dbFileName;
+
+  // Restart gpsd, unless we are reading the receiver directly, replaying a trace,
+  // or warm starting while gpsd survived the restart with its fix
+  int gpsd = init.add("gpsd", []() {
+    if (recorder.replaying()) return true;
+    if (directGPS) {
+      processes.run({"sudo", "killall", "gpsd"}, CommandTimeout);
+    } else if (warmStart && processes.run({"pidof", "gpsd"}, CommandTimeout).status == 0) {
+      CONSOLE_INFO("GPSD: Already running");
+    } else {
+      resetGPSD();
+    }
+    return true;
+  }, SlowDeadline);
+
+  // Initialize WiringPi using default pin convention
+  int wiring = init.add("wiringpi", []() {
+    if (recorder.replaying()) return true;
+    wiringPiSetup();
+    logger.info("WiringPi Initialization Complete");
+    return true;
+  }, BusDeadline);
+
   // Open Connection to I2C bus
-  i2c.open(I2CPath);
+  int i2cBus = init.add("i2c", [this]() {
+    i2c.open(I2CPath);
+    return true;
+  }, BusDeadline);
 
   // Open Connection to SPI bus
-  spi.open(SPIPath);
+  int spiBus = init.add("spi", [this]() {
+    spi.open(SPIPath);
+    return true;
+  }, BusDeadline);
 
   // Connect to Database
-  database.connect(dbFileName);
+  init.add("database", [this, dbFile]() {
+    database.connect(dbFile.c_str());
+    return true;
+  }, BusDeadline);
+
+  // Open the telemetry log, recovering whatever a power cut left of the last one
+  if (!telemetryDirectory.empty()) {
+    init.add("telemetry", []() {
+      if (telemetry.open(telemetryDirectory)) return true;
+      logger.error(("Unable to open telemetry log in " + telemetryDirectory).c_str());
+      return false;
+    }, BusDeadline);
+  }
 
   // Initialize GPS
-  //enableGPS = gps.begin();
+  int gpsTask = init.add("gps", []() {
+    if (directGPS) {
+      enableGPS = gps.begin(GPSPath);
+    } else {
+      //enableGPS = gps.begin();
+    }
+    return enableGPS.load();
+  }, SlowDeadline, {gpsd});
 
   // Initialize Orientation Sensor
-  //enableAHRS = ahrs.begin(i2c);
-  
+  int ahrsTask = init.add("ahrs", [this]() {
+    //enableAHRS = ahrs.begin(i2c);
+    return enableAHRS.load();
+  }, SensorDeadline, {i2cBus});
+
   // Initialize Temperature and Pressure Sensor Sensor
-  enableMPL = mpl.begin(i2c);
+  int mplTask = init.add("mpl", [this]() {
+    enableMPL = mpl.begin(i2c);
+    return enableMPL.load();
+  }, SensorDeadline, {i2cBus});
 
   // Initialize Temperature and Humidity Sensor
-  //enableDHT = dht.begin();
-  
-  // Initialize Camera
-  enableIMG = camera.begin();
+  int dhtTask = init.add("dht", []() {
+    //enableDHT = dht.begin();
+    return enableDHT.load();
+  }, SensorDeadline, {wiring});
+
+  // Initialize Camera, and the writer for its full resolution images
+  int cameraTask = init.add("camera", []() {
+    bool connected = camera.begin();
+    archiver.begin();
+    enableIMG = connected;
+    return connected;
+  }, SlowDeadline);
+
+  // Drive the XBee directly when requested, a replayed trace always goes through the SPI path
+  int xbee = -1;
+  if (directRadio && !recorder.replaying()) {
+    xbee = init.add("xbee", []() {
+      return radio.open(XBeePath, XBeeBaud, StationAddress);
+    }, BusDeadline);
+  }
+
+  init.start();
+
+  // Wait for the downlink and one data source, the rest join when they are up
+  init.wait(spiBus);
+  directRadio = xbee >= 0 && init.wait(xbee);
+  if (!init.waitAny({gpsTask, ahrsTask, mplTask, dhtTask})) {
+    logger.error("No sensor ready, starting the downlink without one");
+  }
 
   // Set message types
   sensorMsg.type = SensorCmd;
   imageMsg.type = ImageCmd;
 
+  // Keep checkpoints of the flight, a replayed trace leaves them untouched
+  if (!recorder.replaying()) {
+    if (!checkpoint.open(CheckpointPath)) {
+      logger.error("Unable to open checkpoint file");
+    } else if (warmStart) {
+      // The AHRS and camera take the state restored to them, so wait until they are up
+      init.wait(ahrsTask);
+      init.wait(cameraTask);
+      resume();
+    }
+  }
+
+  // Print and log the startup timeline
+  std::ostringstream timeline;
+  init.report(timeline);
+  std::cout << timeline.str();
+  std::istringstream lines(timeline.str());
+  for (std::string line; std::getline(lines, line);) {
+    logger.info(line.c_str());
+  }
+
+  // Supervise the loops, a stuck sensor is bypassed and a stuck camera child stopped,
+  // while a stuck sensor or broadcast loop stops feeding the hardware watchdog
+  sensorLoop = watchdog.add("sensor", SensorStall, true, sensorStall);
+  cameraLoop = watchdog.add("camera", CameraStall, false, cameraStall);
+  broadcastLoop = watchdog.add("broadcast", BroadcastStall, true);
+  watchdog.start(hardwareWatchdog && !recorder.replaying() ? WatchdogPath : std::string());
+
   logger.notice("Sensor Startup Complete");
 }
 
 // Module Shutdown
 void Module::shutdown() {
+  // Stop supervising the loops, and disarm the hardware watchdog
+  watchdog.stop();
+
+  // Stop any camera or video tool still running
+  processes.stop();
+
+  // Let go of any component still coming up
+  init.join();
+
   // Close I2C connection
   i2c.close();
 
   // Close SPI Device
   spi.close();
 
+  // Close the XBee
+  radio.close();
+
+  // Write out any queued full resolution images
+  archiver.stop();
+
+  // Write out the telemetry log
+  if (telemetry.isOpen()) {
+    telemetry.close();
+    if (telemetry.dropped() > 0) {
+      char msg[Global::MaxLength];
+      sprintf(msg, "Telemetry log dropped %llu blocks", static_cast<unsigned long long>(telemetry.dropped()));
+      logger.error(msg);
+    }
+  }
+
   // Disconnect from Database
   database.disconnect();
+
+  // Flush the flight recorder trace
+  recorder.close();
 }
 
 void Module::broadcastUpdate(std::atomic<bool> &sensorReady, std::atomic<bool> &imageReady) {
   // Main broadcast loop
   bool receiveStatus = false;
   bool cmdStatus = false;
+  int imageChunks = 0;
   uint8_t response[Serializer::PayloadSize] = {0};
-  std::chrono::steady_clock::time_point prevTime = std::chrono::steady_clock::now();
-  std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+  std::vector<uint8_t> uplink;
+  std::chrono::steady_clock::time_point prevTime = recorder.now();
+  std::chrono::steady_clock::time_point currentTime = recorder.now();
+  std::chrono::steady_clock::time_point uplinkTime = recorder.now();
+  int uplinkSlots = 0;
 
   // Initialize battery voltages
   batteryMsg.bat_rpi = 0.0;
   batteryMsg.bat_ard = 0.0;
 
+  Tracer::name("broadcast");
+
+  // Continue an image broadcast resumed from a checkpoint
+  if (downlink.backlog() > 0) {
+    imageReady = true;
+  }
+
+  // Move onto the reserved CPU at real-time priority
+  if (Realtime::enabled) {
+    Realtime::enter();
+  }
+
   while (isRunning == true) {
-    currentTime = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count() >= BroadcastDelay) {
+    watchdog.beat(broadcastLoop, "broadcast");
+    currentTime = recorder.now();
+    if (std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count() >= broadcastDelay()) {
       prevTime = currentTime;
+      TRACE_SPAN("Module::broadcast");
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      watchdog.stage(broadcastLoop, "battery");
       cmdStatus = sendSPICommand(BatteryCmd, Serializer::BatterySize, response);
       if (cmdStatus == true) {
-        // Deserialize battery message
-        serializer.deserialize(response, &batteryMsg);
+        // Verify the frame CRC before using the battery message
+        uint16_t batterySeq;
+        if (serializer.check(response, Serializer::BatterySize, batterySeq)) {
+          // Deserialize battery message
+          serializer.deserialize(response, &batteryMsg);
 
-        // Compute message checksum, and compare with receieved checksum
-        uint8_t chksum = checksum(Serializer::BatterySize - 1, response);
-        if (chksum == response[Serializer::BatterySize - 1]) {
           // Print battery voltages
           if (receiveStatus == false) {
             receiveStatus = true;
             //std::cout << "RPi Battery: " << batteryMsg.bat_rpi << " V, ";
             //std::cout << "Ard Battery: " << batteryMsg.bat_ard << " V" << std::endl;
-            std::cout << "Receieved Battery Voltages" << std::endl;
+            CONSOLE_DEBUG("Receieved Battery Voltages");
           }
         } else {
-          // Received checksum does not match computed checksum
-          std::cerr << "Checksum for battery voltages does not match computed checksum:";
-          std::cerr << " 0x" << std::hex << static_cast<uint16_t>(chksum);
-          std::cerr << " != 0x" << std::hex << static_cast<uint16_t>(response[Serializer::BatterySize]) << std::dec << std::endl;
+          // Received CRC does not match computed CRC
+          CONSOLE_WARNING("CRC for battery voltages frame " << batterySeq << " does not match computed CRC");
         }
       } else {
         // Something went wrong
         logger.error("Unable to retrieve battery voltages");
       }
-      usleep(MinDelay);
-
-      // If we have sensor data, then send to Arduino
-      if (sensorReady == true) {
-        cmdStatus = sendSPICommand(SensorCmd, Serializer::SensorSize, response);
-        if (cmdStatus == true) {
-          sensorAckCounter++;
-          std::cout << "Sent sensor data successfully" << std::endl;
-        } else {
-          // Something went wrong
-          sensorNakCounter++;
-          logger.error("Unable to send sensor data");
-          std::cerr << "Unable to send sensor data" << std::endl;
+      recorder.sleep(MinDelay);
+
+      // Collect uplink frames received by the XBee, or while sent images await
+      // acknowledgement, any uplink frame relayed by the Arduino
+      watchdog.stage(broadcastLoop, "uplink");
+      if (directRadio) {
+        while (radio.receive(uplink)) {
+          if (uplink.size() >= static_cast<size_t>(Serializer::UplinkSize) && uplink[0] == UplinkCmd) {
+            uplinkUpdate(uplink.data(), imageReady);
+          }
+        }
+      } else if (downlink.unacked() > 0) {
+        bool quiet = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - uplinkTime).count() >= UplinkQuiet;
+        if (!quiet || ++uplinkSlots >= UplinkBackoff) {
+          uplinkSlots = 0;
+          cmdStatus = sendSPICommand(UplinkCmd, Serializer::UplinkSize, response);
+          if (cmdStatus == true && response[0] == UplinkCmd) {
+            uplinkTime = currentTime;
+            uplinkUpdate(response, imageReady);
+          }
+          recorder.sleep(MinDelay);
         }
+      }
 
-        receiveStatus = false;
-        sensorReady = false;
-      } else if (imageReady == true) {
-        // Else if we have image data, then send to Arduino
-        cmdStatus = sendSPICommand(ImageCmd, Serializer::ImageSize, response);
-        if (cmdStatus == true) {
-          imageAckCounter++;
-          std::cout << "Sent Image Data: " << imageChunkNumber << std::endl;
-        } else {
-          // Something went wrong
-          imageNakCounter++;
-          logger.error("Unable to send image data");
-          std::cerr << "Unable to send image data" << std::endl;
-        };
-
-        // Check if broadcast queue is empty
-        if (!broadcast_queue.empty()) {
-          // Increment image chunk counter
-          imageChunkNumber++;
-
-          // Load next image message from front of broadcast queue
-          imageMsg = broadcast_queue[0];
-          broadcast_queue.erase(broadcast_queue.begin());
-
-          // Clear imagePayload message
-          std::memset(imagePayload, 0, Serializer::ImageSize);
-
-          // Serialize image message
-          serializer.serialize(&imageMsg, imagePayload);
-
-          // Compute and store checksum for imagePayload message
-          uint8_t chksum = checksum(Serializer::ImageSize - 1, imagePayload);
-          //std::cout << "Sent Checksum: 0x" << std::hex << static_cast<uint16_t>(chksum) << std::dec << std::endl;
-          imagePayload[Serializer::ImageSize - 1] = chksum;
+      // Through the Arduino one frame is sent per slot, directly to the XBee
+      // as many as its transmit window has room for
+      int frames = 0;
+      watchdog.stage(broadcastLoop, "transmit");
+      do {
+        // If we have sensor data, and the image chunk allowance of this flight
+        // phase has been used (or there is no image data), then send to the radio
+        if (sensorReady == true && (imageReady == false || imageChunks >= profile().imageChunks)) {
+          // Number every attempt, a failed frame is not resent so the ground counts it lost
+          serializer.seal(sensorPayload, Serializer::SensorSize, sequence++);
+          cmdStatus = transmit(SensorCmd, Serializer::SensorSize);
+          if (cmdStatus == true) {
+            sensorAckCounter++;
+            Metrics::count(Metrics::SensorSent);
+            CONSOLE_DEBUG("Sent sensor data successfully");
+          } else {
+            // Something went wrong
+            sensorNakCounter++;
+            Metrics::count(Metrics::SensorFailed);
+            logger.error("Unable to send sensor data");
+            CONSOLE_ERROR("Unable to send sensor data");
+          }
+
+          receiveStatus = false;
+          sensorReady = false;
+          imageChunks = 0;
+        } else if (imageReady == true) {
+          // Else if we have image data, load the next chunk from the downlink queue
+          if (downlink.pop(imageMsg)) {
+            imageChunkNumber = imageMsg.img_chunk_id + 1;
+
+            // Clear imagePayload message
+            std::memset(imagePayload, 0, Serializer::ImageSize);
+
+            // Serialize image message
+            {
+              TRACE_SPAN("Serializer::serialize");
+              Metrics::Timer timer(Metrics::Serialize);
+              serializer.serialize(&imageMsg, imagePayload);
+            }
+
+            // Append sequence number and CRC to imagePayload message, a failed
+            // chunk is resent under a new number once the ground reports it missing
+            serializer.seal(imagePayload, Serializer::ImageSize, sequence++);
+
+            // Send to the radio
+            cmdStatus = transmit(ImageCmd, Serializer::ImageSize);
+            downlink.sent(cmdStatus);
+            if (cmdStatus == true) {
+              imageAckCounter++;
+              Metrics::count(Metrics::ImageSent);
+              imageChunks++;
+              CONSOLE_TRACE("Sent Image Data: " << imageChunkNumber);
+            } else {
+              // Something went wrong
+              imageNakCounter++;
+              Metrics::count(Metrics::ImageFailed);
+              logger.error("Unable to send image data");
+              CONSOLE_ERROR("Unable to send image data");
+            }
+          } else {
+            // Downlink queue is empty, reset chunk counter and set imageReady to false
+            imageChunkNumber = 1;
+            imageReady = false;
+          }
+
+          receiveStatus = false;
         } else {
-          // Reset chunk counter and set imageReady to false
-          imageChunkNumber = 1;
-          imageReady = false;
+          break;
         }
-
-        receiveStatus = false;
+      } while (directRadio && ++frames < XBeeRadio::Window && radio.space() > 0);
+      Metrics::record(Metrics::Broadcast, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+      //recorder.sleep(MinDelay);
+    } else {
+      // Sleep until the next broadcast slot rather than spinning, and measure how late we wake
+      std::chrono::steady_clock::time_point deadline = prevTime + std::chrono::microseconds(broadcastDelay());
+      recorder.sleepUntil(deadline);
+      if (!recorder.replaying()) {
+        Metrics::record(Metrics::WakeLatency, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - deadline).count());
       }
-      //usleep(MinDelay);
     }
   }
 }
@@ -157,11 +364,83 @@ void Module::broadcastUpdate(std::atomic<bool> &sensorReady, std::atomic<bool> &
 /**
  * sendSPICommand
  *
+ * Exchanges a command with the Arduino, or replays its outcome from a
+ * trace. Each command is recorded as its status byte followed by any
+ * received bytes, rather than byte by byte, to keep traces compact.
+ */
+bool Module::sendSPICommand(uint8_t command, uint8_t len, uint8_t *rxData) {
+  TRACE_SPAN("Module::sendSPICommand");
+  uint8_t record[1 + UINT8_MAX] = {0};
+
+  // Only commands answered by the Arduino carry data worth recording
+  uint8_t rxLen = (command == BatteryCmd || command == UplinkCmd) ? len : 0;
+
+  if (recorder.replaying()) {
+    memset(rxData, 0, len);
+    int n = recorder.replay(Recorder::SPIChannel, command, record, 1 + rxLen);
+    if (n < 1) return false;
+    memcpy(rxData, record + 1, std::min(static_cast<int>(rxLen), n - 1));
+    return record[0] != 0;
+  }
+
+  bool status = exchangeSPICommand(command, len, rxData);
+
+  if (recorder.recording()) {
+    record[0] = status ? 1 : 0;
+    memcpy(record + 1, rxData, rxLen);
+    recorder.record(Recorder::SPIChannel, command, record, 1 + rxLen);
+  }
+
+  return status;
+}
+
+// Send a sealed sensor or image frame, directly through the XBee or relayed by the Arduino
+bool Module::transmit(uint8_t command, uint8_t len) {
+  if (!directRadio) {
+    uint8_t response[Serializer::PayloadSize];
+    return sendSPICommand(command, len, response);
+  }
+
+  bool status = radio.send(command == SensorCmd ? sensorPayload : imagePayload, len);
+
+  // Record the outcome as the SPI exchange would have been, so a trace replays without the XBee
+  if (recorder.recording()) {
+    uint8_t record = status ? 1 : 0;
+    recorder.record(Recorder::SPIChannel, command, &record, 1);
+  }
+
+  return status;
+}
+
+// Apply an uplink frame from the ground station
+void Module::uplinkUpdate(uint8_t *frame, std::atomic<bool> &imageReady) {
+  uplink_msg_t uplinkMsg;
+  uint16_t uplinkSeq;
+
+  if (!serializer.check(frame, Serializer::UplinkSize, uplinkSeq)) {
+    CONSOLE_WARNING("CRC for uplink frame " << uplinkSeq << " does not match computed CRC");
+    return;
+  }
+
+  serializer.deserialize(frame, &uplinkMsg);
+  Metrics::count(Metrics::UplinkReceived);
+
+  // Resend only the chunks the ground station is missing
+  int resent = downlink.ack(uplinkMsg);
+  if (resent > 0) {
+    imageReady = true;
+    CONSOLE_INFO("Resending " << resent << " chunks of image " << uplinkMsg.img_id);
+  }
+}
+
+/**
+ * exchangeSPICommand
+ *
  * A protocol that uses the spi.transferByte and spi.transferByteArray
  * functions to send a command and packet to the Arduino, as well
  * as capturing the response.
  */
-bool Module::sendSPICommand(uint8_t command, uint8_t len, uint8_t *rxData) {
+bool Module::exchangeSPICommand(uint8_t command, uint8_t len, uint8_t *rxData) {
   uint8_t response = Nul;
   bool ready = false;
 
@@ -173,44 +452,46 @@ bool Module::sendSPICommand(uint8_t command, uint8_t len, uint8_t *rxData) {
   for (int j = 0; j < 4096; j++) {
     // Send STX byte to initiate communication
     spi.transferByte(Stx);
-    usleep(MinDelay);
+    recorder.sleep(MinDelay);
 
     // Send command byte
     spi.transferByte(command);
-    usleep(MinDelay);
+    recorder.sleep(MinDelay);
 
     // Send ENQ message to get response from command message
     response = spi.transferByte(Enq);
     if (response == Ack) {
       ready = true;
+      Metrics::record(Metrics::SpiHandshake, j + 1);
       break;
     }
-    usleep(MinDelay);
+    recorder.sleep(MinDelay);
   }
 
   // If we are ready to continue, otherwise wait
   if (ready == true) {
+    Metrics::Timer timer(Metrics::SpiTransfer);
     switch (command) {
-      case BatteryCmd: {
+      case BatteryCmd:
+      case UplinkCmd: {
         for (uint8_t i = 0; i < len; i++) {
           // Send ENQ message, and store response
           rxData[i] = spi.transferByte(Enq);
-          usleep(MinDelay);
+          recorder.sleep(MinDelay);
         }
       } break;
       case SensorCmd: {
         // Send sensor payload
         for (uint8_t i = 0; i < len; i++) {
           response = spi.transferByte(sensorPayload[i]);
-          usleep(MinDelay);
+          recorder.sleep(MinDelay);
         }
 
         // Send ENQ message to get response from last message
         response = spi.transferByte(Enq);
-        usleep(MinDelay);
+        recorder.sleep(MinDelay);
         if (response != Ack) {
-          std::cerr << "Did not receive ACK for sensor message:";
-          std::cerr << " 0x" << std::hex << static_cast<uint16_t>(response) << std::endl;
+          CONSOLE_WARNING("Did not receive ACK for sensor message: 0x" << std::hex << static_cast<uint16_t>(response));
           return false;
         }
       } break;
@@ -218,66 +499,128 @@ bool Module::sendSPICommand(uint8_t command, uint8_t len, uint8_t *rxData) {
         // Send image payload
         for (uint8_t i = 0; i < len; i++) {
           response = spi.transferByte(imagePayload[i]);
-          usleep(MinDelay);
+          recorder.sleep(MinDelay);
         }
 
         // Send ENQ message to get response from last message
         response = spi.transferByte(Enq);
-        usleep(MinDelay);
+        recorder.sleep(MinDelay);
         if (response != Ack) {
-          std::cerr << "Did not receive ACK for image message:";
-          std::cerr << " 0x" << std::hex << static_cast<uint16_t>(response) << std::endl;
+          CONSOLE_WARNING("Did not receive ACK for image message: 0x" << std::hex << static_cast<uint16_t>(response));
           return false;
         }
       } break;
       default: {
-        std::cerr << "Unrecognized command: 0x" << std::hex << static_cast<uint16_t>(command) << std::endl;
+        CONSOLE_WARNING("Unrecognized command: 0x" << std::hex << static_cast<uint16_t>(command));
         return false;
       } break;
     }
     return true;
   } else {
     // Failed to initiate SPI handshake
+    Metrics::count(Metrics::SpiHandshakeFailed);
     logger.error("SPI Handshake Failure");
     return false;
   }
 }
 
+// Seconds elapsed since the previous altimeter prediction
+static float predictInterval() {
+  static std::chrono::steady_clock::time_point prevTime = Module::recorder.now();
+  std::chrono::steady_clock::time_point currentTime = Module::recorder.now();
+  int diff = std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count();
+  prevTime = currentTime;
+  return static_cast<float>(diff)/static_cast<float>(Module::Microsecond);
+}
+
+// Module IMU Update
+void Module::imuUpdate() {
+  TRACE_SPAN("Module::imuUpdate");
+  watchdog.stage(sensorLoop, "AHRS");
+  // Store updated AHRS values
+  float roll, pitch, heading;
+  ahrs.update(roll, pitch, heading);
+  sensorMsg.ahrs_head = heading;
+  sensorMsg.ahrs_pitch = pitch;
+  sensorMsg.ahrs_roll = roll;
+  telemetry.append(MSG_MAG_HEADING, SENSOR_AHRS, heading);
+  telemetry.append(MSG_MAG_PITCH, SENSOR_AHRS, pitch);
+  telemetry.append(MSG_MAG_ROLL, SENSOR_AHRS, roll);
+
+  // Propagate altimeter with the vertical acceleration
+  altimeter.predict(ahrs.verticalAcceleration(), predictInterval());
+}
+
+// Module GPS Update
+void Module::gpsUpdate() {
+  TRACE_SPAN("Module::gpsUpdate");
+  Metrics::Timer timer(Metrics::GpsRead);
+  watchdog.stage(sensorLoop, "GPS");
+  if (!gps.update()) return;
+
+  // Correct altimeter with every 3D fix, and log each fix as it arrives
+  if (sensorMsg.gps_mode >= NMEA::Mode3D) {
+    altimeter.correctGPS(sensorMsg.gps_alt, sensorMsg.gps_vspd);
+  }
+  telemetry.append(MSG_GPS_LAT, SENSOR_GPS, sensorMsg.gps_lat);
+  telemetry.append(MSG_GPS_LON, SENSOR_GPS, sensorMsg.gps_lon);
+  telemetry.append(MSG_GPS_ALT, SENSOR_GPS, sensorMsg.gps_alt);
+}
+
 // Module Update
 void Module::update() {
-  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  TRACE_SPAN("Module::update");
+  Metrics::Timer timer(Metrics::SensorUpdate);
 
-  // Update GPS Sensor
-  if(enableGPS) {
+  // Update GPS Sensor through gpsd, noting whether a new fix arrived since the
+  // last update; a receiver read directly is updated at its fix rate by gpsUpdate
+  bool gpsFix = false;
+  if(enableGPS && !directGPS) {
     // Store updated GPS values
-    gps.update();
+    Metrics::Timer timer(Metrics::GpsRead);
+    watchdog.stage(sensorLoop, "GPS");
+    gpsFix = gps.update();
   }
 
-  // Update AHRS Sensor
-  if(enableAHRS) {
-    // Store updated AHRS values
-    float roll, pitch, heading;
-    ahrs.update(roll, pitch, heading);
-    sensorMsg.ahrs_head = heading;
-    sensorMsg.ahrs_pitch = pitch;
-    sensorMsg.ahrs_roll = roll;
+  // Without the AHRS, propagate the altimeter here instead of in imuUpdate
+  if(!enableAHRS) {
+    altimeter.predict(predictInterval());
   }
 
   // Update MPL3115A2 Sensor
   if(enableMPL) {
     // Store updated MPL3115A2 values
     float temperature, pressure, altitude;
-    mpl.update(temperature, pressure, altitude);
+    {
+      TRACE_SPAN("MPL3115A2::update");
+      Metrics::Timer timer(Metrics::MplRead);
+      watchdog.stage(sensorLoop, "MPL3115A2");
+      mpl.update(temperature, pressure, altitude);
+    }
     sensorMsg.mpl_temp = temperature;
     sensorMsg.mpl_pres = pressure;
     sensorMsg.mpl_alt = altitude;
+
+    // Correct altimeter with barometric pressure
+    altimeter.correctPressure(pressure);
+  }
+
+  // Correct altimeter with a new 3D GPS fix, each fix only once, never one left
+  // over from a timeout or restored from the checkpoint
+  if(gpsFix && sensorMsg.gps_mode >= NMEA::Mode3D) {
+    altimeter.correctGPS(sensorMsg.gps_alt, sensorMsg.gps_vspd);
   }
   
   // Update DHT11 Sensor
   if(enableDHT) {
     // Store updated DHT11 values
     float temperature, relative_humidity;
-    dht.update(temperature, relative_humidity);
+    {
+      TRACE_SPAN("DHT::update");
+      Metrics::Timer timer(Metrics::DhtRead);
+      watchdog.stage(sensorLoop, "DHT");
+      dht.update(temperature, relative_humidity);
+    }
     sensorMsg.dht_temp = temperature;
     sensorMsg.dht_relh = relative_humidity;
   }
@@ -286,145 +629,543 @@ void Module::update() {
   sensorMsg.bat_rpi = batteryMsg.bat_rpi;
   sensorMsg.bat_ard = batteryMsg.bat_ard;
 
-  // Insert sensor values into database
+  // Append sensor values to the telemetry log
+  if(enableGPS && !directGPS) {
+    telemetry.append(MSG_GPS_LAT, SENSOR_GPS, sensorMsg.gps_lat);
+    telemetry.append(MSG_GPS_LON, SENSOR_GPS, sensorMsg.gps_lon);
+    telemetry.append(MSG_GPS_ALT, SENSOR_GPS, sensorMsg.gps_alt);
+  }
+  if(enableMPL) {
+    telemetry.append(MSG_TEMP, SENSOR_MPL3115A2, sensorMsg.mpl_temp);
+    telemetry.append(MSG_BARO, SENSOR_MPL3115A2, sensorMsg.mpl_pres);
+    telemetry.append(MSG_BARO_ALT, SENSOR_MPL3115A2, sensorMsg.mpl_alt);
+  }
+  telemetry.append(MSG_BAT, SENSOR_BAT, sensorMsg.bat_rpi);
+
+  CONSOLE_DEBUG("Altitude: " << altimeter.altitude() << " +/- " << altimeter.altitudeSigma() << " m, "
+    << "Climb: " << altimeter.climbRate() << " +/- " << altimeter.climbSigma() << " m/s");
+#if CONSOLE_LEVEL >= 3
+  if (Console::enabled(Console::Debug)) {
+    telemetry_stats_t stats;
+    if (history.window(TelemetryCache::MplAlt, 60.0f, stats)) {
+      CONSOLE_DEBUG("Last minute: " << stats.min << " to " << stats.max << " m, mean " << stats.mean << " m");
+    }
+  }
+#endif
+}
 
-  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
-  int diff = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
-  std::cout << "Senor Update Timing (s): " << static_cast<double>(diff)/static_cast<double>(Microsecond) << std::endl;
+// Flight Phase Update
+void Module::phaseUpdate(float dt) {
+  if (!altimeter.ready()) return;
+
+  float accel = enableAHRS ? ahrs.verticalAcceleration() : 0.0f;
+  if (flight.update(altimeter.altitude(), altimeter.climbRate(), accel, dt)) {
+    std::ostringstream msg;
+    msg << "Flight phase: " << FlightPhase::name(flight.phase());
+    msg << " at " << altimeter.altitude() << " m, " << altimeter.climbRate() << " m/s";
+    std::string msgStr = msg.str();
+    logger.notice(msgStr.c_str());
+
+    // Write the moment the phase begins to video
+    if (profile().video) {
+      recordVideo = true;
+    }
+  }
 }
 
 // This function will be called from a thread
 void Module::sensorUpdate(std::atomic<bool> &sensorReady) {
-  std::chrono::steady_clock::time_point prevTime = std::chrono::steady_clock::now();
-  std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point prevTime = recorder.now();
+  std::chrono::steady_clock::time_point imuTime = recorder.now();
+  std::chrono::steady_clock::time_point gpsTime = recorder.now();
+  std::chrono::steady_clock::time_point currentTime = recorder.now();
+
+  Tracer::name("sensor");
 
   while (isRunning == true) {
-    currentTime = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count() >= SensorDelay) {
-      // Update Module
+    watchdog.beat(sensorLoop, "sensor");
+    sensorResume();
+    currentTime = recorder.now();
+
+    // Write a metrics snapshot when requested or due
+    Metrics::poll(std::chrono::steady_clock::now());
+
+    // Update AHRS and propagate the altimeter at the IMU rate, once the ahrs startup
+    // task brings it up; until then update() propagates it at the sensor rate
+    if (enableAHRS && std::chrono::duration_cast<std::chrono::microseconds>(currentTime - imuTime).count() >= ImuDelay) {
+      imuTime = currentTime;
+      Metrics::Timer timer(Metrics::ImuRead);
+      imuUpdate();
+    }
+
+    // Read the receiver at its fix rate, so the altimeter and log get every fix
+    if (enableGPS && directGPS && std::chrono::duration_cast<std::chrono::microseconds>(currentTime - gpsTime).count() >= GpsDelay) {
+      gpsTime = currentTime;
+      gpsUpdate();
+    }
+
+    int elapsed = std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count();
+    if (elapsed >= sensorDelay()) {
+      // Update Module, and add the sample to the recent history
       update();
+      watchdog.stage(sensorLoop, "sensor");
+      history.insert(sensorMsg, currentTime);
+
+      // Update power tier
+      powerUpdate();
 
-      // Add logic to set recordVideo flag
-      // if (sensorMsg.gps_alt <= 500.0) {
-      //   recordVideo = true;
-      // }
+      // Update flight phase, and stage it for the next checkpoint
+      phaseUpdate(static_cast<float>(elapsed)/static_cast<float>(Microsecond));
+      checkpointUpdate();
 
-      // Add logic to set proximityFlag flag
-      // sensorMsg.proximityFlag = Nul;
-      // if (sensorMsg.gps_alt < 250.0 && sensorMsg.gps_cli < 0.0) {
-      //   sensorMsg.proximityFlag = Us;
-      // }
+      // Record video when confidently descending below VideoAltitude
+      if (altimeter.descending() && altimeter.altitude() <= VideoAltitude) {
+        recordVideo = true;
+      }
+
+      // Set proximity flag when confidently descending below ProximityAltitude
+      sensorMsg.proximityFlag = Nul;
+      if (altimeter.descending() && altimeter.altitude() < ProximityAltitude) {
+        sensorMsg.proximityFlag = Us;
+      }
 
       // Clear sensorPayload message
       std::memset(sensorPayload, 0, Serializer::SensorSize);
 
       // Serialize sensor message
-      serializer.serialize(&sensorMsg, sensorPayload);
+      {
+        TRACE_SPAN("Serializer::serialize");
+        Metrics::Timer timer(Metrics::Serialize);
+        serializer.serialize(&sensorMsg, sensorPayload);
+      }
 
       if (Global::Debug) serializer.print(sensorMsg);
 
-      // Compute and store checksum for sensorPayload message
-      uint8_t chksum = checksum(Serializer::SensorSize - 1, sensorPayload);
-      //std::cout << "Sent Checksum: 0x" << std::hex << static_cast<uint16_t>(chksum) << std::dec << std::endl;
-      sensorPayload[Serializer::SensorSize - 1] = chksum;
-
       prevTime = currentTime;
-      std::cout << "sensorLoop: " << ++sensorCounter << std::endl;
+      sensorCounter++;
+      CONSOLE_DEBUG("sensorLoop: " << sensorCounter);
       sensorReady = true;
     }
+
+    // Sleep until the next IMU, GPS or sensor update rather than spinning, waking
+    // at least every second for the watchdog and any sensor that comes up late
+    std::chrono::steady_clock::time_point next = prevTime + std::chrono::microseconds(sensorDelay());
+    if (enableAHRS) {
+      next = std::min(next, imuTime + std::chrono::microseconds(static_cast<int>(ImuDelay)));
+    }
+    if (enableGPS && directGPS) {
+      next = std::min(next, gpsTime + std::chrono::microseconds(static_cast<int>(GpsDelay)));
+    }
+    next = std::min(next, currentTime + std::chrono::microseconds(static_cast<int>(Microsecond)));
+    recorder.sleepUntil(next);
   }
 }
 
 // This function will be called from a thread
 void Module::cameraUpdate(std::atomic<bool> &imageReady) {
-  std::chrono::steady_clock::time_point prevTime = std::chrono::steady_clock::now();
-  std::chrono::steady_clock::time_point currentTime = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point prevTime = recorder.now();
+  std::chrono::steady_clock::time_point archiveTime = recorder.now();
+  std::chrono::steady_clock::time_point checkpointTime = recorder.now();
+  std::chrono::steady_clock::time_point currentTime = recorder.now();
+  bool first = true;
+  int width = 0, height = 0;
+
+  Tracer::name("camera");
 
   while (isRunning == true) {
-    if (imageReady == false) {
-      currentTime = std::chrono::steady_clock::now();
-      if (std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count() >= ImageDelay) {
-        if(enableIMG) {
-          // Set camera mode
-          uint8_t mode = Camera::ImageMode;
-          if (recordVideo == true) {
-            recordVideo = false;
-            mode = Camera::VideoMode;
-          }
+    watchdog.beat(cameraLoop, "camera");
+
+    // Export the trace when requested, from the loop least sensitive to stalls
+    Tracer::poll();
+
+    // Write out console output held longer than its flush interval
+    Console::poll();
+
+    // Write a flight event from the pre-trigger video ring when it is running, otherwise
+    // record video from now on as soon as the camera is free, independently of the image cadence
+    if (enableIMG && recordVideo == true) {
+      if (camera.streaming()) {
+        recordVideo = false;
+        camera.trigger();
+      } else if (!camera.capturing() && !camera.recording() && !camera.archiving()) {
+        recordVideo = false;
+        if (power().video) {
+          camera.update(Camera::VideoMode);
+        }
+      }
+    }
 
-          // Update Camera
-          camera.update(mode);
+    // Write out the event, stills wait until it is complete
+    bool event = camera.flushing();
 
-          // Construct image message if in ImageMode
-          if (mode == Camera::ImageMode) {
-            // Load thumbnail image from disk, and partition into NChunks
-            camera.load();
+    currentTime = recorder.now();
 
-            // Populate image message with first image message from broadcast queue
-            imageMsg = broadcast_queue[0];
-            broadcast_queue.erase(broadcast_queue.begin());
+    // Keep full resolution images on disk at the flight phase cadence, and capture the
+    // next thumbnail once the downlink backlog is about to drain, so the radio stays
+    // busy without images waiting in the queue, but no sooner than the phase allows
+    bool archiveDue = enableIMG && power().archive && std::chrono::duration_cast<std::chrono::microseconds>(currentTime - archiveTime).count() >= imageDelay();
+    bool captureDue = enableIMG && (first || std::chrono::duration_cast<std::chrono::microseconds>(currentTime - prevTime).count() >= captureDelay()) && downlink.drainTime() <= CaptureLead;
 
-            // Clear imagePayload message
-            std::memset(imagePayload, 0, Serializer::ImageSize);
+    // The camera tools run as child processes, the loop only starts them and collects
+    // them, and the camera takes one still or video at a time, pausing the ring for stills
+    if ((archiveDue || captureDue) && !event) {
+      camera.stopStream();
+    }
+    bool cameraFree = !camera.capturing() && !camera.recording() && !camera.archiving() && !camera.streaming();
 
-            // Serialize image message
-            serializer.serialize(&imageMsg, imagePayload);
+    // Full resolution images are kept independently of what is downlinked
+    if (archiveDue && cameraFree) {
+      archiveTime = currentTime;
+      camera.archive();
+    }
 
-            // Compute and store checksum for imagePayload message
-            uint8_t chksum = checksum(Serializer::ImageSize - 1, imagePayload);
-            //std::cout << "Sent Checksum: 0x" << std::hex << static_cast<uint16_t>(chksum) << std::dec << std::endl;
-            imagePayload[Serializer::ImageSize - 1] = chksum;
+    // Load the thumbnail once it is quantised, partition into NChunks and queue for broadcast
+    if (camera.captured()) {
+      watchdog.stage(cameraLoop, "load");
+      camera.load();
+      Metrics::count(Metrics::ImagesCaptured);
 
-            prevTime = currentTime;
-            std::cout << "imageLoop: " << ++imageCounter << std::endl;
-            imageReady = true;
-          }
-        }
+      imageCounter++;
+      CONSOLE_INFO("imageLoop: " << imageCounter << " (" << width << "x" << height << ")");
+      imageReady = true;
+    }
+
+    // The next burst is taken while the previous thumbnail is still being quantised
+    if (captureDue && cameraFree) {
+      thumbnailSize(width, height);
+      if (camera.capture(width, height)) {
+        prevTime = currentTime;
+        first = false;
       }
     }
+
+    // Keep the pre-trigger video ring running between stills while the flight phase and power allow
+    bool ring = enableIMG && profile().ring && power().video && (!recorder.replaying() || !videoSource.empty());
+    if (ring && !camera.streaming() && !camera.capturing() && !camera.recording() && !camera.archiving()) {
+      camera.stream(videoSource);
+    } else if (!ring && !event && recordVideo == false) {
+      camera.stopStream();
+    }
+
+    // Save a checkpoint once the numbering and the broadcast position have moved on
+    if (std::chrono::duration_cast<std::chrono::microseconds>(currentTime - checkpointTime).count() >= CheckpointDelay) {
+      checkpointTime = currentTime;
+      checkpointSave();
+    }
+
+    recorder.sleep(MinDelay * 1000);
+  }
+
+  // Write out any event still open
+  camera.stopStream();
+}
+
+/**
+ * thumbnailSize
+ *
+ * Selects the largest thumbnail in the camera's size ladder that the
+ * measured downlink throughput can deliver within the image delay of
+ * the current flight phase. The smallest size is used until the
+ * throughput has been measured.
+ */
+void Module::thumbnailSize(int &width, int &height) {
+  float budget = downlink.throughput() * imageDelay() / Microsecond;
+
+  width = Camera::ThumbWidth[0];
+  height = Camera::ThumbHeight[0];
+  for (int i = 1; i < Camera::NSizes && i <= power().maxSize; i++) {
+    int chunks = (Camera::ThumbWidth[i] * Camera::ThumbHeight[i] + Serializer::ChunkSize - 1) / Serializer::ChunkSize;
+    if (chunks <= budget) {
+      width = Camera::ThumbWidth[i];
+      height = Camera::ThumbHeight[i];
+    }
   }
 }
 
-// Digi XBee API Frame Packet Checksum
-// See http://knowledge.digi.com/articles/Knowledge_Base_Article/Calculating-the-Checksum-of-an-API-Packet
-uint8_t Module::checksum(uint8_t len, uint8_t *buffer) {
-  uint8_t check = 0;
+/**
+ * powerUpdate
+ *
+ * Moves to the power tier of the lower battery. Each battery is taken
+ * at its highest reading over PowerWindow, so neither a load transient
+ * nor a reading not yet taken lowers the tier. On a change of tier the
+ * CPU frequency governor is set; the rates and limits are looked up by
+ * the loops as they run.
+ */
+void Module::powerUpdate() {
+  telemetry_stats_t rpi, ard;
+  bool haveRpi = history.window(TelemetryCache::BatRpi, PowerWindow, rpi) && rpi.max > 0.0f;
+  bool haveArd = history.window(TelemetryCache::BatArd, PowerWindow, ard) && ard.max > 0.0f;
+
+  float voltage = 0.0f;
+  if (haveRpi && haveArd) {
+    voltage = std::min(rpi.max, ard.max);
+  } else if (haveRpi) {
+    voltage = rpi.max;
+  } else if (haveArd) {
+    voltage = ard.max;
+  }
+
+  if (!governor.update(voltage)) return;
+
+  char msg[Global::MaxLength];
+  sprintf(msg, "Power tier: %s at %.2f V", Governor::name(governor.tier()), voltage);
+  logger.notice(msg);
+
+  if (!recorder.replaying()) {
+    std::ofstream out(CpuGovernorPath.c_str());
+    out << power().cpuGovernor << std::endl;
+    if (!out) {
+      logger.error("Unable to set the CPU frequency governor");
+    }
+  }
+}
+
+// Restart gpsd on the GPS receiver
+void Module::resetGPSD() {
+  CONSOLE_INFO("GPSD: Reset Begin");
+  processes.run({"sudo", "killall", "gpsd"}, CommandTimeout);
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  process_result_t result = processes.run({"sudo", "gpsd", "/dev/ttyS0", "-F", "/var/run/gpsd.sock"}, CommandTimeout);
+  if (result.status != 0) {
+    char msg[Global::MaxLength];
+    sprintf(msg, "GPSD: Unable to start gpsd: %.40s", Global::trim_copy(result.err).c_str());
+    logger.error(msg);
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  CONSOLE_INFO("GPSD: Reset End");
+}
+
+// Enable flag of the sensor read in stage, or NULL
+static std::atomic<bool> *sensorFlag(const char *stage) {
+  if (strcmp(stage, "GPS") == 0) return &Module::enableGPS;
+  if (strcmp(stage, "AHRS") == 0) return &Module::enableAHRS;
+  if (strcmp(stage, "MPL3115A2") == 0) return &Module::enableMPL;
+  if (strcmp(stage, "DHT") == 0) return &Module::enableDHT;
+  return NULL;
+}
+
+// Bypass the sensor the sensor loop is stuck in, so the rest of the loop skips it while the read is stuck
+void Module::sensorStall(const char *stage) {
+  std::atomic<bool> *flag = sensorFlag(stage);
+  if (flag == NULL || !flag->exchange(false)) return;
+  bypassed = stage;
+
+  char msg[Global::MaxLength];
+  sprintf(msg, "Watchdog: Bypassing %s", stage);
+  logger.error(msg);
+}
+
+// Re-enable the bypassed sensor, called between reads so its stuck read
+// has returned. A sensor that stalls again is bypassed again.
+void Module::sensorResume() {
+  const char *stage = bypassed.exchange(NULL);
+  if (stage == NULL) return;
+  sensorFlag(stage)->store(true);
+
+  char msg[Global::MaxLength];
+  sprintf(msg, "Watchdog: Re-enabling %s", stage);
+  logger.notice(msg);
+}
+
+// Stop the child process the camera loop is stuck in, so the loop carries on without its output
+void Module::cameraStall(const char *stage) {
+  if (processes.terminate(stage) == 0) return;
+
+  char msg[Global::MaxLength];
+  sprintf(msg, "Watchdog: Stopped %s", stage);
+  logger.error(msg);
+}
+
+// Stage the flight state for the next checkpoint
+void Module::checkpointUpdate() {
+  checkpoint_t state;
+  std::memset(&state, 0, sizeof(state));
+
+  state.savedAt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  state.phase = flight.phase();
+  state.launch = flight.launchAltitude();
+
+  if (enableAHRS) {
+    ahrs.getState(state.quaternion, state.integral);
+  }
+
+  bool baro, gps;
+  state.altimeterReady = altimeter.ready() ? 1 : 0;
+  altimeter.getState(state.altimeterState, state.altimeterCovariance, baro, gps);
+  state.baroSeen = baro ? 1 : 0;
+  state.gpsSeen = gps ? 1 : 0;
+
+  state.gps_nsats = sensorMsg.gps_nsats;
+  state.gps_status = sensorMsg.gps_status;
+  state.gps_mode = sensorMsg.gps_mode;
+  state.gps_lat = sensorMsg.gps_lat;
+  state.gps_lon = sensorMsg.gps_lon;
+  state.gps_alt = sensorMsg.gps_alt;
+
+  checkpoint.stage(state);
+}
+
+// Save a checkpoint of the staged flight state and the image numbering
+void Module::checkpointSave() {
+  checkpoint_t state;
+  if (!checkpoint.staged(state)) return;
+
+  state.imageNumber = imageNumber;
+  state.videoNumber = videoNumber;
+  state.archiveNumber = archiveNumber;
+  state.sequence = sequence;
+
+  // The last image loaded is the one being broadcast
+  state.downlinkImage = static_cast<uint16_t>(imageNumber - 1);
+  state.downlinkPending = downlink.pending(state.downlinkImage, state.downlinkChunk) ? 1 : 0;
+
+  checkpoint.save(state);
+}
+
+/**
+ * resume
+ *
+ * Restores the state saved before a watchdog reset or power glitch. The
+ * image, video and archive numbers and the frame sequence always resume,
+ * past a margin, so nothing written or sent before the restart is reused.
+ * The flight phase, filter states and last fix only resume if the
+ * checkpoint is recent, otherwise this is a new flight on old hardware.
+ * The sensors themselves are initialized as usual, since a power cycle
+ * resets them.
+ */
+void Module::resume() {
+  checkpoint_t state;
+  char msg[Global::MaxLength];
+
+  if (!checkpoint.load(state)) {
+    logger.notice("No checkpoint to resume from");
+    return;
+  }
+
+  imageNumber = state.imageNumber + NumberMargin;
+  videoNumber = state.videoNumber + NumberMargin;
+  archiveNumber = state.archiveNumber + NumberMargin;
+  sequence = static_cast<uint16_t>(state.sequence + SequenceMargin);
+
+  int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  int64_t age = (now - state.savedAt) / Microsecond;
+  if (age < 0 || age > ResumeAge) {
+    sprintf(msg, "Checkpoint is %lld s old, resuming numbering only", static_cast<long long>(age));
+    logger.notice(msg);
+    return;
+  }
+
+  flight.resume(state.phase, state.launch);
+
+  if (state.altimeterReady) {
+    altimeter.setState(state.altimeterState, state.altimeterCovariance, state.baroSeen != 0, state.gpsSeen != 0);
+  }
+
+  if (enableAHRS) {
+    ahrs.setState(state.quaternion, state.integral);
+  }
 
-  for (uint8_t i = 0; i < len; i++) {
-    check += buffer[i];
+  // Report the last fix until the receiver has a new one
+  sensorMsg.gps_nsats = state.gps_nsats;
+  sensorMsg.gps_status = state.gps_status;
+  sensorMsg.gps_mode = state.gps_mode;
+  sensorMsg.gps_lat = state.gps_lat;
+  sensorMsg.gps_lon = state.gps_lon;
+  sensorMsg.gps_alt = state.gps_alt;
+
+  // Requeue the rest of the image that was being broadcast
+  if (state.downlinkPending && camera.resume(state.downlinkImage, state.downlinkChunk)) {
+    sprintf(msg, "Resuming broadcast of image %u from chunk %u", state.downlinkImage, state.downlinkChunk);
+    logger.notice(msg);
   }
 
-  return 0xFF - (check & 0xFF);
+  sprintf(msg, "Resumed flight in phase %s from a checkpoint %lld s old", FlightPhase::name(state.phase), static_cast<long long>(age));
+  logger.notice(msg);
 }
 
 // Initialize static constants
 const std::string Module::I2CPath = "/dev/i2c-1";
 const std::string Module::SPIPath = "/dev/spidev0.0";
+const std::string Module::GPSPath = "/dev/ttyS0";
+const std::string Module::XBeePath = "/dev/ttyAMA0";
+const std::string Module::CheckpointPath = "db/habpi.checkpoint";
+const std::string Module::WatchdogPath = "/dev/watchdog";
+const std::string Module::CpuGovernorPath = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor";
+
+// Rates and priorities for each flight phase:
+// on the pad and once landed telemetry is slow and images are rare, during ascent
+// the defaults apply, at float images take priority over telemetry, and during
+// burst and descent telemetry is sent at a high rate ahead of images. In flight a
+// thumbnail is captured as soon as the downlink drains, at most every MinImageDelay.
+// The video ring runs in flight, so the burst and the landing are in it when detected
+const phase_profile_t Module::Profiles[FlightPhase::NPhases] = {
+  // sensorDelay,        imageDelay,          captureDelay,        broadcastDelay,     imageChunks, video, ring
+  {5 * Microsecond,      300 * Microsecond,   300 * Microsecond,   BroadcastDelay,     0,           false, false}, // Pad
+  {SensorDelay,          ImageDelay,          MinImageDelay,       BroadcastDelay,     0,           false, true},  // Ascent
+  {2 * Microsecond,      30 * Microsecond,    MinImageDelay,       BroadcastDelay,     20,          false, true},  // Float
+  {Microsecond / 2,      ImageDelay,          MinImageDelay,       BroadcastDelay,     0,           true,  true},  // Burst
+  {Microsecond / 2,      60 * Microsecond,    MinImageDelay,       BroadcastDelay,     0,           false, true},  // Descent
+  {10 * Microsecond,     600 * Microsecond,   600 * Microsecond,   4 * BroadcastDelay, 0,           true,  false}  // Landed
+};
+
+// Rates and limits for each power tier: as the battery sags, telemetry, which
+// locates the payload, is kept longest, while full resolution images, video and
+// large thumbnails, which cost the most energy per byte returned, go first
+const power_profile_t Module::Power[Governor::NTiers] = {
+  // cpuGovernor,  sensorScale, imageScale, broadcastScale, maxSize,            archive, video
+  {"ondemand",     1,           1,          1,              Camera::NSizes - 1, true,    true},  // Full
+  {"ondemand",     1,           2,          1,              1,                  true,    true},  // Reduced
+  {"powersave",    2,           4,          2,              0,                  false,   true},  // Low
+  {"powersave",    4,           8,          4,              0,                  false,   false}  // Critical
+};
 
 // Initialize static variables
 int Module::imageNumber = 1000000;
 int Module::imageChunkNumber = 1;
 int Module::videoNumber = 1000000;
-bool Module::isRunning = true;
-bool Module::enableGPS = false;
-bool Module::enableAHRS = false;
-bool Module::enableMPL = true;
-bool Module::enableDHT = false;
-bool Module::enableIMG = true;
-bool Module::recordVideo = false;
+int Module::archiveNumber = 1000000;
+std::atomic<bool> Module::isRunning(true);
+std::atomic<bool> Module::enableGPS(false);
+std::atomic<bool> Module::enableAHRS(false);
+std::atomic<bool> Module::enableMPL(false);
+std::atomic<bool> Module::enableDHT(false);
+std::atomic<const char *> Module::bypassed(NULL);
+std::atomic<bool> Module::enableIMG(false);
+std::atomic<bool> Module::recordVideo(false);
+bool Module::directGPS = false;
+bool Module::directRadio = false;
+std::string Module::telemetryDirectory;
+std::string Module::videoSource;
+bool Module::warmStart = false;
+bool Module::hardwareWatchdog = false;
 uint8_t Module::sensorPayload[Serializer::SensorSize] = {0}; //"Lorem ipsum dolor sit amet, consectetur adipiscing elit. Ut eu volutpat.";
 uint8_t Module::imagePayload[Serializer::ImageSize] = {0}; //"Lorem ipsum dolor sit amet, consectetur adipiscing elit. In efficitur urna enim, quis metus.";
 sensor_msg_t Module::sensorMsg;
 image_msg_t Module::imageMsg;
 battery_msg_t Module::batteryMsg;
-std::vector<image_msg_t> Module::broadcast_queue;
+Downlink Module::downlink;
 GPS Module::gps;
 AHRS Module::ahrs;
 MPL3115A2_Unified Module::mpl;
 DHT_Unified Module::dht;
 Camera Module::camera;
+Altimeter Module::altimeter;
+FlightPhase Module::flight;
+Governor Module::governor;
 Serializer Module::serializer;
 Logger Module::logger;
+Recorder Module::recorder;
+Archiver Module::archiver;
+TelemetryLog Module::telemetry;
+TelemetryCache Module::history;
+XBeeRadio Module::radio;
+Checkpoint Module::checkpoint;
+Startup Module::init;
+Watchdog Module::watchdog;
+ProcessRunner Module::processes;
+int Module::sensorLoop = 0;
+int Module::cameraLoop = 0;
+int Module::broadcastLoop = 0;
 
 // Debugging counters
 int Module::sensorCounter = 0;
@@ -432,4 +1173,5 @@ int Module::imageCounter = 0;
 int Module::sensorAckCounter = 0;
 int Module::imageAckCounter = 0;
 int Module::sensorNakCounter = 0;
+uint16_t Module::sequence = 0;
 int Module::imageNakCounter = 0;
@@ -0,0 +1,416 @@
+#include "HABPi.h"
+
+// NMEA Constructor
+NMEA::NMEA() {
+  reset();
+}
+
+// NMEA Destructor
+NMEA::~NMEA() {}
+
+// Reset parser state and fix
+void NMEA::reset() {
+  state = Idle;
+  length = 0;
+  nfields = 0;
+  checksum = 0;
+  received = 0;
+  ubxClass = ubxId = ubxCkA = ubxCkB = 0;
+  ubxLength = ubxIndex = 0;
+  prevAltitude = prevTime = 0.0;
+  havePrev = false;
+  std::memset(&current, 0, sizeof(current));
+  current.mode = ModeNoFix;
+  nsentences = 0;
+  nerrors = 0;
+}
+
+// Parse a buffer of bytes
+int NMEA::parse(const uint8_t *buffer, size_t len) {
+  int n = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (parse(buffer[i])) n++;
+  }
+  return n;
+}
+
+/**
+ * parse
+ *
+ * Byte-at-a-time state machine. NMEA sentences are collected between
+ * '$' and '*', with the running XOR checksum computed as the bytes
+ * arrive. UBX packets are recognised by the 0xB5 0x62 sync characters
+ * and verified with the 8-bit Fletcher checksum.
+ */
+bool NMEA::parse(uint8_t c) {
+  switch (state) {
+    case Idle: {
+      if (c == '$') {
+        length = 0;
+        checksum = 0;
+        state = Sentence;
+      } else if (c == 0xB5) {
+        state = UbxSync2;
+      }
+    } break;
+    case Sentence: {
+      if (c == '*') {
+        state = Checksum1;
+      } else if (c == '$') {
+        // Restart on a truncated sentence
+        length = 0;
+        checksum = 0;
+      } else if (c < 0x20 || c > 0x7E || length >= MaxSentence - 1) {
+        nerrors++;
+        state = Idle;
+      } else {
+        sentence[length++] = static_cast<char>(c);
+        checksum ^= c;
+      }
+    } break;
+    case Checksum1: {
+      int v = hex(c);
+      if (v < 0) {
+        nerrors++;
+        state = Idle;
+      } else {
+        received = static_cast<uint8_t>(v << 4);
+        state = Checksum2;
+      }
+    } break;
+    case Checksum2: {
+      int v = hex(c);
+      state = Idle;
+      if (v < 0 || (received | v) != checksum) {
+        nerrors++;
+        return false;
+      }
+      sentence[length] = '\0';
+      return decodeSentence();
+    } break;
+    case UbxSync2: {
+      state = (c == 0x62) ? UbxClass : Idle;
+    } break;
+    case UbxClass: {
+      ubxClass = c;
+      ubxCkA = c;
+      ubxCkB = ubxCkA;
+      state = UbxId;
+    } break;
+    case UbxId: {
+      ubxId = c;
+      ubxCkA += c;
+      ubxCkB += ubxCkA;
+      state = UbxLength1;
+    } break;
+    case UbxLength1: {
+      ubxLength = c;
+      ubxCkA += c;
+      ubxCkB += ubxCkA;
+      state = UbxLength2;
+    } break;
+    case UbxLength2: {
+      ubxLength |= static_cast<uint16_t>(c) << 8;
+      ubxCkA += c;
+      ubxCkB += ubxCkA;
+      ubxIndex = 0;
+      if (ubxLength > MaxPayload) {
+        // Not a packet we decode, wait for the next sync
+        state = Idle;
+      } else {
+        state = (ubxLength == 0) ? UbxCheckA : UbxPayload;
+      }
+    } break;
+    case UbxPayload: {
+      payload[ubxIndex++] = c;
+      ubxCkA += c;
+      ubxCkB += ubxCkA;
+      if (ubxIndex >= ubxLength) state = UbxCheckA;
+    } break;
+    case UbxCheckA: {
+      if (c == ubxCkA) {
+        state = UbxCheckB;
+      } else {
+        nerrors++;
+        state = Idle;
+      }
+    } break;
+    case UbxCheckB: {
+      state = Idle;
+      if (c != ubxCkB) {
+        nerrors++;
+        return false;
+      }
+      return decodeUBX();
+    } break;
+    default: {
+      state = Idle;
+    } break;
+  }
+  return false;
+}
+
+// Split the sentence into fields in place, and dispatch on its type
+bool NMEA::decodeSentence() {
+  nfields = 0;
+  fields[nfields++] = sentence;
+  for (int i = 0; i < length && nfields < MaxFields; i++) {
+    if (sentence[i] == ',') {
+      sentence[i] = '\0';
+      fields[nfields++] = &sentence[i + 1];
+    }
+  }
+
+  // Skip the two character talker identifier (GP, GN, GL, ...)
+  const char *type = fields[0];
+  if (std::strlen(type) != 5) return false;
+  type += 2;
+
+  if (std::strcmp(type, "GGA") == 0) {
+    decodeGGA();
+  } else if (std::strcmp(type, "RMC") == 0) {
+    decodeRMC();
+  } else if (std::strcmp(type, "GSA") == 0) {
+    decodeGSA();
+  } else if (std::strcmp(type, "VTG") == 0) {
+    decodeVTG();
+  } else {
+    return false;
+  }
+
+  nsentences++;
+  return true;
+}
+
+// $--GGA,time,lat,N,lon,E,quality,nsats,hdop,alt,M,sep,M,age,station
+void NMEA::decodeGGA() {
+  if (!empty(field(1))) {
+    current.time = utc(field(1));
+    current.set |= TimeSet;
+  }
+
+  int quality = static_cast<int>(decimal(field(6)));
+  current.status = (quality == 0) ? StatusNoFix : (quality == 2 ? StatusDgpsFix : StatusFix);
+  current.set |= StatusSet;
+
+  if (!empty(field(7))) {
+    current.nsats = static_cast<uint8_t>(decimal(field(7)));
+    current.set |= SatelliteSet;
+  }
+
+  if (quality == 0) return;
+
+  if (!empty(field(2)) && !empty(field(4))) {
+    current.latitude = coordinate(field(2), field(3)[0]);
+    current.longitude = coordinate(field(4), field(5)[0]);
+    current.set |= LatLonSet;
+  }
+
+  if (!empty(field(9))) {
+    current.altitude = decimal(field(9));
+    current.set |= AltitudeSet;
+
+    // NMEA has no vertical velocity, so derive it from successive fixes
+    if (havePrev && (current.set & TimeSet)) {
+      double dt = current.time - prevTime;
+      if (dt < 0.0) dt += 86400.0;
+      if (dt > 0.0 && dt < 10.0) {
+        current.climb = (current.altitude - prevAltitude) / dt;
+        current.set |= ClimbSet;
+      }
+    }
+    prevAltitude = current.altitude;
+    prevTime = current.time;
+    havePrev = (current.set & TimeSet) != 0;
+  }
+}
+
+// $--RMC,time,status,lat,N,lon,E,speed,track,date,magvar,E,mode
+void NMEA::decodeRMC() {
+  if (!empty(field(1))) {
+    current.time = utc(field(1));
+    current.set |= TimeSet;
+  }
+
+  if (field(2)[0] != 'A') return;
+
+  if (!empty(field(3)) && !empty(field(5))) {
+    current.latitude = coordinate(field(3), field(4)[0]);
+    current.longitude = coordinate(field(5), field(6)[0]);
+    current.set |= LatLonSet;
+  }
+  if (!empty(field(7))) {
+    current.speed = decimal(field(7)) * KnotsToMs;
+    current.set |= SpeedSet;
+  }
+  if (!empty(field(8))) {
+    current.track = decimal(field(8));
+    current.set |= TrackSet;
+  }
+}
+
+// $--GSA,selection,mode,sv1,...,sv12,pdop,hdop,vdop
+void NMEA::decodeGSA() {
+  if (!empty(field(2))) {
+    int mode = static_cast<int>(decimal(field(2)));
+    if (mode >= ModeNoFix && mode <= Mode3D) {
+      current.mode = static_cast<uint8_t>(mode);
+      current.set |= ModeSet;
+    }
+  }
+}
+
+// $--VTG,track,T,mtrack,M,knots,N,kph,K,mode
+void NMEA::decodeVTG() {
+  if (!empty(field(1))) {
+    current.track = decimal(field(1));
+    current.set |= TrackSet;
+  }
+  if (!empty(field(7))) {
+    current.speed = decimal(field(7)) * KphToMs;
+    current.set |= SpeedSet;
+  } else if (!empty(field(5))) {
+    current.speed = decimal(field(5)) * KnotsToMs;
+    current.set |= SpeedSet;
+  }
+}
+
+// Little-endian payload accessors
+static inline uint16_t u16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline int32_t i32(const uint8_t *p) {
+  return static_cast<int32_t>(static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                              (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24));
+}
+
+/**
+ * decodeUBX
+ *
+ * Decodes UBX-NAV-PVT, which carries the complete navigation solution
+ * (including the vertical velocity) in a single 92 byte packet, and is
+ * the preferred message at fix rates above 1 Hz.
+ */
+bool NMEA::decodeUBX() {
+  if (ubxClass != UbxNav || ubxId != UbxNavPvt || ubxLength < 92) return false;
+
+  const uint8_t *p = payload;
+  uint8_t fixType = p[20];
+  uint8_t flags = p[21];
+
+  current.time = (p[8] * 3600.0) + (p[9] * 60.0) + p[10];
+  current.set |= TimeSet;
+
+  if ((flags & 0x01) == 0 || fixType < 2 || fixType > 4) {
+    current.status = StatusNoFix;
+    current.mode = ModeNoFix;
+  } else {
+    current.status = (flags & 0x02) ? StatusDgpsFix : StatusFix;
+    current.mode = (fixType == 2) ? Mode2D : Mode3D;
+  }
+  current.nsats = p[23];
+  current.set |= StatusSet | ModeSet | SatelliteSet;
+
+  if (current.status == StatusNoFix) {
+    nsentences++;
+    return true;
+  }
+
+  current.longitude = i32(p + 24) * 1.0E-7;
+  current.latitude = i32(p + 28) * 1.0E-7;
+  current.altitude = i32(p + 36) * 1.0E-3;
+  current.climb = -i32(p + 56) * 1.0E-3;
+  current.speed = i32(p + 60) * 1.0E-3;
+  current.track = i32(p + 64) * 1.0E-5;
+  current.set |= LatLonSet | AltitudeSet | ClimbSet | SpeedSet | TrackSet;
+
+  nsentences++;
+  return true;
+}
+
+// Parse an unsigned or signed decimal number without allocation
+double NMEA::decimal(const char *s) {
+  double value = 0.0, scale = 1.0;
+  bool negative = false, fraction = false;
+
+  if (*s == '-') {
+    negative = true;
+    s++;
+  }
+  for (; *s != '\0'; s++) {
+    if (*s == '.') {
+      fraction = true;
+    } else if (*s >= '0' && *s <= '9') {
+      value = value * 10.0 + (*s - '0');
+      if (fraction) scale *= 10.0;
+    } else {
+      break;
+    }
+  }
+  value /= scale;
+  return negative ? -value : value;
+}
+
+// Convert an NMEA (d)ddmm.mmmm coordinate and hemisphere to degrees
+double NMEA::coordinate(const char *s, char hemisphere) {
+  double raw = decimal(s);
+  double degrees = std::floor(raw / 100.0);
+  double value = degrees + (raw - degrees * 100.0) / 60.0;
+  return (hemisphere == 'S' || hemisphere == 'W') ? -value : value;
+}
+
+// Convert an NMEA hhmmss.ss time to seconds of the day
+double NMEA::utc(const char *s) {
+  double raw = decimal(s);
+  int hhmm = static_cast<int>(raw / 100.0);
+  return (hhmm / 100) * 3600.0 + (hhmm % 100) * 60.0 + (raw - hhmm * 100.0);
+}
+
+// Convert a hexadecimal character to its value
+int NMEA::hex(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Build a UBX packet with sync characters and Fletcher checksum
+size_t NMEA::ubxPacket(uint8_t cls, uint8_t id, const uint8_t *data, uint16_t len, uint8_t *buffer) {
+  uint8_t ckA = 0, ckB = 0;
+  size_t n = 0;
+
+  buffer[n++] = 0xB5;
+  buffer[n++] = 0x62;
+  buffer[n++] = cls;
+  buffer[n++] = id;
+  buffer[n++] = static_cast<uint8_t>(len & 0xFF);
+  buffer[n++] = static_cast<uint8_t>(len >> 8);
+  for (uint16_t i = 0; i < len; i++) {
+    buffer[n++] = data[i];
+  }
+  for (size_t i = 2; i < n; i++) {
+    ckA += buffer[i];
+    ckB += ckA;
+  }
+  buffer[n++] = ckA;
+  buffer[n++] = ckB;
+
+  return n;
+}
+
+// UBX-CFG-RATE: measurement period, one navigation solution per measurement, GPS time
+size_t NMEA::rateCommand(uint16_t periodMs, uint8_t *buffer) {
+  uint8_t data[6] = {
+    static_cast<uint8_t>(periodMs & 0xFF), static_cast<uint8_t>(periodMs >> 8),
+    0x01, 0x00,
+    0x01, 0x00
+  };
+  return ubxPacket(UbxCfg, UbxCfgRate, data, sizeof(data), buffer);
+}
+
+// UBX-CFG-MSG: output rate of a message on the current port
+size_t NMEA::messageRateCommand(uint8_t cls, uint8_t id, uint8_t rate, uint8_t *buffer) {
+  uint8_t data[3] = {cls, id, rate};
+  return ubxPacket(UbxCfg, UbxCfgMsg, data, sizeof(data), buffer);
+}
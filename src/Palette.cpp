@@ -0,0 +1,38 @@
+#include "Palette.h"
+
+// The 16 EGA colours, 16 grays, then 9 blocks of 24 hues at decreasing
+// saturation and intensity, padded with black
+const rgb_t Palette::Vga[Palette::NColours] = {
+  {0x0,0x0,0x0}, {0x0,0x0,0xa8}, {0x0,0xa8,0x0}, {0x0,0xa8,0xa8}, {0xa8,0x0,0x0}, {0xa8,0x0,0xa8}, {0xa8,0x57,0x0}, {0xa8,0xa8,0xa8},
+  {0x57,0x57,0x57}, {0x57,0x57,0xff}, {0x57,0xff,0x57}, {0x57,0xff,0xff}, {0xff,0x57,0x57}, {0xff,0x57,0xff}, {0xff,0xff,0x57}, {0xff,0xff,0xff},
+  {0x0,0x0,0x0}, {0x17,0x17,0x17}, {0x20,0x20,0x20}, {0x2f,0x2f,0x2f}, {0x38,0x38,0x38}, {0x47,0x47,0x47}, {0x50,0x50,0x50}, {0x60,0x60,0x60},
+  {0x70,0x70,0x70}, {0x80,0x80,0x80}, {0x90,0x90,0x90}, {0xa0,0xa0,0xa0}, {0xb7,0xb7,0xb7}, {0xc8,0xc8,0xc8}, {0xe0,0xe0,0xe0}, {0xff,0xff,0xff},
+  {0x0,0x0,0xff}, {0x40,0x0,0xff}, {0x7f,0x0,0xff}, {0xbf,0x0,0xff}, {0xff,0x0,0xff}, {0xff,0x0,0xbf}, {0xff,0x0,0x7f}, {0xff,0x0,0x40},
+  {0xff,0x0,0x0}, {0xff,0x40,0x0}, {0xff,0x7f,0x0}, {0xff,0xbf,0x0}, {0xff,0xff,0x0}, {0xbf,0xff,0x0}, {0x7f,0xff,0x0}, {0x40,0xff,0x0},
+  {0x0,0xff,0x0}, {0x0,0xff,0x40}, {0x0,0xff,0x7f}, {0x0,0xff,0xbf}, {0x0,0xff,0xff}, {0x0,0xbf,0xff}, {0x0,0x7f,0xff}, {0x0,0x40,0xff},
+  {0x7f,0x7f,0xff}, {0x9f,0x7f,0xff}, {0xbf,0x7f,0xff}, {0xdf,0x7f,0xff}, {0xff,0x7f,0xff}, {0xff,0x7f,0xdf}, {0xff,0x7f,0xbf}, {0xff,0x7f,0x9f},
+  {0xff,0x7f,0x7f}, {0xff,0x9f,0x7f}, {0xff,0xbf,0x7f}, {0xff,0xdf,0x7f}, {0xff,0xff,0x7f}, {0xdf,0xff,0x7f}, {0xbf,0xff,0x7f}, {0x9f,0xff,0x7f},
+  {0x7f,0xff,0x7f}, {0x7f,0xff,0x9f}, {0x7f,0xff,0xbf}, {0x7f,0xff,0xdf}, {0x7f,0xff,0xff}, {0x7f,0xdf,0xff}, {0x7f,0xbf,0xff}, {0x7f,0x9f,0xff},
+  {0xb7,0xb7,0xff}, {0xc7,0xb7,0xff}, {0xd8,0xb7,0xff}, {0xe8,0xb7,0xff}, {0xff,0xb7,0xff}, {0xff,0xb7,0xe8}, {0xff,0xb7,0xd8}, {0xff,0xb7,0xc7},
+  {0xff,0xb7,0xb7}, {0xff,0xc7,0xb7}, {0xff,0xd8,0xb7}, {0xff,0xe8,0xb7}, {0xff,0xff,0xb7}, {0xe8,0xff,0xb7}, {0xd8,0xff,0xb7}, {0xc7,0xff,0xb7},
+  {0xb7,0xff,0xb7}, {0xb7,0xff,0xc7}, {0xb7,0xff,0xd8}, {0xb7,0xff,0xe8}, {0xb7,0xff,0xff}, {0xb7,0xe8,0xff}, {0xb7,0xd8,0xff}, {0xb7,0xc7,0xff},
+  {0x0,0x0,0x70}, {0x1f,0x0,0x70}, {0x38,0x0,0x70}, {0x57,0x0,0x70}, {0x70,0x0,0x70}, {0x70,0x0,0x57}, {0x70,0x0,0x38}, {0x70,0x0,0x1f},
+  {0x70,0x0,0x0}, {0x70,0x1f,0x0}, {0x70,0x38,0x0}, {0x70,0x57,0x0}, {0x70,0x70,0x0}, {0x57,0x70,0x0}, {0x38,0x70,0x0}, {0x1f,0x70,0x0},
+  {0x0,0x70,0x0}, {0x0,0x70,0x1f}, {0x0,0x70,0x38}, {0x0,0x70,0x57}, {0x0,0x70,0x70}, {0x0,0x57,0x70}, {0x0,0x38,0x70}, {0x0,0x1f,0x70},
+  {0x38,0x38,0x70}, {0x47,0x38,0x70}, {0x57,0x38,0x70}, {0x60,0x38,0x70}, {0x70,0x38,0x70}, {0x70,0x38,0x60}, {0x70,0x38,0x57}, {0x70,0x38,0x47},
+  {0x70,0x38,0x38}, {0x70,0x47,0x38}, {0x70,0x57,0x38}, {0x70,0x60,0x38}, {0x70,0x70,0x38}, {0x60,0x70,0x38}, {0x57,0x70,0x38}, {0x47,0x70,0x38},
+  {0x38,0x70,0x38}, {0x38,0x70,0x47}, {0x38,0x70,0x57}, {0x38,0x70,0x60}, {0x38,0x70,0x70}, {0x38,0x60,0x70}, {0x38,0x57,0x70}, {0x38,0x47,0x70},
+  {0x50,0x50,0x70}, {0x58,0x50,0x70}, {0x60,0x50,0x70}, {0x68,0x50,0x70}, {0x70,0x50,0x70}, {0x70,0x50,0x68}, {0x70,0x50,0x60}, {0x70,0x50,0x58},
+  {0x70,0x50,0x50}, {0x70,0x58,0x50}, {0x70,0x60,0x50}, {0x70,0x68,0x50}, {0x70,0x70,0x50}, {0x68,0x70,0x50}, {0x60,0x70,0x50}, {0x58,0x70,0x50},
+  {0x50,0x70,0x50}, {0x50,0x70,0x58}, {0x50,0x70,0x60}, {0x50,0x70,0x68}, {0x50,0x70,0x70}, {0x50,0x68,0x70}, {0x50,0x60,0x70}, {0x50,0x58,0x70},
+  {0x0,0x0,0x40}, {0x10,0x0,0x40}, {0x20,0x0,0x40}, {0x30,0x0,0x40}, {0x40,0x0,0x40}, {0x40,0x0,0x30}, {0x40,0x0,0x20}, {0x40,0x0,0x10},
+  {0x40,0x0,0x0}, {0x40,0x10,0x0}, {0x40,0x20,0x0}, {0x40,0x30,0x0}, {0x40,0x40,0x0}, {0x30,0x40,0x0}, {0x20,0x40,0x0}, {0x10,0x40,0x0},
+  {0x0,0x40,0x0}, {0x0,0x40,0x10}, {0x0,0x40,0x20}, {0x0,0x40,0x30}, {0x0,0x40,0x40}, {0x0,0x30,0x40}, {0x0,0x20,0x40}, {0x0,0x10,0x40},
+  {0x20,0x20,0x40}, {0x28,0x20,0x40}, {0x30,0x20,0x40}, {0x38,0x20,0x40}, {0x40,0x20,0x40}, {0x40,0x20,0x38}, {0x40,0x20,0x30}, {0x40,0x20,0x28},
+  {0x40,0x20,0x20}, {0x40,0x28,0x20}, {0x40,0x30,0x20}, {0x40,0x38,0x20}, {0x40,0x40,0x20}, {0x38,0x40,0x20}, {0x30,0x40,0x20}, {0x28,0x40,0x20},
+  {0x20,0x40,0x20}, {0x20,0x40,0x28}, {0x20,0x40,0x30}, {0x20,0x40,0x38}, {0x20,0x40,0x40}, {0x20,0x38,0x40}, {0x20,0x30,0x40}, {0x20,0x28,0x40},
+  {0x2f,0x2f,0x40}, {0x30,0x2f,0x40}, {0x37,0x2f,0x40}, {0x3f,0x2f,0x40}, {0x40,0x2f,0x40}, {0x40,0x2f,0x3f}, {0x40,0x2f,0x37}, {0x40,0x2f,0x30},
+  {0x40,0x2f,0x2f}, {0x40,0x30,0x2f}, {0x40,0x37,0x2f}, {0x40,0x3f,0x2f}, {0x40,0x40,0x2f}, {0x3f,0x40,0x2f}, {0x37,0x40,0x2f}, {0x30,0x40,0x2f},
+  {0x2f,0x40,0x2f}, {0x2f,0x40,0x30}, {0x2f,0x40,0x37}, {0x2f,0x40,0x3f}, {0x2f,0x40,0x40}, {0x2f,0x3f,0x40}, {0x2f,0x37,0x40}, {0x2f,0x30,0x40},
+  {0x0,0x0,0x0}, {0x0,0x0,0x0}, {0x0,0x0,0x0}, {0x0,0x0,0x0}, {0x0,0x0,0x0}, {0x0,0x0,0x0}, {0x0,0x0,0x0}, {0x0,0x0,0x0}
+};
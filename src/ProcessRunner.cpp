@@ -0,0 +1,318 @@
+#include "ProcessRunner.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <algorithm>
+
+extern char **environ;
+
+// pidfd of a child, or -1 where the kernel has none
+static int pidfdOpen(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void) pid;
+  return -1;
+#endif
+}
+
+// ProcessRunner Constructor
+ProcessRunner::ProcessRunner(): nrunning(0), nextJob(0), stopping(false) {
+  wake[0] = -1;
+  wake[1] = -1;
+}
+
+// ProcessRunner Destructor
+ProcessRunner::~ProcessRunner() {
+  stop();
+  if (wake[0] >= 0) close(wake[0]);
+  if (wake[1] >= 0) close(wake[1]);
+}
+
+// Start argv with a timeout [ms], or 0 for none, optionally capturing stdout
+int ProcessRunner::start(const std::vector<std::string> &argv, int timeout, bool captureOut) {
+  return spawn(argv, timeout, captureOut, NULL);
+}
+
+// Start argv with a timeout [ms], or 0 for none, handing the read end of its stdout to the caller
+int ProcessRunner::stream(const std::vector<std::string> &argv, int timeout, int &outFd) {
+  return spawn(argv, timeout, false, &outFd);
+}
+
+/**
+ * spawn
+ *
+ * Spawns argv[0], looked up on the PATH, with stdin and (unless it is
+ * captured or streamed) stdout on /dev/null, and stderr on a pipe to the
+ * reaper. The pipes are close-on-exec, so children started at the same
+ * time do not hold each other's pipes open. The reaper is started with
+ * the first child.
+ */
+int ProcessRunner::spawn(const std::vector<std::string> &argv, int timeout, bool captureOut, int *outFd) {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [&]() { return stopping || nrunning < MaxRunning; });
+  if (stopping || argv.empty()) {
+    errno = stopping ? ECANCELED : EINVAL;
+    return -1;
+  }
+
+  if (!reaper.joinable()) {
+    if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) return -1;
+    reaper = std::thread(&ProcessRunner::reap, this);
+  }
+
+  int outPipe[2] = {-1, -1}, errPipe[2] = {-1, -1};
+  bool outPiped = captureOut || outFd != NULL;
+  if ((outPiped && pipe2(outPipe, O_CLOEXEC) != 0) || pipe2(errPipe, O_CLOEXEC) != 0) {
+    int error = errno;
+    if (outPipe[0] >= 0) {
+      close(outPipe[0]);
+      close(outPipe[1]);
+    }
+    errno = error;
+    return -1;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  if (outPiped) {
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  }
+  posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+  // Own process group, no blocked signals, and default dispositions for the signals HABPi handles
+  posix_spawnattr_t attr;
+  sigset_t mask, defaults;
+  sigemptyset(&mask);
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGHUP);
+  sigaddset(&defaults, SIGINT);
+  sigaddset(&defaults, SIGTERM);
+  sigaddset(&defaults, SIGPIPE);
+  sigaddset(&defaults, SIGUSR1);
+  sigaddset(&defaults, SIGUSR2);
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  std::vector<char *> args;
+  for (size_t i = 0; i < argv.size(); i++) args.push_back(const_cast<char *>(argv[i].c_str()));
+  args.push_back(NULL);
+
+  pid_t pid;
+  int error = posix_spawnp(&pid, args[0], &actions, &attr, args.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+
+  if (outPipe[1] >= 0) close(outPipe[1]);
+  close(errPipe[1]);
+  if (error != 0) {
+    if (outPipe[0] >= 0) close(outPipe[0]);
+    close(errPipe[0]);
+    errno = error;
+    return -1;
+  }
+
+  child_t child;
+  child.name = argv[0];
+  child.pid = pid;
+  child.pidfd = pidfdOpen(pid);
+  child.outFd = captureOut ? outPipe[0] : -1;
+  child.errFd = errPipe[0];
+  if (child.outFd >= 0) fcntl(child.outFd, F_SETFL, O_NONBLOCK);
+  fcntl(child.errFd, F_SETFL, O_NONBLOCK);
+  if (outFd != NULL) *outFd = outPipe[0];
+  if (timeout > 0) {
+    child.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  } else {
+    child.deadline = std::chrono::steady_clock::time_point::max();
+  }
+  child.terminated = false;
+  child.done = false;
+  child.result.status = -1;
+  child.result.timedOut = false;
+
+  int job = nextJob++;
+  children[job] = child;
+  nrunning++;
+
+  if (write(wake[1], "", 1) < 0) {}
+  return job;
+}
+
+// Job has finished
+bool ProcessRunner::finished(int job) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<int, child_t>::iterator it = children.find(job);
+  return it == children.end() || it->second.done;
+}
+
+// Wait for job to finish and take its result
+process_result_t ProcessRunner::wait(int job) {
+  std::unique_lock<std::mutex> lock(mutex);
+  process_result_t result;
+  result.status = -1;
+  result.timedOut = false;
+
+  std::map<int, child_t>::iterator it = children.find(job);
+  if (it == children.end()) return result;
+
+  changed.wait(lock, [&]() { return it->second.done; });
+  result = it->second.result;
+  children.erase(it);
+  return result;
+}
+
+// Start argv and wait for it
+process_result_t ProcessRunner::run(const std::vector<std::string> &argv, int timeout, bool captureOut) {
+  int job = start(argv, timeout, captureOut);
+  if (job >= 0) return wait(job);
+
+  process_result_t result;
+  result.status = -1;
+  result.timedOut = false;
+  result.err = strerror(errno);
+  return result;
+}
+
+// Stop the running children started as name
+int ProcessRunner::terminate(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  int n = 0;
+  for (std::map<int, child_t>::iterator it = children.begin(); it != children.end(); ++it) {
+    if (!it->second.done && !it->second.terminated && it->second.name == name) {
+      interrupt(it->second, false);
+      n++;
+    }
+  }
+  if (n > 0 && write(wake[1], "", 1) < 0) {}
+  return n;
+}
+
+// Stop every child, and refuse new ones
+void ProcessRunner::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    for (std::map<int, child_t>::iterator it = children.begin(); it != children.end(); ++it) {
+      if (!it->second.done && !it->second.terminated) interrupt(it->second, false);
+    }
+    if (wake[1] >= 0 && write(wake[1], "", 1) < 0) {}
+  }
+  changed.notify_all();
+  if (reaper.joinable()) reaper.join();
+}
+
+/**
+ * reap
+ *
+ * Sleeps in poll() on the wake pipe and each child's pipes and pidfd,
+ * until the next timeout or kill is due. On waking it reads whatever
+ * the children have written, applies timeouts, and collects the exit
+ * status of children that have ended. Runs until stopped with no child
+ * left running.
+ */
+void ProcessRunner::reap() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (!stopping || nrunning > 0) {
+    std::vector<struct pollfd> fds;
+    struct pollfd wakeFd = {wake[0], POLLIN, 0};
+    fds.push_back(wakeFd);
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    int timeout = -1;
+    for (std::map<int, child_t>::iterator it = children.begin(); it != children.end(); ++it) {
+      child_t &child = it->second;
+      if (child.done) continue;
+
+      int watched[3] = {child.outFd, child.errFd, child.pidfd};
+      for (int i = 0; i < 3; i++) {
+        if (watched[i] < 0) continue;
+        struct pollfd fd = {watched[i], POLLIN, 0};
+        fds.push_back(fd);
+      }
+
+      std::chrono::steady_clock::time_point due = child.terminated ? child.killAt : child.deadline;
+      int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count() + 1;
+      int ms = static_cast<int>(std::min(std::max(left, static_cast<int64_t>(0)), static_cast<int64_t>(INT32_MAX)));
+      if (child.pidfd < 0) ms = std::min(ms, static_cast<int>(PollInterval));
+      timeout = timeout < 0 ? ms : std::min(timeout, ms);
+    }
+
+    lock.unlock();
+    poll(fds.data(), fds.size(), timeout);
+    lock.lock();
+
+    char buffer[64];
+    while (read(wake[0], buffer, sizeof(buffer)) > 0) {}
+
+    now = std::chrono::steady_clock::now();
+    for (std::map<int, child_t>::iterator it = children.begin(); it != children.end(); ++it) {
+      child_t &child = it->second;
+      if (child.done) continue;
+
+      drain(child.outFd, child.result.out, std::string::npos);
+      drain(child.errFd, child.result.err, MaxError);
+
+      if (!child.terminated && now >= child.deadline) {
+        interrupt(child, true);
+      } else if (child.terminated && now >= child.killAt) {
+        kill(-child.pid, SIGKILL);
+        child.killAt = now + std::chrono::milliseconds(static_cast<int>(KillGrace));
+      }
+
+      int status;
+      if (waitpid(child.pid, &status, WNOHANG) != child.pid) continue;
+
+      // Keep what was written just before exiting, and let go of pipes a grandchild may still hold
+      drain(child.outFd, child.result.out, std::string::npos);
+      drain(child.errFd, child.result.err, MaxError);
+      if (child.outFd >= 0) close(child.outFd);
+      if (child.errFd >= 0) close(child.errFd);
+      if (child.pidfd >= 0) close(child.pidfd);
+      child.outFd = child.errFd = child.pidfd = -1;
+
+      child.result.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+      child.done = true;
+      nrunning--;
+      changed.notify_all();
+    }
+  }
+}
+
+// Read what is available from fd into out, up to limit bytes, closing it at end of file
+void ProcessRunner::drain(int &fd, std::string &out, size_t limit) {
+  char buffer[64 * 1024];
+  while (fd >= 0) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      if (out.size() < limit) out.append(buffer, std::min(static_cast<size_t>(n), limit - out.size()));
+    } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+      close(fd);
+      fd = -1;
+    } else if (errno == EAGAIN) {
+      break;
+    }
+  }
+}
+
+// Send SIGTERM to the process group of child
+void ProcessRunner::interrupt(child_t &child, bool timedOut) {
+  kill(-child.pid, SIGTERM);
+  child.terminated = true;
+  child.result.timedOut = timedOut;
+  child.killAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int>(KillGrace));
+}
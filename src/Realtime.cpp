@@ -0,0 +1,88 @@
+#include "HABPi.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+// Lock memory and reserve a CPU for the real-time thread
+bool Realtime::reserve() {
+  char msg[Global::MaxLength];
+  bool status = true;
+
+  // Keep freed heap memory mapped, so locked pages are reused rather than faulted again
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+
+  // Lock pages as they are touched, rather than committing every thread's full stack
+#ifdef MCL_ONFAULT
+  int flags = MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT;
+#else
+  int flags = MCL_CURRENT | MCL_FUTURE;
+#endif
+  if (mlockall(flags) != 0) {
+    sprintf(msg, "Realtime: Unable to lock memory: %s", strerror(errno));
+    Module::logger.error(msg);
+    status = false;
+  }
+
+  // Keep this thread, and everything it starts, off the last CPU
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpus > 1) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (long i = 0; i < ncpus - 1; i++) CPU_SET(i, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) == 0) {
+      cpu = static_cast<int>(ncpus - 1);
+      sprintf(msg, "Realtime: Reserved CPU %d for the broadcast loop", cpu);
+      Module::logger.info(msg);
+    } else {
+      sprintf(msg, "Realtime: Unable to reserve a CPU: %s", strerror(errno));
+      Module::logger.error(msg);
+      status = false;
+    }
+  }
+
+  return status;
+}
+
+// Run the calling thread on the reserved CPU with SCHED_FIFO priority
+bool Realtime::enter() {
+  char msg[Global::MaxLength];
+  bool status = true;
+
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      Module::logger.error("Realtime: Unable to move to the reserved CPU");
+      status = false;
+    }
+  }
+
+  struct sched_param param;
+  std::memset(&param, 0, sizeof(param));
+  param.sched_priority = Priority;
+  int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (result != 0) {
+    sprintf(msg, "Realtime: Unable to set SCHED_FIFO priority: %s", strerror(result));
+    Module::logger.error(msg);
+    status = false;
+  }
+
+  // Touch the stack now, so the loop never takes a page fault on it
+  uint8_t stack[PrefaultStack];
+  std::memset(stack, 0, sizeof(stack));
+  asm volatile("" : : "r"(stack) : "memory");
+
+  if (status) {
+    sprintf(msg, "Realtime: Broadcast loop running at SCHED_FIFO %d on CPU %d", Priority, cpu);
+    Module::logger.notice(msg);
+  }
+  return status;
+}
+
+// Initialize static variables
+bool Realtime::enabled = false;
+int Realtime::cpu = -1;
@@ -0,0 +1,251 @@
+#include "HABPi.h"
+
+// Recorder Constructor
+Recorder::Recorder(): mode(OffMode), speed(1.0f), lastTime(0), duration(0) {
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < NChannels; i++) {
+    records[i] = 0;
+    bytes[i] = 0;
+  }
+}
+
+// Recorder Destructor
+Recorder::~Recorder() {
+  close();
+}
+
+// Start recording a trace to path
+bool Recorder::record(const std::string &path) {
+  file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::string msg = std::string("Unable to open trace file ") + path;
+    Module::logger.error(msg.c_str());
+    return false;
+  }
+
+  // Write header
+  const uint8_t header[8] = {'H', 'A', 'B', 'T', Version & 0xFF, Version >> 8, 0, 0};
+  file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+  buffer.reserve(BufferSize + 1024);
+  start = std::chrono::steady_clock::now();
+  lastTime = 0;
+  mode = RecordMode;
+
+  std::string msg = std::string("Recording trace to ") + path;
+  Module::logger.info(msg.c_str());
+  return true;
+}
+
+// Load a trace for replay
+bool Recorder::replay(const std::string &path, float factor) {
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+  if (!in.is_open()) {
+    std::string msg = std::string("Unable to open trace file ") + path;
+    Module::logger.error(msg.c_str());
+    return false;
+  }
+
+  trace.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  if (trace.size() < 8 || trace[0] != 'H' || trace[1] != 'A' || trace[2] != 'B' || trace[3] != 'T' ||
+      (trace[4] | (trace[5] << 8)) != Version) {
+    std::string msg = std::string("Invalid trace file ") + path;
+    Module::logger.error(msg.c_str());
+    trace.clear();
+    return false;
+  }
+
+  // Index every record by (channel, key)
+  size_t pos = 8;
+  uint64_t time = 0;
+  while (pos < trace.size()) {
+    uint64_t delta, length;
+    if (!getVarint(pos, delta) || pos + 3 > trace.size()) break;
+    uint8_t channel = trace[pos];
+    uint16_t key = trace[pos + 1] | (trace[pos + 2] << 8);
+    pos += 3;
+    if (!getVarint(pos, length) || pos + length > trace.size()) break;
+
+    time += delta;
+    trace_record_t rec = {time, static_cast<uint32_t>(pos), static_cast<uint32_t>(length)};
+    queues[(static_cast<uint32_t>(channel) << 16) | key].push_back(rec);
+    pos += length;
+  }
+  if (pos != trace.size()) {
+    Module::logger.error("Trace is truncated, replaying the complete records");
+  }
+  duration = time;
+
+  speed = (factor > 0.0f) ? factor : MaxSpeed;
+  start = std::chrono::steady_clock::now();
+  mode = ReplayMode;
+
+  std::ostringstream msg;
+  msg << "Replaying " << duration / 1000000 << " s trace from " << path << " at " << speed << "x";
+  std::string msgStr = msg.str();
+  Module::logger.info(msgStr.c_str());
+  return true;
+}
+
+// Flush and close the trace
+void Recorder::close() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (mode == RecordMode && file.is_open()) {
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    buffer.clear();
+    file.close();
+  }
+}
+
+// Record a device interaction
+void Recorder::record(uint8_t channel, uint16_t key, const uint8_t *data, size_t len) {
+  if (mode != RecordMode || channel >= NChannels) return;
+
+  uint64_t time = elapsed(std::chrono::steady_clock::now());
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Threads may race between reading the clock and taking the lock
+  if (time < lastTime) time = lastTime;
+  putVarint(time - lastTime);
+  lastTime = time;
+
+  buffer.push_back(channel);
+  buffer.push_back(key & 0xFF);
+  buffer.push_back(key >> 8);
+  putVarint(len);
+  buffer.insert(buffer.end(), data, data + len);
+
+  records[channel]++;
+  bytes[channel] += len;
+
+  if (buffer.size() >= BufferSize) {
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    buffer.clear();
+  }
+}
+
+// Replay the next interaction for (channel, key) into a fixed buffer
+int Recorder::replay(uint8_t channel, uint16_t key, uint8_t *data, size_t len) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<uint32_t, std::deque<trace_record_t> >::iterator it = queues.find((static_cast<uint32_t>(channel) << 16) | key);
+  if (it == queues.end() || it->second.empty()) return -1;
+
+  trace_record_t rec = it->second.front();
+  it->second.pop_front();
+
+  std::memcpy(data, trace.data() + rec.offset, std::min(len, static_cast<size_t>(rec.length)));
+  records[channel]++;
+  bytes[channel] += rec.length;
+  return static_cast<int>(rec.length);
+}
+
+// Replay the next interaction for (channel, key) of any length
+bool Recorder::replay(uint8_t channel, uint16_t key, std::vector<uint8_t> &data) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<uint32_t, std::deque<trace_record_t> >::iterator it = queues.find((static_cast<uint32_t>(channel) << 16) | key);
+  if (it == queues.end() || it->second.empty()) return false;
+
+  trace_record_t rec = it->second.front();
+  it->second.pop_front();
+
+  data.assign(trace.begin() + rec.offset, trace.begin() + rec.offset + rec.length);
+  records[channel]++;
+  bytes[channel] += rec.length;
+  return true;
+}
+
+/**
+ * now
+ *
+ * Outside replay this is the steady clock. During replay, time advances
+ * speed times faster than real time from the start of the replay, and
+ * once it passes the end of the trace the Module loops are stopped.
+ */
+std::chrono::steady_clock::time_point Recorder::now() {
+  std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+  if (mode != ReplayMode) return t;
+
+  uint64_t virtualTime = static_cast<uint64_t>(elapsed(t) * static_cast<double>(speed));
+  if (virtualTime > duration && Module::isRunning) {
+    Module::logger.notice("End of replay trace");
+    Module::isRunning = false;
+  }
+
+  return start + std::chrono::microseconds(virtualTime);
+}
+
+// Sleep for us microseconds of (replay) time
+void Recorder::sleep(int us) {
+  if (mode == ReplayMode) {
+    us = static_cast<int>(us / speed);
+    if (us <= 0) return;
+  }
+  usleep(us);
+}
+
+// Sleep until time t of now(), on an absolute deadline when not replaying
+void Recorder::sleepUntil(std::chrono::steady_clock::time_point t) {
+  if (mode == ReplayMode) {
+    sleep(std::chrono::duration_cast<std::chrono::microseconds>(t - now()).count());
+    return;
+  }
+
+  // steady_clock is CLOCK_MONOTONIC
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+  struct timespec deadline;
+  deadline.tv_sec = ns / 1000000000ULL;
+  deadline.tv_nsec = ns % 1000000000ULL;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
+}
+
+// Print throughput and memory usage
+void Recorder::report(std::ostream &out) {
+  static const char *channelNames[NChannels] = {"", "I2C", "SPI", "GPS", "DHT", "Camera"};
+  std::lock_guard<std::mutex> lock(mutex);
+
+  double wall = elapsed(std::chrono::steady_clock::now()) * 1.0E-6;
+  double simulated = (mode == ReplayMode) ? wall * speed : wall;
+
+  out << std::fixed << std::setprecision(1);
+  out << "Wall Time:            " << wall << " s" << std::endl;
+  out << "Flight Time:          " << simulated << " s" << std::endl;
+  if (mode == ReplayMode) {
+    out << "Replay Speed:         " << simulated / std::max(wall, 1.0E-6) << "x" << std::endl;
+  }
+
+  for (int i = 1; i < NChannels; i++) {
+    out << channelNames[i] << " Records:" << std::string(13 - std::strlen(channelNames[i]), ' ');
+    out << records[i] << " (" << bytes[i] / 1024 << " KiB, " << records[i] / std::max(wall, 1.0E-6) << "/s)" << std::endl;
+  }
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    out << "Max Resident Memory:  " << usage.ru_maxrss << " KiB" << std::endl;
+  }
+  out << std::defaultfloat;
+}
+
+// Append a variable length integer to the record buffer
+void Recorder::putVarint(uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<uint8_t>(value));
+}
+
+// Read a variable length integer from the loaded trace
+bool Recorder::getVarint(size_t &pos, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < trace.size(); shift += 7) {
+    uint8_t byte = trace[pos++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+// Elapsed microseconds since start
+uint64_t Recorder::elapsed(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(t - start).count();
+}
@@ -1,4 +1,5 @@
-#include "HABPi.h"
+#include "Serializer.h"
+#include "CRC.h"
 
 // Serializer Constructor
 Serializer::Serializer() {}
@@ -190,6 +191,73 @@ void Serializer::deserialize(uint8_t *data, battery_msg_t *msg) {
   p++;
 }
 
+// Serialize Uplink Message
+void Serializer::serialize(uplink_msg_t *msg, uint8_t *data) {
+  uint8_t *p = (uint8_t *)data;
+  *p = msg->type;
+  p++;
+  *p = msg->ack_nbytes;
+  p++;
+
+  uint16_t *q = (uint16_t *)p;
+  *q = msg->img_id;
+  q++;
+  *q = msg->ack_base;
+  q++;
+
+  uint8_t *r = (uint8_t *)q;
+  for (uint16_t i = 0; i < AckBytes; i++) {
+    *r = msg->ack_bitmap[i];
+    r++;
+  }
+}
+
+// Deserialize Uplink Message
+void Serializer::deserialize(uint8_t *data, uplink_msg_t *msg) {
+  // Message Type
+  uint8_t *p = (uint8_t *)data;
+  msg->type = *p;
+  p++;
+  msg->ack_nbytes = *p;
+  p++;
+
+  uint16_t *q = (uint16_t *)p;
+  msg->img_id = *q;
+  q++;
+  msg->ack_base = *q;
+  q++;
+
+  uint8_t *r = (uint8_t *)q;
+  for (uint16_t i = 0; i < AckBytes; i++) {
+    msg->ack_bitmap[i] = *r;
+    r++;
+  }
+}
+
+/**
+ * seal
+ *
+ * Writes the trailer of a frame: the sequence number, then the CRC-16
+ * of the message and sequence number. The receiver recomputes the CRC
+ * to reject corrupt frames, and gaps in the sequence numbers show the
+ * ground station exactly which frames were lost.
+ */
+void Serializer::seal(uint8_t *frame, int size, uint16_t seq) {
+  frame[size - 4] = static_cast<uint8_t>(seq & 0xFF);
+  frame[size - 3] = static_cast<uint8_t>(seq >> 8);
+
+  uint16_t crc = CRC::crc16(frame, size - 2);
+  frame[size - 2] = static_cast<uint8_t>(crc & 0xFF);
+  frame[size - 1] = static_cast<uint8_t>(crc >> 8);
+}
+
+// Verify the CRC-16 of a frame, and read its sequence number
+bool Serializer::check(const uint8_t *frame, int size, uint16_t &seq) {
+  uint16_t crc = static_cast<uint16_t>(frame[size - 2] | (frame[size - 1] << 8));
+  seq = static_cast<uint16_t>(frame[size - 4] | (frame[size - 3] << 8));
+  return CRC::crc16(frame, size - 2) == crc;
+}
+
 // Print Sensor Message
 void Serializer::print(sensor_msg_t msg) {
   std::cout << "Type        = 0x" << std::hex << static_cast<uint16_t>(msg.type) << std::dec << std::endl;
@@ -0,0 +1,139 @@
+#include "Startup.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <exception>
+
+// Startup Constructor
+Startup::Startup() {}
+
+// Startup Destructor
+Startup::~Startup() {
+  join();
+}
+
+// Add a task run after the tasks in after, with a deadline [ms], returns its id
+int Startup::add(const char *name, std::function<bool()> fn, int deadline, const std::vector<int> &after) {
+  task_t task;
+  task.name = name;
+  task.fn = fn;
+  task.deadline = deadline;
+  task.after = after;
+  task.state = Waiting;
+  tasks.push_back(task);
+  return static_cast<int>(tasks.size()) - 1;
+}
+
+// Start every task
+void Startup::start() {
+  origin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < tasks.size(); i++) {
+    threads.push_back(std::thread(&Startup::run, this, static_cast<int>(i)));
+  }
+}
+
+// Wait for task until its deadline, returns true if its component is ready
+bool Startup::wait(int task) {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait_until(lock, deadline(task), [&]() { return finished(task); });
+  return tasks[task].state == Ready;
+}
+
+// Wait for the first of tasks to be ready, until the last of their deadlines, returns true if one is
+bool Startup::waitAny(const std::vector<int> &any) {
+  std::unique_lock<std::mutex> lock(mutex);
+  std::chrono::steady_clock::time_point until = origin;
+  for (size_t i = 0; i < any.size(); i++) until = std::max(until, deadline(any[i]));
+
+  // Stop early once one is ready, or all have finished without
+  bool found = false;
+  changed.wait_until(lock, until, [&]() {
+    bool all = true;
+    for (size_t i = 0; i < any.size(); i++) {
+      found = found || tasks[any[i]].state == Ready;
+      all = all && finished(any[i]);
+    }
+    return found || all;
+  });
+  return found;
+}
+
+// Component of task is ready
+bool Startup::ready(int task) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return tasks[task].state == Ready;
+}
+
+// Write the timeline of every task
+void Startup::report(std::ostream &out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  char line[128];
+
+  for (size_t i = 0; i < tasks.size(); i++) {
+    const task_t &task = tasks[i];
+    static const char *names[] = {"waiting", "running", "ready", "unavailable"};
+    long long begin = 0, duration = 0;
+    if (task.state != Waiting) {
+      begin = std::chrono::duration_cast<std::chrono::milliseconds>(task.begin - origin).count();
+      duration = std::chrono::duration_cast<std::chrono::milliseconds>((finished(i) ? task.end : now) - task.begin).count();
+    }
+    bool late = (finished(i) ? task.end : now) > deadline(i);
+    snprintf(line, sizeof(line), "Startup: %-12s %6lld ms +%6lld ms  %s%s", task.name, begin, duration, names[task.state], late ? " (late)" : "");
+    out << line << std::endl;
+  }
+}
+
+// Join the threads of finished tasks, and leave those still running
+void Startup::join() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < threads.size(); i++) {
+    if (!threads[i].joinable()) continue;
+    if (finished(i)) {
+      threads[i].join();
+    } else {
+      threads[i].detach();
+    }
+  }
+}
+
+/**
+ * run
+ *
+ * Waits for the predecessors of task to finish, runs it, and wakes any
+ * waiters. A task throwing an exception leaves its component unavailable.
+ * Finishing past the deadline is reported, since whoever waited for the
+ * task has carried on without it.
+ */
+void Startup::run(int task) {
+  std::function<bool()> fn;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() {
+      for (size_t i = 0; i < tasks[task].after.size(); i++) {
+        if (!finished(tasks[task].after[i])) return false;
+      }
+      return true;
+    });
+    tasks[task].state = Running;
+    tasks[task].begin = std::chrono::steady_clock::now();
+    fn = tasks[task].fn;
+  }
+
+  bool ok = false;
+  try {
+    ok = fn();
+  } catch (const std::exception &e) {
+    std::cerr << "Startup: " << tasks[task].name << " failed: " << e.what() << std::endl;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  tasks[task].state = ok ? Ready : Unavailable;
+  tasks[task].end = std::chrono::steady_clock::now();
+  if (tasks[task].end > deadline(task)) {
+    std::cout << "Startup: " << tasks[task].name << (ok ? " ready " : " unavailable ")
+              << std::chrono::duration_cast<std::chrono::milliseconds>(tasks[task].end - deadline(task)).count()
+              << " ms past its deadline" << std::endl;
+  }
+  changed.notify_all();
+}
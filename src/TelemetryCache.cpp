@@ -0,0 +1,185 @@
+#include "TelemetryCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+// TelemetryCache Constructor
+TelemetryCache::TelemetryCache(): started(false) {
+  for (int t = 0; t < NTiers; t++) {
+    tiers[t].closed = 0;
+    open(tiers[t], 0);
+  }
+}
+
+// Add a sample taken at time
+void TelemetryCache::insert(const sensor_msg_t &msg, std::chrono::steady_clock::time_point time) {
+  float values[NFields];
+  for (uint8_t f = 0; f < NFields; f++) values[f] = value(msg, f);
+
+  if (!started) {
+    origin = time;
+    started = true;
+  }
+  int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time - origin).count();
+
+  for (int t = 0; t < NTiers; t++) {
+    tier_t &tier = tiers[t];
+
+    if (t != Raw) {
+      // Close the open bucket once its interval is over, and leave an empty bucket
+      // for each interval without samples, as many as the ring holds
+      int64_t interval = elapsed / Resolution[t];
+      if (interval > tier.interval) {
+        int64_t closes = std::min(interval - tier.interval, static_cast<int64_t>(Capacity));
+        for (int64_t i = 0; i < closes; i++) {
+          close(tier);
+          open(tier, interval);
+        }
+      }
+    }
+
+    tier.openCount++;
+    for (uint8_t f = 0; f < NFields; f++) {
+      tier.openMin[f] = std::min(tier.openMin[f], values[f]);
+      tier.openMax[f] = std::max(tier.openMax[f], values[f]);
+      tier.openSum[f] += values[f];
+    }
+
+    // Every raw sample is a bucket of its own
+    if (t == Raw) {
+      close(tier);
+      open(tier, 0);
+    }
+  }
+}
+
+// Aggregate of field over the last n samples
+bool TelemetryCache::recent(uint8_t field, int n, telemetry_stats_t &stats) const {
+  return aggregate(tiers[Raw], field, n, false, stats);
+}
+
+// Aggregate of field over the last seconds
+bool TelemetryCache::window(uint8_t field, float seconds, telemetry_stats_t &stats) const {
+  int t = Second;
+  while (t < NTiers - 1 && seconds * 1000.0f > static_cast<float>((Capacity - 1) * Resolution[t])) t++;
+
+  // The open bucket is the last of the window
+  int n = static_cast<int>(std::ceil(seconds * 1000.0f / static_cast<float>(Resolution[t])));
+  return aggregate(tiers[t], field, n - 1, true, stats);
+}
+
+// Value of field in msg
+float TelemetryCache::value(const sensor_msg_t &msg, uint8_t field) {
+  switch (field) {
+    case GpsNsats: return msg.gps_nsats;
+    case GpsStatus: return msg.gps_status;
+    case GpsMode: return msg.gps_mode;
+    case GpsLat: return msg.gps_lat;
+    case GpsLon: return msg.gps_lon;
+    case GpsAlt: return msg.gps_alt;
+    case GpsGspd: return msg.gps_gspd;
+    case GpsDir: return msg.gps_dir;
+    case GpsVspd: return msg.gps_vspd;
+    case MplTemp: return msg.mpl_temp;
+    case MplPres: return msg.mpl_pres;
+    case MplAlt: return msg.mpl_alt;
+    case AhrsHead: return msg.ahrs_head;
+    case AhrsPitch: return msg.ahrs_pitch;
+    case AhrsRoll: return msg.ahrs_roll;
+    case DhtTemp: return msg.dht_temp;
+    case DhtRelh: return msg.dht_relh;
+    case BatRpi: return msg.bat_rpi;
+    case BatArd: return msg.bat_ard;
+    default: return 0.0f;
+  }
+}
+
+// Start a new open bucket
+void TelemetryCache::open(tier_t &tier, int64_t interval) {
+  tier.interval = interval;
+  tier.openCount = 0;
+  for (uint8_t f = 0; f < NFields; f++) {
+    tier.openMin[f] = INFINITY;
+    tier.openMax[f] = -INFINITY;
+    tier.openSum[f] = 0.0;
+  }
+}
+
+/**
+ * close
+ *
+ * Stores the open bucket at the next ring position, extending the prefix
+ * sums, and fills in its sparse table column: level k combines level k-1
+ * of this bucket with level k-1 of the bucket 2^(k-1) earlier, for as
+ * many levels as there are buckets before it.
+ */
+void TelemetryCache::close(tier_t &tier) {
+  int slot = static_cast<int>(tier.closed % Capacity);
+  int prev = static_cast<int>((tier.closed + Capacity - 1) % Capacity);
+  bool first = tier.closed == 0;
+
+  tier.count[slot] = (first ? 0 : tier.count[prev]) + tier.openCount;
+  for (uint8_t f = 0; f < NFields; f++) {
+    tier.sum[slot][f] = (first ? 0.0 : tier.sum[prev][f]) + tier.openSum[f];
+    tier.min[0][slot][f] = tier.openMin[f];
+    tier.max[0][slot][f] = tier.openMax[f];
+  }
+
+  for (int k = 1; k < Levels && tier.closed + 1 >= (1ULL << k); k++) {
+    int other = static_cast<int>((tier.closed - (1ULL << (k - 1))) % Capacity);
+    for (uint8_t f = 0; f < NFields; f++) {
+      tier.min[k][slot][f] = std::min(tier.min[k - 1][slot][f], tier.min[k - 1][other][f]);
+      tier.max[k][slot][f] = std::max(tier.max[k - 1][slot][f], tier.max[k - 1][other][f]);
+    }
+  }
+
+  tier.closed++;
+}
+
+// Aggregate of field over the last n closed buckets of tier, and optionally its open bucket
+bool TelemetryCache::aggregate(const tier_t &tier, uint8_t field, int n, bool withOpen, telemetry_stats_t &stats) const {
+  uint64_t count = 0;
+  double sum = 0.0;
+  float lo = INFINITY, hi = -INFINITY;
+
+  // The prefix sum of the bucket before the window must still be in the ring
+  if (field >= NFields) return false;
+  n = static_cast<int>(std::min(static_cast<uint64_t>(std::max(n, 0)), std::min(tier.closed, static_cast<uint64_t>(Capacity - 1))));
+
+  if (n > 0) {
+    uint64_t last = tier.closed - 1;
+    uint64_t first = last - n + 1;
+    int slot = static_cast<int>(last % Capacity);
+
+    count = tier.count[slot];
+    sum = tier.sum[slot][field];
+    if (first > 0) {
+      int before = static_cast<int>((first - 1) % Capacity);
+      count -= tier.count[before];
+      sum -= tier.sum[before][field];
+    }
+
+    // Two overlapping power of two spans cover the window
+    int k = 31 - __builtin_clz(static_cast<unsigned int>(n));
+    int start = static_cast<int>((first + (1ULL << k) - 1) % Capacity);
+    lo = std::min(tier.min[k][slot][field], tier.min[k][start][field]);
+    hi = std::max(tier.max[k][slot][field], tier.max[k][start][field]);
+  }
+
+  if (withOpen && tier.openCount > 0) {
+    count += tier.openCount;
+    sum += tier.openSum[field];
+    lo = std::min(lo, tier.openMin[field]);
+    hi = std::max(hi, tier.openMax[field]);
+  }
+
+  if (count == 0) return false;
+  stats.count = static_cast<uint32_t>(count);
+  stats.min = lo;
+  stats.max = hi;
+  stats.mean = static_cast<float>(sum / count);
+  return true;
+}
+
+// Initialize static constants
+const int TelemetryCache::Resolution[TelemetryCache::NTiers] = {0, 1000, 10000, 60000};
@@ -0,0 +1,425 @@
+#include "TelemetryLog.h"
+#include "CRC.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+
+// Write all of len bytes, returns false on error
+static bool writeAll(int fd, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+// Read all of len bytes at offset, returns false on error or end of file
+static bool readAll(int fd, uint8_t *data, size_t len, off_t offset) {
+  while (len > 0) {
+    ssize_t n = pread(fd, data, len, offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    len -= n;
+    offset += n;
+  }
+  return true;
+}
+
+// Check a segment header
+static bool validHeader(const uint8_t *header) {
+  uint32_t magic, crc;
+  uint16_t version;
+  memcpy(&magic, header, 4);
+  memcpy(&version, header + 4, 2);
+  memcpy(&crc, header + 12, 4);
+  return magic == TelemetryLog::Magic && version == TelemetryLog::Version && crc == CRC::crc32(header, 12);
+}
+
+// Length of the valid block starting at offset in data of size bytes, 0 if it is torn or corrupt
+static size_t validBlock(const uint8_t *data, size_t size, size_t offset) {
+  uint32_t crc;
+  uint16_t count;
+
+  if (size - offset < TelemetryLog::BlockHeaderSize) return 0;
+  memcpy(&crc, data + offset, 4);
+  memcpy(&count, data + offset + 4, 2);
+  if (count == 0 || count > TelemetryLog::BlockRecords) return 0;
+
+  size_t len = TelemetryLog::BlockHeaderSize + count * sizeof(telemetry_record_t);
+  if (size - offset < len) return 0;
+  if (crc != CRC::crc32(data + offset + 4, len - 4)) return 0;
+  return len;
+}
+
+// Read the valid entries of a sparse index, stopping at the first torn entry
+static std::vector<std::pair<uint64_t, uint32_t> > readIndex(const std::string &path) {
+  std::vector<std::pair<uint64_t, uint32_t> > entries;
+  uint8_t entry[TelemetryLog::IndexEntrySize];
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return entries;
+
+  for (off_t offset = 0; readAll(fd, entry, sizeof(entry), offset); offset += sizeof(entry)) {
+    uint64_t time;
+    uint32_t blockOffset, crc;
+    memcpy(&time, entry, 8);
+    memcpy(&blockOffset, entry + 8, 4);
+    memcpy(&crc, entry + 12, 4);
+    if (crc != CRC::crc32(entry, 12)) break;
+    entries.push_back(std::make_pair(time, blockOffset));
+  }
+
+  ::close(fd);
+  return entries;
+}
+
+// Index path of a segment
+static std::string indexPath(const std::string &path) {
+  return path.substr(0, path.size() - TelemetryLog::SegmentSuffix.size()) + TelemetryLog::IndexSuffix;
+}
+
+// TelemetryLog Constructor
+TelemetryLog::TelemetryLog(): segment(0), fd(-1), indexFd(-1), length(0), blocks(0), droppedBlocks(0), running(false) {
+  current.count = 0;
+}
+
+// TelemetryLog Destructor
+TelemetryLog::~TelemetryLog() {
+  close();
+}
+
+// Recover the last segment and start a new one
+bool TelemetryLog::open(const std::string &dir) {
+  if (isOpen()) return true;
+  directory = dir;
+
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) return false;
+
+  // Continue numbering after the last segment, once its torn tail is cut off
+  uint32_t number = 0;
+  std::vector<std::string> paths = segments(directory);
+  if (!paths.empty()) {
+    if (recover(paths.back()) < 0) return false;
+    std::string name = paths.back().substr(directory.size() + 1);
+    number = static_cast<uint32_t>(strtoul(name.c_str(), NULL, 10)) + 1;
+  }
+
+  if (!startSegment(number)) return false;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  current.count = 0;
+  running = true;
+  writer = std::thread(&TelemetryLog::run, this);
+  return true;
+}
+
+// Write out queued blocks and stop the writer
+void TelemetryLog::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  wake.notify_all();
+  if (writer.joinable()) writer.join();
+
+  if (fd >= 0) {
+    fdatasync(fd);
+    ::close(fd);
+    fd = -1;
+  }
+  if (indexFd >= 0) {
+    fdatasync(indexFd);
+    ::close(indexFd);
+    indexFd = -1;
+  }
+}
+
+// Writer running
+bool TelemetryLog::isOpen() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return running;
+}
+
+// Append a value stamped with the current time
+void TelemetryLog::append(uint8_t type, uint8_t sensor, float value) {
+  telemetry_record_t record;
+  record.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  record.type = type;
+  record.sensor = sensor;
+  record.reserved = 0;
+  record.value = value;
+  append(record);
+}
+
+// Append a record
+void TelemetryLog::append(const telemetry_record_t &record) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!running) return;
+
+  current.records[current.count++] = record;
+  if (current.count < BlockRecords) return;
+
+  // Keep the most recent data when the writer falls behind
+  if (pending.size() >= MaxPending) {
+    pending.pop_front();
+    droppedBlocks++;
+  }
+  pending.push_back(current);
+  current.count = 0;
+  lock.unlock();
+
+  wake.notify_one();
+}
+
+// Blocks dropped
+uint64_t TelemetryLog::dropped() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return droppedBlocks;
+}
+
+// Writer thread
+void TelemetryLog::run() {
+  std::deque<telemetry_block_t> batch;
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    wake.wait_for(lock, std::chrono::milliseconds(static_cast<int>(FlushInterval)), [this] { return !running || !pending.empty(); });
+
+    // Bound how long a partial block waits
+    if (pending.empty() && current.count > 0) {
+      pending.push_back(current);
+      current.count = 0;
+    }
+    if (pending.empty()) {
+      if (!running) break;
+      continue;
+    }
+
+    batch.swap(pending);
+    lock.unlock();
+
+    uint64_t failed = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+      if (!write(batch[i])) failed++;
+    }
+    batch.clear();
+
+    // One sync per batch, rather than per record as a SQLite transaction would
+    fdatasync(fd);
+    if (indexFd >= 0) fdatasync(indexFd);
+
+    lock.lock();
+    droppedBlocks += failed;
+  }
+}
+
+// Start segment number
+bool TelemetryLog::startSegment(uint32_t number) {
+  char name[16];
+  uint8_t header[HeaderSize] = {0};
+  uint32_t magic = Magic, crc;
+  uint16_t version = Version, recordSize = sizeof(telemetry_record_t);
+
+  if (fd >= 0) ::close(fd);
+  if (indexFd >= 0) ::close(indexFd);
+  fd = indexFd = -1;
+
+  snprintf(name, sizeof(name), "%08u", number);
+  std::string path = directory + "/" + name + SegmentSuffix;
+
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+  indexFd = ::open(indexPath(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+
+  memcpy(header, &magic, 4);
+  memcpy(header + 4, &version, 2);
+  memcpy(header + 6, &recordSize, 2);
+  memcpy(header + 8, &number, 4);
+  crc = CRC::crc32(header, 12);
+  memcpy(header + 12, &crc, 4);
+  if (!writeAll(fd, header, sizeof(header))) return false;
+  fdatasync(fd);
+
+  // Make the new files themselves survive a power cut
+  int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirFd >= 0) {
+    fsync(dirFd);
+    ::close(dirFd);
+  }
+
+  segment = number;
+  length = HeaderSize;
+  blocks = 0;
+  return true;
+}
+
+// Append a block to the current segment
+bool TelemetryLog::write(const telemetry_block_t &block) {
+  uint8_t buffer[BlockHeaderSize + BlockRecords * sizeof(telemetry_record_t)];
+  size_t len = BlockHeaderSize + block.count * sizeof(telemetry_record_t);
+  uint16_t reserved = 0;
+
+  // Roll over to the next segment once this one is full
+  if (length + static_cast<off_t>(len) > SegmentSize) {
+    fdatasync(fd);
+    if (indexFd >= 0) fdatasync(indexFd);
+    if (!startSegment(segment + 1)) return false;
+  }
+
+  memcpy(buffer + 4, &block.count, 2);
+  memcpy(buffer + 6, &reserved, 2);
+  memcpy(buffer + 8, &block.records[0].time, 8);
+  memcpy(buffer + BlockHeaderSize, block.records, block.count * sizeof(telemetry_record_t));
+  uint32_t crc = CRC::crc32(buffer + 4, len - 4);
+  memcpy(buffer, &crc, 4);
+
+  if (!writeAll(fd, buffer, len)) {
+    // Cut off the partial block, or move past it, so the reader does not stop there
+    if (ftruncate(fd, length) != 0) startSegment(segment + 1);
+    return false;
+  }
+
+  // Sparse index entry for the first block of every interval
+  if (blocks % IndexInterval == 0 && indexFd >= 0) {
+    uint8_t entry[IndexEntrySize];
+    uint32_t offset = static_cast<uint32_t>(length);
+    memcpy(entry, &block.records[0].time, 8);
+    memcpy(entry + 8, &offset, 4);
+    uint32_t entryCrc = CRC::crc32(entry, 12);
+    memcpy(entry + 12, &entryCrc, 4);
+    writeAll(indexFd, entry, sizeof(entry));
+  }
+
+  length += len;
+  blocks++;
+  return true;
+}
+
+// Segment files in directory, oldest first
+std::vector<std::string> TelemetryLog::segments(const std::string &directory) {
+  std::vector<std::string> paths;
+
+  DIR *dir = opendir(directory.c_str());
+  if (dir == NULL) return paths;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    std::string name = entry->d_name;
+    if (name.size() > SegmentSuffix.size() && name.compare(name.size() - SegmentSuffix.size(), SegmentSuffix.size(), SegmentSuffix) == 0) {
+      paths.push_back(directory + "/" + name);
+    }
+  }
+  closedir(dir);
+
+  // Zero padded numbers sort in order
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+/**
+ * recover
+ *
+ * Walks the blocks of a segment and cuts the file after the last one
+ * whose length and CRC check out, then drops index entries that point
+ * past it. A segment whose header never made it to disk is emptied.
+ */
+off_t TelemetryLog::recover(const std::string &path) {
+  struct stat st;
+  int segmentFd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (segmentFd < 0 || fstat(segmentFd, &st) != 0) {
+    if (segmentFd >= 0) ::close(segmentFd);
+    return -1;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  std::vector<uint8_t> data(size);
+  if (size > 0 && !readAll(segmentFd, &data[0], size, 0)) {
+    ::close(segmentFd);
+    return -1;
+  }
+
+  size_t valid = 0;
+  if (size >= HeaderSize && validHeader(&data[0])) {
+    valid = HeaderSize;
+    size_t len;
+    while ((len = validBlock(&data[0], size, valid)) > 0) valid += len;
+  }
+
+  if (valid < size) {
+    if (ftruncate(segmentFd, valid) != 0) {
+      ::close(segmentFd);
+      return -1;
+    }
+    fdatasync(segmentFd);
+  }
+  ::close(segmentFd);
+
+  // Keep the index entries that point at surviving blocks
+  std::vector<std::pair<uint64_t, uint32_t> > entries = readIndex(indexPath(path));
+  size_t keep = 0;
+  while (keep < entries.size() && entries[keep].second < valid) keep++;
+  if (truncate(indexPath(path).c_str(), keep * IndexEntrySize) != 0 && errno != ENOENT) return -1;
+
+  return static_cast<off_t>(valid);
+}
+
+/**
+ * read
+ *
+ * Starts at the last index entry no later than from, so earlier blocks
+ * are never read, then keeps the records stamped from onward. Reading
+ * stops at the first torn or corrupt block.
+ */
+bool TelemetryLog::read(const std::string &path, uint64_t from, std::vector<telemetry_record_t> &records) {
+  struct stat st;
+  uint8_t header[HeaderSize];
+
+  int segmentFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (segmentFd < 0) return false;
+  if (fstat(segmentFd, &st) != 0 || !readAll(segmentFd, header, sizeof(header), 0) || !validHeader(header)) {
+    ::close(segmentFd);
+    return false;
+  }
+
+  size_t start = HeaderSize;
+  std::vector<std::pair<uint64_t, uint32_t> > entries = readIndex(indexPath(path));
+  for (size_t i = 0; i < entries.size() && entries[i].first <= from; i++) {
+    if (entries[i].second >= HeaderSize && entries[i].second < static_cast<uint64_t>(st.st_size)) start = entries[i].second;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size) - start;
+  std::vector<uint8_t> data(size);
+  bool status = size == 0 || readAll(segmentFd, &data[0], size, start);
+  ::close(segmentFd);
+  if (!status) return false;
+
+  size_t offset = 0, len;
+  while (size > 0 && (len = validBlock(&data[0], size, offset)) > 0) {
+    uint16_t count;
+    memcpy(&count, &data[offset + 4], 2);
+    for (uint16_t i = 0; i < count; i++) {
+      telemetry_record_t record;
+      memcpy(&record, &data[offset + BlockHeaderSize + i * sizeof(record)], sizeof(record));
+      if (record.time >= from) records.push_back(record);
+    }
+    offset += len;
+  }
+
+  return true;
+}
+
+// Initialize static constants
+const std::string TelemetryLog::SegmentSuffix = ".tlog";
+const std::string TelemetryLog::IndexSuffix = ".tidx";
@@ -0,0 +1,118 @@
+#include "HABPi.h"
+
+// Return the ring of an exiting thread to spare
+Tracer::holder_t::~holder_t() {
+  if (ring == NULL) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  spare.push_back(ring);
+}
+
+// Ring of the calling thread, taken from spare or created on first use
+Tracer::ring_t &Tracer::ring() {
+  static thread_local holder_t local = {NULL};
+  if (local.ring == NULL) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Rings are never freed, so an export never sees a dangling ring, and one
+    // left by an exited thread keeps its spans, under their own tid, and
+    // carries on after them with the tid and name of the new thread
+    if (!spare.empty()) {
+      local.ring = spare.back();
+      spare.pop_back();
+      local.ring->thread.clear();
+    } else {
+      local.ring = new ring_t();
+      local.ring->head = 0;
+      rings.push_back(local.ring);
+    }
+    local.ring->id = ++threads;
+  }
+  return *local.ring;
+}
+
+// Record a completed span
+void Tracer::record(const char *name, uint64_t start, uint64_t stop) {
+  ring_t &r = ring();
+  uint64_t head = r.head.load(std::memory_order_relaxed);
+
+  trace_event_t &event = r.events[head % Capacity];
+  event.name = name;
+  event.start = start;
+  event.duration = stop - start;
+  event.tid = r.id;
+
+  // Publish the span to exports
+  r.head.store(head + 1, std::memory_order_release);
+}
+
+// Name the calling thread
+void Tracer::name(const char *thread) {
+  ring_t &r = ring();
+  std::lock_guard<std::mutex> lock(mutex);
+  r.thread = thread;
+}
+
+// Write every ring as Chrome trace-event JSON
+void Tracer::write(std::ostream &out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  bool first = true;
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < rings.size(); i++) {
+    const ring_t &r = *rings[i];
+
+    if (!r.thread.empty()) {
+      out << (first ? "" : ",") << std::endl;
+      out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r.id;
+      out << ",\"args\":{\"name\":\"" << r.thread << "\"}}";
+      first = false;
+    }
+
+    uint64_t head = r.head.load(std::memory_order_acquire);
+    uint64_t begin = (head > Capacity) ? head - Capacity + Margin : 0;
+    for (uint64_t j = begin; j < head; j++) {
+      const trace_event_t &event = r.events[j % Capacity];
+
+      // Timestamps and durations are microseconds, with ns precision
+      out << (first ? "" : ",") << std::endl;
+      out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.tid;
+      out << ",\"ts\":" << event.start / 1000 << '.' << std::setw(3) << std::setfill('0') << event.start % 1000;
+      out << ",\"dur\":" << event.duration / 1000 << '.' << std::setw(3) << std::setfill('0') << event.duration % 1000;
+      out << std::setfill(' ') << '}';
+      first = false;
+    }
+  }
+  out << std::endl << "]}" << std::endl;
+}
+
+// Atomically replace path with the trace
+bool Tracer::dump(const std::string &path) {
+  std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+    if (!out.is_open()) return false;
+    write(out);
+    if (!out.good()) return false;
+  }
+  return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// Export the trace if requested
+void Tracer::poll() {
+  if (requested.exchange(false)) {
+    TRACE_SPAN("Tracer::dump");
+    if (!dump(Path)) {
+      Module::logger.error("Unable to write trace");
+    } else {
+      Module::logger.info("Wrote trace");
+    }
+  }
+}
+
+// Initialize static variables
+const std::string Tracer::Path = "log/trace.json";
+std::mutex Tracer::mutex;
+std::vector<Tracer::ring_t *> Tracer::rings;
+std::vector<Tracer::ring_t *> Tracer::spare;
+int Tracer::threads = 0;
+std::atomic<bool> Tracer::requested(false);
@@ -0,0 +1,255 @@
+#include "VideoRing.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// VideoRing Constructor
+VideoRing::VideoRing(int preTrigger, size_t capacity, int framerate):
+  preTrigger(preTrigger), framerate(framerate), capacity(capacity), buffer(new uint8_t[capacity]),
+  written(0), pictures(0), zeros(0), header(false), slice(false), keyframe(false), nalStart(0),
+  fd(-1), position(0), last(UINT64_MAX), until(0) {}
+
+// VideoRing Destructor
+VideoRing::~VideoRing() {
+  close();
+}
+
+/**
+ * write
+ *
+ * Scans the data for NAL start codes. An SPS starts a segment, as does
+ * an IDR picture without one before it, and each slice beginning at the
+ * first macroblock starts a picture. The data is then copied into the
+ * ring, overwriting the oldest, and segments no longer needed dropped.
+ */
+void VideoRing::write(const uint8_t *data, size_t len) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (size_t i = 0; i < len; i++) {
+    uint8_t byte = data[i];
+
+    // first_mb_in_slice is zero, coded as a single set bit, on the first slice of a picture,
+    // and the event ends before the first picture past its end
+    if (slice) {
+      slice = false;
+      if (byte & 0x80) {
+        pictures++;
+        if (fd >= 0 && last == UINT64_MAX && current() > until) last = nalStart;
+      }
+    }
+
+    if (header) {
+      header = false;
+      uint8_t type = byte & 0x1F;
+      if (type == NalSps) {
+        segment(nalStart);
+        keyframe = true;
+      } else if (type == NalIdr) {
+        if (!keyframe) segment(nalStart);
+        keyframe = false;
+        slice = true;
+      } else if (type == NalSlice) {
+        keyframe = false;
+        slice = true;
+      }
+    }
+
+    // A start code is two or more zero bytes and a one, the NAL header follows it
+    if (byte == 0) {
+      zeros++;
+    } else {
+      if (byte == 1 && zeros >= 2) {
+        header = true;
+        nalStart = written + i - std::min(zeros, 3);
+      }
+      zeros = 0;
+    }
+  }
+
+  // Copy into the ring, only the last capacity bytes survive a longer write
+  size_t skip = len > capacity ? len - capacity : 0;
+  uint64_t pos = written + skip;
+  data += skip;
+  len -= skip;
+  while (len > 0) {
+    size_t offset = pos % capacity;
+    size_t n = std::min(len, capacity - offset);
+    memcpy(buffer.get() + offset, data, n);
+    pos += n;
+    data += n;
+    len -= n;
+  }
+  written = pos;
+
+  prune();
+}
+
+// Append the stream read from fd until end of file or running is cleared
+bool VideoRing::feed(int source, bool paced, const std::atomic<bool> &running) {
+  uint8_t chunk[ChunkSize];
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  int64_t start = time();
+
+  while (running) {
+    struct pollfd input = {source, POLLIN, 0};
+    int rc = poll(&input, 1, ReadInterval);
+    if (rc < 0 && errno != EINTR) return false;
+    if (rc <= 0) continue;
+
+    ssize_t n = read(source, chunk, sizeof(chunk));
+    if (n == 0) return true;
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      return false;
+    }
+    write(chunk, static_cast<size_t>(n));
+
+    // A file is read no faster than the camera would have written it
+    if (paced) {
+      std::chrono::steady_clock::time_point due = begin + std::chrono::milliseconds(time() - start);
+      while (running && std::chrono::steady_clock::now() < due) {
+        std::this_thread::sleep_for(std::min(std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now()), std::chrono::milliseconds(static_cast<int>(ReadInterval))));
+      }
+    }
+  }
+
+  return true;
+}
+
+// Write the ring and the next post [ms] of the stream to path, or extend the event being written
+bool VideoRing::trigger(const std::string &path, int post) {
+  std::lock_guard<std::mutex> lock(mutex);
+  int64_t end = current() + post;
+
+  if (fd >= 0) {
+    until = std::max(until, end);
+    if (current() <= until) last = UINT64_MAX;
+    return true;
+  }
+
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return false;
+
+  position = segments.empty() ? written : segments.front().start;
+  last = UINT64_MAX;
+  until = end;
+  return true;
+}
+
+/**
+ * flush
+ *
+ * Copies what the event has not written yet out of the ring a chunk at
+ * a time, and writes it without holding the ring, so the stream is not
+ * held up by the SD card. The event file is closed once the stream has
+ * passed the end of the event and all of it is written. Should the card
+ * fall so far behind that the ring wraps, the overwritten part is lost.
+ */
+bool VideoRing::flush() {
+  return drain(false);
+}
+
+// Write out what the event has not written yet and close it, even if the stream stopped short of its end
+bool VideoRing::finish() {
+  return drain(true);
+}
+
+// Write out the event up to its end, or all of the stream when closing
+bool VideoRing::drain(bool closing) {
+  uint8_t chunk[ChunkSize];
+
+  while (true) {
+    int out;
+    size_t n;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (fd < 0) return true;
+
+      if (written - position > capacity) position = written - capacity;
+      uint64_t end = std::min(written, last);
+      if (position >= end) {
+        if (closing || position >= last) close();
+        return true;
+      }
+
+      size_t offset = position % capacity;
+      n = static_cast<size_t>(std::min(static_cast<uint64_t>(ChunkSize), end - position));
+      n = std::min(n, capacity - offset);
+      memcpy(chunk, buffer.get() + offset, n);
+      out = fd;
+    }
+
+    size_t done = 0;
+    while (done < n) {
+      ssize_t rc = ::write(out, chunk + done, n - done);
+      if (rc < 0 && errno == EINTR) continue;
+      if (rc <= 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        close();
+        return false;
+      }
+      done += static_cast<size_t>(rc);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    position += n;
+  }
+}
+
+// An event is being written
+bool VideoRing::flushing() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return fd >= 0;
+}
+
+// Stream time [ms], from the pictures seen
+int64_t VideoRing::time() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return current();
+}
+
+// Stream held by the ring [ms]
+int64_t VideoRing::duration() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return segments.empty() ? 0 : current() - segments.front().time;
+}
+
+// Stream held by the ring [bytes]
+size_t VideoRing::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return segments.empty() ? 0 : static_cast<size_t>(written - segments.front().start);
+}
+
+// Stream time [ms], with the ring held
+int64_t VideoRing::current() const {
+  return static_cast<int64_t>(pictures) * 1000 / framerate;
+}
+
+// Start a segment at position
+void VideoRing::segment(uint64_t start) {
+  segment_t segment;
+  segment.start = start;
+  segment.time = current();
+  segments.push_back(segment);
+}
+
+// Drop segments that have been overwritten, or are older than needed to cover preTrigger
+void VideoRing::prune() {
+  while (!segments.empty() && written - segments.front().start > capacity) segments.pop_front();
+
+  int64_t now = current();
+  while (segments.size() >= 2 && segments[1].time <= now - preTrigger) segments.pop_front();
+}
+
+// Close the event file
+void VideoRing::close() {
+  if (fd < 0) return;
+  ::close(fd);
+  fd = -1;
+}
@@ -0,0 +1,133 @@
+#include "HABPi.h"
+#include <fcntl.h>
+
+// Watchdog Constructor
+Watchdog::Watchdog(): nloops(0), fd(-1), running(false) {}
+
+// Watchdog Destructor
+Watchdog::~Watchdog() {
+  stop();
+}
+
+// Add a loop with a heartbeat deadline [ms] and a stall handler, returns its id
+int Watchdog::add(const char *name, int deadline, bool critical, std::function<void(const char *stage)> onStall) {
+  if (nloops >= MaxLoops) return -1;
+
+  loop_t &loop = loops[nloops];
+  loop.name = name;
+  loop.deadline = deadline;
+  loop.critical = critical;
+  loop.onStall = onStall;
+  loop.last = now();
+  loop.stage = name;
+  loop.stalled = false;
+  loop.since = 0;
+  loop.stalls = 0;
+  loop.longest = 0;
+  loop.stuck = name;
+  return nloops++;
+}
+
+// Start supervising, feeding the hardware watchdog device unless it is empty
+bool Watchdog::start(const std::string &device) {
+  char msg[Global::MaxLength];
+
+  if (running) return true;
+
+  // Opening the device arms it
+  if (!device.empty()) {
+    fd = open(device.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+      sprintf(msg, "Watchdog: Unable to open %s: %s", device.c_str(), strerror(errno));
+      Module::logger.error(msg);
+    }
+  }
+
+  // Loops start their deadline now
+  for (int i = 0; i < nloops; i++) loops[i].last = now();
+
+  running = true;
+  supervisor = std::thread(&Watchdog::run, this);
+  return device.empty() || fd >= 0;
+}
+
+// Stop supervising, and disarm the hardware watchdog
+void Watchdog::stop() {
+  running = false;
+  if (supervisor.joinable()) supervisor.join();
+
+  // The magic close disarms the device, unless the kernel has it set to never stop
+  if (fd >= 0) {
+    if (write(fd, "V", 1) != 1) Module::logger.error("Watchdog: Unable to disarm the hardware watchdog");
+    close(fd);
+    fd = -1;
+  }
+}
+
+// Write the stalls of each loop
+void Watchdog::report(std::ostream &out) {
+  for (int i = 0; i < nloops; i++) {
+    const loop_t &loop = loops[i];
+    out << "Watchdog: " << loop.name << " loop stalled " << loop.stalls << " times";
+    if (loop.stalls > 0) out << ", longest " << loop.longest << " ms, last in " << loop.stuck;
+    out << std::endl;
+  }
+}
+
+// Supervisor thread
+void Watchdog::run() {
+  Tracer::name("watchdog");
+
+  while (running && Module::isRunning) {
+    // Feed the hardware watchdog only while the critical loops are beating
+    if (check() && fd >= 0 && write(fd, "\0", 1) != 1) {
+      Module::logger.error("Watchdog: Unable to feed the hardware watchdog");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int>(Interval)));
+  }
+}
+
+/**
+ * check
+ *
+ * Reports a loop as stalled the first time its last heartbeat is past
+ * its deadline, and calls its stall handler with the stage it is stuck
+ * in. Once it beats again the stall, from the heartbeat before it to the
+ * one after, is recorded.
+ */
+bool Watchdog::check() {
+  char msg[Global::MaxLength];
+  int64_t current = now();
+  bool healthy = true;
+
+  for (int i = 0; i < nloops; i++) {
+    loop_t &loop = loops[i];
+    int64_t last = loop.last.load(std::memory_order_relaxed);
+    bool late = current - last > loop.deadline;
+
+    if (late && !loop.stalled) {
+      loop.stalled = true;
+      loop.since = last;
+      loop.stalls++;
+      loop.stuck = loop.stage.load(std::memory_order_relaxed);
+      Metrics::count(Metrics::Stalls);
+
+      sprintf(msg, "Watchdog: %s loop stalled in %s for %lld ms", loop.name, loop.stuck, static_cast<long long>(current - last));
+      Module::logger.error(msg);
+
+      if (loop.onStall) loop.onStall(loop.stuck);
+    } else if (!late && loop.stalled) {
+      int64_t duration = last - loop.since;
+      loop.stalled = false;
+      loop.longest = std::max(loop.longest, duration);
+      Metrics::record(Metrics::Stall, static_cast<uint64_t>(duration) * 1000);
+
+      sprintf(msg, "Watchdog: %s loop recovered after %lld ms in %s", loop.name, static_cast<long long>(duration), loop.stuck);
+      Module::logger.notice(msg);
+    }
+
+    if (loop.critical && loop.stalled) healthy = false;
+  }
+
+  return healthy;
+}
@@ -0,0 +1,134 @@
+#include "XBeeApi.h"
+
+// Write one byte, escaping it if needed
+static size_t put(uint8_t byte, uint8_t *out) {
+  if (byte == XBeeApi::StartDelimiter || byte == XBeeApi::Escape || byte == XBeeApi::Xon || byte == XBeeApi::Xoff) {
+    out[0] = XBeeApi::Escape;
+    out[1] = byte ^ XBeeApi::EscapeMask;
+    return 2;
+  }
+  out[0] = byte;
+  return 1;
+}
+
+// XBeeApi Constructor
+XBeeApi::XBeeApi(): state(WaitStart), escaped(false), expected(0), count(0), len(0), sum(0), nerrors(0) {}
+
+/**
+ * decode
+ *
+ * An unescaped start delimiter always begins a new frame, so the decoder
+ * resynchronises on the next frame after line noise or a dropped byte.
+ * The last complete frame stays available until the next one completes.
+ */
+bool XBeeApi::decode(uint8_t byte) {
+  if (byte == StartDelimiter) {
+    if (state != WaitStart) nerrors++;
+    state = LengthHigh;
+    escaped = false;
+    return false;
+  }
+  if (state == WaitStart) return false;
+
+  if (byte == Escape) {
+    escaped = true;
+    return false;
+  }
+  if (escaped) {
+    byte ^= EscapeMask;
+    escaped = false;
+  }
+
+  switch (state) {
+    case LengthHigh: {
+      expected = static_cast<size_t>(byte) << 8;
+      state = LengthLow;
+    } break;
+    case LengthLow: {
+      expected |= byte;
+      count = 0;
+      sum = 0;
+      if (expected == 0 || expected > MaxFrame) {
+        nerrors++;
+        state = WaitStart;
+      } else {
+        state = FrameData;
+      }
+    } break;
+    case FrameData: {
+      data[count++] = byte;
+      sum += byte;
+      if (count == expected) state = Checksum;
+    } break;
+    case Checksum: {
+      state = WaitStart;
+      if (static_cast<uint8_t>(sum + byte) == 0xFF) {
+        len = expected;
+        return true;
+      }
+      nerrors++;
+    } break;
+  }
+  return false;
+}
+
+// Escape and delimit frame data
+size_t XBeeApi::encode(const uint8_t *frameData, size_t n, uint8_t *out) {
+  size_t k = 0;
+  uint8_t sum = 0;
+
+  out[k++] = StartDelimiter;
+  k += put(static_cast<uint8_t>(n >> 8), out + k);
+  k += put(static_cast<uint8_t>(n & 0xFF), out + k);
+  for (size_t i = 0; i < n; i++) {
+    sum += frameData[i];
+    k += put(frameData[i], out + k);
+  }
+  k += put(0xFF - sum, out + k);
+  return k;
+}
+
+// Build the frame data of a transmit request to a 64-bit address
+size_t XBeeApi::txRequest(uint64_t address, uint8_t frameId, const uint8_t *payload, size_t n, uint8_t *frameData) {
+  size_t k = 0;
+
+  frameData[k++] = TxRequest;
+  frameData[k++] = frameId;
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    frameData[k++] = static_cast<uint8_t>(address >> shift);
+  }
+  frameData[k++] = static_cast<uint8_t>(UnknownAddress >> 8);
+  frameData[k++] = static_cast<uint8_t>(UnknownAddress & 0xFF);
+
+  // Broadcast radius and transmit options, both defaults
+  frameData[k++] = 0;
+  frameData[k++] = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    frameData[k++] = payload[i];
+  }
+  return k;
+}
+
+// Find the source address and payload of a receive packet
+bool XBeeApi::rxPacket(const uint8_t *frameData, size_t n, uint64_t &source, const uint8_t *&payload, size_t &payloadLen) {
+  if (n < RxHeader || frameData[0] != RxPacket) return false;
+
+  source = 0;
+  for (int i = 1; i <= 8; i++) {
+    source = (source << 8) | frameData[i];
+  }
+  payload = frameData + RxHeader;
+  payloadLen = n - RxHeader;
+  return true;
+}
+
+// Read the frame id and delivery status of a transmit status
+bool XBeeApi::txStatus(const uint8_t *frameData, size_t n, uint8_t &frameId, uint8_t &status) {
+  if (n < StatusSize || frameData[0] != TxStatus) return false;
+
+  // Frame id, 16-bit address, transmit retry count, delivery status, discovery status
+  frameId = frameData[1];
+  status = frameData[5];
+  return true;
+}
@@ -0,0 +1,200 @@
+#include "HABPi.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+
+// Termios speed of a baud rate, B0 if unsupported
+static speed_t baudRate(int baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B0;
+  }
+}
+
+// XBeeRadio Constructor
+XBeeRadio::XBeeRadio(): fd(-1), destination(0), running(false), nextId(1) {}
+
+// XBeeRadio Destructor
+XBeeRadio::~XBeeRadio() {
+  close();
+}
+
+// Open the UART in raw mode and start the reader
+bool XBeeRadio::open(const std::string &path, int baud, uint64_t destination) {
+  char msg[Global::MaxLength];
+
+  this->destination = destination;
+  fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (fd < 0) {
+    sprintf(msg, "XBeeRadio: Unable to open %s: %s", path.c_str(), strerror(errno));
+    Module::logger.error(msg);
+    return false;
+  }
+
+  struct termios tty;
+  if (baudRate(baud) == B0 || tcgetattr(fd, &tty) != 0) {
+    Module::logger.error("XBeeRadio: Unable to configure UART");
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, baudRate(baud));
+  cfsetospeed(&tty, baudRate(baud));
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cflag &= ~CRTSCTS;
+  tcsetattr(fd, TCSANOW, &tty);
+  tcflush(fd, TCIOFLUSH);
+
+  running = true;
+  reader = std::thread(&XBeeRadio::run, this);
+
+  sprintf(msg, "XBeeRadio: Transmitting on %s at %d baud", path.c_str(), baud);
+  Module::logger.info(msg);
+  return true;
+}
+
+// Stop the reader and close the UART
+void XBeeRadio::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  slot.notify_all();
+  if (reader.joinable()) reader.join();
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+}
+
+/**
+ * send
+ *
+ * Frame ids run from 1 to 255, 0 would ask the XBee not to report a
+ * status. An id still in flight is skipped, which cannot happen while
+ * the window is much smaller than the id space.
+ */
+bool XBeeRadio::send(const uint8_t *payload, size_t n) {
+  TRACE_SPAN("XBeeRadio::send");
+  uint8_t frameData[XBeeApi::MaxFrame];
+  uint8_t encoded[XBeeApi::MaxEncoded];
+  uint8_t id;
+
+  if (fd < 0 || n > XBeeApi::MaxFrame - XBeeApi::TxHeader) return false;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!slot.wait_for(lock, std::chrono::milliseconds(static_cast<int>(SendTimeout)), [this] { return !running || inflight.size() < static_cast<size_t>(Window); })) {
+      return false;
+    }
+    if (!running) return false;
+
+    do {
+      id = nextId;
+      nextId = (nextId == 255) ? 1 : nextId + 1;
+    } while (inflight.count(id) > 0);
+    inflight[id] = std::chrono::steady_clock::now();
+  }
+
+  size_t len = XBeeApi::txRequest(destination, id, payload, n, frameData);
+  len = XBeeApi::encode(frameData, len, encoded);
+
+  // Only the broadcast loop writes, the reader thread only reads
+  size_t written = 0;
+  while (written < len) {
+    ssize_t w = write(fd, encoded + written, len - written);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) {
+      std::lock_guard<std::mutex> lock(mutex);
+      inflight.erase(id);
+      slot.notify_all();
+      return false;
+    }
+    written += w;
+  }
+  return true;
+}
+
+// Free window slots
+int XBeeRadio::space() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return Window - static_cast<int>(inflight.size());
+}
+
+// Take the oldest received payload
+bool XBeeRadio::receive(std::vector<uint8_t> &payload) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (received.empty()) return false;
+  payload.swap(received.front());
+  received.pop_front();
+  return true;
+}
+
+// Reader thread
+void XBeeRadio::run() {
+  Tracer::name("xbee");
+  uint8_t buffer[256];
+
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!running) break;
+    }
+
+    // Wake regularly to expire overdue requests and notice close
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 100) > 0) {
+      ssize_t n = read(fd, buffer, sizeof(buffer));
+      for (ssize_t i = 0; i < n; i++) {
+        if (decoder.decode(buffer[i])) handle(decoder.frame(), decoder.length());
+      }
+    }
+
+    expire(std::chrono::steady_clock::now());
+  }
+}
+
+// Handle a complete API frame
+void XBeeRadio::handle(const uint8_t *frame, size_t n) {
+  uint8_t id, status;
+  uint64_t source;
+  const uint8_t *payload;
+  size_t len;
+
+  if (XBeeApi::txStatus(frame, n, id, status)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<uint8_t, std::chrono::steady_clock::time_point>::iterator it = inflight.find(id);
+    if (it == inflight.end()) return;
+
+    Metrics::record(Metrics::RadioStatus, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - it->second).count());
+    Metrics::count(status == XBeeApi::Delivered ? Metrics::RadioDelivered : Metrics::RadioFailed);
+    inflight.erase(it);
+    slot.notify_one();
+  } else if (XBeeApi::rxPacket(frame, n, source, payload, len)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (received.size() >= MaxReceived) received.pop_front();
+    received.push_back(std::vector<uint8_t>(payload, payload + len));
+  }
+}
+
+// Give up on requests whose status is overdue
+void XBeeRadio::expire(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex);
+  bool freed = false;
+
+  for (std::map<uint8_t, std::chrono::steady_clock::time_point>::iterator it = inflight.begin(); it != inflight.end();) {
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - it->second).count() >= StatusTimeout) {
+      Metrics::count(Metrics::RadioFailed);
+      inflight.erase(it++);
+      freed = true;
+    } else {
+      ++it;
+    }
+  }
+  if (freed) slot.notify_all();
+}
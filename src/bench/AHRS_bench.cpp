@@ -0,0 +1,48 @@
+/**
+ * Orientation filter benchmarks
+ */
+#include "HABPi.h"
+#include "Bench.h"
+
+// Gyroscope [deg/s], accelerometer [g] and magnetometer [uT] samples
+static const int NSamples = 64;
+static float samples[NSamples][9];
+
+// Slowly rotating, slightly noisy sensor readings
+static bool makeSamples() {
+  for (int i = 0; i < NSamples; i++) {
+    float t = i * 0.1f;
+    samples[i][0] = 2.0f * sinf(t);
+    samples[i][1] = 1.5f * cosf(t);
+    samples[i][2] = 0.5f;
+    samples[i][3] = 0.02f * sinf(3.0f * t);
+    samples[i][4] = 0.03f * cosf(2.0f * t);
+    samples[i][5] = 0.99f;
+    samples[i][6] = 22.0f + sinf(t);
+    samples[i][7] = -5.0f + cosf(t);
+    samples[i][8] = -40.0f;
+  }
+  return true;
+}
+
+static const bool samplesReady = makeSamples();
+
+BENCHMARK(Mahony_update) {
+  Mahony filter;
+  filter.begin(70.0f);
+  for (uint64_t i = 0; i < n; i++) {
+    const float *s = samples[i % NSamples];
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+  }
+  Bench::keep(filter.getYaw());
+}
+
+BENCHMARK(Madgwick_update) {
+  Madgwick filter;
+  filter.begin(70.0f);
+  for (uint64_t i = 0; i < n; i++) {
+    const float *s = samples[i % NSamples];
+    filter.update(s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8]);
+  }
+  Bench::keep(filter.getYaw());
+}
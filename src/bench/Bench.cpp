@@ -0,0 +1,170 @@
+/**
+ * HABPi Microbenchmarks
+ *
+ * Usage: HABPi_bench [-f filter] [-r reps] [-o results.tsv] [-b baseline.tsv]
+ *
+ * Results are tab separated, one benchmark per line:
+ *   name, iterations, reps, median, mean, stddev and min [ns/op], allocs/op
+ * With a baseline, the change in median ns/op is printed as well.
+ */
+#include <time.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+
+#include "Bench.h"
+
+// Heap allocation counter
+static std::atomic<uint64_t> allocationCount(0);
+
+void *operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
+
+// Registered benchmarks, in registration order
+static std::vector<std::pair<std::string, Bench::Function> > &benchmarks() {
+  static std::vector<std::pair<std::string, Bench::Function> > list;
+  return list;
+}
+
+void Bench::add(const char *name, Function function) {
+  benchmarks().push_back(std::make_pair(std::string(name), function));
+}
+
+uint64_t Bench::allocations() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+// Monotonic time [ns]
+static uint64_t nanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Time n iterations [ns]
+static uint64_t measure(Bench::Function function, uint64_t n) {
+  uint64_t start = nanoseconds();
+  function(n);
+  return nanoseconds() - start;
+}
+
+// Load median ns/op from a previous results file
+static std::map<std::string, double> loadBaseline(const char *path) {
+  std::map<std::string, double> baseline;
+  std::ifstream in(path);
+  std::string line;
+
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream fields(line);
+    std::string name;
+    double iterations, reps, median;
+    if (fields >> name >> iterations >> reps >> median) baseline[name] = median;
+  }
+
+  return baseline;
+}
+
+int main(int argc, char *argv[]) {
+  const char *filter = "", *outPath = NULL, *baselinePath = NULL;
+  int reps = Bench::Reps, opt;
+
+  while ((opt = getopt(argc, argv, "f:r:o:b:")) != -1) {
+    switch (opt) {
+      case 'f': filter = optarg; break;
+      case 'r': reps = std::max(2, atoi(optarg)); break;
+      case 'o': outPath = optarg; break;
+      case 'b': baselinePath = optarg; break;
+      default: {
+        std::cerr << "Usage: " << argv[0] << " [-f filter] [-r reps] [-o results.tsv] [-b baseline.tsv]" << std::endl;
+        return 1;
+      }
+    }
+  }
+
+  std::map<std::string, double> baseline;
+  if (baselinePath != NULL) baseline = loadBaseline(baselinePath);
+
+  std::ostringstream results;
+  results << "# name\titerations\treps\tmedian_ns\tmean_ns\tstddev_ns\tmin_ns\tallocs" << std::endl;
+  std::cout << results.str();
+
+  for (size_t b = 0; b < benchmarks().size(); b++) {
+    const std::string &name = benchmarks()[b].first;
+    Bench::Function function = benchmarks()[b].second;
+    if (name.find(filter) == std::string::npos) continue;
+
+    // Warm up and find an iteration count lasting at least MinTime
+    uint64_t n = 1;
+    while (measure(function, n) < Bench::MinTime && n < (1ULL << 40)) n *= 2;
+
+    // Timed repetitions
+    std::vector<double> samples;
+    samples.reserve(reps);
+    uint64_t allocs = Bench::allocations();
+    for (int r = 0; r < reps; r++) {
+      samples.push_back(static_cast<double>(measure(function, n)) / n);
+    }
+    allocs = Bench::allocations() - allocs;
+
+    std::sort(samples.begin(), samples.end());
+    double mean = 0.0, var = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) mean += samples[i];
+    mean /= samples.size();
+    for (size_t i = 0; i < samples.size(); i++) var += (samples[i] - mean) * (samples[i] - mean);
+    var /= samples.size() - 1;
+    double median = (samples[(samples.size() - 1) / 2] + samples[samples.size() / 2]) / 2.0;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2);
+    line << name << '\t' << n << '\t' << reps << '\t' << median << '\t' << mean << '\t';
+    line << std::sqrt(var) << '\t' << samples.front() << '\t' << static_cast<double>(allocs) / (static_cast<double>(n) * reps);
+    results << line.str() << std::endl;
+
+    std::cout << line.str();
+    if (baseline.count(name) && baseline[name] > 0.0) {
+      std::cout << "\t(" << std::fixed << std::showpos << std::setprecision(1) << 100.0 * (median / baseline[name] - 1.0) << "%)" << std::noshowpos;
+    }
+    std::cout << std::endl;
+  }
+
+  if (outPath != NULL) {
+    std::ofstream out(outPath);
+    out << results.str();
+  }
+
+  return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * Microbenchmark Harness
+ *
+ * Each benchmark is a function that runs its operation n times. The
+ * harness doubles n until one repetition takes at least MinTime, then
+ * times Reps repetitions and reports ns/op (median, mean, standard
+ * deviation and minimum) and heap allocations/op, counted by replacing
+ * the global operator new.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-10-14
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Bench {
+public:
+  typedef void (*Function)(uint64_t n);
+
+  // Registers a benchmark at static initialization
+  struct Registrar {
+    Registrar(const char *name, Function function) { add(name, function); }
+  };
+
+  // Register a benchmark
+  static void add(const char *name, Function function);
+
+  // Number of heap allocations so far
+  static uint64_t allocations();
+
+  // Prevent the compiler from discarding a computed value
+  template <typename T>
+  static void keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+  }
+
+  // Static Constants
+
+  // Minimum duration of one repetition [ns]
+  static const uint64_t MinTime = 20000000;
+
+  // Default number of timed repetitions
+  static const int Reps = 10;
+};
+
+// Define and register a benchmark taking the iteration count n
+#define BENCHMARK(name) \
+  static void name(uint64_t n); \
+  static Bench::Registrar name##_registrar(#name, name); \
+  static void name(uint64_t n)
@@ -0,0 +1,28 @@
+/**
+ * Camera palette mapping benchmark
+ */
+#include "HABPi.h"
+#include "Bench.h"
+
+// Map a thumbnail of palette colours, as produced by the VGA remap, to indices
+BENCHMARK(Camera_remap_thumbnail) {
+  static Camera camera;
+  static std::vector<uint8_t> rgb, indices;
+  const int w = Camera::WidthSmall, h = Camera::HeightSmall;
+
+  if (rgb.empty()) {
+    rgb.resize(w * h * 3);
+    indices.resize(w * h);
+    for (int i = 0; i < w * h; i++) {
+      const rgb_t &c = camera.palette[(i * 31 + i / w) % camera.palette.size()];
+      rgb[3 * i + 0] = c.r;
+      rgb[3 * i + 1] = c.g;
+      rgb[3 * i + 2] = c.b;
+    }
+  }
+
+  for (uint64_t i = 0; i < n; i++) {
+    camera.remap(rgb.data(), w, h, 3, indices.data());
+    Bench::keep(indices[0]);
+  }
+}
@@ -0,0 +1,100 @@
+/**
+ * Serializer and CRC benchmarks
+ */
+#include "HABPi.h"
+#include "Bench.h"
+
+// Sensor message with every field populated
+static sensor_msg_t sensorMessage() {
+  sensor_msg_t msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.type = Module::SensorCmd;
+  msg.gps_nsats = 9;
+  msg.gps_status = 1;
+  msg.gps_mode = 3;
+  msg.gps_lat = 43.4584f;
+  msg.gps_lon = -80.5147f;
+  msg.gps_alt = 21345.6f;
+  msg.mpl_pres = 4.52f;
+  msg.ahrs_head = 123.4f;
+  msg.bat_rpi = 3.71f;
+  return msg;
+}
+
+// Image message with a full chunk
+static image_msg_t imageMessage() {
+  image_msg_t msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.type = Module::ImageCmd;
+  msg.img_chunksize = Serializer::ChunkSize;
+  for (int i = 0; i < Serializer::ChunkSize; i++) msg.img_chunk[i] = static_cast<uint8_t>(i * 7);
+  msg.img_id = 42;
+  msg.img_chunk_id = 17;
+  msg.img_nchunks = 873;
+  msg.img_w = 320;
+  msg.img_h = 240;
+  return msg;
+}
+
+BENCHMARK(Serializer_serialize_sensor) {
+  Serializer serializer;
+  sensor_msg_t msg = sensorMessage();
+  uint8_t payload[Serializer::SensorSize];
+  for (uint64_t i = 0; i < n; i++) {
+    serializer.serialize(&msg, payload);
+    Bench::keep(payload);
+  }
+}
+
+BENCHMARK(Serializer_deserialize_sensor) {
+  Serializer serializer;
+  sensor_msg_t msg = sensorMessage(), out;
+  uint8_t payload[Serializer::SensorSize];
+  serializer.serialize(&msg, payload);
+  for (uint64_t i = 0; i < n; i++) {
+    serializer.deserialize(payload, &out);
+    Bench::keep(out);
+  }
+}
+
+BENCHMARK(Serializer_serialize_image) {
+  Serializer serializer;
+  image_msg_t msg = imageMessage();
+  uint8_t payload[Serializer::ImageSize];
+  for (uint64_t i = 0; i < n; i++) {
+    serializer.serialize(&msg, payload);
+    Bench::keep(payload);
+  }
+}
+
+BENCHMARK(Serializer_deserialize_image) {
+  Serializer serializer;
+  image_msg_t msg = imageMessage(), out;
+  uint8_t payload[Serializer::ImageSize];
+  serializer.serialize(&msg, payload);
+  for (uint64_t i = 0; i < n; i++) {
+    serializer.deserialize(payload, &out);
+    Bench::keep(out);
+  }
+}
+
+BENCHMARK(Serializer_seal_image) {
+  Serializer serializer;
+  image_msg_t msg = imageMessage();
+  uint8_t payload[Serializer::ImageSize];
+  serializer.serialize(&msg, payload);
+  for (uint64_t i = 0; i < n; i++) {
+    serializer.seal(payload, Serializer::ImageSize, static_cast<uint16_t>(i));
+    Bench::keep(payload);
+  }
+}
+
+BENCHMARK(CRC_crc32_4k) {
+  uint8_t block[4096];
+  for (int i = 0; i < 4096; i++) block[i] = static_cast<uint8_t>(i * 31);
+  for (uint64_t i = 0; i < n; i++) {
+    block[0] = static_cast<uint8_t>(i);
+    uint32_t crc = CRC::crc32(block, sizeof(block));
+    Bench::keep(crc);
+  }
+}
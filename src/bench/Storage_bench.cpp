@@ -0,0 +1,65 @@
+/**
+ * Database and logger benchmarks
+ *
+ * Both write to temporary files under /tmp, which should be on the
+ * same storage as the flight database for representative results.
+ */
+#include "HABPi.h"
+#include "Bench.h"
+
+static const char *BenchLog = "/tmp/habpi_bench";
+static const char *BenchDB = "/tmp/habpi_bench.sqlite3";
+static const char *BenchTelemetry = "/tmp/habpi_bench_telemetry";
+
+// Send the module log to temporary files
+static bool startLogger() {
+  static bool started = false;
+  if (!started) {
+    Module::logger.startup(BenchLog);
+    started = true;
+  }
+  return started;
+}
+
+BENCHMARK(Logger_log) {
+  startLogger();
+  for (uint64_t i = 0; i < n; i++) {
+    Module::logger.log(Logger::InfoTag.c_str(), "Benchmark message of typical length for the log");
+  }
+}
+
+BENCHMARK(Database_insertRecord) {
+  static Database database;
+  static bool connected = false;
+  char data[] = "43.458416";
+
+  if (!connected) {
+    startLogger();
+    unlink(BenchDB);
+    database.connect(BenchDB);
+
+    sqlite3 *db;
+    sqlite3_open(BenchDB, &db);
+    sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS message (id INTEGER PRIMARY KEY AUTOINCREMENT, message_type_id INTEGER, "
+                     "sensor_type_id INTEGER, message STRING NOT NULL, created_at DATETIME);", 0, 0, 0);
+    sqlite3_close(db);
+    connected = true;
+  }
+
+  for (uint64_t i = 0; i < n; i++) {
+    database.insertRecord(MSG_GPS_LAT, data);
+  }
+}
+
+BENCHMARK(TelemetryLog_append) {
+  static TelemetryLog telemetry;
+
+  // Each run starts a new segment after those of earlier runs
+  if (!telemetry.isOpen()) {
+    telemetry.open(BenchTelemetry);
+  }
+
+  for (uint64_t i = 0; i < n; i++) {
+    telemetry.append(MSG_GPS_LAT, SENSOR_GPS, 43.458416f);
+  }
+}
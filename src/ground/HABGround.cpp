@@ -0,0 +1,92 @@
+/**
+ * HABPi Ground Station
+ *
+ * Running on the ground station computer, this program reads the frames
+ * received by the station XBee (in API mode 2) from its serial port,
+ * stores the telemetry in a sqlite3 database, and reassembles the
+ * broadcast thumbnails into preview images as their chunks arrive.
+ *
+ * Author: Chris Capobianco
+ * Date: 2018-12-09
+ */
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "Ingest.h"
+
+// Address of the HABPi radio
+static const uint64_t HABPiAddress = 0x0013A20040F32EA5ULL;
+
+static std::atomic<bool> isRunning(true);
+
+// Signal Handler
+void signalHandler(int) {
+  isRunning = false;
+}
+
+// Print usage
+void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [-b baud] [-a address] [-o directory] /dev/ttyUSB0 /path/to/ground.sqlite3" << std::endl;
+  std::cerr << "  -b  Serial rate of the station XBee (default " << Ingest::DefaultBaud << ")" << std::endl;
+  std::cerr << "  -a  64-bit address of the HABPi XBee in hex, for acknowledgements" << std::endl;
+  std::cerr << "  -o  Directory for preview images (default images)" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  int baud = Ingest::DefaultBaud;
+  uint64_t address = HABPiAddress;
+  std::string directory = "images";
+  int opt;
+
+  signal(SIGINT, signalHandler);
+  signal(SIGTERM, signalHandler);
+  signal(SIGHUP, signalHandler);
+
+  while ((opt = getopt(argc, argv, "b:a:o:")) != -1) {
+    switch (opt) {
+      case 'b': {
+        baud = atoi(optarg);
+      } break;
+      case 'a': {
+        address = strtoull(optarg, NULL, 16);
+      } break;
+      case 'o': {
+        directory = optarg;
+      } break;
+      default: {
+        usage(argv[0]);
+        return 1;
+      } break;
+    }
+  }
+
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  TelemetryStore store;
+  if (!store.open(argv[optind + 1])) return 1;
+
+  ImageAssembler assembler(directory);
+  Ingest ingest(store, assembler, address);
+  if (!ingest.open(argv[optind], baud)) return 1;
+
+  std::cout << "Receiving on " << argv[optind] << " at " << baud << " baud" << std::endl;
+
+  while (isRunning) {
+    if (!ingest.step(1000)) {
+      std::cerr << "Serial port failed" << std::endl;
+      break;
+    }
+  }
+
+  ingest.close();
+  store.close();
+  ingest.report(std::cout);
+  return 0;
+}
@@ -0,0 +1,162 @@
+#include "ImageAssembler.h"
+#include "Palette.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// ImageAssembler Constructor
+ImageAssembler::ImageAssembler(const std::string &directory): directory(directory) {}
+
+// ImageAssembler Destructor
+ImageAssembler::~ImageAssembler() {}
+
+// Add a chunk
+bool ImageAssembler::add(const image_msg_t &msg, std::chrono::steady_clock::time_point now) {
+  int pixels = msg.img_w * msg.img_h;
+  int nchunks = (pixels + Serializer::ChunkSize - 1) / Serializer::ChunkSize;
+  if (pixels == 0 || pixels > MaxPixels || msg.img_nchunks != nchunks || msg.img_chunk_id >= nchunks) return false;
+
+  std::map<uint16_t, assembly_t>::iterator it = images.find(msg.img_id);
+
+  // The same id with a different size is a new image, the flight computer has restarted
+  if (it != images.end() && (it->second.width != msg.img_w || it->second.height != msg.img_h)) {
+    images.erase(it);
+    it = images.end();
+  }
+
+  if (it == images.end()) {
+    // Make room by dropping the image least recently received
+    while (images.size() >= MaxImages) {
+      std::map<uint16_t, assembly_t>::iterator oldest = images.begin();
+      for (std::map<uint16_t, assembly_t>::iterator i = images.begin(); i != images.end(); ++i) {
+        if (i->second.lastChunk < oldest->second.lastChunk) oldest = i;
+      }
+      images.erase(oldest);
+    }
+
+    assembly_t &image = images[msg.img_id];
+    image.nchunks = msg.img_nchunks;
+    image.width = msg.img_w;
+    image.height = msg.img_h;
+    image.received = 0;
+    image.pixels.assign(pixels, 0);
+    image.have.assign(nchunks, false);
+    image.dirty = false;
+    image.lastPreview = std::chrono::steady_clock::time_point();
+    it = images.find(msg.img_id);
+  }
+
+  assembly_t &image = it->second;
+  image.lastChunk = now;
+  if (image.have[msg.img_chunk_id]) return false;
+
+  // The last chunk is padded past the end of the image
+  int offset = msg.img_chunk_id * Serializer::ChunkSize;
+  int n = std::min(static_cast<int>(Serializer::ChunkSize), pixels - offset);
+  std::memcpy(&image.pixels[offset], msg.img_chunk, n);
+
+  image.have[msg.img_chunk_id] = true;
+  image.received++;
+  image.dirty = true;
+  return true;
+}
+
+// Write the previews that are due
+void ImageAssembler::poll(std::chrono::steady_clock::time_point now, TelemetryStore &store) {
+  for (std::map<uint16_t, assembly_t>::iterator it = images.begin(); it != images.end(); ++it) {
+    assembly_t &image = it->second;
+    if (!image.dirty) continue;
+
+    bool done = image.received == image.nchunks;
+    int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - image.lastPreview).count();
+    if (!done && elapsed < PreviewInterval) continue;
+
+    image.lastPreview = now;
+    image.dirty = false;
+    if (!write(it->first, image)) continue;
+
+    image_row_t row;
+    row.id = it->first;
+    row.nchunks = image.nchunks;
+    row.received = image.received;
+    row.width = image.width;
+    row.height = image.height;
+    row.path = path(it->first);
+    row.updatedAt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() * 1.0E-6;
+    store.add(row);
+  }
+}
+
+// Time until a preview is due
+int ImageAssembler::timeout(std::chrono::steady_clock::time_point now) {
+  int wait = -1;
+  for (std::map<uint16_t, assembly_t>::iterator it = images.begin(); it != images.end(); ++it) {
+    const assembly_t &image = it->second;
+    if (!image.dirty) continue;
+
+    int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - image.lastPreview).count();
+    int due = (image.received == image.nchunks || elapsed >= PreviewInterval) ? 0 : PreviewInterval - elapsed;
+    if (wait < 0 || due < wait) wait = due;
+  }
+  return wait;
+}
+
+// Image has all of its chunks
+bool ImageAssembler::complete(uint16_t id) {
+  std::map<uint16_t, assembly_t>::iterator it = images.find(id);
+  return it != images.end() && it->second.received == it->second.nchunks;
+}
+
+// Build the uplink acknowledgement of an image
+bool ImageAssembler::ack(uint16_t id, uplink_msg_t &msg) {
+  std::map<uint16_t, assembly_t>::iterator it = images.find(id);
+  if (it == images.end()) return false;
+  const assembly_t &image = it->second;
+
+  int base = 0;
+  while (base < image.nchunks && image.have[base]) base++;
+
+  std::memset(&msg, 0, sizeof(msg));
+  msg.img_id = id;
+  msg.ack_base = base;
+
+  int end = std::min(static_cast<int>(image.nchunks), base + 8 * Serializer::AckBytes);
+  for (int i = base; i < end; i++) {
+    if (image.have[i]) msg.ack_bitmap[(i - base) / 8] |= 1 << ((i - base) % 8);
+  }
+  msg.ack_nbytes = (end - base + 7) / 8;
+  return true;
+}
+
+// Preview path of an image
+std::string ImageAssembler::path(uint16_t id) {
+  std::ostringstream name;
+  name << directory << "/preview_" << id << ".png";
+  return name.str();
+}
+
+// Write the preview PNG, replacing the previous one atomically so viewers never see a partial file
+bool ImageAssembler::write(uint16_t id, assembly_t &image) {
+  std::vector<uint8_t> rgb(3 * image.pixels.size());
+  for (size_t i = 0; i < image.pixels.size(); i++) {
+    const rgb_t &c = Palette::Vga[image.pixels[i]];
+    rgb[3*i] = c.r;
+    rgb[3*i + 1] = c.g;
+    rgb[3*i + 2] = c.b;
+  }
+
+  std::string final = path(id);
+  std::string tmp = final + ".tmp";
+  if (stbi_write_png(tmp.c_str(), image.width, image.height, 3, rgb.data(), 3 * image.width) == 0 ||
+      std::rename(tmp.c_str(), final.c_str()) != 0) {
+    std::cerr << "ImageAssembler: Unable to write " << final << std::endl;
+    return false;
+  }
+  return true;
+}
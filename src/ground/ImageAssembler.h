@@ -0,0 +1,79 @@
+/**
+ * Ground Image Assembler
+ *
+ * Reassembles broadcast thumbnails from their chunks, keyed by img_id and
+ * img_chunk_id, in whatever order and however often the chunks arrive.
+ * Each image being received is written to a preview PNG as it fills in,
+ * at most every PreviewInterval and as soon as it completes, so it can be
+ * watched while the rest is still on the way. Missing chunks show black.
+ *
+ * The assembler also builds the uplink acknowledgement of an image, the
+ * first missing chunk followed by a bitmap of the chunks after it.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-09
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Serializer.h"
+#include "TelemetryStore.h"
+
+// Image being reassembled
+struct assembly_t {
+  uint16_t nchunks, width, height, received;
+  std::vector<uint8_t> pixels;
+  std::vector<bool> have;
+  bool dirty;
+  std::chrono::steady_clock::time_point lastChunk, lastPreview;
+};
+
+class ImageAssembler {
+public:
+  // ImageAssembler Constructor, previews are written to directory
+  ImageAssembler(const std::string &directory);
+
+  // ImageAssembler Destructor
+  ~ImageAssembler();
+
+  // Add a chunk, returns false if it was a duplicate or inconsistent with its image
+  bool add(const image_msg_t &msg, std::chrono::steady_clock::time_point now);
+
+  // Write the previews that are due, queueing each image's progress in the store
+  void poll(std::chrono::steady_clock::time_point now, TelemetryStore &store);
+
+  // Time until a preview is due [ms], -1 if none is pending
+  int timeout(std::chrono::steady_clock::time_point now);
+
+  // Image has all of its chunks
+  bool complete(uint16_t id);
+
+  // Build the uplink acknowledgement of an image, returns false if the image is unknown
+  bool ack(uint16_t id, uplink_msg_t &msg);
+
+  // Preview path of an image
+  std::string path(uint16_t id);
+
+  // Static Constants
+
+  // Minimum time between previews of an incomplete image [ms]
+  static const int PreviewInterval = 1000;
+
+  // Images kept, the least recently received is dropped first
+  static const size_t MaxImages = 8;
+
+  // Largest image accepted
+  static const int MaxPixels = 640 * 480;
+
+private:
+  // Write the preview PNG of an image, returns false on error
+  bool write(uint16_t id, assembly_t &image);
+
+  std::string directory;
+  std::map<uint16_t, assembly_t> images;
+};
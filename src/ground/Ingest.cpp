@@ -0,0 +1,252 @@
+#include "Ingest.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Termios speed of a baud rate, B0 if unsupported
+static speed_t baudRate(int baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B0;
+  }
+}
+
+// Ingest Constructor
+Ingest::Ingest(TelemetryStore &store, ImageAssembler &assembler, uint64_t remote):
+  store(store), assembler(assembler), remote(remote), fd(-1), expected(0), synced(false),
+  currentImage(0), haveImage(false), ackRetries(0), uplinkSeq(0) {
+  std::memset(&counters, 0, sizeof(counters));
+}
+
+// Ingest Destructor
+Ingest::~Ingest() {
+  close();
+}
+
+// Open the serial port in raw mode
+bool Ingest::open(const std::string &device, int baud) {
+  speed_t speed = baudRate(baud);
+  if (speed == B0) {
+    std::cerr << "Ingest: Unsupported baud rate " << baud << std::endl;
+    return false;
+  }
+
+  fd = ::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "Ingest: Unable to open " << device << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  struct termios tty;
+  if (tcgetattr(fd, &tty) != 0) {
+    std::cerr << "Ingest: " << device << " is not a terminal" << std::endl;
+    close();
+    return false;
+  }
+  cfmakeraw(&tty);
+  cfsetispeed(&tty, speed);
+  cfsetospeed(&tty, speed);
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cc[VMIN] = 0;
+  tty.c_cc[VTIME] = 0;
+  if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+    std::cerr << "Ingest: Unable to configure " << device << ": " << strerror(errno) << std::endl;
+    close();
+    return false;
+  }
+  return true;
+}
+
+// Close the serial port
+void Ingest::close() {
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+}
+
+/**
+ * step
+ *
+ * The wait is cut short by whatever is due first, the telemetry batch,
+ * a preview or an acknowledgement, so none of them waits on the radio.
+ */
+bool Ingest::step(int maxWait) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  int wait = maxWait;
+
+  int due = store.timeout(now);
+  if (due >= 0 && due < wait) wait = due;
+  due = assembler.timeout(now);
+  if (due >= 0 && due < wait) wait = due;
+  if (haveImage && ackRetries < AckRetries && !assembler.complete(currentImage)) {
+    int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastChunk).count();
+    due = std::max(0, AckTimeout - elapsed);
+    if (due < wait) wait = due;
+  }
+
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  int ready = poll(&pfd, 1, wait);
+  if (ready < 0 && errno != EINTR) return false;
+
+  if (ready > 0) {
+    uint8_t buffer[ReadSize];
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno != EAGAIN && errno != EINTR) return false;
+    if (n == 0 && (pfd.revents & POLLHUP)) return false;
+
+    now = std::chrono::steady_clock::now();
+    for (ssize_t i = 0; i < n; i++) {
+      if (!decoder.decode(buffer[i])) continue;
+
+      uint64_t source;
+      const uint8_t *payload;
+      size_t len;
+      if (XBeeApi::rxPacket(decoder.frame(), decoder.length(), source, payload, len)) {
+        handle(payload, len, now);
+      }
+    }
+  }
+
+  now = std::chrono::steady_clock::now();
+  assembler.poll(now, store);
+  store.poll(now);
+
+  // Acknowledge an incomplete image once its chunks stop arriving
+  if (haveImage && ackRetries < AckRetries && !assembler.complete(currentImage) &&
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - lastChunk).count() >= AckTimeout) {
+    lastChunk = now;
+    ackRetries++;
+    sendAck(currentImage);
+  }
+  return true;
+}
+
+// Handle the payload of one received packet
+void Ingest::handle(const uint8_t *payload, size_t len, std::chrono::steady_clock::time_point now) {
+  uint8_t frame[Serializer::PayloadSize];
+  uint16_t seq;
+
+  counters.frames++;
+
+  // The Arduino relay pads sensor frames to the image frame size, the type gives the real length
+  size_t size = (len > 0 && payload[0] == SensorType) ? static_cast<size_t>(Serializer::SensorSize) : static_cast<size_t>(Serializer::ImageSize);
+  if (len < size || !serializer.check(payload, static_cast<int>(size), seq)) {
+    counters.crcErrors++;
+    return;
+  }
+  sequence(seq);
+
+  // The serializer reads fields in place, so work on an aligned copy
+  std::memcpy(frame, payload, size);
+
+  if (frame[0] == SensorType) {
+    sensor_msg_t msg;
+    serializer.deserialize(frame, &msg);
+    double receivedAt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count() * 1.0E-6;
+    store.add(msg, seq, receivedAt);
+    counters.sensor++;
+
+    std::cout << "Sensor " << seq << ": " << msg.gps_lat << ", " << msg.gps_lon << ", " << msg.gps_alt << " m, ";
+    std::cout << msg.mpl_alt << " m baro, " << msg.bat_rpi << " V" << std::endl;
+  } else if (frame[0] == ImageType) {
+    image_msg_t msg;
+    serializer.deserialize(frame, &msg);
+
+    // A new image starts, acknowledge what arrived of the previous one
+    if (haveImage && msg.img_id != currentImage && !assembler.complete(currentImage)) {
+      sendAck(currentImage);
+    }
+    currentImage = msg.img_id;
+    haveImage = true;
+    lastChunk = now;
+    ackRetries = 0;
+
+    if (!assembler.add(msg, now)) {
+      counters.duplicates++;
+      return;
+    }
+    counters.chunks++;
+
+    // Acknowledge on the last chunk, and on the last missing chunk of a resend
+    if (msg.img_chunk_id == msg.img_nchunks - 1 || assembler.complete(msg.img_id)) {
+      sendAck(msg.img_id);
+    }
+  }
+}
+
+// Print the counters
+void Ingest::report(std::ostream &out) {
+  out << "Frames:      " << counters.frames << std::endl;
+  out << "Sensor:      " << counters.sensor << std::endl;
+  out << "Chunks:      " << counters.chunks << std::endl;
+  out << "Duplicates:  " << counters.duplicates << std::endl;
+  out << "CRC Errors:  " << counters.crcErrors << std::endl;
+  out << "Lost:        " << counters.lost << std::endl;
+  out << "ACKs Sent:   " << counters.acks << std::endl;
+  out << "XBee Errors: " << decoder.errors() << std::endl;
+  out << "Rows Stored: " << store.written() << std::endl;
+}
+
+// Count frames missing before sequence number seq
+void Ingest::sequence(uint16_t seq) {
+  uint16_t gap = static_cast<uint16_t>(seq - expected);
+
+  // Frames behind the expected number are repeats, such as the radio's emergency broadcasts
+  if (!synced || gap < 0x8000) {
+    if (synced) counters.lost += gap;
+    expected = static_cast<uint16_t>(seq + 1);
+    synced = true;
+  }
+}
+
+// Send the uplink acknowledgement of an image
+void Ingest::sendAck(uint16_t id) {
+  uplink_msg_t msg;
+  if (!assembler.ack(id, msg)) return;
+  msg.type = UplinkType;
+
+  uint8_t payload[Serializer::UplinkSize] = {0};
+  serializer.serialize(&msg, payload);
+  serializer.seal(payload, Serializer::UplinkSize, uplinkSeq++);
+
+  // Frame id 0 asks the radio not to report the delivery status
+  uint8_t frameData[XBeeApi::MaxFrame];
+  uint8_t encoded[XBeeApi::MaxEncoded];
+  size_t n = XBeeApi::txRequest(remote, 0, payload, Serializer::UplinkSize, frameData);
+  n = XBeeApi::encode(frameData, n, encoded);
+
+  size_t written = 0;
+  while (written < n) {
+    ssize_t w = write(fd, encoded + written, n - written);
+    if (w < 0 && errno == EINTR) continue;
+
+    // Wait for the port to drain rather than spinning on it
+    if (w < 0 && errno == EAGAIN) {
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLOUT;
+      pfd.revents = 0;
+      int ready = poll(&pfd, 1, WriteTimeout);
+      if (ready > 0 || (ready < 0 && errno == EINTR)) continue;
+      if (ready == 0) errno = ETIMEDOUT;
+    }
+    if (w <= 0) {
+      std::cerr << "Ingest: Unable to send acknowledgement: " << strerror(errno) << std::endl;
+      return;
+    }
+    written += w;
+  }
+  counters.acks++;
+}
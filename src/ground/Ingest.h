@@ -0,0 +1,110 @@
+/**
+ * Ground Station Ingest
+ *
+ * Reads XBee API mode 2 frames from the station radio's serial port,
+ * checks the CRC-16 trailer of each HABPi frame, and dispatches sensor
+ * frames to the telemetry store and image chunks to the assembler. Gaps
+ * in the frame sequence numbers are counted as lost frames.
+ *
+ * Image chunks are acknowledged to the balloon with uplink frames, when
+ * the last chunk of an image arrives, when the next image starts, and
+ * after AckTimeout without a chunk, so only missing chunks are resent.
+ *
+ * Everything runs on one thread: step() waits on the port until data
+ * arrives or the next batch, preview or acknowledgement is due.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-09
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "Serializer.h"
+#include "XBeeApi.h"
+#include "TelemetryStore.h"
+#include "ImageAssembler.h"
+
+// Ingest counters
+struct ingest_stats_t {
+  uint64_t frames, sensor, chunks, duplicates, crcErrors, lost, acks;
+};
+
+class Ingest {
+public:
+  // Ingest Constructor, acknowledgements are sent to the radio at 64-bit address remote
+  Ingest(TelemetryStore &store, ImageAssembler &assembler, uint64_t remote);
+
+  // Ingest Destructor
+  ~Ingest();
+
+  // Open the serial port (or pty) in raw mode, returns false on error
+  bool open(const std::string &device, int baud);
+
+  // Close the serial port
+  void close();
+
+  // Wait up to maxWait [ms] for data, then process it and anything due, returns false if the port failed
+  bool step(int maxWait);
+
+  // Handle the payload of one received packet
+  void handle(const uint8_t *payload, size_t len, std::chrono::steady_clock::time_point now);
+
+  // Counters so far
+  const ingest_stats_t &stats() const { return counters; }
+
+  // Print the counters
+  void report(std::ostream &out);
+
+  // Static Constants
+
+  // Message types, as sent by the flight computer
+  static const uint8_t SensorType = 0x60;
+  static const uint8_t ImageType = 0x70;
+  static const uint8_t UplinkType = 0xA0;
+
+  // Time without a chunk before an incomplete image is acknowledged [ms]
+  static const int AckTimeout = 5000;
+
+  // Acknowledgements sent for an image without receiving a chunk
+  static const int AckRetries = 5;
+
+  // Longest wait for the port to accept an acknowledgement [ms]
+  static const int WriteTimeout = 1000;
+
+  // Bytes read from the port at a time
+  static const size_t ReadSize = 4096;
+
+  // Station radio serial rate (BD=3)
+  static const int DefaultBaud = 9600;
+
+private:
+  // Count frames missing before sequence number seq
+  void sequence(uint16_t seq);
+
+  // Send the uplink acknowledgement of an image
+  void sendAck(uint16_t id);
+
+  TelemetryStore &store;
+  ImageAssembler &assembler;
+  uint64_t remote;
+
+  int fd;
+  XBeeApi decoder;
+  Serializer serializer;
+  ingest_stats_t counters;
+
+  // Next expected sequence number
+  uint16_t expected;
+  bool synced;
+
+  // Image being acknowledged
+  uint16_t currentImage;
+  bool haveImage;
+  int ackRetries;
+  std::chrono::steady_clock::time_point lastChunk;
+  uint16_t uplinkSeq;
+};
@@ -0,0 +1,123 @@
+/**
+ * Telemetry Import
+ *
+ * Run after the flight, this program copies the records of a segmented
+ * telemetry log into the message table of the flight database, in one
+ * transaction. Each record becomes one message row with its own
+ * timestamp; the timestamp trigger, which would stamp every row with
+ * the import time, is set aside while the rows are inserted.
+ *
+ * Author: Chris Capobianco
+ * Date: 2018-12-23
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sqlite3.h>
+
+#include "TelemetryLog.h"
+
+static const char *InsertMessage =
+  "INSERT INTO message (message_type_id, sensor_type_id, message, created_at) VALUES (?, ?, ?, ?);";
+
+// Print usage
+void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [-f from] /path/to/telemetry /path/to/habpi.sqlite3" << std::endl;
+  std::cerr << "  -f  Only import records from this time on, in seconds since the epoch" << std::endl;
+}
+
+// Report a database error
+static int fail(sqlite3 *db, const char *what) {
+  std::cerr << what << ": " << sqlite3_errmsg(db) << std::endl;
+  sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+  sqlite3_close(db);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t from = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:")) != -1) {
+    switch (opt) {
+      case 'f': {
+        from = static_cast<uint64_t>(atof(optarg) * 1.0E6);
+      } break;
+      default: {
+        usage(argv[0]);
+        return 1;
+      } break;
+    }
+  }
+
+  if (argc - optind != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::string directory = argv[optind];
+  std::vector<std::string> segments = TelemetryLog::segments(directory);
+  if (segments.empty()) {
+    std::cerr << "No telemetry segments in " << directory << std::endl;
+    return 1;
+  }
+
+  sqlite3 *db;
+  sqlite3_stmt *insert = NULL, *trigger = NULL;
+  if (sqlite3_open(argv[optind + 1], &db) != SQLITE_OK) return fail(db, "Unable to open database");
+
+  if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) return fail(db, "Unable to start transaction");
+
+  // Set the timestamp trigger aside, to be restored in the same transaction
+  std::string triggerSql;
+  if (sqlite3_prepare_v2(db, "SELECT sql FROM sqlite_master WHERE type = 'trigger' AND name = 'timestamp';", -1, &trigger, NULL) != SQLITE_OK) {
+    return fail(db, "Unable to read schema");
+  }
+  if (sqlite3_step(trigger) == SQLITE_ROW) triggerSql = reinterpret_cast<const char *>(sqlite3_column_text(trigger, 0));
+  sqlite3_finalize(trigger);
+  if (!triggerSql.empty() && sqlite3_exec(db, "DROP TRIGGER timestamp;", NULL, NULL, NULL) != SQLITE_OK) {
+    return fail(db, "Unable to set aside the timestamp trigger");
+  }
+
+  if (sqlite3_prepare_v2(db, InsertMessage, -1, &insert, NULL) != SQLITE_OK) return fail(db, "Unable to prepare insert");
+
+  uint64_t imported = 0;
+  for (size_t i = 0; i < segments.size(); i++) {
+    std::vector<telemetry_record_t> records;
+    if (!TelemetryLog::read(segments[i], from, records)) {
+      std::cerr << "Skipping unreadable segment " << segments[i] << std::endl;
+      continue;
+    }
+
+    for (size_t j = 0; j < records.size(); j++) {
+      char value[32];
+      snprintf(value, sizeof(value), "%.7g", records[j].value);
+
+      sqlite3_bind_int(insert, 1, records[j].type);
+      sqlite3_bind_int(insert, 2, records[j].sensor);
+      sqlite3_bind_text(insert, 3, value, -1, SQLITE_TRANSIENT);
+      sqlite3_bind_double(insert, 4, records[j].time * 1.0E-6);
+      if (sqlite3_step(insert) != SQLITE_DONE) {
+        sqlite3_finalize(insert);
+        return fail(db, "Unable to insert record");
+      }
+      sqlite3_reset(insert);
+    }
+
+    imported += records.size();
+    std::cout << segments[i] << ": " << records.size() << " records" << std::endl;
+  }
+  sqlite3_finalize(insert);
+
+  if (!triggerSql.empty() && sqlite3_exec(db, triggerSql.c_str(), NULL, NULL, NULL) != SQLITE_OK) {
+    return fail(db, "Unable to restore the timestamp trigger");
+  }
+  if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) return fail(db, "Unable to commit");
+
+  sqlite3_close(db);
+  std::cout << "Imported " << imported << " records from " << segments.size() << " segments" << std::endl;
+  return 0;
+}
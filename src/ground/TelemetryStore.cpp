@@ -0,0 +1,160 @@
+#include "TelemetryStore.h"
+
+#include <iostream>
+
+// Tables are created on first use, so a new database file needs no setup
+static const char *Schema =
+  "CREATE TABLE IF NOT EXISTS telemetry ("
+  "id INTEGER PRIMARY KEY AUTOINCREMENT, seq INTEGER, received_at REAL, proximity INTEGER, "
+  "gps_nsats INTEGER, gps_status INTEGER, gps_mode INTEGER, gps_lat REAL, gps_lon REAL, gps_alt REAL, "
+  "gps_gspd REAL, gps_dir REAL, gps_vspd REAL, mpl_temp REAL, mpl_pres REAL, mpl_alt REAL, "
+  "ahrs_head REAL, ahrs_pitch REAL, ahrs_roll REAL, dht_temp REAL, dht_relh REAL, bat_rpi REAL, bat_ard REAL);"
+  "CREATE INDEX IF NOT EXISTS telemetry_received_at ON telemetry (received_at);"
+  "CREATE TABLE IF NOT EXISTS image ("
+  "img_id INTEGER PRIMARY KEY, nchunks INTEGER, received INTEGER, width INTEGER, height INTEGER, "
+  "path TEXT, updated_at REAL);";
+
+static const char *InsertTelemetry =
+  "INSERT INTO telemetry (seq, received_at, proximity, gps_nsats, gps_status, gps_mode, gps_lat, gps_lon, "
+  "gps_alt, gps_gspd, gps_dir, gps_vspd, mpl_temp, mpl_pres, mpl_alt, ahrs_head, ahrs_pitch, ahrs_roll, "
+  "dht_temp, dht_relh, bat_rpi, bat_ard) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+
+static const char *InsertImage =
+  "INSERT OR REPLACE INTO image (img_id, nchunks, received, width, height, path, updated_at) "
+  "VALUES (?, ?, ?, ?, ?, ?, ?);";
+
+// TelemetryStore Constructor
+TelemetryStore::TelemetryStore(): db(NULL), insertTelemetry(NULL), insertImage(NULL), nwritten(0) {}
+
+// TelemetryStore Destructor
+TelemetryStore::~TelemetryStore() {
+  close();
+}
+
+// Open or create the database
+bool TelemetryStore::open(const std::string &path) {
+  if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+    error("Unable to open database");
+    return false;
+  }
+
+  // WAL lets readers run alongside the writer, and NORMAL only syncs at checkpoints
+  if (sqlite3_exec(db, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", NULL, NULL, NULL) != SQLITE_OK ||
+      sqlite3_exec(db, Schema, NULL, NULL, NULL) != SQLITE_OK ||
+      sqlite3_prepare_v2(db, InsertTelemetry, -1, &insertTelemetry, NULL) != SQLITE_OK ||
+      sqlite3_prepare_v2(db, InsertImage, -1, &insertImage, NULL) != SQLITE_OK) {
+    error("Unable to prepare database");
+    close();
+    return false;
+  }
+  return true;
+}
+
+// Write any queued rows and close the database
+void TelemetryStore::close() {
+  if (db == NULL) return;
+  flush();
+  sqlite3_finalize(insertTelemetry);
+  sqlite3_finalize(insertImage);
+  sqlite3_close(db);
+  insertTelemetry = NULL;
+  insertImage = NULL;
+  db = NULL;
+}
+
+// Queue a sensor frame
+void TelemetryStore::add(const sensor_msg_t &msg, uint16_t seq, double receivedAt) {
+  if (telemetry.empty() && images.empty()) oldest = std::chrono::steady_clock::now();
+
+  telemetry_row_t row;
+  row.msg = msg;
+  row.seq = seq;
+  row.receivedAt = receivedAt;
+  telemetry.push_back(row);
+}
+
+// Queue the progress of an image
+void TelemetryStore::add(const image_row_t &row) {
+  if (telemetry.empty() && images.empty()) oldest = std::chrono::steady_clock::now();
+  images[row.id] = row;
+}
+
+// Write the queued rows if the batch is full or due
+void TelemetryStore::poll(std::chrono::steady_clock::time_point now) {
+  if (telemetry.size() + images.size() >= BatchSize || timeout(now) == 0) flush();
+}
+
+/**
+ * flush
+ *
+ * One transaction per batch: SQLite pays for a journal sync per commit,
+ * not per row, so batching is what lets the store keep up with the radio.
+ */
+bool TelemetryStore::flush() {
+  if (db == NULL || (telemetry.empty() && images.empty())) return true;
+  bool status = true;
+
+  sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+
+  for (size_t i = 0; i < telemetry.size() && status; i++) {
+    const telemetry_row_t &row = telemetry[i];
+    const sensor_msg_t &m = row.msg;
+    const double values[] = {
+      m.gps_lat, m.gps_lon, m.gps_alt, m.gps_gspd, m.gps_dir, m.gps_vspd,
+      m.mpl_temp, m.mpl_pres, m.mpl_alt, m.ahrs_head, m.ahrs_pitch, m.ahrs_roll,
+      m.dht_temp, m.dht_relh, m.bat_rpi, m.bat_ard
+    };
+
+    sqlite3_bind_int(insertTelemetry, 1, row.seq);
+    sqlite3_bind_double(insertTelemetry, 2, row.receivedAt);
+    sqlite3_bind_int(insertTelemetry, 3, m.proximityFlag);
+    sqlite3_bind_int(insertTelemetry, 4, m.gps_nsats);
+    sqlite3_bind_int(insertTelemetry, 5, m.gps_status);
+    sqlite3_bind_int(insertTelemetry, 6, m.gps_mode);
+    for (int j = 0; j < 16; j++) {
+      sqlite3_bind_double(insertTelemetry, 7 + j, values[j]);
+    }
+
+    status = sqlite3_step(insertTelemetry) == SQLITE_DONE;
+    sqlite3_reset(insertTelemetry);
+  }
+
+  for (std::map<uint16_t, image_row_t>::iterator it = images.begin(); it != images.end() && status; ++it) {
+    const image_row_t &row = it->second;
+    sqlite3_bind_int(insertImage, 1, row.id);
+    sqlite3_bind_int(insertImage, 2, row.nchunks);
+    sqlite3_bind_int(insertImage, 3, row.received);
+    sqlite3_bind_int(insertImage, 4, row.width);
+    sqlite3_bind_int(insertImage, 5, row.height);
+    sqlite3_bind_text(insertImage, 6, row.path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(insertImage, 7, row.updatedAt);
+
+    status = sqlite3_step(insertImage) == SQLITE_DONE;
+    sqlite3_reset(insertImage);
+  }
+
+  if (status && sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK) {
+    nwritten += telemetry.size() + images.size();
+  } else {
+    error("Unable to write batch");
+    sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    status = false;
+  }
+
+  // A failed batch is dropped rather than retried, so one bad row cannot stall the store
+  telemetry.clear();
+  images.clear();
+  return status;
+}
+
+// Time until the queued rows are due
+int TelemetryStore::timeout(std::chrono::steady_clock::time_point now) {
+  if (telemetry.empty() && images.empty()) return -1;
+  int waited = std::chrono::duration_cast<std::chrono::milliseconds>(now - oldest).count();
+  return waited >= MaxDelay ? 0 : MaxDelay - waited;
+}
+
+// Report an SQLite error
+void TelemetryStore::error(const char *what) {
+  std::cerr << "TelemetryStore: " << what << ": " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+}
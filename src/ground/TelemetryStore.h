@@ -0,0 +1,85 @@
+/**
+ * Ground Telemetry Store
+ *
+ * Writes decoded sensor frames and image progress to SQLite. Rows are
+ * queued and written together in one transaction, once BatchSize rows
+ * are waiting or the oldest has waited MaxDelay, which keeps up with the
+ * full radio rate while bounding how stale the stored data can be. The
+ * database runs in WAL mode, so displays can read it while it is written.
+ *
+ * Written By: Chris Capobianco
+ * Date: 2018-12-09
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+#include "Serializer.h"
+
+// Received sensor frame
+struct telemetry_row_t {
+  sensor_msg_t msg;
+  uint16_t seq;
+  double receivedAt;
+};
+
+// Progress of an image
+struct image_row_t {
+  uint16_t id, nchunks, received, width, height;
+  std::string path;
+  double updatedAt;
+};
+
+class TelemetryStore {
+public:
+  // TelemetryStore Constructor
+  TelemetryStore();
+
+  // TelemetryStore Destructor
+  ~TelemetryStore();
+
+  // Open or create the database, returns false on error
+  bool open(const std::string &path);
+
+  // Write any queued rows and close the database
+  void close();
+
+  // Queue a sensor frame
+  void add(const sensor_msg_t &msg, uint16_t seq, double receivedAt);
+
+  // Queue the progress of an image, replacing any queued progress of the same image
+  void add(const image_row_t &row);
+
+  // Write the queued rows if the batch is full or due
+  void poll(std::chrono::steady_clock::time_point now);
+
+  // Write the queued rows in one transaction, returns false on error
+  bool flush();
+
+  // Time until the queued rows are due [ms], -1 if none are queued
+  int timeout(std::chrono::steady_clock::time_point now);
+
+  // Rows written so far
+  uint64_t written() const { return nwritten; }
+
+  // Static Constants
+  static const size_t BatchSize = 32;
+  static const int MaxDelay = 250;  // [ms]
+
+private:
+  // Report an SQLite error
+  void error(const char *what);
+
+  sqlite3 *db;
+  sqlite3_stmt *insertTelemetry, *insertImage;
+
+  std::vector<telemetry_row_t> telemetry;
+  std::map<uint16_t, image_row_t> images;
+  std::chrono::steady_clock::time_point oldest;
+  uint64_t nwritten;
+};
@@ -54,6 +54,14 @@ void i2c_bus::close() {
 }
 
 void i2c_bus::write_byte_and_read(uint8_t address, uint8_t command, uint8_t *data, size_t size) {
+  TRACE_SPAN("i2c_bus::write_byte_and_read");
+  if (Module::recorder.replaying()) {
+    if (Module::recorder.replay(Recorder::I2CChannel, (address << 8) | command, data, size) < 0) {
+      if (Global::Debug) Module::logger.error("Failed to read to I2C");
+    }
+    return;
+  }
+
   i2c_msg messages[2] = {
     { address, 0, 1, (typeof(i2c_msg().buf)) &command },
     { address, I2C_M_RD, (typeof(i2c_msg().len)) size, (typeof(i2c_msg().buf)) data },
@@ -64,10 +72,15 @@ void i2c_bus::write_byte_and_read(uint8_t address, uint8_t command, uint8_t *dat
 
   if (result != 2) {
     if (Global::Debug) Module::logger.error("Failed to read to I2C");
+  } else if (Module::recorder.recording()) {
+    Module::recorder.record(Recorder::I2CChannel, (address << 8) | command, data, size);
   }
 }
 
 void i2c_bus::write(uint8_t address, uint8_t *data, size_t size) {
+  TRACE_SPAN("i2c_bus::write");
+  if (Module::recorder.replaying()) return;
+
   i2c_msg messages[1] = {
     { address, 0, (typeof(i2c_msg().len)) size, (typeof(i2c_msg().buf)) data }
   };
@@ -81,6 +94,11 @@ void i2c_bus::write(uint8_t address, uint8_t *data, size_t size) {
 }
 
 int i2c_bus::try_write_byte_and_read(uint8_t address, uint8_t byte, uint8_t *data, size_t size) {
+  TRACE_SPAN("i2c_bus::try_write_byte_and_read");
+  if (Module::recorder.replaying()) {
+    return Module::recorder.replay(Recorder::I2CChannel, (address << 8) | byte, data, size) < 0 ? -1 : 0;
+  }
+
   i2c_msg messages[2] = {
     { address, 0, 1, (typeof(i2c_msg().buf)) &byte },
     { address, I2C_M_RD, (typeof(i2c_msg().len))size, (typeof(i2c_msg().buf))data },
@@ -93,5 +111,9 @@ int i2c_bus::try_write_byte_and_read(uint8_t address, uint8_t byte, uint8_t *dat
     return -1;
   }
 
+  if (Module::recorder.recording()) {
+    Module::recorder.record(Recorder::I2CChannel, (address << 8) | byte, data, size);
+  }
+
   return 0;
 }
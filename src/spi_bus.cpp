@@ -102,6 +102,7 @@ uint8_t spi_bus::transferByte(uint8_t txData) {
  * and configuration parameters to the SPI device via IOCTL
  */
 void spi_bus::transferByteArray(uint16_t len, uint8_t *txData, uint8_t *rxData) {
+  TRACE_SPAN("spi_bus::transferByteArray");
   int ret;
   struct spi_ioc_transfer spi_transfer;
 
@@ -0,0 +1,93 @@
+/**
+ * Altimeter fusion test
+ *
+ * Simulates an ascent, burst and descent, feeding noisy IMU vertical
+ * acceleration (70 Hz), barometric pressure (10 Hz, with a weather
+ * offset) and GPS altitude/climb (1 Hz) into the altimeter, and reports
+ * the estimation error and how quickly the descent is detected. Then
+ * checks that outliers of one measurement are gated independently of
+ * those of another.
+ */
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+
+#include "Altimeter.h"
+#include "Expect.h"
+
+using namespace std;
+
+// Standard atmosphere pressure [kPa] at altitude [m]
+static float pressureAt(double altitude) {
+  return static_cast<float>(101.325 * pow(1.0 - 2.25577E-5 * altitude, 5.25588));
+}
+
+int main() {
+  const double dt = 1.0 / 70.0, launch = 337.0, burstTime = 1800.0, offset = 40.0;
+  const double ascent = 5.0, descent = -12.0, bias = 0.15;
+  default_random_engine rng(2018);
+  normal_distribution<double> accelNoise(0.0, 0.3), baroNoise(0.0, 2.0), gpsNoise(0.0, 10.0), climbNoise(0.0, 0.5);
+  Altimeter altimeter;
+  double h = launch, v = 0.0, sumAlt = 0.0, sumClimb = 0.0, detected = -1.0;
+  int n = 0;
+
+  for (int step = 0; h >= launch - 1.0E-6; step++) {
+    double t = step * dt;
+
+    // True vertical motion: ramp to ascent rate, then a sudden burst
+    double target = (t < burstTime) ? ascent : descent;
+    double a = max(-9.0, min(2.0, (target - v)));
+    v += a * dt;
+    h += v * dt;
+    if (t < 10.0) {
+      h = launch;
+      v = 0.0;
+      a = 0.0;
+    }
+
+    altimeter.predict(static_cast<float>(a + bias + accelNoise(rng)), static_cast<float>(dt));
+    if (step % 7 == 0) altimeter.correctPressure(pressureAt(h + offset + baroNoise(rng)));
+    if (step % 70 == 0) altimeter.correctGPS(static_cast<float>(h + gpsNoise(rng)), static_cast<float>(v + climbNoise(rng)));
+
+    if (t > 60.0) {
+      sumAlt += pow(altimeter.altitude() - h, 2);
+      sumClimb += pow(altimeter.climbRate() - v, 2);
+      n++;
+    }
+    if (detected < 0.0 && t > burstTime && altimeter.descending()) {
+      detected = t - burstTime;
+    }
+    if (step % (70 * 300) == 0) {
+      cout << fixed << setprecision(1) << "t: " << t << " s, true: " << h << " m, " << v << " m/s";
+      cout << ", estimate: " << altimeter.altitude() << " +/- " << altimeter.altitudeSigma() << " m, ";
+      cout << altimeter.climbRate() << " +/- " << altimeter.climbSigma() << " m/s" << endl;
+    }
+  }
+
+  double rmsAlt = sqrt(sumAlt / n), rmsClimb = sqrt(sumClimb / n);
+  cout << "RMS altitude error: " << setprecision(2) << rmsAlt << " m" << endl;
+  cout << "RMS climb rate error: " << rmsClimb << " m/s" << endl;
+  cout << "Descent detected after: " << detected << " s" << endl;
+
+  expect(rmsAlt <= 5.0, "altitude error within 5 m");
+  expect(rmsClimb <= 0.5, "climb rate error within 0.5 m/s");
+  expect(detected >= 0.0 && detected <= 5.0, "descent detected within 5 s");
+
+  // Settle a filter at 1000 m, then check baro spikes do not use up the GPS gate
+  Altimeter gated;
+  for (int i = 0; i < 100; i++) {
+    gated.predict(1.0f);
+    gated.correctPressure(pressureAt(1000.0));
+    gated.correctGPS(1000.0f, 0.0f);
+  }
+  for (int i = 0; i < Altimeter::MaxRejects; i++) gated.correctPressure(pressureAt(3000.0));
+  expect(fabs(gated.altitude() - 1000.0) < 5.0, "baro spikes rejected");
+  gated.correctGPS(5000.0f, 0.0f);
+  expect(fabs(gated.altitude() - 1000.0) < 5.0, "GPS spike after baro spikes rejected");
+
+  // A measurement that keeps disagreeing is accepted after MaxRejects
+  for (int i = 0; i < Altimeter::MaxRejects; i++) gated.correctPressure(pressureAt(3000.0));
+  expect(fabs(gated.altitude() - 1000.0) > 5.0, "persistent baro step accepted");
+  return failures == 0 ? 0 : 1;
+}
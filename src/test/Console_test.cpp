@@ -0,0 +1,91 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Compile trace out, as a build with -DCONSOLE_LEVEL=3 would
+#define CONSOLE_LEVEL 3
+#include "Console.h"
+#include "Expect.h"
+
+/**
+ * Captures stdout and stderr, and checks that console output is held
+ * until the buffer fills or waits long enough, that errors are written
+ * at once after it, and which levels are compiled and switched out.
+ */
+
+using namespace std;
+
+static ostringstream out, err;
+static streambuf *stdoutBuf, *stderrBuf;
+
+// Count evaluations of a message argument
+static int evaluated = 0;
+static int evaluate() {
+  return ++evaluated;
+}
+
+int main() {
+  stdoutBuf = cout.rdbuf(out.rdbuf());
+  stderrBuf = cerr.rdbuf(err.rdbuf());
+
+  // Lines are held until the buffer is flushed
+  CONSOLE_INFO("sensorLoop: " << 1);
+  expect(out.str().empty(), "info line held");
+  Console::flush();
+  expect(out.str() == "sensorLoop: 1\n", "info line written on flush");
+
+  // Errors are written at once, after what was held
+  out.str("");
+  CONSOLE_INFO("before");
+  CONSOLE_ERROR("Unable to send sensor data");
+  expect(out.str() == "before\n", "held output written before an error");
+  expect(err.str() == "Unable to send sensor data\n", "error written at once");
+
+  // A full buffer is written out
+  out.str("");
+  string line(100, 'x');
+  for (size_t i = 0; i <= Console::FlushSize / line.size(); i++) CONSOLE_INFO(line);
+  expect(!out.str().empty(), "full buffer written");
+  Console::flush();
+
+  // Held output is written once it has waited the flush interval
+  out.str("");
+  CONSOLE_INFO("imageLoop: 1");
+  Console::poll();
+  expect(out.str().empty(), "recent output held by poll");
+  this_thread::sleep_for(chrono::milliseconds(static_cast<int>(Console::FlushInterval) + 50));
+  Console::poll();
+  expect(out.str() == "imageLoop: 1\n", "output written by poll after the interval");
+
+  // Levels compiled in print up to the runtime level, without evaluating the rest
+  out.str("");
+  CONSOLE_DEBUG("debug " << evaluate());
+  expect(evaluated == 0, "debug not evaluated at info");
+  Console::level = Console::Debug;
+  CONSOLE_DEBUG("debug " << evaluate());
+  CONSOLE_TRACE("trace " << evaluate());
+  Console::level = Console::Trace;
+  CONSOLE_TRACE("trace " << evaluate());
+  Console::flush();
+  expect(evaluated == 1 && out.str() == "debug 1\n", "debug printed, trace compiled out");
+
+  // Lines written directly, as the logger does, are filtered by level too
+  out.str("");
+  err.str("");
+  Console::level = Console::Error;
+  Console::write(Console::Info, "Logger: info");
+  Console::write(Console::Warning, "Logger: warning");
+  Console::write(Console::Error, "Logger: error");
+  Console::flush();
+  expect(out.str().empty() && err.str() == "Logger: error\n", "direct writes filtered at error");
+  Console::level = Console::Info;
+
+  expect(Console::parse("warning") == Console::Warning && Console::parse("info") == Console::Info, "levels parsed");
+  expect(Console::parse("verbose") < 0, "unknown level rejected");
+  expect(Console::parse("trace") < 0, "level compiled out of Console.o rejected");
+
+  cout.rdbuf(stdoutBuf);
+  cerr.rdbuf(stderrBuf);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/**
+ * DHT edge decode test
+ *
+ * Builds the edges of a sensor reply as the GPIO character device would
+ * capture them, and checks the 40 bits are decoded from the high pulse
+ * widths, with the start signal and response pulse skipped, and that
+ * corrupt or incomplete replies are rejected.
+ */
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "DHTReader.h"
+#include "Expect.h"
+
+using namespace std;
+
+// Captured edges, the time [ns] and the level after each edge
+struct edges_t {
+  vector<uint64_t> times;
+  vector<uint8_t> levels;
+
+  void add(uint64_t time, uint8_t level) {
+    times.push_back(time);
+    levels.push_back(level);
+  }
+};
+
+// Edges of a reply carrying data, with 0 and 1 bits high for zero and one [us]
+static edges_t reply(const uint8_t data[5], uint64_t zero, uint64_t one) {
+  edges_t edges;
+  uint64_t t = 0;
+
+  // Start signal released by the host, then the 80 us response low and high
+  edges.add(t, 1);
+  t += 30000;
+  edges.add(t, 0);
+  t += 80000;
+  edges.add(t, 1);
+  t += 80000;
+  edges.add(t, 0);
+
+  // Each bit is a 50 us low and a high of its width, the reply ends low
+  for (int i = 0; i < 40; i++) {
+    bool bit = (data[i / 8] >> (7 - i % 8)) & 1;
+    t += 50000;
+    edges.add(t, 1);
+    t += (bit ? one : zero) * 1000;
+    edges.add(t, 0);
+  }
+  return edges;
+}
+
+int main() {
+  const uint8_t sent[5] = {0x37, 0x00, 0x18, 0x04, 0x53};
+  uint8_t data[5];
+
+  edges_t edges = reply(sent, 27, 70);
+  expect(DHTReader::decode(edges.times.data(), edges.levels.data(), static_cast<int>(edges.times.size()), data) &&
+         std::equal(sent, sent + 5, data), "reply decoded");
+
+  // Pulse widths off nominal, but either side of the threshold
+  edges = reply(sent, 40, 56);
+  expect(DHTReader::decode(edges.times.data(), edges.levels.data(), static_cast<int>(edges.times.size()), data) &&
+         std::equal(sent, sent + 5, data), "reply with pulse jitter decoded");
+
+  // A 0 bit stretched into a 1 fails the checksum
+  edges = reply(sent, 27, 70);
+  for (size_t i = 4 + 2 * 37 + 1; i < edges.times.size(); i++) edges.times[i] += 50000;
+  expect(!DHTReader::decode(edges.times.data(), edges.levels.data(), static_cast<int>(edges.times.size()), data), "stretched bit rejected");
+
+  // A bad checksum byte is rejected
+  const uint8_t corrupt[5] = {0x37, 0x00, 0x18, 0x04, 0x54};
+  edges = reply(corrupt, 27, 70);
+  expect(!DHTReader::decode(edges.times.data(), edges.levels.data(), static_cast<int>(edges.times.size()), data), "bad checksum rejected");
+
+  // A lost edge merges two pulses and is rejected
+  edges = reply(sent, 27, 70);
+  edges.times.erase(edges.times.begin() + 40);
+  edges.levels.erase(edges.levels.begin() + 40);
+  expect(!DHTReader::decode(edges.times.data(), edges.levels.data(), static_cast<int>(edges.times.size()), data), "lost edge rejected");
+
+  // A reply cut short has too few pulses
+  edges = reply(sent, 27, 70);
+  expect(!DHTReader::decode(edges.times.data(), edges.levels.data(), 60, data), "short reply rejected");
+
+  return failures == 0 ? 0 : 1;
+}
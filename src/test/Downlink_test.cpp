@@ -0,0 +1,110 @@
+/**
+ * Downlink acknowledgement test
+ *
+ * Queues and sends the chunks of an image, then applies ground station
+ * acknowledgements and checks which chunks are queued again: offsets of
+ * the bitmap from its base, bitmaps crossing byte boundaries or running
+ * past the last chunk, image ids wrapping around, and chunks that were
+ * already acknowledged.
+ */
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Downlink.h"
+#include "Expect.h"
+
+using namespace std;
+
+// Queue and send every chunk of image id
+static void send(Downlink &downlink, uint16_t id, uint16_t nchunks) {
+  image_msg_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.img_id = id;
+  msg.img_nchunks = nchunks;
+  for (uint16_t i = 0; i < nchunks; i++) {
+    msg.img_chunk_id = i;
+    downlink.push(msg);
+  }
+  while (downlink.pop(msg)) {}
+}
+
+// Acknowledgement of image id, every chunk below base and those set in received from base on
+static uplink_msg_t ack(uint16_t id, uint16_t base, uint8_t nbytes, const vector<int> &received) {
+  uplink_msg_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.type = 0xA0;
+  msg.img_id = id;
+  msg.ack_base = base;
+  msg.ack_nbytes = nbytes;
+  for (size_t i = 0; i < received.size(); i++) {
+    int bit = received[i] - base;
+    msg.ack_bitmap[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+  }
+  return msg;
+}
+
+// Chunk ids queued, in order
+static vector<int> queued(Downlink &downlink) {
+  vector<int> ids;
+  image_msg_t msg;
+  while (downlink.pop(msg)) ids.push_back(msg.img_chunk_id);
+  return ids;
+}
+
+int main() {
+  Downlink downlink;
+
+  // Image 65535 then image 0, the id wraps around
+  send(downlink, 65535, 40);
+  send(downlink, 0, 20);
+  expect(downlink.unacked() == 2, "images kept across the id wraparound");
+
+  // Everything but 12 and 21 received from base 10, crossing bytes of the bitmap
+  vector<int> received;
+  for (int i = 10; i < 34; i++) {
+    if (i != 12 && i != 21) received.push_back(i);
+  }
+  uplink_msg_t msg = ack(65535, 10, 3, received);
+  expect(downlink.ack(msg) == 0 && downlink.backlog() == 0, "nothing resent within the holdoff");
+
+  this_thread::sleep_for(chrono::milliseconds(static_cast<int>(Downlink::Holdoff * 1000.0f) + 100));
+
+  // Only the missing chunks inside the bitmap are resent, chunks past it are not yet reported
+  expect(downlink.ack(msg) == 2, "missing chunks queued again");
+  vector<int> resent = queued(downlink);
+  expect(resent.size() == 2 && resent[0] == 12 && resent[1] == 21, "missing chunks resent in order");
+
+  // A bitmap running past the last chunk: 12, just resent, is left alone, 34 is resent,
+  // and the chunks acknowledged before are not
+  received.clear();
+  for (int i = 10; i < 40; i++) {
+    if (i != 12 && i != 34) received.push_back(i);
+  }
+  expect(downlink.ack(ack(65535, 10, 4, received)) == 1 && queued(downlink) == vector<int>(1, 34), "only the old missing chunk resent");
+
+  // A chunk acknowledged while queued is skipped when popped
+  image_msg_t chunk;
+  memset(&chunk, 0, sizeof(chunk));
+  chunk.img_id = 0;
+  chunk.img_nchunks = 20;
+  chunk.img_chunk_id = 5;
+  downlink.push(chunk);
+  received.clear();
+  for (int i = 0; i < 16; i++) received.push_back(i);
+  downlink.ack(ack(0, 0, 2, received));
+  expect(queued(downlink).empty(), "chunk acknowledged while queued skipped");
+
+  // A bitmap running past the last chunk, and a base past it, complete the image
+  received.clear();
+  for (int i = 16; i < 20; i++) received.push_back(i);
+  expect(downlink.ack(ack(0, 16, Serializer::AckBytes, received)) == 0 && downlink.unacked() == 1, "bitmap past the last chunk completes the image");
+  expect(downlink.ack(ack(65535, 60000, 0, vector<int>())) == 0 && downlink.unacked() == 0, "base past the last chunk completes the image");
+
+  // An acknowledgement of an image no longer kept is ignored
+  expect(downlink.ack(ack(65535, 0, 1, vector<int>())) == 0 && downlink.backlog() == 0, "forgotten image ignored");
+
+  return failures == 0 ? 0 : 1;
+}
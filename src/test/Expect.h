@@ -0,0 +1,16 @@
+/**
+ * Reports the checks of a test, counting those that fail. A test returns
+ * failures == 0 ? 0 : 1 from main. Checks are printed through stdio, so
+ * a test capturing std::cout still reports them.
+ */
+#pragma once
+
+#include <cstdio>
+
+static int failures = 0;
+
+// Report a check
+static void expect(bool ok, const char *what) {
+  std::printf("%s%s\n", ok ? "PASS: " : "FAIL: ", what);
+  if (!ok) failures++;
+}
@@ -0,0 +1,94 @@
+/**
+ * Flight phase test
+ *
+ * Steps the detector through each transition with the condition held for
+ * one step less than its hold time and then for the full hold time, and
+ * checks that an interrupted condition starts its hold again.
+ */
+#include <iostream>
+
+#include "FlightPhase.h"
+#include "Expect.h"
+
+using namespace std;
+
+// Update steps times with the same measurements, returns true if the last update changed phase
+static bool steps(FlightPhase &flight, int steps, float altitude, float climb, float accel, float dt) {
+  bool changed = false;
+  for (int i = 0; i < steps; i++) changed = flight.update(altitude, climb, accel, dt);
+  return changed;
+}
+
+int main() {
+  const float launch = 337.0f;
+
+  // Launch on climb rate after AscentHold
+  FlightPhase flight;
+  steps(flight, static_cast<int>(FlightPhase::AscentHold) - 1, launch, 2.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Pad, "pad held until AscentHold");
+  expect(steps(flight, 1, launch, 2.0f, 0.0f, 1.0f) && flight.phase() == FlightPhase::Ascent, "ascent after AscentHold");
+  expect(flight.launchAltitude() == launch, "launch altitude tracked on the pad");
+
+  // An interrupted climb starts the hold again
+  FlightPhase bounce;
+  steps(bounce, 3, launch, 2.0f, 0.0f, 1.0f);
+  steps(bounce, 1, launch, 0.0f, 0.0f, 1.0f);
+  steps(bounce, 3, launch, 2.0f, 0.0f, 1.0f);
+  expect(bounce.phase() == FlightPhase::Pad, "interrupted climb restarts the hold");
+
+  // Launch on height above the pad, without a climb rate
+  FlightPhase lifted;
+  steps(lifted, 1, launch, 0.0f, 0.0f, 1.0f);
+  steps(lifted, static_cast<int>(FlightPhase::AscentHold), launch + 1.5f * FlightPhase::LaunchHeight, 0.0f, 0.0f, 1.0f);
+  expect(lifted.phase() == FlightPhase::Ascent, "ascent on height above the pad");
+
+  // Float once the climb rate settles for FloatHold
+  steps(flight, static_cast<int>(FlightPhase::FloatHold) - 1, 30000.0f, 0.5f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Ascent, "ascent held until FloatHold");
+  steps(flight, 1, 30000.0f, 0.5f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Float, "float after FloatHold");
+
+  // Ascent again on climbing
+  steps(flight, static_cast<int>(FlightPhase::AscentHold), 30000.0f, 2.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Ascent, "ascent again from float");
+
+  // Burst on falling for BurstHold, a rate just above the threshold is not falling
+  steps(flight, 10, 30000.0f, FlightPhase::BurstRate + 0.5f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Ascent, "no burst above BurstRate");
+  steps(flight, static_cast<int>(FlightPhase::BurstHold) - 1, 30000.0f, -6.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Ascent, "ascent held until BurstHold");
+  steps(flight, 1, 30000.0f, -6.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Burst, "burst after BurstHold");
+
+  // Burst on free fall after the shorter FreeFallHold
+  FlightPhase falling;
+  falling.set(FlightPhase::Float);
+  steps(falling, 1, 30000.0f, -1.0f, -8.0f, FlightPhase::FreeFallHold / 2.0f);
+  expect(falling.phase() == FlightPhase::Float, "float held until FreeFallHold");
+  steps(falling, 1, 30000.0f, -1.0f, -8.0f, FlightPhase::FreeFallHold / 2.0f);
+  expect(falling.phase() == FlightPhase::Burst, "burst after FreeFallHold");
+
+  // Descent after BurstTime
+  steps(flight, static_cast<int>(FlightPhase::BurstTime) - 1, 29000.0f, -30.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Burst, "burst held until BurstTime");
+  steps(flight, 1, 29000.0f, -30.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Descent, "descent after BurstTime");
+
+  // Landed once still for LandedHold, an interruption starts the hold again
+  steps(flight, static_cast<int>(FlightPhase::LandedHold) - 1, 400.0f, 0.0f, 0.0f, 1.0f);
+  steps(flight, 1, 400.0f, -5.0f, 0.0f, 1.0f);
+  steps(flight, static_cast<int>(FlightPhase::LandedHold) - 1, 400.0f, 0.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Descent, "descent held until LandedHold");
+  expect(steps(flight, 1, 400.0f, 0.0f, 0.0f, 1.0f) && flight.phase() == FlightPhase::Landed, "landed after LandedHold");
+
+  // Landed is final
+  steps(flight, 10, 400.0f, 5.0f, 0.0f, 1.0f);
+  expect(flight.phase() == FlightPhase::Landed, "landed is final");
+
+  // Resuming keeps the launch altitude
+  FlightPhase resumed;
+  resumed.resume(FlightPhase::Descent, launch);
+  expect(resumed.phase() == FlightPhase::Descent && resumed.launchAltitude() == launch, "resumed phase and launch altitude");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/**
+ * Frame score test
+ *
+ * Scores synthetic 320x240 RGB frames: a sharp textured scene, the same
+ * scene blurred as if by payload swing, and a frame of almost uniform
+ * sky, and checks the sharp scene is selected.
+ */
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include "FrameScore.h"
+#include "Expect.h"
+
+using namespace std;
+
+static const int Width = 320, Height = 240, Channels = 3;
+
+// Textured scene: fields of different brightness with sharp borders and noise
+static vector<uint8_t> scene(default_random_engine &rng) {
+  normal_distribution<double> noise(0.0, 6.0);
+  vector<uint8_t> image(Width * Height * Channels);
+  for (int y = 0; y < Height; y++) {
+    for (int x = 0; x < Width; x++) {
+      int field = ((x / 24) * 7 + (y / 20) * 13) % 9;
+      for (int c = 0; c < Channels; c++) {
+        double v = 30.0 + field * 22.0 + c * 8.0 + noise(rng);
+        image[(y * Width + x) * Channels + c] = static_cast<uint8_t>(max(0.0, min(255.0, v)));
+      }
+    }
+  }
+  return image;
+}
+
+// Horizontal motion blur
+static vector<uint8_t> blur(const vector<uint8_t> &image, int length) {
+  vector<uint8_t> out(image.size());
+  for (int y = 0; y < Height; y++) {
+    for (int x = 0; x < Width; x++) {
+      for (int c = 0; c < Channels; c++) {
+        int sum = 0, n = 0;
+        for (int k = -length / 2; k <= length / 2; k++) {
+          int xx = min(Width - 1, max(0, x + k));
+          sum += image[(y * Width + xx) * Channels + c];
+          n++;
+        }
+        out[(y * Width + x) * Channels + c] = static_cast<uint8_t>(sum / n);
+      }
+    }
+  }
+  return out;
+}
+
+// Sky: smooth vertical gradient with sensor noise
+static vector<uint8_t> sky(default_random_engine &rng) {
+  normal_distribution<double> noise(0.0, 2.0);
+  vector<uint8_t> image(Width * Height * Channels);
+  for (int y = 0; y < Height; y++) {
+    for (int x = 0; x < Width; x++) {
+      double base[3] = {90.0 + 0.1 * y, 140.0 + 0.1 * y, 220.0};
+      for (int c = 0; c < Channels; c++) {
+        double v = base[c] + noise(rng);
+        image[(y * Width + x) * Channels + c] = static_cast<uint8_t>(max(0.0, min(255.0, v)));
+      }
+    }
+  }
+  return image;
+}
+
+int main() {
+  default_random_engine rng(2018);
+  vector<uint8_t> sharp = scene(rng);
+  vector<uint8_t> blurred = blur(sharp, 15);
+  vector<uint8_t> empty = sky(rng);
+
+  const char *names[3] = {"sharp", "blurred", "sky"};
+  const vector<uint8_t> *frames[3] = {&sharp, &blurred, &empty};
+  float scores[3];
+
+  for (int i = 0; i < 3; i++) {
+    vector<uint8_t> grey;
+    int w, h;
+    FrameScore::downscale(frames[i]->data(), Width, Height, Channels, grey, w, h);
+    scores[i] = FrameScore::score(frames[i]->data(), Width, Height, Channels);
+
+    cout << fixed << setprecision(2) << names[i] << ": " << w << "x" << h;
+    cout << ", sharpness " << FrameScore::sharpness(grey.data(), w, h);
+    cout << ", entropy " << FrameScore::entropy(grey.data(), w, h) << " bits";
+    cout << ", score " << scores[i] << endl;
+
+    expect(w <= FrameScore::MaxWidth, "downscaled within MaxWidth");
+  }
+
+  expect(scores[0] > scores[1], "sharp scene scores above the blurred one");
+  expect(scores[0] > scores[2], "sharp scene scores above the sky");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+/**
+ * Power governor test
+ *
+ * Steps the battery voltage across the tier thresholds and checks that
+ * a tier is left as soon as the voltage falls below its threshold, but
+ * only regained once the voltage clears it by Hysteresis.
+ */
+#include <iostream>
+
+#include "Governor.h"
+#include "Expect.h"
+
+using namespace std;
+
+int main() {
+  Governor governor;
+  const float margin = Governor::Hysteresis / 2.0f;
+
+  expect(!governor.update(0.0f) && governor.tier() == Governor::Full, "unmeasured voltage ignored");
+  expect(!governor.update(6.5f) && governor.tier() == Governor::Full, "full on a fresh battery");
+  expect(!governor.update(Governor::FullVoltage) && governor.tier() == Governor::Full, "full at its threshold");
+
+  // Dropped at once just below a threshold
+  expect(governor.update(Governor::FullVoltage - 0.01f) && governor.tier() == Governor::Reduced, "reduced just below the full threshold");
+
+  // Regained only above the threshold plus the hysteresis
+  expect(!governor.update(Governor::FullVoltage + margin) && governor.tier() == Governor::Reduced, "reduced within the hysteresis");
+  expect(governor.update(Governor::FullVoltage + Governor::Hysteresis + margin) && governor.tier() == Governor::Full, "full above the hysteresis");
+
+  // Several tiers dropped in one step
+  expect(governor.update(Governor::LowVoltage - 0.1f) && governor.tier() == Governor::Critical, "critical below the low threshold");
+
+  // Recovery climbs only as far as the hysteresis allows
+  expect(!governor.update(Governor::LowVoltage + margin) && governor.tier() == Governor::Critical, "critical within the hysteresis");
+  expect(governor.update(Governor::LowVoltage + Governor::Hysteresis + margin) && governor.tier() == Governor::Low, "low above the hysteresis");
+  expect(governor.update(Governor::ReducedVoltage + Governor::Hysteresis + margin) && governor.tier() == Governor::Reduced, "reduced above the hysteresis");
+
+  // A full recovery regains every tier in one step
+  governor.update(Governor::LowVoltage - 0.1f);
+  expect(governor.update(6.5f) && governor.tier() == Governor::Full, "full regained from critical");
+
+  // Oscillating around a threshold does not flip the tier back and forth
+  int changes = 0;
+  governor.update(Governor::ReducedVoltage - 0.01f);
+  for (int i = 0; i < 10; i++) {
+    changes += governor.update(Governor::ReducedVoltage + margin);
+    changes += governor.update(Governor::ReducedVoltage - 0.01f);
+  }
+  expect(changes == 0 && governor.tier() == Governor::Low, "no flapping around a threshold");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+#include "../ground/Ingest.h"
+#include "Expect.h"
+
+/**
+ * Feeds the ground station ingest through a pseudo terminal standing in
+ * for the station XBee: sensor frames, a corrupt frame, and an image with
+ * a chunk missing, which must be acknowledged and then completed.
+ */
+
+using namespace std;
+
+static Serializer serializer;
+static uint16_t sequence = 0;
+// Wrap a frame, padded to length bytes as the Arduino relay does, in a receive packet and write it to the pty
+static void send(int master, uint8_t *frame, int size, bool corrupt = false, int length = 0) {
+  uint8_t frameData[XBeeApi::MaxFrame] = {XBeeApi::RxPacket, 0x00, 0x13, 0xA2, 0x00, 0x40, 0xF3, 0x2E, 0xA5, 0xFF, 0xFE, 0x01};
+  uint8_t encoded[XBeeApi::MaxEncoded];
+
+  serializer.seal(frame, size, sequence++);
+  if (corrupt) frame[20] ^= 0x01;
+  if (length < size) length = size;
+  memcpy(frameData + XBeeApi::RxHeader, frame, size);
+
+  size_t n = XBeeApi::encode(frameData, XBeeApi::RxHeader + length, encoded);
+  if (write(master, encoded, n) != static_cast<ssize_t>(n)) perror("write");
+}
+
+// Send one chunk of a w x h test image
+static void sendChunk(int master, uint16_t id, uint16_t chunk, uint16_t w, uint16_t h) {
+  image_msg_t msg;
+  uint8_t frame[Serializer::ImageSize] = {0};
+
+  memset(&msg, 0, sizeof(msg));
+  msg.type = Ingest::ImageType;
+  msg.img_id = id;
+  msg.img_chunk_id = chunk;
+  msg.img_nchunks = (w * h + Serializer::ChunkSize - 1) / Serializer::ChunkSize;
+  msg.img_chunksize = Serializer::ChunkSize;
+  msg.img_w = w;
+  msg.img_h = h;
+  for (int i = 0; i < Serializer::ChunkSize; i++) msg.img_chunk[i] = static_cast<uint8_t>(chunk * 16 + 1);
+
+  serializer.serialize(&msg, frame);
+  send(master, frame, Serializer::ImageSize);
+}
+
+// Process whatever the pty has buffered
+static void drain(Ingest &ingest) {
+  for (int i = 0; i < 20; i++) ingest.step(10);
+}
+
+// Read the uplink acknowledgements written back to the pty
+static int readAcks(int master, uplink_msg_t &last) {
+  XBeeApi decoder;
+  uint8_t buffer[1024];
+  int acks = 0;
+
+  ssize_t n;
+  while ((n = read(master, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t i = 0; i < n; i++) {
+      if (!decoder.decode(buffer[i]) || decoder.frame()[0] != XBeeApi::TxRequest) continue;
+
+      uint8_t payload[Serializer::UplinkSize];
+      uint16_t seq;
+      memcpy(payload, decoder.frame() + XBeeApi::TxHeader, Serializer::UplinkSize);
+      if (serializer.check(payload, Serializer::UplinkSize, seq)) {
+        serializer.deserialize(payload, &last);
+        acks++;
+      }
+    }
+  }
+  return acks;
+}
+
+int main() {
+  char dir[] = "/tmp/ingest_testXXXXXX";
+  if (mkdtemp(dir) == NULL) return 1;
+  string dbPath = string(dir) + "/ground.sqlite3";
+
+  // Pseudo terminal standing in for the station XBee
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+  fcntl(master, F_SETFL, O_NONBLOCK);
+
+  TelemetryStore store;
+  ImageAssembler assembler(dir);
+  Ingest ingest(store, assembler, 0x0013A20040F32EA5ULL);
+  expect(store.open(dbPath), "open database");
+  expect(ingest.open(ptsname(master), 9600), "open pty");
+
+  // Three sensor frames, one of them corrupt and the last padded by the relay
+  for (int i = 0; i < 3; i++) {
+    sensor_msg_t msg;
+    uint8_t frame[Serializer::SensorSize] = {0};
+    memset(&msg, 0, sizeof(msg));
+    msg.type = Ingest::SensorType;
+    msg.gps_alt = 1000.0f * i;
+    serializer.serialize(&msg, frame);
+    send(master, frame, Serializer::SensorSize, i == 1, i == 2 ? Serializer::ImageSize : 0);
+  }
+  drain(ingest);
+  expect(ingest.stats().sensor == 2, "two sensor frames decoded");
+  expect(ingest.stats().crcErrors == 1, "corrupt frame rejected");
+
+  // A 20x10 image has 3 chunks, the middle one is lost
+  sendChunk(master, 42, 0, 20, 10);
+  sequence++;
+  sendChunk(master, 42, 2, 20, 10);
+  drain(ingest);
+  expect(ingest.stats().lost == 2, "corrupt and lost frames counted as gaps");
+
+  uplink_msg_t ack;
+  memset(&ack, 0, sizeof(ack));
+  expect(readAcks(master, ack) == 1, "last chunk acknowledged");
+  expect(ack.type == Ingest::UplinkType && ack.img_id == 42 && ack.ack_base == 1 && ack.ack_bitmap[0] == 0x02, "missing chunk reported");
+  expect(!assembler.complete(42), "image incomplete");
+
+  // The resent chunk completes the image
+  sendChunk(master, 42, 1, 20, 10);
+  sendChunk(master, 42, 1, 20, 10);
+  drain(ingest);
+  expect(assembler.complete(42), "image complete");
+  expect(ingest.stats().duplicates == 1, "duplicate chunk ignored");
+  expect(readAcks(master, ack) == 1 && ack.ack_base == 3, "completion acknowledged");
+  expect(access(assembler.path(42).c_str(), F_OK) == 0, "preview written");
+
+  ingest.close();
+  store.close();
+
+  // Everything queued has been written
+  sqlite3 *db;
+  sqlite3_stmt *stmt;
+  int telemetry = -1, received = -1;
+  sqlite3_open(dbPath.c_str(), &db);
+  sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM telemetry", -1, &stmt, NULL);
+  if (sqlite3_step(stmt) == SQLITE_ROW) telemetry = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  sqlite3_prepare_v2(db, "SELECT received FROM image WHERE img_id = 42", -1, &stmt, NULL);
+  if (sqlite3_step(stmt) == SQLITE_ROW) received = sqlite3_column_int(stmt, 0);
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+  expect(telemetry == 2, "telemetry stored");
+  expect(received == 3, "image progress stored");
+
+  ingest.report(cout);
+  close(master);
+  return failures == 0 ? 0 : 1;
+}
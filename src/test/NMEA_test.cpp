@@ -0,0 +1,95 @@
+/**
+ * NMEA/UBX parser replay test
+ *
+ * Replays a recorded NMEA log through the parser, one byte at a time
+ * as it would arrive from the UART, followed by a synthetic UBX
+ * NAV-PVT packet, and prints the decoded fixes.
+ *
+ * Usage: NMEA_test [/path/to/recording.nmea]
+ */
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+#include "NMEA.h"
+#include "Expect.h"
+
+using namespace std;
+
+static void printFix(const gnss_fix_t &fix) {
+  cout << "time: " << fixed << setprecision(2) << fix.time;
+  cout << ", nsats: " << static_cast<int>(fix.nsats);
+  cout << ", status: " << static_cast<int>(fix.status);
+  cout << ", mode: " << static_cast<int>(fix.mode) << endl;
+  cout << "lat, lon: " << setprecision(6) << fix.latitude << ", " << fix.longitude;
+  cout << ", alt: " << setprecision(1) << fix.altitude;
+  cout << ", dir: " << fix.track;
+  cout << ", gspd: " << setprecision(2) << fix.speed;
+  cout << ", vspd: " << fix.climb << endl;
+}
+
+int main(int argc, char *argv[]) {
+  const char *path = (argc > 1) ? argv[1] : "src/test/data/gps_replay.nmea";
+  NMEA nmea;
+
+  ifstream in(path, ios::binary);
+  if (!in) {
+    cerr << "Unable to open " << path << endl;
+    return 1;
+  }
+  vector<uint8_t> recording((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+  // Replay the recording
+  int fixes = 0;
+  for (size_t i = 0; i < recording.size(); i++) {
+    if (nmea.parse(recording[i])) {
+      const gnss_fix_t &fix = nmea.fix();
+      if ((fix.set & NMEA::AltitudeSet) && (fix.set & NMEA::LatLonSet)) {
+        if (fixes % 10 == 0) printFix(fix);
+        fixes++;
+        nmea.clearSet();
+      }
+    }
+  }
+
+  cout << "Replayed " << recording.size() << " bytes: " << nmea.sentences() << " sentences, ";
+  cout << fixes << " fixes, " << nmea.errors() << " errors" << endl;
+  printFix(nmea.fix());
+
+  expect(fixes == 30 && nmea.errors() == 1, "recording replayed");
+  expect(nmea.fix().mode == NMEA::Mode3D && nmea.fix().nsats != 0, "3D fix from the recording");
+  expect(fabs(nmea.fix().altitude - 482.0) <= 1.0E-6 && fabs(nmea.fix().climb - 5.0) <= 1.0E-6, "altitude and climb of the recording");
+  expect(fabs(nmea.fix().latitude - 43.458416) <= 1.0E-5 && nmea.fix().longitude <= -80.0, "position of the recording");
+
+  // Synthetic UBX NAV-PVT packet
+  uint8_t pvt[92] = {0}, packet[100];
+  int32_t lon = -804920564, lat = 434578362, hmsl = 30000000, veld = 5500, gspeed = 12000, head = 9000000;
+  pvt[8] = 13; pvt[9] = 45; pvt[10] = 30;
+  pvt[20] = 3;    // 3D fix
+  pvt[21] = 0x01; // gnssFixOK
+  pvt[23] = 11;
+  memcpy(pvt + 24, &lon, 4);
+  memcpy(pvt + 28, &lat, 4);
+  memcpy(pvt + 36, &hmsl, 4);
+  memcpy(pvt + 56, &veld, 4);
+  memcpy(pvt + 60, &gspeed, 4);
+  memcpy(pvt + 64, &head, 4);
+  size_t len = NMEA::ubxPacket(NMEA::UbxNav, NMEA::UbxNavPvt, pvt, sizeof(pvt), packet);
+
+  nmea.clearSet();
+  expect(nmea.parse(packet, len) == 1, "NAV-PVT packet parsed");
+  cout << "UBX NAV-PVT:" << endl;
+  printFix(nmea.fix());
+  expect(fabs(nmea.fix().altitude - 30000.0) <= 1.0E-6 && fabs(nmea.fix().climb + 5.5) <= 1.0E-6, "NAV-PVT altitude and climb");
+  expect(nmea.fix().nsats == 11 && nmea.fix().status == NMEA::StatusFix, "NAV-PVT satellites and status");
+
+  // A corrupted packet must be rejected
+  packet[30] ^= 0xFF;
+  expect(nmea.parse(packet, len) == 0, "corrupted packet rejected");
+
+  return failures == 0 ? 0 : 1;
+}
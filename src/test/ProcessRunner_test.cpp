@@ -0,0 +1,73 @@
+#include <unistd.h>
+#include <chrono>
+
+#include "ProcessRunner.h"
+#include "Expect.h"
+
+/**
+ * Runs short shell commands through the runner, and checks their exit
+ * status, captured and streamed output, timeouts, the limit on children
+ * running at once, and stopping children by name.
+ */
+
+using namespace std;
+using namespace std::chrono;
+
+int main() {
+  static ProcessRunner runner;
+
+  process_result_t result = runner.run({"true"}, 1000);
+  expect(result.status == 0 && !result.timedOut, "true exits with 0");
+
+  result = runner.run({"sh", "-c", "echo failed >&2; exit 3"}, 1000);
+  expect(result.status == 3, "exit status collected");
+  expect(result.err == "failed\n", "stderr captured");
+
+  result = runner.run({"sh", "-c", "echo frame"}, 1000, true);
+  expect(result.status == 0 && result.out == "frame\n", "stdout captured");
+
+  result = runner.run({"no-such-tool"}, 1000);
+  expect(result.status != 0, "missing tool fails");
+
+  // A streaming child's stdout is read by the caller as it is written
+  int outFd = -1;
+  int streamJob = runner.stream({"sh", "-c", "echo one; sleep 0.1; echo two"}, 0, outFd);
+  string streamed;
+  char buffer[64];
+  ssize_t n;
+  while (outFd >= 0 && (n = read(outFd, buffer, sizeof(buffer))) > 0) streamed.append(buffer, n);
+  if (outFd >= 0) close(outFd);
+  expect(runner.wait(streamJob).status == 0 && streamed == "one\ntwo\n", "stdout streamed to the caller");
+
+  // A child past its timeout is stopped
+  steady_clock::time_point start = steady_clock::now();
+  result = runner.run({"sleep", "10"}, 100);
+  expect(result.timedOut && result.status == -1, "sleep stopped at its timeout");
+  expect(steady_clock::now() - start < milliseconds(1000), "timeout prompt");
+
+  // A third child waits for one of the first two to finish
+  start = steady_clock::now();
+  int first = runner.start({"sleep", "0.3"}, 2000);
+  int second = runner.start({"sleep", "0.3"}, 2000);
+  expect(first >= 0 && second >= 0 && !runner.finished(first), "two children running");
+  int third = runner.start({"true"}, 2000);
+  expect(steady_clock::now() - start >= milliseconds(250), "third child waited for a slot");
+  expect(runner.wait(third).status == 0, "third child ran");
+  runner.wait(first);
+  runner.wait(second);
+
+  // Children are stopped by name
+  int job = runner.start({"sleep", "10"}, 20000);
+  expect(runner.terminate("sleep") == 1, "one sleep terminated");
+  result = runner.wait(job);
+  expect(!result.timedOut && result.status == -1, "terminated sleep collected");
+
+  // Stopping ends running children and refuses new ones
+  start = steady_clock::now();
+  runner.start({"sleep", "10"}, 20000);
+  runner.stop();
+  expect(steady_clock::now() - start < milliseconds(1000), "stop prompt");
+  expect(runner.start({"true"}, 1000) < 0, "no children after stop");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -1,46 +1,86 @@
 #include "Serializer.h"
+#include "CRC.h"
+#include "Expect.h"
 
 /**
- * Actually there is no need to use the new at all. Here are further possible improvements:
- * 1. make the MSG a return type of the deserialize function instead of an output parameter
- * 2. instead of typedef struct MSG{...}MSG; use struct MSG{...};, it's the same in C++
- * 3. use std::string or std::vector<byte> to hold the serialized data (and dispose of that #define PACKETSIZE altogether)
- *    and use it as a return value of the serialize function instead of the output parameter (or if you insist change the parameter to char(&data)[PACKETSIZE]).
+ * Serializes an image chunk and a sensor message, seals them with the
+ * sequence number and CRC-16 trailer, and checks that they read back
+ * unchanged, that corrupt frames are rejected, and that both CRCs match
+ * their published check values.
  */
 
 using namespace std;
 
 int main() {
   Serializer serializer;
-  uint8_t data[PACKETSIZE] = {0};
-  i2c_msg_t msg;
 
-  cout << "Original:" << endl;
+  // Check values of "123456789"
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  expect(CRC::crc16(check, sizeof(check)) == 0x29B1, "CRC-16/CCITT-FALSE check value");
+  expect(CRC::crc32(check, sizeof(check)) == 0xCBF43926, "CRC-32 check value");
+  expect(CRC::crc16(check + 4, sizeof(check) - 4, CRC::crc16(check, 4)) == 0x29B1, "CRC-16 continued across calls");
+
+  // The header, a full chunk and the trailer fill the largest frame
+  expect(Serializer::ImageSize == Serializer::PayloadSize, "image frame fills the payload");
+  expect(HEADERSIZE + CHUNKSIZE + TRAILERSIZE == PAYLOADSIZE, "chunk leaves room for the trailer");
+
+  image_msg_t msg;
+  msg.type = 0x70;
+  msg.img_chunksize = CHUNKSIZE;
   msg.img_id = 1;
-  msg.img_chunkid = 9;
+  msg.img_chunk_id = 9;
   msg.img_nchunks = 22;
   msg.img_w = 640;
   msg.img_h = 480;
-  msg.type = 5;
-  //msg.img_chunksize = 3;
-  //msg.img_chunk[0] = 'H';
-  //msg.img_chunk[1] = 'i';
-  //msg.img_chunk[2] = '\0';
-  msg.img_chunksize = 18;
-  memcpy(&msg.img_chunk, (const uint8_t*)("Hello from HABPI!"), sizeof(msg.img_chunk));
-  serializer.print(msg);
-
-  cout << "Serialized:" << endl;
+  for (int i = 0; i < CHUNKSIZE; i++) msg.img_chunk[i] = static_cast<uint8_t>(i * 7 + 1);
+
+  uint8_t data[PAYLOADSIZE] = {0};
   serializer.serialize(&msg, data);
-  for(int16_t i = 0; i < PACKETSIZE; i++) {
-    cout << static_cast<int16_t>(data[i]) << " ";
-  }
-  cout << '\n' << endl;
+  serializer.seal(data, Serializer::ImageSize, 0xBEEF);
+
+  uint16_t seq = 0;
+  expect(serializer.check(data, Serializer::ImageSize, seq) && seq == 0xBEEF, "sealed image frame checks");
 
-  cout << "Deserialized:" << endl;
-  i2c_msg_t temp;
+  image_msg_t temp;
   serializer.deserialize(data, &temp);
-  serializer.print(temp);
+  expect(temp.type == msg.type && temp.img_chunksize == msg.img_chunksize && temp.img_id == msg.img_id &&
+         temp.img_chunk_id == msg.img_chunk_id && temp.img_nchunks == msg.img_nchunks &&
+         temp.img_w == msg.img_w && temp.img_h == msg.img_h, "image header read back");
+  expect(memcmp(temp.img_chunk, msg.img_chunk, CHUNKSIZE) == 0, "last chunk byte not overwritten by the trailer");
+
+  // Any single flipped bit, in the message or the trailer, is rejected
+  bool rejected = true;
+  for (int i = 0; i < Serializer::ImageSize * 8; i++) {
+    data[i / 8] ^= static_cast<uint8_t>(1 << (i % 8));
+    if (serializer.check(data, Serializer::ImageSize, seq)) rejected = false;
+    data[i / 8] ^= static_cast<uint8_t>(1 << (i % 8));
+  }
+  expect(rejected, "single bit errors rejected");
+
+  // A changed sequence number without a new CRC is rejected
+  data[Serializer::ImageSize - 4]++;
+  expect(!serializer.check(data, Serializer::ImageSize, seq), "altered sequence number rejected");
+
+  sensor_msg_t sensor;
+  memset(&sensor, 0, sizeof(sensor));
+  sensor.type = 0x60;
+  sensor.gps_nsats = 9;
+  sensor.gps_lat = 43.6532f;
+  sensor.gps_lon = -79.3832f;
+  sensor.gps_alt = 21034.5f;
+  sensor.mpl_pres = 4470.0f;
+  sensor.bat_ard = 7.4f;
+
+  uint8_t sensorData[PAYLOADSIZE] = {0};
+  serializer.serialize(&sensor, sensorData);
+  serializer.seal(sensorData, Serializer::SensorSize, 65535);
+  expect(serializer.check(sensorData, Serializer::SensorSize, seq) && seq == 65535, "sealed sensor frame checks");
+
+  sensor_msg_t sensorTemp;
+  serializer.deserialize(sensorData, &sensorTemp);
+  expect(sensorTemp.type == sensor.type && sensorTemp.gps_nsats == sensor.gps_nsats && sensorTemp.gps_lat == sensor.gps_lat &&
+         sensorTemp.gps_lon == sensor.gps_lon && sensorTemp.gps_alt == sensor.gps_alt &&
+         sensorTemp.mpl_pres == sensor.mpl_pres && sensorTemp.bat_ard == sensor.bat_ard, "sensor message read back");
 
-  return 0;
+  return failures == 0 ? 0 : 1;
 }
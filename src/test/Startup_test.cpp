@@ -0,0 +1,63 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "Startup.h"
+#include "Expect.h"
+
+/**
+ * Runs a small startup graph: a bus, two sensors behind it (one failing),
+ * a slow component past its deadline and one throwing, and checks the
+ * ordering, the waits and the timeline.
+ */
+
+using namespace std;
+using namespace std::chrono;
+
+int main() {
+  static Startup init;
+  atomic<bool> busUp(false), sensorAfterBus(false), slowUp(false);
+
+  int bus = init.add("bus", [&]() {
+    this_thread::sleep_for(milliseconds(50));
+    busUp = true;
+    return true;
+  }, 200);
+  int broken = init.add("broken", []() { return false; }, 200, {bus});
+  int sensor = init.add("sensor", [&]() {
+    sensorAfterBus = busUp.load();
+    return true;
+  }, 200, {bus});
+  int slow = init.add("slow", [&]() {
+    this_thread::sleep_for(milliseconds(400));
+    slowUp = true;
+    return true;
+  }, 100);
+  int thrower = init.add("thrower", []() -> bool { throw runtime_error("no device"); }, 100);
+
+  steady_clock::time_point start = steady_clock::now();
+  init.start();
+
+  // The first ready sensor ends the wait, well before the slow component
+  expect(init.waitAny({slow, broken, sensor}), "one sensor ready");
+  expect(sensorAfterBus, "sensor ran after the bus");
+  expect(!init.wait(broken), "failed component unavailable");
+  expect(!init.wait(thrower), "throwing component unavailable");
+
+  // Waiting gives up at the deadline, and the component joins later
+  expect(!init.wait(slow) && !slowUp, "slow component past its deadline");
+  expect(steady_clock::now() - start < milliseconds(300), "wait bounded by the deadline");
+  this_thread::sleep_for(milliseconds(400));
+  expect(init.ready(slow), "slow component joined later");
+
+  ostringstream timeline;
+  init.report(timeline);
+  cout << timeline.str();
+  expect(timeline.str().find("slow") != string::npos && timeline.str().find("(late)") != string::npos, "timeline reports late component");
+
+  init.join();
+  return failures == 0 ? 0 : 1;
+}
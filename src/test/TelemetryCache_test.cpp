@@ -0,0 +1,102 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "TelemetryCache.h"
+#include "Expect.h"
+
+/**
+ * Inserts an hour of samples at irregular times, with a long gap, and
+ * checks every window and recent query of the cache against a brute
+ * force aggregate of the same samples.
+ */
+
+using namespace std;
+using namespace std::chrono;
+
+struct sample_t {
+  int64_t ms;
+  float value;
+};
+
+// Brute force aggregate of the samples in buckets of resolution, from the bucket n before the last sample's onward
+static bool brute(const vector<sample_t> &samples, int resolution, int n, telemetry_stats_t &stats) {
+  int64_t last = samples.back().ms / resolution;
+  double sum = 0.0;
+  stats.count = 0;
+  stats.min = INFINITY;
+  stats.max = -INFINITY;
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (samples[i].ms / resolution < last - n) continue;
+    stats.count++;
+    stats.min = min(stats.min, samples[i].value);
+    stats.max = max(stats.max, samples[i].value);
+    sum += samples[i].value;
+  }
+  stats.mean = static_cast<float>(sum / stats.count);
+  return stats.count > 0;
+}
+
+// Compare two aggregates
+static bool same(const telemetry_stats_t &a, const telemetry_stats_t &b) {
+  return a.count == b.count && a.min == b.min && a.max == b.max && fabs(a.mean - b.mean) <= 1.0E-3f * fabs(b.mean) + 1.0E-3f;
+}
+
+int main() {
+  static TelemetryCache cache;
+  vector<sample_t> samples;
+  steady_clock::time_point origin = steady_clock::now();
+  sensor_msg_t msg;
+  memset(&msg, 0, sizeof(msg));
+
+  // Samples every 0.3 to 2.5 s for an hour, then nothing for 20 minutes, then another 10 minutes
+  int64_t ms = 0;
+  unsigned int seed = 1;
+  while (ms < 5400000) {
+    if (ms > 3600000 && ms < 4800000) ms = 4800000;
+    seed = seed * 1103515245 + 12345;
+    msg.mpl_alt = static_cast<float>((seed >> 8) % 30000) / 10.0f;
+    msg.gps_nsats = static_cast<uint8_t>(seed % 12);
+    cache.insert(msg, origin + milliseconds(ms));
+
+    sample_t sample = {ms, msg.mpl_alt};
+    samples.push_back(sample);
+    ms += 300 + (seed >> 4) % 2200;
+  }
+
+  telemetry_stats_t expected, actual;
+  bool ok = true;
+
+  // Last n raw samples
+  for (int n = 1; n < TelemetryCache::Capacity; n++) {
+    vector<sample_t> last(samples.end() - n, samples.end());
+    brute(last, 1, 1 << 30, expected);
+    if (!cache.recent(TelemetryCache::MplAlt, n, actual) || !same(actual, expected)) ok = false;
+  }
+  expect(ok, "recent samples match");
+
+  // Windows of every length, each answered by the finest tier that spans it
+  ok = true;
+  for (int seconds = 1; seconds <= 4 * 3600; seconds += (seconds < 600 ? 1 : 7)) {
+    int resolution = seconds <= 255 ? 1000 : seconds <= 2550 ? 10000 : 60000;
+    int n = static_cast<int>(ceil(seconds * 1000.0 / resolution)) - 1;
+    n = min(n, TelemetryCache::Capacity - 1);
+    brute(samples, resolution, n, expected);
+    if (!cache.window(TelemetryCache::MplAlt, static_cast<float>(seconds), actual) || !same(actual, expected)) {
+      if (ok) printf("window %d s: count %u/%u min %g/%g max %g/%g mean %g/%g\n", seconds, actual.count, expected.count,
+                     actual.min, expected.min, actual.max, expected.max, actual.mean, expected.mean);
+      ok = false;
+    }
+  }
+  expect(ok, "windows match");
+
+  // Fields other than the first are kept apart
+  expect(cache.window(TelemetryCache::GpsNsats, 3600.0f, actual) && actual.max <= 11.0f && actual.min >= 0.0f, "integer field");
+
+  // An empty cache has nothing to report
+  static TelemetryCache empty;
+  expect(!empty.window(TelemetryCache::MplAlt, 10.0f, actual) && !empty.recent(TelemetryCache::MplAlt, 5, actual), "empty cache");
+
+  return failures == 0 ? 0 : 1;
+}
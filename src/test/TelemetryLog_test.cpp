@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TelemetryLog.h"
+#include "Expect.h"
+
+/**
+ * Writes a telemetry log across several blocks, tears the tail of the
+ * segment as a power cut would, and checks that reopening cuts it back
+ * to the last whole block, and that reads from a time skip earlier data.
+ */
+
+using namespace std;
+
+// Size of a file, -1 if missing
+static off_t fileSize(const string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+// Append n records stamped from time on, one microsecond apart
+static void fill(TelemetryLog &log, uint64_t time, int n) {
+  for (int i = 0; i < n; i++) {
+    telemetry_record_t record;
+    memset(&record, 0, sizeof(record));
+    record.time = time + i;
+    record.type = 4;
+    record.sensor = 1;
+    record.value = static_cast<float>(i);
+    log.append(record);
+  }
+}
+
+int main() {
+  char dir[] = "/tmp/telemetry_testXXXXXX";
+  if (mkdtemp(dir) == NULL) return 1;
+  string directory = string(dir) + "/log";
+
+  // 40 full blocks, enough for three index entries, and a partial block flushed by close
+  int total = 40 * TelemetryLog::BlockRecords + 100;
+  TelemetryLog log;
+  expect(log.open(directory), "open log");
+  fill(log, 1000000, total);
+  log.close();
+  expect(log.dropped() == 0, "no blocks dropped");
+
+  vector<string> segments = TelemetryLog::segments(directory);
+  expect(segments.size() == 1, "one segment");
+  if (segments.empty()) return 1;
+
+  vector<telemetry_record_t> records;
+  expect(TelemetryLog::read(segments[0], 0, records), "read segment");
+  expect(static_cast<int>(records.size()) == total, "every record read back");
+  expect(!records.empty() && records.back().time == 1000000ULL + total - 1 && records.back().value == static_cast<float>(total - 1), "records intact");
+
+  // Reading from a time only returns later records
+  uint64_t from = 1000000 + 35 * TelemetryLog::BlockRecords + 7;
+  records.clear();
+  TelemetryLog::read(segments[0], from, records);
+  expect(!records.empty() && records.front().time == from && records.size() == 1000000ULL + total - from, "read from time");
+
+  // Tear the last block, and write half a block header after it
+  off_t size = fileSize(segments[0]);
+  if (truncate(segments[0].c_str(), size - 8) != 0) perror("truncate");
+  int fd = open(segments[0].c_str(), O_WRONLY | O_APPEND);
+  uint8_t garbage[10] = {0xFF, 0xFF, 0xFF, 0xFF, 0x10, 0x00};
+  if (write(fd, garbage, sizeof(garbage)) != sizeof(garbage)) perror("write");
+  close(fd);
+
+  off_t valid = TelemetryLog::recover(segments[0]);
+  expect(valid == size - static_cast<off_t>(TelemetryLog::BlockHeaderSize + 100 * sizeof(telemetry_record_t)), "torn tail cut back to the last block");
+  expect(fileSize(segments[0]) == valid, "segment truncated");
+
+  // Reopening recovers the last segment and starts the next
+  TelemetryLog reopened;
+  expect(reopened.open(directory), "reopen log");
+  fill(reopened, 2000000, 10);
+  reopened.close();
+
+  segments = TelemetryLog::segments(directory);
+  expect(segments.size() == 2, "new segment started");
+  records.clear();
+  for (size_t i = 0; i < segments.size(); i++) TelemetryLog::read(segments[i], 0, records);
+  expect(static_cast<int>(records.size()) == 40 * TelemetryLog::BlockRecords + 10, "records after recovery");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "VideoRing.h"
+#include "Expect.h"
+
+/**
+ * Feeds the ring from files written by a stub encoder, an Annex B stream
+ * with an SPS, PPS and IDR picture every second and P pictures between,
+ * and checks what the ring keeps and what an event writes out.
+ */
+
+using namespace std;
+
+// Append a NAL unit of type with a payload of size bytes, starting a picture for slices
+static void nal(vector<uint8_t> &stream, uint8_t type, size_t size) {
+  const uint8_t start[] = {0x00, 0x00, 0x00, 0x01};
+  stream.insert(stream.end(), start, start + sizeof(start));
+  stream.push_back(0x60 | type);
+  if (type == VideoRing::NalSlice || type == VideoRing::NalIdr) stream.push_back(0x88);
+  stream.insert(stream.end(), size, 0xA5);
+}
+
+// Write seconds of stream at VideoRing::Framerate to path
+static void encode(const char *path, int seconds) {
+  vector<uint8_t> stream;
+  for (int i = 0; i < seconds * VideoRing::Framerate; i++) {
+    if (i % VideoRing::Framerate == 0) {
+      nal(stream, VideoRing::NalSps, 8);
+      nal(stream, 8, 4);
+      nal(stream, VideoRing::NalIdr, 4000);
+    } else {
+      nal(stream, VideoRing::NalSlice, 500);
+    }
+  }
+  ofstream out(path, ios::out | ios::binary | ios::trunc);
+  out.write(reinterpret_cast<const char *>(stream.data()), stream.size());
+}
+
+// Feed the stream in path to ring
+static bool feed(VideoRing &ring, const char *path) {
+  atomic<bool> running(true);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  bool ok = ring.feed(fd, false, running);
+  close(fd);
+  return ok;
+}
+
+// Count the pictures in the stream in path
+static int count(const char *path, bool &keyframe) {
+  ifstream in(path, ios::in | ios::binary);
+  vector<uint8_t> stream((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  keyframe = stream.size() > 4 && (stream[4] & 0x1F) == VideoRing::NalSps;
+
+  int pictures = 0;
+  for (size_t i = 0; i + 4 < stream.size(); i++) {
+    if (stream[i] == 0 && stream[i + 1] == 0 && stream[i + 2] == 1) {
+      uint8_t type = stream[i + 3] & 0x1F;
+      if ((type == VideoRing::NalSlice || type == VideoRing::NalIdr) && (stream[i + 4] & 0x80)) pictures++;
+    }
+  }
+  return pictures;
+}
+
+int main() {
+  const char *before = "/tmp/VideoRing_before.h264";
+  const char *after = "/tmp/VideoRing_after.h264";
+  const char *event = "/tmp/VideoRing_event.h264";
+  encode(before, 30);
+  encode(after, 10);
+
+  // The ring keeps whole seconds from a keyframe, covering the pre-trigger
+  VideoRing ring(10000, 1024 * 1024, VideoRing::Framerate);
+  expect(feed(ring, before), "stream fed from file");
+  expect(ring.time() == 30000, "stream time from the pictures");
+  expect(ring.duration() >= 10000 && ring.duration() < 11000, "ring covers the pre-trigger");
+  expect(ring.size() < 1024 * 1024, "ring within capacity");
+
+  // An event writes the ring, then the post-trigger
+  expect(ring.trigger(event, 5000) && ring.flushing(), "event started");
+  expect(ring.flush() && ring.flushing(), "event open until the post-trigger has passed");
+  expect(feed(ring, after), "stream fed after the event");
+  expect(ring.flush() && !ring.flushing(), "event closed after the post-trigger");
+
+  bool keyframe;
+  int pictures = count(event, keyframe);
+  expect(keyframe, "event starts at a keyframe");
+  expect(pictures == (10 + 5) * VideoRing::Framerate, "event holds the pre-trigger and post-trigger pictures");
+
+  // A ring smaller than a keyframe interval drops it whole rather than keep part of it
+  VideoRing small(10000, 16 * 1024, VideoRing::Framerate);
+  feed(small, before);
+  expect(small.size() == 0 && small.duration() == 0, "segment larger than a small ring dropped");
+
+  remove(before);
+  remove(after);
+  remove(event);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+#include <cstring>
+#include <vector>
+
+#include "XBeeApi.h"
+#include "Expect.h"
+
+/**
+ * Encodes API frames and feeds them back through the decoder, checking
+ * the checksum against a frame from the XBee manual, the escaping of the
+ * reserved bytes, and that the decoder resynchronises after a corrupt or
+ * truncated frame.
+ */
+
+using namespace std;
+
+// Feed bytes to the decoder, returns the number of complete frames
+static int feed(XBeeApi &decoder, const uint8_t *bytes, size_t n) {
+  int frames = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (decoder.decode(bytes[i])) frames++;
+  }
+  return frames;
+}
+
+int main() {
+  uint8_t encoded[XBeeApi::MaxEncoded];
+
+  // AT command NI, frame id 1, from the XBee manual: 7E 00 04 08 01 4E 49 5F
+  const uint8_t at[] = {0x08, 0x01, 0x4E, 0x49};
+  const uint8_t atEncoded[] = {0x7E, 0x00, 0x04, 0x08, 0x01, 0x4E, 0x49, 0x5F};
+  size_t n = XBeeApi::encode(at, sizeof(at), encoded);
+  expect(n == sizeof(atEncoded) && memcmp(encoded, atEncoded, n) == 0, "checksum matches the manual");
+
+  // Each reserved byte is escaped, and nothing after the start delimiter is a raw reserved byte
+  const uint8_t reserved[] = {XBeeApi::RxPacket, 0x7E, 0x7D, 0x11, 0x13, 0x42};
+  n = XBeeApi::encode(reserved, sizeof(reserved), encoded);
+  bool clean = true;
+  for (size_t i = 1; i < n; i++) {
+    if (encoded[i] == 0x7E || encoded[i] == 0x11 || encoded[i] == 0x13) clean = false;
+    if (encoded[i] == 0x7D && (i + 1 >= n || (encoded[i + 1] != (0x7E ^ 0x20) && encoded[i + 1] != (0x7D ^ 0x20) &&
+                                              encoded[i + 1] != (0x11 ^ 0x20) && encoded[i + 1] != (0x13 ^ 0x20)))) clean = false;
+  }
+  expect(clean && n == 1 + 2 + sizeof(reserved) + 4 + 1, "reserved bytes escaped");
+
+  XBeeApi decoder;
+  expect(feed(decoder, encoded, n) == 1, "escaped frame decoded");
+  expect(decoder.length() == sizeof(reserved) && memcmp(decoder.frame(), reserved, sizeof(reserved)) == 0, "escaped frame restored");
+
+  // A corrupt checksum is rejected, and the next frame still decodes
+  vector<uint8_t> stream(encoded, encoded + n);
+  stream[n - 1] ^= 0x01;
+  size_t good = XBeeApi::encode(at, sizeof(at), encoded);
+  stream.insert(stream.end(), encoded, encoded + good);
+  XBeeApi corrupt;
+  expect(feed(corrupt, stream.data(), stream.size()) == 1 && corrupt.errors() == 1, "bad checksum rejected");
+  expect(corrupt.length() == sizeof(at) && memcmp(corrupt.frame(), at, sizeof(at)) == 0, "next frame decoded after a bad checksum");
+
+  // A frame cut short by a new start delimiter is dropped, and the decoder resynchronises on it
+  stream.assign(encoded, encoded + good - 3);
+  stream.insert(stream.end(), encoded, encoded + good);
+  XBeeApi truncated;
+  expect(feed(truncated, stream.data(), stream.size()) == 1 && truncated.errors() == 1, "resynchronised after a truncated frame");
+
+  // Line noise before a frame is skipped
+  const uint8_t noise[] = {0x00, 0xFF, 0x20, 0x5D};
+  XBeeApi noisy;
+  expect(feed(noisy, noise, sizeof(noise)) == 0 && feed(noisy, encoded, good) == 1 && noisy.errors() == 0, "noise before a frame skipped");
+
+  // An oversized length is rejected
+  const uint8_t oversized[] = {0x7E, 0x7D, 0x31, 0x00};
+  XBeeApi large;
+  expect(feed(large, oversized, sizeof(oversized)) == 0 && large.errors() == 1, "oversized frame rejected");
+
+  return failures == 0 ? 0 : 1;
+}